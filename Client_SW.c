@@ -1,6 +1,32 @@
 #include "BluetoothSerial.h"  // BT: Include the Serial Bluetooth library
+#include "esp_bt_device.h"     // BT: Own address, to seed the reconnect jitter
+#include "esp_bt.h"            // BT: Controller modem sleep
+#include "esp_pm.h"            // Automatic light sleep and the lock that holds it off
+#include "esp_sleep.h"         // Light-sleep wake-up sources
+#include "driver/gpio.h"       // Wake-up on the GPS RX pin
+#include "LittleFS.h"           // Flash file system for captures
+#include <Preferences.h>        // NVS storage for the warm-start state
 #include <TinyGPSPlus.h>      // Include TinyGPSPlus library for GPS parsing
 #include <LiquidCrystal.h>    // Include LiquidCrystal library for LCD display
+#include "src/PositionFrame.h"  // Binary position frame shared with the master
+#include "src/PositionStream.h" // Keyframe plus delta stream on top of the binary frame
+#include "src/DeadReckoning.h"  // Extrapolates the master between updates
+#include "src/Breadcrumbs.h"    // Thinned, delta-compressed trail of the master's positions
+#include "src/Geofence.h"       // Zone and waypoint enter/exit alerts with a grid index
+#include "src/LinkClock.h"      // Round-trip time, clock offset and position age over the link
+#include "src/RxRing.h"         // Receive ring and line assembler for the Bluetooth link
+#include "src/Geodesy.h"        // Distance and bearing kernel
+#include "src/LcdShadow.h"      // LCD framebuffer that only sends changed cells
+#include "src/GpsConfig.h"      // Start-up baud, rate and sentence setup of the GPS receiver
+#include "src/LinkState.h"      // Connection state machine with jittered backoff
+#include "src/Profiler.h"       // Per-stage cycle histograms, dumped on request
+#include "src/LogEvents.h"      // Deferred event log and the events this sketch records
+#include "src/PowerManager.h"   // GPS burst prediction and duty-cycle measurement for light sleep
+#include "src/Capture.h"        // GPS and link traffic capture for replay on the host
+#include "src/Seqlock.h"        // Lock-free position snapshots between the two cores
+#include "src/WarmStart.h"      // Last fixes and peer kept in NVS, receiver aiding and the boot timeline
+#include "src/HeapWatch.h"      // Heap allocations made after setup()
+#include "src/PositionFilter.h" // Kalman smoothing of this client's own fixes
 
 #define LED_BT 2  // BT: Internal LED (or LED on the pin D2) for the connection indication (connected solid/disconnected blinking)
 #define GPS_RX_PIN 16
@@ -12,28 +38,258 @@
 #define D5 25
 #define D6 33
 #define D7 32
+// 1 = receive binary position frames, 0 = legacy "Latitude: ... Longitude: ..." text
+// Must match LINK_BINARY_FRAMES in Master_SW.c
+#ifndef LINK_BINARY_FRAMES
+#define LINK_BINARY_FRAMES 1
+#endif
+// 1 = receive keyframes plus varint deltas (needs LINK_BINARY_FRAMES), 0 = a full frame per fix
+// Must match LINK_DELTA_STREAM in Master_SW.c
+#ifndef LINK_DELTA_STREAM
+#define LINK_DELTA_STREAM 1
+#endif
+// 1 = the master skips fixes the clients can extrapolate from speed and course (needs
+// LINK_BINARY_FRAMES), 0 = every fix is sent
+// Must match DEAD_RECKONING in Master_SW.c
+#ifndef DEAD_RECKONING
+#define DEAD_RECKONING 1
+#endif
+// 1 = exchange clock frames with the master for round-trip time, clock offset and
+// the age of its positions (src/LinkClock.h; needs LINK_BINARY_FRAMES), 0 = positions only
+// Must match LINK_CLOCK in Master_SW.c
+#ifndef LINK_CLOCK
+#define LINK_CLOCK 1
+#endif
+// 1 = at startup, ask the GPS receiver for RMC and GGA only, a higher baud and
+// a faster fix rate (PMTK or UBX), 0 = use it at its 9600 baud defaults
+#ifndef GPS_CONFIG
+#define GPS_CONFIG 1
+#endif
+#if !LINK_BINARY_FRAMES
+#undef LINK_DELTA_STREAM
+#define LINK_DELTA_STREAM 0
+#undef DEAD_RECKONING
+#define DEAD_RECKONING 0
+#undef LINK_CLOCK
+#define LINK_CLOCK 0
+#endif
+// 1 = integer micro-degree positions and float/integer math from the GPS to
+// the LCD digits, 0 = the original double pipeline
+#ifndef NAV_FIXED_POINT
+#define NAV_FIXED_POINT 1
+#endif
+// 1 = the log task writes binary records for host/tools/log_decode, 0 = text lines
+#ifndef LOG_BINARY
+#define LOG_BINARY 0
+#endif
+// 1 = loop() blocks until it has work and the chip light-sleeps in between
+// (src/PowerManager.h), 0 = loop() polls continuously
+#ifndef POWER_SAVE
+#define POWER_SAVE 1
+#endif
+// 1 = record GPS input and link traffic to a LittleFS file for host/tools/replay
+// (src/Capture.h), 0 = no capture
+#ifndef CAPTURE
+#define CAPTURE 0
+#endif
+// 1 = a task on core 0, next to the Bluetooth stack, receives from the master and
+// reads the GPS, and loop() on core 1 does navigation and the LCD from position
+// snapshots (src/Seqlock.h), 0 = loop() does both in turn
+#ifndef DUAL_CORE
+#define DUAL_CORE 1
+#endif
+// 1 = keep the last fixes and the master's address in NVS, show them at boot and
+// aid the GPS receiver with the last fix (src/WarmStart.h), 0 = start from nothing
+#ifndef WARM_START
+#define WARM_START 1
+#endif
+// 1 = stop at the first heap allocation any of the sketch's tasks makes after setup()
+// (src/HeapWatch.h), 0 = count them for the periodic report
+#ifndef HEAP_TRAP
+#define HEAP_TRAP 0
+#endif
+// 1 = smooth this client's fixes with a Kalman filter weighted by HDOP and satellite
+// count, leave outliers out, and pass a fix on to navigation and the LCD only once
+// the estimate has moved OWN_MOVE_M (src/PositionFilter.h), 0 = every raw fix
+#ifndef OWN_FILTER
+#define OWN_FILTER 1
+#endif
+#ifndef OWN_MOVE_M
+#define OWN_MOVE_M 3.0f
+#endif
+
+#if NAV_FIXED_POINT
+typedef uint32_t NavDistance;  // Hundredths of a yard
+typedef int NavBearing;        // Whole degrees, 0-359
+typedef int32_t NavCoord;      // Micro-degrees
+#else
+typedef double NavDistance;    // Yards
+typedef double NavBearing;     // Degrees
+typedef double NavCoord;       // Degrees
+#endif
+
+// A position in the units of the display pipeline
+struct NavPoint {
+#if NAV_FIXED_POINT
+  int32_t lat_e6;
+  int32_t lng_e6;
+#else
+  double lat;
+  double lng;
+#endif
+};
+
+// A master position as the receiving side applied it, handed to loop()
+struct MasterView {
+  NavPoint pos;
+  DeadReckoner track;  // Fix and velocity to extrapolate from; not valid on the text link
+};
 
-const double EARTH_RADIUS_KM = 6371.0;   // Earth radius in kilometers
 const double KM_TO_YARDS = 1093.613298;  // Conversion factor for kilometers to yards
+const float M_TO_CENTIYARDS = 109.3613298f;  // Conversion factor for meters to hundredths of a yard
 const int GPS_BAUD_RATE = 9600;
 const int MAX_RETRIES = 5;                     // Maximum number of retries for Bluetooth initialization
-const unsigned long BT_CHECK_INTERVAL = 1000;  // 1 seconds
+const unsigned long MASTER_WAIT_MS = 30000;    // Listening time without a master before the SPP server is restarted
 const unsigned long UPDATE_INTERVAL = 1000;    // 1 second update rate
+const uint8_t LCD_CELLS_PER_SLICE = 4;         // Most LCD characters sent per loop() pass
+const int32_t DIST_HYSTERESIS = 100;           // Hundredths of a yard the distance must move past a step boundary
+const int32_t DIR_HYSTERESIS = 2;              // Degrees the bearing must move past a step boundary
+const unsigned long KEY_REQUEST_INTERVAL = 1000;  // Shortest time between keyframe requests to the master
+#if POWER_SAVE
+const unsigned long LOG_DRAIN_MS = 250;        // How often the log task writes out queued events; rarely, so the chip can sleep
+#else
+const unsigned long LOG_DRAIN_MS = 20;         // How often the log task writes out queued events
+#endif
+const unsigned long DR_REFRESH_INTERVAL = 200;    // Display refresh while the master is extrapolated
+const unsigned long GPS_LOAD_REPORT_INTERVAL = 10000;  // Time between GPS parse load reports
+const size_t TRAIL_BYTES = 2048;               // Master trail ring; hours of walking at a few bytes per point
+const size_t FENCE_EVENTS_MAX = 8;             // Fence events reported per position update
+const Fence FENCES[] = {                       // Zones and waypoints, in micro-degrees and meters
+  { 42320222, -83234719, 18.3f },              // Rally point, 20 yards
+  { 42319500, -83235400, 150.0f },             // Park
+  { 42321800, -83233000, 80.0f },              // Parking lot
+};
+const size_t CAPTURE_MAX_BYTES = 512 * 1024;  // Largest capture file; about five minutes of RMC and GGA at 10 fixes/s
+const unsigned long BOOT_REPORT_MS = 60000;    // Longest the boot timeline waits for live data before it is printed
+const size_t SERIAL_LINE_MAX = 256;            // Longest line serialPrintf() writes
 
 bool ledBtState = false;                    // BT: Variable used to change the indication LED state
-bool MasterConnected = false;               // BT: Variable to store the current connection state (true=connected/false=disconnected)
+std::atomic<bool> MasterConnected{false};   // BT: Variable to store the current connection state (true=connected/false=disconnected)
 String device_name = "ESP32-BT-Slave";      // BT: Device name for the slave (client)
 String MACadd = "1C:69:20:C6:5E:32";        // BT: Use the slave MAC address
+#if NAV_FIXED_POINT
+int32_t Master_lat_e6 = 42320222;           // testing change back to 0
+int32_t Master_lng_e6 = -83234719;          // testing change back to 0
+int32_t my_lat_e6 = 0;                      // Current GPS latitude in micro-degrees
+int32_t my_lng_e6 = 0;                      // Current GPS longitude in micro-degrees
+#else
 double Master_latitude = 42.3202225;        // testing change back to 0.0
 double Master_longitude = -83.234719;       // testing change back to 0.0
 double my_lat = 0.0;                        // Variable to store the current GPS latitude
 double my_lng = 0.0;                        // Variable to store the current GPS longitude
+#endif
 TinyGPSPlus gps;                            // Create an instance of the TinyGPSPlus library
 HardwareSerial gpsSerial(1);                // Use hardware serial port 1 for GPS communication
-char gpsData[256];                          // Fixed-size buffer for incoming GPS data
-static double lastDist = -1.0;              // For updating the screen only when there is a change
-static double lastDir = -1.0;               // For updating the screen only when there is a change
+GpsLoad gpsLoad;                            // NMEA bytes and fixes parsed, for the periodic report
+RxRing<256> btRing;                         // Bytes drained from the Bluetooth link on every pass
+LineAssembler<129> btLine;                  // Legacy text line being received (128 chars max)
+Hysteresis shownDist;                       // Displayed distance, held while GPS jitter stays in the dead band
+Hysteresis shownDir;                        // Displayed bearing, held while GPS jitter stays in the dead band
+LcdShadow<16, 2> lcdShadow;                 // What the LCD should show; pushed a few cells per loop()
+DeadReckoner masterTrack;                   // Last master fix with its velocity, as loop() took it
+Breadcrumbs<TRAIL_BYTES> masterTrail;       // Where the master has been, with distance and speed totals
+typedef FenceIndex<32, 128, 64> Fences;     // Room for the fence table and a few more
+Fences fences;                              // FENCES in a grid, built in setup()
+FenceTracker<Fences> masterFences;          // Which fences the master is in
+FenceTracker<Fences> myFences;              // Which fences this client is in
 LiquidCrystal lcd(RS, EN, D4, D5, D6, D7);  // LCD Screen
+#if LINK_DELTA_STREAM
+StreamDecoder frameDecoder;                 // Rebuilds positions from the master's keyframes and deltas
+unsigned long lastKeyRequest = 0;           // When a keyframe was last requested
+uint32_t keyRequests = 0;                   // Keyframe requests sent
+#else
+FrameDecoder frameDecoder;                  // Reassembles binary position frames from the Bluetooth stream
+#endif
+#if LINK_CLOCK
+LinkClock masterClock;                      // Round trip and offset to the master's clock, and its fix anchor
+ClockMatcher clockMatcher;                  // Picks the master's clock frames out of the link
+int32_t masterAgeUs = 0;                    // Age of the last master position when it was applied
+int32_t masterAgeMeanUs = 0;                // Smoothed over about 8 positions
+int32_t masterAgeMaxUs = 0;                 // Oldest on arrival so far
+uint32_t agedFixes = 0;                     // Positions whose age was known
+#endif
+Seqlock<MasterView> masterShared;           // Newest master position, from the receiving side to loop()
+Seqlock<NavPoint> ownShared;                // Newest fix of this client's GPS, likewise
+uint32_t masterSeen = 0;                    // masterShared version loop() last took
+uint32_t ownSeen = 0;                       // ownShared version loop() last took; 0 = no fix yet
+uint32_t storedMaster = 0;                  // masterShared version that came from NVS, not the master
+uint32_t storedOwn = 0;                     // ownShared version that came from NVS, not the GPS
+#if OWN_FILTER
+PositionFilter ownFilter;                   // Smoothed own position, on the receiving side
+MoveGate ownGate(OWN_MOVE_M);               // Passes it to ownShared once it has moved
+std::atomic<uint32_t> ownFixMs{0};          // When the filter last took a fix, passed on or not
+#endif
+NavCoord navInputs[4];                      // Own and master position updateDisplay() last worked from
+bool navShown = false;                      // navInputs holds something
+std::atomic<uint32_t> navRuns{0};           // updateDisplay() passes that redid distance, bearing and the LCD
+std::atomic<uint32_t> navSkips{0};          // Those that found neither position moved
+BootTimeline boot;                          // Time from power-up to the LCD, the GPS, the master and live data
+bool bootReported = false;                  // The timeline has been printed
+GpsConfigResult gpsSetup;                   // What configureGPS() found
+TaskHandle_t ingestTaskHandle = nullptr;    // Runs ingest(), woken by the GPS UART and the Bluetooth callback
+TaskHandle_t logTaskHandle = nullptr;       // Runs logTask()
+uint32_t heapLargestMin = UINT32_MAX;       // Smallest largest free block seen by the report
+LinkStateMachine masterLink;                // Listening, connected or backing off before restarting the server
+QueueHandle_t linkEvents;                   // Connects and drops from Bt_Status, applied to masterLink in serviceLink()
+EventRing<LOG_RING_SIZE> eventLog;          // LOG() events waiting for logTask()
+unsigned long lastUpdateTime = 0;           // Last distance and direction update
+unsigned long lastLoadReport = 0;           // Last GPS parse load and link report
+unsigned long lastPredictTime = 0;          // Last time the master position was extrapolated
+#if CAPTURE
+CaptureWriter<CAPTURE_BLOCKS> capture;      // Records waiting for logTask() to write them to flash
+File captureFile;                           // Open while capturing
+size_t captureWritten = 0;                  // Bytes in captureFile
+size_t captureLimit = 0;                    // Size at which the capture stops
+#endif
+#if WARM_START
+Preferences nvs;                            // The "warm" namespace
+WarmState warm = {};                        // As loaded, then kept up to date by the receiving side
+WarmSaver warmSaver;                        // When the state is next worth writing
+bool warmLoaded = false;                    // A stored state was found at boot
+bool warmAidPending = false;                // PMTK aiding waits for the master's GPS time
+#endif
+#if POWER_SAVE
+TaskHandle_t loopTaskHandle;                // Woken by the receiving side with a new master position
+std::atomic<uint8_t> wakeCauses{0};         // PowerWake bits of the callbacks since the receiving side last woke
+bool gpsWoke = false;                       // The receiving side last woke for GPS bytes
+GpsBurstClock gpsBursts;                    // When the GPS receiver's next burst is due
+DutyCycle duty;                             // Share of time the chip is kept awake
+esp_pm_lock_handle_t gpsAwakeLock = nullptr;  // Held while a GPS burst is due, so the UART misses nothing
+bool gpsAwake = false;                      // Whether gpsAwakeLock is held
+bool lightSleepOn = false;                  // Automatic light sleep could be enabled
+#endif
+
+// Stages timed by the profiler (PROFILER in src/Profiler.h), in the order of PROF_STAGE_NAMES
+enum ProfStage {
+  PROF_BT_READ,    // Link drained into btRing
+  PROF_PARSE,      // Frames decoded, or a text line parsed by gps_parse()
+  PROF_BT_WRITE,   // Keyframe requests and stats dumps sent to the master
+  PROF_GPS_READ,   // NMEA parsed by readGPS()
+  PROF_GPS_DATA,   // getGPSData()
+  PROF_DISTANCE,
+  PROF_DIRECTION,
+  PROF_DISPLAY,    // display() rendering into the framebuffer
+  PROF_LCD,        // Framebuffer cells sent to the LCD
+  PROF_STAGES
+};
+#if PROFILER
+const char* const PROF_STAGE_NAMES[PROF_STAGES] = {
+  "bt read", "parse", "bt write", "gps read", "getGPSData", "distance", "direction", "display", "lcd flush"
+};
+Profiler profiler;
+ProfRequestMatcher usbProfRequest;          // Stats requests from the serial monitor
+ProfRequestMatcher btProfRequest;           // Stats requests passed on by the master
+#endif
 
 // BT: Bluetooth availability check
 #if !defined(CONFIG_BT_ENABLED) || !defined(CONFIG_BLUEDROID_ENABLED)
@@ -46,12 +302,73 @@ LiquidCrystal lcd(RS, EN, D4, D5, D6, D7);  // LCD Screen
 
 BluetoothSerial SerialBT;  // BT: Set the Bluetooth Serial Object
 
+// The GPS UART as GpsConfigurator sees it
+struct GpsUartLink {
+  void setBaud(uint32_t baud) {
+    gpsSerial.updateBaudRate(baud);
+  }
+
+  int read() {
+    return gpsSerial.read();
+  }
+
+  void write(const uint8_t* data, size_t len) {
+    gpsSerial.write(data, len);
+  }
+};
+
+// A connect or drop reported by the SPP callback
+struct LinkEvent {
+  bool opened;
+  uint32_t atMs;
+  uint8_t address[6];  // The master's, on a connect
+};
+
+/**
+ * @brief Wakes the receiving side, ingestTask() or loop(), from a driver callback.
+ * 
+ * @param cause What has work for it, for the duty-cycle report.
+ * 
+ * @return void
+ */
+void wakeIngest(PowerWake cause) {
+#if POWER_SAVE
+  wakeCauses.fetch_or(1 << cause);
+  if (ingestTaskHandle) {  // Not started yet; its first pass finds the work
+    xTaskNotifyGive(ingestTaskHandle);
+  }
+#endif
+}
+
+/**
+ * @brief Wakes loop() on the other core for a master position just published.
+ * 
+ * @return void
+ */
+void wakeNav() {
+#if POWER_SAVE && DUAL_CORE
+  xTaskNotifyGive(loopTaskHandle);
+#endif
+}
+
+// UART receive event: GPS bytes are waiting
+void onGpsReceive() {
+  wakeIngest(POWER_WAKE_GPS);
+}
+
+// UART receive event on the serial monitor: a stats request may be waiting
+void onUsbReceive() {
+  wakeIngest(POWER_WAKE_USB);
+}
+
 /**
  * @brief Callback function for Bluetooth status events.
  * 
  * This function handles events for Bluetooth connection status such as
  * when the master device connects or disconnects. It updates the 
- * `MasterConnected` variable accordingly.
+ * `MasterConnected` variable accordingly and queues the event for
+ * serviceLink(), since it runs in the Bluetooth task. Link events and
+ * received data wake the receiving side.
  * 
  * @param event The Bluetooth event that occurred (e.g., connection open or close).
  * @param param Parameters associated with the event.
@@ -60,142 +377,566 @@ BluetoothSerial SerialBT;  // BT: Set the Bluetooth Serial Object
  */
 void Bt_Status(esp_spp_cb_event_t event, esp_spp_cb_param_t* param) {
   if (event == ESP_SPP_SRV_OPEN_EVT) {  // BT: Checks if the SPP Server connection is open
-    Serial.println("Master Connected");
+    LOG(MASTER_CONNECTED);
     MasterConnected = true;  // BT: Server is connected to the slave
+    boot.mark(BOOT_CONNECTED, millis());
     digitalWrite(LED_BT, HIGH);             // Turn LED on
   } else if (event == ESP_SPP_CLOSE_EVT) {  // BT: Checks if the SPP connection is closed
-    Serial.println("Master Disconnected");
+    LOG(MASTER_DISCONNECTED);
     MasterConnected = false;  // BT: Server connection lost
     digitalWrite(LED_BT, LOW);  // Turn LED off
+  } else {
+    if (event == ESP_SPP_DATA_IND_EVT) {
+      wakeIngest(POWER_WAKE_BT);  // The data itself is in SerialBT's queue
+    }
+    return;
+  }
+  LinkEvent ev = { event == ESP_SPP_SRV_OPEN_EVT, (uint32_t)millis(), {} };
+  if (ev.opened) {
+    memcpy(ev.address, param->srv_open.rem_bda, 6);
   }
+  xQueueSend(linkEvents, &ev, 0);
+  wakeIngest(POWER_WAKE_BT);
 }
 
 /**
  * @brief Parses GPS data to extract latitude and longitude.
  * 
  * This function extracts and validates latitude and longitude from a 
- * formatted GPS data string. The function handles errors in the data format 
- * and ensures the extracted values are within valid ranges.
+ * formatted GPS data line in place, without copying it. The function handles
+ * errors in the data format and ensures the extracted values are within
+ * valid ranges.
  * 
- * @param gpsData A string containing the GPS data in a specific format.
+ * @param gpsData A NUL-terminated line in the "Latitude: ... Longitude: ..." format.
+ * @param lat Set to the parsed latitude on success.
+ * @param lon Set to the parsed longitude on success.
  * 
  * @return true If the GPS data is valid and successfully parsed.
  * @return false If there is an error parsing the GPS data.
  */
-bool gps_parse(String gpsData) {
-  if (gpsData.isEmpty()) {
-    Serial.println("Error: Emptry GPS Data");
+bool gps_parse(const char* gpsData, double* lat, double* lon) {
+  PROF_SCOPE(profiler, PROF_PARSE);
+  if (gpsData[0] == '\0') {
+    LOG(TEXT_EMPTY);
     return false;
   }
   // Validate if the data contains the necessary labels
-  if (gpsData.indexOf("Latitude:") == -1 || gpsData.indexOf("Longitude:") == -1) {
-    Serial.println("Error: Invalid GPS data format.");
+  const char* latLabel = strstr(gpsData, "Latitude:");
+  const char* lonLabel = strstr(gpsData, "Longitude:");
+  if (latLabel == NULL || lonLabel == NULL || lonLabel < latLabel) {
+    LOG(TEXT_FORMAT);
+    return false;
+  }
+
+  // Convert the numbers that follow the labels; strtod skips leading spaces
+  char* latEnd;
+  char* lonEnd;
+  double latitude = strtod(latLabel + 9, &latEnd);    // The start of the latitude number (after "Latitude:")
+  double longitude = strtod(lonLabel + 10, &lonEnd);  // The start of the longitude number (after "Longitude:")
+  if (latEnd == latLabel + 9 || latEnd > lonLabel || lonEnd == lonLabel + 10) {
+    LOG(TEXT_NUMBERS);
+    return false;
+  }
+
+  // Validate range for latitude
+  if (latitude < -90.0 || latitude > 90.0) {
+    LOG(TEXT_LAT_RANGE);
     return false;
   }
-  if (gpsData.length() > 0) {      // Only proceed if the data is non-empty
-    if (gpsData.length() > 128) {  // Prevent excessively long strings
-      Serial.println("Error: GPS data too long.");
-      return false;
-    }
-    Serial.print("Received GPS Data: ");
-    Serial.println(gpsData);  // Print the received GPS data to the serial monitor
-
-    // Find the start and end positions of the latitude value int latStart = gpsData.indexOf("Latitude:") + 9;  // Start after "Latitude:"
-    int latStart = gpsData.indexOf("Latitude:") + 9;    // The start of the latitude number (after "Latitude:")
-    int latEnd = gpsData.indexOf("Longitude:") - 1;     // The end of the latitude value, before "Longitude:"
-    int lonStart = gpsData.indexOf("Longitude:") + 10;  // The start of the longitude number (after "Longitude:")
-    int lonEnd = gpsData.length();                      // The end of the longitude value (end of the string)
-
-    if (latStart == -1 || latEnd == -1 || lonStart == -1 || latStart >= latEnd || lonStart <= latEnd) {
-      Serial.println("Error: Unable to parse latitude and longitude.");
-      return false;
-    }
 
-    // Use String.substring() to extract latitude and longitude
-    String latStr = gpsData.substring(latStart, latEnd);
-    String lonStr = gpsData.substring(lonStart);
+  // Validate range for longitude
+  if (longitude < -180.0 || longitude > 180.0) {
+    LOG(TEXT_LON_RANGE);
+    return false;
+  }
 
-    // Remove any extra spaces or newlines
-    latStr.trim();
-    lonStr.trim();
+  *lat = latitude;
+  *lon = longitude;
+  return true;
+}
 
-    // Ensure that the extracted strings are not empty or excessively long
-    if (latStr.length() == 0 || lonStr.length() == 0) {
-      Serial.println("Error: Empty latitude or longitude extracted.");
-      return false;
+/**
+ * @brief Moves a position through the fences and logs the ones it entered or left.
+ *
+ * @param tracker The position's fence state, `masterFences` or `myFences`.
+ * @param lat Latitude in micro-degrees.
+ * @param lon Longitude in micro-degrees.
+ * @param master Whether the position is the master's.
+ *
+ * @return void
+ */
+void checkFences(FenceTracker<Fences>& tracker, int32_t lat, int32_t lon, bool master) {
+  FenceEvent events[FENCE_EVENTS_MAX];
+  size_t n = tracker.update(fences, lat, lon, events, FENCE_EVENTS_MAX);
+  for (size_t i = 0; i < n; i++) {
+    bool enter = events[i].type == FENCE_ENTER;
+    if (master) {
+      if (enter) {
+        LOG(MASTER_FENCE_ENTER, events[i].fence);
+      } else {
+        LOG(MASTER_FENCE_EXIT, events[i].fence);
+      }
+    } else if (enter) {
+      LOG(FENCE_ENTER, events[i].fence);
+    } else {
+      LOG(FENCE_EXIT, events[i].fence);
     }
+  }
+}
 
-    if (latStr.length() > 15 || lonStr.length() > 15) {
-      Serial.println("Error: Extracted latitude or longitude is too long.");
-      return false;
+/**
+ * @brief Applies a decoded binary position frame from the master.
+ * 
+ * The frame carries integer micro-degrees, so no string parsing is needed.
+ * Coordinates outside the valid range are rejected and the previous master
+ * position is kept. A position in range goes on the trail and through the
+ * fences, and is published to loop() for the display.
+ * 
+ * @param fix The decoded position fix.
+ * 
+ * @return true If the position was in range and applied.
+ * @return false If the position was rejected.
+ */
+bool frame_apply(const PositionFix& fix) {
+  if (fix.lat_e6 < -90 * FRAME_DEG_SCALE || fix.lat_e6 > 90 * FRAME_DEG_SCALE ||
+      fix.lon_e6 < -180 * FRAME_DEG_SCALE || fix.lon_e6 > 180 * FRAME_DEG_SCALE) {
+    LOG(FRAME_RANGE);
+    return false;
+  }
+  MasterView view;
+#if NAV_FIXED_POINT
+  view.pos.lat_e6 = fix.lat_e6;
+  view.pos.lng_e6 = fix.lon_e6;
+#else
+  view.pos.lat = fix.lat_e6 / (double)FRAME_DEG_SCALE;
+  view.pos.lng = fix.lon_e6 / (double)FRAME_DEG_SCALE;
+#endif
+  uint32_t takenMs = millis();
+#if LINK_CLOCK
+  // The fix is as old as the time since the master's GPS took it, link and queues included
+  uint32_t takenUs;
+  if (fix.time_ms && masterClock.gpsToLocalUs(fix.time_ms, &takenUs)) {
+    int32_t age = (int32_t)(micros() - takenUs);
+    if (age >= 0 && age < (int32_t)DR_TIMEOUT_MS * 1000) {
+      masterAgeMeanUs = agedFixes ? masterAgeMeanUs + (age - masterAgeMeanUs) / 8 : age;
+      masterAgeUs = age;
+      if (age > masterAgeMaxUs) {
+        masterAgeMaxUs = age;
+      }
+      agedFixes++;
+      takenMs -= (uint32_t)age / 1000;
     }
+  }
+#endif
+  view.track.update(fix, takenMs);
+  publishMaster(view);
+  masterTrail.add(fix.lat_e6, fix.lon_e6, millis());
+  checkFences(masterFences, fix.lat_e6, fix.lon_e6, true);
+  LOG(FRAME, fix.seq, fix.lat_e6, fix.lon_e6);
+  return true;
+}
+
+/**
+ * @brief Moves the master position along its last reported velocity.
+ * 
+ * @return void
+ */
+void predictMaster() {
+  int32_t lat, lon;
+  masterTrack.predict(millis(), &lat, &lon);
+#if NAV_FIXED_POINT
+  Master_lat_e6 = lat;
+  Master_lng_e6 = lon;
+#else
+  Master_latitude = lat / (double)FRAME_DEG_SCALE;
+  Master_longitude = lon / (double)FRAME_DEG_SCALE;
+#endif
+}
+
+/**
+ * @brief Hands a new master position to loop() and wakes it.
+ * 
+ * Called by the receiving side only, the one writer of `masterShared`.
+ * 
+ * @param view The position, with the fix to extrapolate from.
+ * 
+ * @return void
+ */
+void publishMaster(const MasterView& view) {
+  masterShared.write(view);
+  boot.mark(BOOT_MASTER, millis());
+  wakeNav();
+}
+
+/**
+ * @brief Takes the newest master position published, if loop() has not taken it yet.
+ * 
+ * Never blocks: a read that overlaps a write on the other core is retried,
+ * so the latitude and longitude always come from the same position.
+ * 
+ * @return true If there was a new position.
+ * @return false If the master has not moved since the last call.
+ */
+bool takeMaster() {
+  if (masterShared.version() == masterSeen) {
+    return false;
+  }
+  MasterView view;
+  masterSeen = masterShared.read(&view);
+  masterTrack = view.track;
+#if NAV_FIXED_POINT
+  Master_lat_e6 = view.pos.lat_e6;
+  Master_lng_e6 = view.pos.lng_e6;
+#else
+  Master_latitude = view.pos.lat;
+  Master_longitude = view.pos.lng;
+#endif
+#if DEAD_RECKONING && LINK_CLOCK
+  if (masterTrack.valid) {
+    predictMaster();  // Show where the master is now, not where it was when the fix was taken
+  }
+#endif
+  return true;
+}
 
-    // Convert extracted strings to double
-    Master_latitude = latStr.toDouble();
-    Master_longitude = lonStr.toDouble();
+#if LINK_CLOCK
+/**
+ * @brief Sends the master a clock frame once CLOCK_INTERVAL_US has passed since the last.
+ *
+ * The frame echoes the master's last clock frame and carries this client's
+ * newest fix, so the master gets the round trip and the client's position.
+ *
+ * @return void
+ */
+void sendClock() {
+  uint32_t now = micros();
+  if (!masterClock.due(now)) {
+    return;
+  }
+  ClockFrame f;
+  masterClock.prepare(now, &f);
+  f.fixUs = 0;
+  f.fixMs = CLOCK_NO_FIX;
+  f.lat_e6 = 0;
+  f.lon_e6 = 0;
+  if (gps.location.isValid() && gps.time.isValid() && gps.location.age() < CLOCK_ANCHOR_MAX_MS) {
+    f.fixUs = now - gps.location.age() * 1000UL;
+    f.fixMs = ((gps.time.hour() * 60UL + gps.time.minute()) * 60UL + gps.time.second()) * 1000UL + gps.time.centisecond() * 10UL;
+    f.lat_e6 = rawToE6(gps.location.rawLat());
+    f.lon_e6 = rawToE6(gps.location.rawLng());
+  }
+  uint8_t frame[CLOCK_FRAME_LEN];
+  PROF_SCOPE(profiler, PROF_BT_WRITE);
+  size_t len = clock_encode(f, frame);
+#if CAPTURE
+  capture.put(CAPTURE_BT_TX, micros(), frame, len);
+#endif
+  SerialBT.write(frame, len);  // One write, so the master gets the frame in one piece
+}
 
-    // Validate range for latitude
-    if (Master_latitude < -90.0 || Master_latitude > 90.0) {
-      Serial.println("Error: Latitude out of range.");
-      return false;
+#endif
+/**
+ * @brief Drains the Bluetooth link and applies the newest master position.
+ * 
+ * Called on every pass of ingest(). Whatever the link has buffered is moved into
+ * `btRing` without waiting, then decoded in place. When a burst holds several
+ * positions only the last one is applied, so the display never works
+ * through a backlog of stale fixes. A partial frame or line stays in the
+ * decoder until the rest arrives on a later pass.
+ * 
+ * @return true If a new master position was applied.
+ * @return false If no complete position arrived.
+ */
+bool receiveMaster() {
+  int pending;
+  while ((pending = SerialBT.available()) > 0) {
+    PROF_SCOPE(profiler, PROF_BT_READ);
+    size_t span;
+    uint8_t* dst = btRing.writeSpan(&span);
+    size_t n = (size_t)pending < span ? (size_t)pending : span;
+    size_t got = SerialBT.readBytes(dst, n);
+#if CAPTURE
+    capture.put(CAPTURE_BT_RX, micros(), dst, got);
+#endif
+    if (btRing.commit(got)) {
+      // Oldest bytes were overwritten, so the partial frame or line is broken
+#if LINK_BINARY_FRAMES
+      frameDecoder.reset();
+#else
+      btLine.resync();
+#endif
     }
+  }
 
-    // Validate range for longitude
-    if (Master_longitude < -180.0 || Master_longitude > 180.0) {
-      Serial.println("Error: Longitude out of range.");
-      return false;
+  bool found = false;
+  int c;
+#if LINK_BINARY_FRAMES
+  PositionFix fix, newest;
+  if (btRing.available()) {  // Only passes with bytes to decode are timed
+    PROF_SCOPE(profiler, PROF_PARSE);
+#if LINK_CLOCK
+    uint32_t rxUs = micros();  // When the bytes were read, which is when ingest() got to them
+#endif
+    while ((c = btRing.read()) >= 0) {
+#if PROFILER
+      if (btProfRequest.push((uint8_t)c)) {
+        sendProfile(SerialBT, btProfRequest.flags);
+      }
+#endif
+#if LINK_CLOCK
+      if (clockMatcher.push((uint8_t)c)) {
+        masterClock.receive(clockMatcher.frame, rxUs);
+      }
+#endif
+      if (frameDecoder.push((uint8_t)c, &fix)) {
+        newest = fix;
+        found = true;
+      }
+    }
+  }
+#if LINK_DELTA_STREAM
+  // Deltas after a gap cannot be applied; ask for a keyframe until one arrives
+  if (frameDecoder.needKeyframe && millis() - lastKeyRequest >= KEY_REQUEST_INTERVAL) {
+    lastKeyRequest = millis();
+    uint8_t request[STREAM_REQUEST_LEN];
+    {
+      PROF_SCOPE(profiler, PROF_BT_WRITE);
+      size_t len = stream_encode_request(frameDecoder.last.seq, request);
+#if CAPTURE
+      capture.put(CAPTURE_BT_TX, micros(), request, len);
+#endif
+      SerialBT.write(request, len);
+    }
+    keyRequests++;
+    LOG(KEY_REQUEST, frameDecoder.last.seq);
+  }
+#endif
+  return found && frame_apply(newest);
+#else
+  double lat = 0.0, lon = 0.0;
+  while ((c = btRing.read()) >= 0) {
+#if PROFILER
+    if (btProfRequest.push((uint8_t)c)) {
+      sendProfile(SerialBT, btProfRequest.flags);
+      btLine.resync();  // The request is not part of a position line
+      continue;
     }
+#endif
+    if (btLine.push((char)c)) {
+      if (gps_parse(btLine.line, &lat, &lon)) {
+        found = true;
+      } else {
+        LOG(TEXT_FAILED);
+      }
+    }
+  }
+  if (found) {
+    MasterView view;
+#if NAV_FIXED_POINT
+    view.pos.lat_e6 = frame_to_e6(lat);
+    view.pos.lng_e6 = frame_to_e6(lon);
+#else
+    view.pos.lat = lat;
+    view.pos.lng = lon;
+#endif
+    publishMaster(view);
+    masterTrail.add(frame_to_e6(lat), frame_to_e6(lon), millis());
+    checkFences(masterFences, frame_to_e6(lat), frame_to_e6(lon), true);
+    // Log the parsed latitude and longitude values for debugging
+    LOG(TEXT_PARSED, frame_to_e6(lat), frame_to_e6(lon));
+  }
+  return found;
+#endif
+}
+
+/**
+ * @brief Converts TinyGPS++ raw degrees to micro-degrees without floating point.
+ * 
+ * @param raw Whole degrees plus billionths of a degree, as parsed from NMEA.
+ * 
+ * @return int32_t The coordinate in micro-degrees.
+ */
+int32_t rawToE6(const RawDegrees& raw) {
+  int32_t e6 = (int32_t)raw.deg * 1000000 + (int32_t)((raw.billionths + 500) / 1000);
+  return raw.negative ? -e6 : e6;
+}
+
+// A micro-degree position in the units of the display pipeline
+NavPoint navPoint(int32_t lat_e6, int32_t lng_e6) {
+  NavPoint p;
+#if NAV_FIXED_POINT
+  p.lat_e6 = lat_e6;
+  p.lng_e6 = lng_e6;
+#else
+  p.lat = lat_e6 / (double)FRAME_DEG_SCALE;
+  p.lng = lng_e6 / (double)FRAME_DEG_SCALE;
+#endif
+  return p;
+}
+
+// The inverse of navPoint()
+void navE6(const NavPoint& p, int32_t* lat_e6, int32_t* lng_e6) {
+#if NAV_FIXED_POINT
+  *lat_e6 = p.lat_e6;
+  *lng_e6 = p.lng_e6;
+#else
+  *lat_e6 = frame_to_e6(p.lat);
+  *lng_e6 = frame_to_e6(p.lng);
+#endif
+}
 
-    // Print the parsed latitude and longitude values for debugging
-    Serial.printf("Parsed Latitude: %.11lf, Longitude: %.11lf\n", Master_latitude, Master_longitude);  // Print with 8 decimal places
-    return true;
+/**
+ * @brief Formats an unsigned integer right-aligned in a field.
+ * 
+ * Replaces dtostrf() for values that are already scaled integers.
+ * 
+ * @param out Destination buffer, at least max(width, 10) + 1 bytes.
+ * @param value The value to format.
+ * @param width Minimum field width; shorter numbers are padded with spaces.
+ * 
+ * @return int Number of characters written, excluding the terminator.
+ */
+int formatUint(char* out, uint32_t value, int width) {
+  char digits[10];
+  int n = 0;
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  int len = 0;
+  while (len < width - n) {
+    out[len++] = ' ';
   }
-  return false;
+  while (n) {
+    out[len++] = digits[--n];
+  }
+  out[len] = '\0';
+  return len;
 }
 
 /**
- * @brief Retrieves the current GPS data from the GPS module.
+ * @brief Feeds everything the GPS UART holds to the NMEA parser.
  * 
- * This function reads data from the GPS module and updates the `my_lat` 
- * and `my_lng` variables with the latest coordinates if the data is valid.
+ * Called on every pass of ingest(): at the configured fix rate the UART
+ * buffer would overflow between one-second display updates.
  * 
  * @return void
  */
-void getGPSData() {
-  while (gpsSerial.available()) {
-    gps.encode(gpsSerial.read());  // Send data to the GPS object for decoding
+void readGPS() {
+  if (!gpsSerial.available()) {
+#if POWER_SAVE
+    gpsBursts.read(micros(), 0, 10000000UL / gpsSerial.baudRate(), gpsWoke);  // A wake-up whose bytes were lost
+#endif
+    return;  // Only passes with bytes to parse are timed
   }
-
-  // Once data is processed, save the latitude and longitude to my_lat and my_lng
-  if (gps.location.isUpdated()) {  // Check if a new location update is available
-    my_lat = gps.location.lat();   // Get the latitude from the GPS module
-    my_lng = gps.location.lng();   // Get the longitude from the GPS module
-
-    // Print the current GPS coordinates
-    Serial.print("Current Latitude: ");
-    Serial.println(my_lat, 11);  // Print latitude with 11 decimal places
-    Serial.print("Current Longitude: ");
-    Serial.println(my_lng, 11);  // Print longitude with 11 decimal places
-  } else {
-    Serial.println("Warning: No GPS data available or signal is weak.");
+  PROF_SCOPE(profiler, PROF_GPS_READ);
+  static uint32_t lastFixTime = UINT32_MAX;  // GPS time of the last fix counted
+  uint32_t count = 0;
+  uint8_t chunk[64];
+  size_t n;
+  while ((n = gpsSerial.read(chunk, sizeof(chunk))) > 0) {
+#if CAPTURE
+    capture.put(CAPTURE_GPS_RX, micros(), chunk, n);
+#endif
+    count += n;
+    gpsLoad.bytes += n;
+    for (size_t i = 0; i < n; i++) {
+      if (gps.encode(chunk[i]) && gps.location.isUpdated() && gps.time.value() != lastFixTime) {
+        lastFixTime = gps.time.value();  // RMC and GGA of one epoch count once
+        gpsLoad.fixes++;
+      }
+    }
   }
+#if POWER_SAVE
+  gpsBursts.read(micros(), count, 10000000UL / gpsSerial.baudRate(), gpsWoke);
+#endif
 }
 
-// Helper function to convert degrees to radians
-inline double degreesToRadians(double degrees) {
-  return degrees * M_PI / 180.0;
+/**
+ * @brief Publishes the GPS module's newest location to loop().
+ * 
+ * Called by the receiving side after readGPS(), when the location has been
+ * updated. The position also goes through the fences here, at the fix rate.
+ * 
+ * @return void
+ */
+void getGPSData() {
+  PROF_SCOPE(profiler, PROF_GPS_DATA);
+  if (!gps.location.isUpdated()) {  // Check if a new location update is available
+    return;
+  }
+  NavPoint own;
+#if OWN_FILTER
+  int32_t lat_e6 = rawToE6(gps.location.rawLat());
+  int32_t lng_e6 = rawToE6(gps.location.rawLng());
+  uint32_t sats = gps.satellites.isValid() ? gps.satellites.value() : 0;
+  float hdop = gps.hdop.isValid() ? (float)gps.hdop.hdop() : 0.0f;
+  FilterResult result = ownFilter.update(lat_e6, lng_e6, hdop, (uint8_t)(sats < 255 ? sats : 255), millis());
+  if (result == FILTER_REJECTED || result == FILTER_WEAK) {
+    return;
+  }
+  ownFixMs = millis();
+  ownFilter.position(&lat_e6, &lng_e6);
+  checkFences(myFences, lat_e6, lng_e6, false);
+  if (!ownGate.pass(lat_e6, lng_e6)) {
+    return;  // Within OWN_MOVE_M of what loop() has; nothing downstream would change
+  }
+  own = navPoint(lat_e6, lng_e6);
+#elif NAV_FIXED_POINT
+  own.lat_e6 = rawToE6(gps.location.rawLat());  // Get the latitude from the GPS module
+  own.lng_e6 = rawToE6(gps.location.rawLng());  // Get the longitude from the GPS module
+  checkFences(myFences, own.lat_e6, own.lng_e6, false);
+#else
+  own.lat = gps.location.lat();   // Get the latitude from the GPS module
+  own.lng = gps.location.lng();   // Get the longitude from the GPS module
+  checkFences(myFences, frame_to_e6(own.lat), frame_to_e6(own.lng), false);
+#endif
+  ownShared.write(own);
+  boot.mark(BOOT_FIX, millis());
 }
 
-// Helper function to convert radians to degrees
-inline double radiansToDegrees(double radians) {
-  return radians * 180.0 / M_PI;
+/**
+ * @brief Takes this client's newest GPS fix into `my_lat` and `my_lng`.
+ * 
+ * @return true If there was a new one.
+ * @return false If this client has not moved since the last call.
+ */
+bool takeOwnFix() {
+  if (ownShared.version() == ownSeen) {
+#if OWN_FILTER
+    if (millis() - ownFixMs.load() >= UPDATE_INTERVAL) {
+      LOG(NO_GPS);  // No new location since the last update; otherwise the filter held it back
+    }
+#else
+    LOG(NO_GPS);  // No new location since the last update
+#endif
+    return false;
+  }
+  NavPoint own;
+  ownSeen = ownShared.read(&own);
+#if NAV_FIXED_POINT
+  my_lat_e6 = own.lat_e6;
+  my_lng_e6 = own.lng_e6;
+
+  // Log the current GPS coordinates
+  LOG(MY_POSITION, my_lat_e6, my_lng_e6);
+#else
+  my_lat = own.lat;
+  my_lng = own.lng;
+
+  // Log the current GPS coordinates
+  LOG(MY_POSITION, frame_to_e6(my_lat), frame_to_e6(my_lng));
+#endif
+  return true;
 }
 
+#if !NAV_FIXED_POINT
 /**
  * @brief Calculates the distance between two GPS coordinates.
  * 
- * This function uses the Haversine formula to compute the distance between 
- * two sets of GPS coordinates in yards.
+ * This function uses the geodesy kernel, which picks a flat-earth, float
+ * haversine or double haversine formula depending on how far apart the
+ * points are, and converts the result to yards.
  * 
  * @param lat1 Latitude of the first point.
  * @param lon1 Longitude of the first point.
@@ -205,54 +946,37 @@ inline double radiansToDegrees(double radians) {
  * @return double The distance between the two points in yards.
  */
 double distance(double lat1, double lon1, double lat2, double lon2) {
+  PROF_SCOPE(profiler, PROF_DISTANCE);
   if (lat1 == lat2 && lon1 == lon2) {
     return 0.0;
   }
-  // Convert latitude and longitude from degrees to radians
-  double lat1_rad = degreesToRadians(lat1);
-  double lon1_rad = degreesToRadians(lon1);
-  double lat2_rad = degreesToRadians(lat2);
-  double lon2_rad = degreesToRadians(lon2);
-  // Differences in coordinates
-  double dlat = lat2_rad - lat1_rad;
-  double dlon = lon2_rad - lon1_rad;
-  // Haversine formula
-  double a = sin(dlat / 2.0) * sin(dlat / 2.0) + cos(lat1_rad) * cos(lat2_rad) * sin(dlon / 2.0) * sin(dlon / 2.0);
-  double c = 2.0 * atan2(sqrt(a), sqrt(1.0 - a));
-
-  return EARTH_RADIUS_KM * c * KM_TO_YARDS;  // Return distance in yards
+  return geo_distance(lat1, lon1, lat2, lon2) / 1000.0 * KM_TO_YARDS;  // Return distance in yards
 }
 
+#endif
+
 /**
  * @brief Maps a bearing (angle) to a cardinal compass direction.
  * 
  * This function converts a bearing (angle) in degrees to a cardinal direction 
- * (e.g., North, East, South, West).
+ * (e.g., North, East, South, West) by indexing a table of the 16 points.
  * 
  * @param bearing The bearing in degrees.
  * 
- * @return char* A string representing the compass direction.
- */
-char* getCompassDirection(double bearing) {
-  if (bearing >= 348.75 || bearing < 11.25) return "N";          // North
-  else if (bearing >= 11.25 && bearing < 33.75) return "NNE";    // North-NorthEast
-  else if (bearing >= 33.75 && bearing < 56.25) return "NE";     // NorthEast
-  else if (bearing >= 56.25 && bearing < 78.75) return "ENE";    // East-NorthEast
-  else if (bearing >= 78.75 && bearing < 101.25) return "E";     // East
-  else if (bearing >= 101.25 && bearing < 123.75) return "ESE";  // East-SouthEast
-  else if (bearing >= 123.75 && bearing < 146.25) return "SE";   // SouthEast
-  else if (bearing >= 146.25 && bearing < 168.75) return "SSE";  // South-SouthEast
-  else if (bearing >= 168.75 && bearing < 191.25) return "S";    // South
-  else if (bearing >= 191.25 && bearing < 213.75) return "SSW";  // South-SouthWest
-  else if (bearing >= 213.75 && bearing < 236.25) return "SW";   // SouthWest
-  else if (bearing >= 236.25 && bearing < 258.75) return "WSW";  // West-SouthWest
-  else if (bearing >= 258.75 && bearing < 281.25) return "W";    // West
-  else if (bearing >= 281.25 && bearing < 303.75) return "WNW";  // West-NorthWest
-  else if (bearing >= 303.75 && bearing < 326.25) return "NW";   // NorthWest
-  else if (bearing >= 326.25 && bearing < 348.75) return "NNW";  // North-NorthWest
-  return "X";                                                    // Default case, should never be hit
+ * @return const char* A string representing the compass direction.
+ */
+const char* getCompassDirection(float bearing) {
+  static const char* const points[16] = {
+    "N", "NNE", "NE", "ENE", "E", "ESE", "SE", "SSE",
+    "S", "SSW", "SW", "WSW", "W", "WNW", "NW", "NNW"
+  };
+  if (!(bearing >= 0.0f && bearing < 360.0f)) {
+    return "X";  // Out of range, should never be hit
+  }
+  return points[(int)((bearing + 11.25f) * (1.0f / 22.5f)) & 15];  // 22.5 degree sectors centred on each point
 }
 
+#if !NAV_FIXED_POINT
 /**
  * @brief Calculates the bearing (direction) from one GPS coordinate to another.
  * 
@@ -267,93 +991,160 @@ char* getCompassDirection(double bearing) {
  * @return double The bearing in degrees from the current position to the master device.
  */
 double direction(double lat1, double lon1, double lat2, double lon2) {
-  double phi = log(tan(lat2 / 2 + M_PI / 4) / tan(lat1 / 2 + M_PI / 4));
-  double lon = abs(lon1 - lon2);
-  double bearing = atan2(lon, phi);
-  return radiansToDegrees(bearing);  // Returns bearing in degrees
+  PROF_SCOPE(profiler, PROF_DIRECTION);
+  return geo_bearing(lat1, lon1, lat2, lon2);  // Great-circle initial bearing in degrees
 }
 
+#endif
+
 /**
  * @brief Updates the LCD display with the current distance and direction.
  * 
  * This function calculates the distance and direction between the master device
- * and the current GPS position, and updates the LCD with the latest data. The
- * display is updated only if there is a change in either distance or direction.
+ * and the current GPS position, and updates the LCD with the latest data. Both
+ * are rounded to whole units with hysteresis, so GPS jitter does not redraw
+ * the screen. If neither position has changed since the last call there is
+ * nothing to redo.
  * 
- * @return void
+ * @param log Also print the values to the serial monitor.
+ * 
+ * @return true If the distance and direction were worked out again.
+ * @return false If neither position had changed.
  */
-void updateDisplay() {
-  double dist = distance(Master_latitude, Master_longitude, my_lat, my_lng);
-  Serial.printf("Distance to Master: %.2f yards\n", dist);
-  double dir = direction(Master_latitude, Master_longitude, my_lat, my_lng);
-  char* dirStr = getCompassDirection(dir);             // Convert bearing to cardinal direction
-  Serial.printf("Direction to Master: %s\n", dirStr);  // Print the cardinal direction
+bool updateDisplay(bool log) {
+#if NAV_FIXED_POINT
+  NavCoord inputs[4] = { my_lat_e6, my_lng_e6, Master_lat_e6, Master_lng_e6 };
+#else
+  NavCoord inputs[4] = { my_lat, my_lng, Master_latitude, Master_longitude };
+#endif
+  if (navShown && memcmp(inputs, navInputs, sizeof(inputs)) == 0) {
+    navSkips++;
+    return false;
+  }
+  memcpy(navInputs, inputs, sizeof(inputs));
+  navShown = true;
+  navRuns++;
+#if NAV_FIXED_POINT
+  NavDistance dist;
+  NavBearing dir;
+  {
+    PROF_SCOPE(profiler, PROF_DISTANCE);
+    dist = (NavDistance)(geo_distance_e6(Master_lat_e6, Master_lng_e6, my_lat_e6, my_lng_e6) * M_TO_CENTIYARDS + 0.5f);
+  }
+  if (log) {
+    LOG(DISTANCE, dist / 100, dist % 100);
+  }
+  {
+    PROF_SCOPE(profiler, PROF_DIRECTION);
+    dir = (NavBearing)(geo_bearing_e6(my_lat_e6, my_lng_e6, Master_lat_e6, Master_lng_e6) + 0.5f) % 360;
+  }
+#else
+  NavDistance dist = distance(Master_latitude, Master_longitude, my_lat, my_lng);
+  if (log) {
+    uint32_t hundredths = (uint32_t)(dist * 100.0 + 0.5);
+    LOG(DISTANCE, hundredths / 100, hundredths % 100);
+  }
+  NavBearing dir = direction(my_lat, my_lng, Master_latitude, Master_longitude);
+#endif
+#if NAV_FIXED_POINT
+  int32_t distHundredths = (int32_t)dist;
+  int32_t dirDeg = dir;
+#else
+  int32_t distHundredths = (int32_t)(dist * 100.0 + 0.5);
+  int32_t dirDeg = (int32_t)(dir + 0.5) % 360;
+#endif
+
+  // Whole yards and degrees that only move once the change is larger than jitter
+  int32_t yards = shownDist.update(distHundredths, 100, DIST_HYSTERESIS) / 100;
+  int32_t deg = shownDir.update(dirDeg, 1, DIR_HYSTERESIS, 360);
+  const char* dirStr = getCompassDirection(deg);       // Convert bearing to cardinal direction
+  if (log) {
+    LOG(DIRECTION, deg);  // The bearing shown, which dirStr names
+  }
 
-  // Only call display if there's a change in distance or direction
-  if (dist != lastDist || dir != lastDir) {
-    display(dist, dir, dirStr);  // Update the display with new data
+  // Render into the framebuffer and send the first slice of changed cells
+  // now; loop() sends the rest
+  display(yards, deg, dirStr);
+  flushLcd();
+  if (log) {
+    LOG(LCD_WRITES, lcdShadow.dataWrites + lcdShadow.cursorWrites, lcdShadow.writesSaved());
   }
+  return true;
 }
 
 /**
  * @brief Displays distance and direction on the LCD screen.
  * 
- * This function formats and displays the distance and direction values on 
- * the LCD screen. It only updates the display if the values have changed.
+ * This function formats the distance and direction values into the LCD
+ * framebuffer. Nothing is sent to the LCD here; the loop pushes the cells
+ * that changed a few at a time.
  * 
- * @param dist The distance in yards.
- * @param dir The direction in degrees.
+ * @param dist The distance in whole yards.
+ * @param dir The direction in whole degrees.
  * @param cardinal The cardinal direction string.
  * 
  * @return void
  */
-void display(double dist, double dir, char* cardinal) {
-  // Create string buffers to hold the formatted distance and direction
-  char distStr[10];
-  char dirStr[10];
+void display(uint32_t dist, int dir, const char* cardinal) {
+  PROF_SCOPE(profiler, PROF_DISPLAY);
+  char line[24];
 
-  // Convert dist (distance) and dir (direction) to strings
-  dtostrf(dist, 3, 2, distStr);  // Convert distance to string with 2 decimal places
-  dtostrf(dir, 3, 0, dirStr);    // Convert direction to string with no decimals
+  // Top row: distance in yards
+  int len = formatUint(line, dist, 1);
+  strcpy(line + len, " yards");
+  lcdShadow.print(0, 0, line, 16);
 
-  // Check if the distance has changed before updating
-  if (dist != lastDist) {
-    // Position the cursor to the top left of the screen and print the distance
-    lcd.setCursor(0, 0);  // (col, row)
-    lcd.print(distStr);   // Print the formatted distance
-    lcd.print(" yards");  // Appends "yards" after the distance
-    lastDist = dist;      // Update the last distance value
-  }
+  // Bottom row: "Dir: NE   38 deg"
+  strcpy(line, "Dir: ");
+  strncpy(line + 5, cardinal, 3);
+  line[8] = '\0';
+  len = strlen(line);
+  line[len++] = ' ';
+  len += formatUint(line + len, dir, 3);
+  strcpy(line + len, " deg");
+  lcdShadow.print(0, 1, line, 16);
+}
 
-  // Check if the direction has changed before updating
-  if (dir != lastDir) {
-    // Position the cursor to the bottom left of the screen and print the direction
-    lcd.setCursor(0, 1);  // (col, row)
-    lcd.print("Dir: ");   // Print "Dir:" to indicate direction
-    lcd.print(cardinal);
-    lcd.print(" ");
-    lcd.print(dirStr);  // Print the formatted direction
-    lcd.print(" deg  ");  // Appends "deg" after the bearing
-    lastDir = dir;      // Update the last direction value
+/**
+ * @brief Sends the next slice of changed cells to the LCD.
+ * 
+ * @return void
+ */
+void flushLcd() {
+  if (!lcdShadow.dirty) {
+    return;  // Only flushes with cells to send are timed
   }
+  PROF_SCOPE(profiler, PROF_LCD);
+  lcdShadow.flush(lcd, LCD_CELLS_PER_SLICE);
 }
 
+#if PROFILER
 /**
- * @brief Updates GPS data by fetching new coordinates.
+ * @brief Answers a stats request with the profiler's binary dump.
  * 
- * This function calls `getGPSData()` and updates the current GPS position
- * if new data is available.
+ * @param out Where the request came from, Serial or SerialBT.
+ * @param flags Flags of the request; PROF_REQUEST_RESET starts a new interval.
  * 
  * @return void
  */
-void updateGPS() {
-  getGPSData();
-  if (gps.location.isValid()) {
-    my_lat = gps.location.lat();
-    my_lng = gps.location.lng();
+void sendProfile(Print& out, uint8_t flags) {
+  static uint8_t dump[PROF_DUMP_MAX];
+  size_t len = profiler.dump(esp_bt_dev_get_address(), millis(), dump);
+#if CAPTURE
+  if (&out == &SerialBT) {
+    capture.put(CAPTURE_BT_TX, micros(), dump, len);
+  }
+#endif
+  {
+    PROF_SCOPE(profiler, PROF_BT_WRITE);
+    out.write(dump, len);
+  }
+  if (flags & PROF_REQUEST_RESET) {
+    profiler.reset();
   }
 }
 
+#endif
 /**
  * @brief Initializes the Bluetooth communication and attempts to connect.
  * 
@@ -373,7 +1164,7 @@ void initBluetooth() {
       btInitialized = true;
       break;
     } else {
-      Serial.printf("Bluetooth initialization failed. Retry %d/%d...\n", retry + 1, MAX_RETRIES);
+      serialPrintf("Bluetooth initialization failed. Retry %d/%d...\n", retry + 1, MAX_RETRIES);
       delay(1000);  // Wait 1 second before retrying
     }
   }
@@ -385,145 +1176,915 @@ void initBluetooth() {
 
   // BT: Define the Bt_Status callback
   SerialBT.register_callback(Bt_Status);
-  Serial.printf("The device with name \"%s\" and MAC address \"%s\" is started.\nNow you can pair it with Bluetooth!\n", device_name.c_str(), MACadd.c_str());
+  serialPrintf("The device with name \"%s\" and MAC address \"%s\" is started.\nNow you can pair it with Bluetooth!\n", device_name.c_str(), MACadd.c_str());
 }
 
 /**
- * @brief Attempts to reconnect to Bluetooth if disconnected.
+ * @brief Keeps the Bluetooth server available to the master without blocking.
  * 
- * This function tries to reconnect to the Bluetooth master device if the 
- * connection is lost. It retries up to a specified number of times.
+ * Applies the connects and drops queued by Bt_Status() to `masterLink`.
+ * After a drop, or after MASTER_WAIT_MS without a master, the SPP server is
+ * restarted once the backoff has passed; the wait grows with each failure.
  * 
  * @return void
  */
-void reconnectBluetooth() {
-  Serial.println("Attempting to reconnect to Bluetooth...");
-
-  // Try reconnecting to Bluetooth if not connected
-  if (!SerialBT.hasClient()) {
-    // Try to reconnect a few times (3 retries)
-    const int MAX_RETRIES = 3;
-    bool connected = false;
-
-    for (int attempt = 0; attempt < MAX_RETRIES; attempt++) {
-      Serial.println("Reinitializing Bluetooth...");
-      if (SerialBT.begin(device_name)) {
-        Serial.println("Bluetooth reconnected.");
-        connected = true;
-        break;
-      } else {
-        Serial.printf("Failed to reconnect (Attempt %d/%d)\n", attempt + 1, MAX_RETRIES);
-        delay(1000);  // Wait 1 second before retrying
+void serviceLink() {
+  LinkEvent ev;
+  while (xQueueReceive(linkEvents, &ev, 0) == pdPASS) {
+    if (ev.opened) {
+      bool wasDown = masterLink.down;
+      masterLink.opened(ev.atMs);
+      if (wasDown) {
+        serialPrintf("Master reconnected after %lu ms\n", (unsigned long)masterLink.stats.lastReconnectMs);
       }
+#if WARM_START
+      warmPeer(ev.address);
+#endif
+    } else {
+      masterLink.closed(ev.atMs);
+#if LINK_CLOCK
+      masterClock.reset();  // The next master may be another one, or restarted
+#endif
+      serialPrintf("Restarting Bluetooth in %lu ms\n", (unsigned long)masterLink.waitMs(ev.atMs));
     }
+  }
 
-    if (connected) {
-      MasterConnected = true;      // Mark as connected
-      digitalWrite(LED_BT, HIGH);  // Turn on the Bluetooth connection LED
-    } else {
-      Serial.println("Bluetooth reconnect failed. Please check your Bluetooth connection.");
-      MasterConnected = false;    // Ensure we don't proceed without a connection
-      digitalWrite(LED_BT, LOW);  // Turn off the LED indicating disconnected state
+  uint32_t now = millis();
+  if (masterLink.timedOut(now, MASTER_WAIT_MS)) {
+    masterLink.failed(now);
+    serialPrintf("No master for %lu s; restarting Bluetooth in %lu ms\n", MASTER_WAIT_MS / 1000,
+                 (unsigned long)masterLink.waitMs(now));
+  }
+  if (masterLink.due(now) && !SerialBT.hasClient()) {
+    Serial.println("Reinitializing Bluetooth...");
+    masterLink.connecting(now);
+    if (!SerialBT.begin(device_name)) {
+      masterLink.failed(now);
+      serialPrintf("Failed to reinitialize Bluetooth (attempt %u); retrying in %lu ms\n", masterLink.attempts,
+                   (unsigned long)masterLink.waitMs(now));
     }
   }
 }
 
 /**
- * @brief Initializes hardware components and configurations.
+ * @brief Brings the GPS receiver to its fastest useful settings.
  * 
- * This function configures the serial communication, Bluetooth, GPS, and LCD 
- * components at the start of the program.
+ * Takes about two seconds with a receiver that answers, and up to six
+ * while it probes every baud for one that does not.
  * 
  * @return void
  */
-void setup() {
-  Serial.begin(115200);       // Sets the data rate for serial data transmission, allowing communication with the Serial Monitor
-  pinMode(LED_BT, OUTPUT);    // Set LED pin as output to indicate Bluetooth connection status
-  digitalWrite(LED_BT, LOW);  // Start with LED off, indicating no Bluetooth connection
-
-  // Initialize Bluetooth module
-  initBluetooth();  // Calls the initBluetooth function to set up Bluetooth communication.
-
-  // Initialize the GPS serial communication
-  gpsSerial.begin(GPS_BAUD_RATE, SERIAL_8N1, GPS_RX_PIN, GPS_TX_PIN);  // Initialize GPS module with RX and TX pins 16 and 17
-  Serial.println("Initialization complete.");                          // Log completion of setup
+void configureGPS() {
+  GpsUartLink link;
+  GpsConfigurator config;
+  while (!config.step(link, millis())) {
+    delay(10);
+  }
+  const GpsConfigResult& r = config.result;
+  gpsSetup = r;
+  boot.mark(BOOT_GPS_SETUP, millis());
+  serialPrintf("GPS: %s receiver at %lu baud, %u fixes/s, %s, %u commands refused\n", gps_dialect_name(r.dialect),
+               (unsigned long)r.baud, r.rateHz, r.filtered ? "RMC and GGA only" : "default sentences", r.refused);
+}
 
-  //Initialize the size of the display. 16 Columns (0-15) 2 Rows (0-1)
+#if WARM_START
+/**
+ * @brief Loads the state saved before the last power-off.
+ * 
+ * The stored positions are published as if they had just arrived, so
+ * loop() works from them until the GPS and the master give live ones.
+ * Called from setup() before anything else publishes.
+ * 
+ * @return void
+ */
+void loadWarmStart() {
+  if (!nvs.begin("warm")) {
+    Serial.println("Warm start: NVS unavailable");
+    return;
+  }
+  uint8_t blob[WARM_BLOB_LEN];
+  size_t len = nvs.getBytes("state", blob, sizeof(blob));
+  warmLoaded = len && warm_decode(blob, len, &warm);
+  if (!warmLoaded) {
+    Serial.println("Warm start: nothing stored, cold start");
+    return;
+  }
+  if (warm.flags & WARM_OWN) {
+    ownShared.write(navPoint(warm.ownLat_e6, warm.ownLon_e6));
+    storedOwn = ownShared.version();
+  }
+  if (warm.flags & WARM_MASTER) {
+    MasterView view = {};  // No velocity: a stored position is not extrapolated
+    view.pos = navPoint(warm.masterLat_e6, warm.masterLon_e6);
+    masterShared.write(view);
+    storedMaster = masterShared.version();
+  }
+  serialPrintf("Warm start: saved by boot %u, own fix %s, master position %s, master %02X:%02X:%02X:%02X:%02X:%02X, "
+               "rtt %ld us\n", (unsigned)warm.boots, (warm.flags & WARM_OWN) ? "kept" : "none",
+               (warm.flags & WARM_MASTER) ? "kept" : "none", warm.peer[0], warm.peer[1], warm.peer[2], warm.peer[3],
+               warm.peer[4], warm.peer[5], (long)warm.rttUs);
+}
+
+/**
+ * @brief Hands the stored fix to the GPS receiver, so it only searches for the satellites above it.
+ * 
+ * A UBX receiver takes the position on its own. A PMTK one needs the time
+ * as well, which aidGpsTime() sends once the master's clock frames give it.
+ * 
+ * @return void
+ */
+void aidGPS() {
+  if (!(warm.flags & WARM_OWN)) {
+    return;
+  }
+  if (gpsSetup.dialect == GPS_DIALECT_UBX) {
+    uint8_t msg[28];
+    size_t len = warm_ubx_aid(warm.ownLat_e6, warm.ownLon_e6, msg);
+    gpsSerial.write(msg, len);
+    boot.mark(BOOT_AIDED, millis());
+    Serial.println("GPS: aided with the stored position");
+  } else if (gpsSetup.dialect == GPS_DIALECT_MTK && LINK_CLOCK && warm.ownUtc) {
+    warmAidPending = true;
+    Serial.println("GPS: aiding waits for the master's GPS time");
+  }
+}
+
+#if LINK_CLOCK
+/**
+ * @brief Sends PMTK741 aiding with the master's GPS time once the clock frames have it.
+ * 
+ * The date is the stored fix's, a day later if the time of day has gone
+ * back since; aiding from a client that was off for more than a day is
+ * wrong by whole days, and the receiver then starts as if it had none.
+ * 
+ * @return void
+ */
+void aidGpsTime() {
+  if (ownShared.version() != storedOwn) {
+    warmAidPending = false;  // A fix came first
+    return;
+  }
+  if (!masterClock.synced() || !masterClock.peerFix) {
+    return;
+  }
+  uint32_t dayMs = (masterClock.fixMs + (micros() - masterClock.toLocalUs(masterClock.fixUs)) / 1000) % CLOCK_DAY_MS;
+  uint32_t days = warm.ownUtc / WARM_DAY_S;
+  if (dayMs / 1000 < warm.ownUtc % WARM_DAY_S) {
+    days++;
+  }
+  char sentence[96];
+  size_t len = warm_pmtk_aid(warm.ownLat_e6, warm.ownLon_e6, days * WARM_DAY_S + dayMs / 1000, sentence);
+  gpsSerial.write((const uint8_t*)sentence, len);
+  warmAidPending = false;
+  boot.mark(BOOT_AIDED, millis());
+}
+#endif
+
+/**
+ * @brief Takes note of the master that connected.
+ * 
+ * A master other than the stored one makes the stored master position
+ * meaningless, so it is replaced with none until the new one sends its own.
+ * 
+ * @param address The master's Bluetooth address.
+ * 
+ * @return void
+ */
+void warmPeer(const uint8_t* address) {
+  if ((warm.flags & WARM_PEER) && memcmp(warm.peer, address, 6) != 0) {
+    LOG(WARM_OTHER_MASTER, LOG_MAC(address));
+    MasterView none = {};
+    masterShared.write(none);
+    storedMaster = masterShared.version();  // Positions up to here are the other master's
+    wakeNav();
+    warm.flags &= ~WARM_MASTER;
+  }
+  memcpy(warm.peer, address, 6);
+  warm.flags |= WARM_PEER;
+}
+
+// The GPS module's UTC time in seconds since 2000-01-01, or 0 if it has none
+uint32_t gpsUtc() {
+  if (!gps.date.isValid() || !gps.time.isValid() || gps.date.year() < 2001) {
+    return 0;
+  }
+  return warm_days(gps.date.year(), gps.date.month(), gps.date.day()) * WARM_DAY_S +
+         (gps.time.hour() * 60UL + gps.time.minute()) * 60UL + gps.time.second();
+}
+
+/**
+ * @brief Writes the newest fixes, master and round trip to NVS when WarmSaver says so.
+ * 
+ * Runs on the receiving side, which owns the GPS parser and the link.
+ * 
+ * @param nowMs Current time.
+ * 
+ * @return void
+ */
+void saveWarmState(uint32_t nowMs) {
+  if (ownShared.version() == storedOwn) {
+    return;  // No fix this boot; what is stored is as good as it gets
+  }
+  uint32_t utc = gpsUtc();
+  NavPoint own;
+  ownShared.read(&own);
+  navE6(own, &warm.ownLat_e6, &warm.ownLon_e6);
+  warm.ownUtc = utc;
+  warm.flags |= WARM_OWN;
+  MasterView view;
+  int32_t lat, lon;
+  if (masterShared.version() != storedMaster && masterShared.read(&view)) {
+    navE6(view.pos, &lat, &lon);
+    if (lat || lon) {
+      warm.masterLat_e6 = lat;
+      warm.masterLon_e6 = lon;
+      warm.masterUtc = utc && view.track.valid ? warm_utc_near(utc, view.track.fix.time_ms) : 0;
+      warm.flags |= WARM_MASTER;
+    }
+  }
+#if LINK_CLOCK
+  if (masterClock.synced()) {
+    warm.rttUs = masterClock.bestRttUs;
+  }
+#endif
+  if (!warmSaver.due(warm, nowMs)) {
+    return;
+  }
+  if (!warmSaver.saved) {
+    warm.boots++;
+  }
+  uint8_t blob[WARM_BLOB_LEN];
+  size_t len = warm_encode(warm, blob);
+  if (nvs.putBytes("state", blob, len) == len) {
+    warmSaver.done(warm, nowMs);
+    LOG(WARM_SAVED, warm.ownLat_e6, warm.ownLon_e6);
+  }
+}
+
+#endif
+/**
+ * @brief Shows the stored state on the LCD, or placeholder data without one.
+ * 
+ * Sends the whole screen at once; nothing else is waiting for the LCD yet.
+ * 
+ * @return void
+ */
+void showBootScreen() {
+  if (storedOwn && storedMaster) {
+    takeMaster();
+    takeOwnFix();
+    updateDisplay(false);
+  } else {
+    display(10, 90, "Z");  // Placeholder data for the initial view
+  }
+  lcdShadow.flush(lcd, 2 * 16);
+  boot.mark(BOOT_LCD, millis());
+}
+
+/**
+ * @brief printf() to the serial monitor without the heap.
+ *
+ * The core's Print::printf() formats into a 64-byte buffer on the stack
+ * and mallocs one for anything longer, which most report lines are. This
+ * formats into a stack buffer of SERIAL_LINE_MAX bytes instead and cuts
+ * off what does not fit.
+ *
+ * @param format printf() format.
+ *
+ * @return void
+ */
+void serialPrintf(const char* format, ...) {
+  char line[SERIAL_LINE_MAX];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (len > 0) {
+    Serial.write((const uint8_t*)line, (size_t)len < sizeof(line) ? len : sizeof(line) - 1);
+  }
+}
+
+/**
+ * @brief Prints the master's trail for the periodic report.
+ *
+ * Gives the trail's size, the distance the master has travelled and its
+ * average speed, how long ago it was last heard from, and how long it
+ * would take to get here at that speed.
+ *
+ * @return void
+ */
+void reportTrail() {
+  if (!masterTrail.points) {
+    return;
+  }
+  const TrailPoint& seen = masterTrail.latest();
+  NavPoint own;
+  bool fixed = ownShared.read(&own) > 0;  // my_lat and my_lng belong to loop()
+#if NAV_FIXED_POINT
+  int32_t lat = own.lat_e6, lon = own.lng_e6;
+#else
+  int32_t lat = frame_to_e6(own.lat), lon = frame_to_e6(own.lng);
+#endif
+  float eta = -1.0f;
+  if (fixed) {
+    eta = masterTrail.etaSeconds(geo_distance_e6(seen.lat_e6, seen.lon_e6, lat, lon));
+  }
+  char etaText[16] = "-";
+  if (eta >= 0.0f) {
+    snprintf(etaText, sizeof(etaText), "%lu s", (unsigned long)eta);
+  }
+  serialPrintf("Trail: %u points in %u bytes, %.0f m travelled, %.2f m/s average, last seen %lu s ago, ETA %s\n",
+               (unsigned)masterTrail.points, (unsigned)masterTrail.used, masterTrail.distanceM(),
+               masterTrail.averageSpeedMps(), (unsigned long)((millis() - seen.timeMs) / 1000), etaText);
+}
+
+#if CAPTURE
+/**
+ * @brief Opens the next free capture file on LittleFS and starts recording.
+ * 
+ * @return void
+ */
+void startCapture() {
+  if (!LittleFS.begin(true)) {
+    Serial.println("Capture: no LittleFS partition");
+    capture.stopped = true;
+    return;
+  }
+  char path[24];
+  for (int i = 0; i < 100; i++) {
+    snprintf(path, sizeof(path), "/capture-%02d.bin", i);
+    if (!LittleFS.exists(path)) {
+      captureFile = LittleFS.open(path, FILE_WRITE);
+      break;
+    }
+  }
+  if (!captureFile) {
+    Serial.println("Capture: cannot create a file; delete old captures");
+    capture.stopped = true;
+    return;
+  }
+  // Leave a block free for the file system itself
+  size_t free = LittleFS.totalBytes() - LittleFS.usedBytes();
+  free = free > 2 * CAPTURE_BLOCK_SIZE ? free - 2 * CAPTURE_BLOCK_SIZE : 0;
+  captureLimit = free < CAPTURE_MAX_BYTES ? free : CAPTURE_MAX_BYTES;
+  uint8_t meta[CAPTURE_META_LEN];
+  uint8_t link = (LINK_BINARY_FRAMES ? CAPTURE_LINK_BINARY : 0) | (LINK_DELTA_STREAM ? CAPTURE_LINK_DELTA : 0);
+  capture.put(CAPTURE_META, micros(), meta, capture_encode_meta(CAPTURE_CLIENT, link, gpsSerial.baudRate(), meta));
+  serialPrintf("Capture: recording to %s\n", path);
+}
+
+/**
+ * @brief Writes sealed capture blocks to flash; runs in logTask().
+ * 
+ * Stops the capture once the next block would not fit in `captureLimit`.
+ * 
+ * @return void
+ */
+void flushCapture() {
+  if (!captureFile) {
+    return;
+  }
+  captureWritten += capture_drain(capture, captureFile, captureLimit - captureWritten);
+  if (captureLimit - captureWritten < CAPTURE_BLOCK_SIZE) {
+    capture.stopped = true;
+    captureFile.close();
+    serialPrintf("Capture: stopped at %lu bytes\n", (unsigned long)captureWritten);
+  }
+}
+
+#endif
+/**
+ * @brief Writes out the events LOG() queued, off the loop() path.
+ *
+ * Runs at low priority on core 0, below the receiving side, so the serial
+ * port's wait for room never delays the LCD or the Bluetooth link.
+ *
+ * @param arg Unused.
+ *
+ * @return void
+ */
+void logTask(void* arg) {
+  (void)arg;
+  for (;;) {
+    log_drain(eventLog, Serial, LOG_BINARY, millis());
+#if CAPTURE
+    flushCapture();
+#endif
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+  }
+}
+
+#if POWER_SAVE
+/**
+ * @brief Milliseconds from `now` until `since + interval`, or `wait` if that is sooner.
+ * 
+ * @return uint32_t 0 if the interval is already over.
+ */
+uint32_t msUntil(uint32_t now, uint32_t since, uint32_t interval, uint32_t wait) {
+  uint32_t left = now - since >= interval ? 0 : since + interval - now;
+  return left < wait ? left : wait;
+}
+
+/**
+ * @brief Time until ingest() has something to do.
+ * 
+ * @return uint32_t 0 if there is work now, otherwise the milliseconds until
+ *         the next timer of ingest() or serviceLink() is due.
+ */
+uint32_t ingestMsUntilWork() {
+  if (SerialBT.available() || gpsSerial.available() || uxQueueMessagesWaiting(linkEvents)) {
+    return 0;
+  }
+#if PROFILER
+  if (Serial.available()) {
+    return 0;
+  }
+#endif
+  uint32_t now = millis();
+  uint32_t wait = msUntil(now, lastLoadReport, GPS_LOAD_REPORT_INTERVAL, UINT32_MAX);
+#if LINK_BINARY_FRAMES && LINK_DELTA_STREAM
+  if (frameDecoder.needKeyframe && MasterConnected) {
+    wait = msUntil(now, lastKeyRequest, KEY_REQUEST_INTERVAL, wait);
+  }
+#endif
+#if LINK_CLOCK
+  if (MasterConnected) {
+    wait = msUntil(now, now - (micros() - masterClock.lastTxUs) / 1000, CLOCK_INTERVAL_US / 1000, wait);
+  }
+#endif
+  if (masterLink.state == LINK_CONNECTING) {
+    wait = msUntil(now, masterLink.sinceMs, MASTER_WAIT_MS, wait);
+  }
+  uint32_t retry = masterLink.waitMs(now);
+  return retry < wait ? retry : wait;
+}
+
+/**
+ * @brief Time until the navigation half of loop() has something to do.
+ * 
+ * @return uint32_t 0 if there is work now, otherwise the milliseconds until
+ *         the next display update or extrapolation is due.
+ */
+uint32_t navMsUntilWork() {
+  if (lcdShadow.dirty || masterShared.version() != masterSeen) {
+    return 0;
+  }
+  uint32_t now = millis();
+  uint32_t wait = msUntil(now, lastUpdateTime, UPDATE_INTERVAL, UINT32_MAX);
+#if DEAD_RECKONING
+  if (masterTrack.moving(now)) {
+    wait = msUntil(now, lastPredictTime, DR_REFRESH_INTERVAL, wait);
+  }
+#endif
+  return wait;
+}
+
+/**
+ * @brief Holds off light sleep while a GPS burst is due, and releases it after.
+ * 
+ * @param hold true while GpsBurstClock::holdAwake() says so.
+ * 
+ * @return void
+ */
+void holdGpsAwake(bool hold) {
+  if (hold == gpsAwake) {
+    return;
+  }
+  gpsAwake = hold;
+  if (gpsAwakeLock) {
+    if (hold) {
+      esp_pm_lock_acquire(gpsAwakeLock);
+    } else {
+      esp_pm_lock_release(gpsAwakeLock);
+    }
+  }
+  if (hold) {
+    duty.wake(micros(), POWER_WAKE_TIMER);
+  } else {
+    duty.sleep(micros());
+  }
+}
+
+/**
+ * @brief Blocks the receiving side until it has work, a callback wakes it or a GPS burst is due.
+ * 
+ * While both cores are blocked and no GPS burst is expected, the idle task
+ * can put the chip into light sleep.
+ * 
+ * @param wait Milliseconds until its next timer, UINT32_MAX if none.
+ * 
+ * @return void
+ */
+void ingestWait(uint32_t wait) {
+  uint32_t changeUs;
+  holdGpsAwake(gpsBursts.holdAwake(micros(), &changeUs));
+  if (changeUs != UINT32_MAX) {
+    uint32_t changeMs = (changeUs + 999) / 1000;
+    wait = changeMs < wait ? changeMs : wait;
+  }
+  if (wait == 0) {
+    gpsWoke = false;
+    return;
+  }
+#if !DUAL_CORE
+  PROF_IDLE(profiler);  // loop() waits here; the wait is not a stall
+#endif
+  duty.sleep(micros());
+  bool woken = ulTaskNotifyTake(pdTRUE, wait == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(wait)) > 0;
+  uint8_t causes = wakeCauses.exchange(0);
+  PowerWake cause = !woken                            ? POWER_WAKE_TIMER
+                    : (causes & (1 << POWER_WAKE_GPS)) ? POWER_WAKE_GPS
+                    : (causes & (1 << POWER_WAKE_USB)) ? POWER_WAKE_USB
+                                                       : POWER_WAKE_BT;
+  gpsWoke = cause == POWER_WAKE_GPS;
+  duty.wake(micros(), cause);
+}
+
+#if DUAL_CORE
+/**
+ * @brief Blocks loop() until a master position is published or a display timer is due.
+ * 
+ * @return void
+ */
+void navWait() {
+  uint32_t wait = navMsUntilWork();
+  if (wait == 0) {
+    return;
+  }
+  PROF_IDLE(profiler);  // The wait is not a stall
+  duty.sleep(micros());
+  bool woken = ulTaskNotifyTake(pdTRUE, wait == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(wait)) > 0;
+  duty.wake(micros(), woken ? POWER_WAKE_BT : POWER_WAKE_TIMER);  // Only wakeNav() notifies loop()
+}
+
+#endif
+
+/**
+ * @brief Turns on automatic light sleep with the GPS RX pin as a wake-up source.
+ * 
+ * The CPU stays at full speed so the UART baud rates do not change, and
+ * the Bluetooth controller keeps the SPP link in modem sleep.
+ * 
+ * @return true If light sleep is enabled.
+ * @return false If the firmware does not support it; loop() still blocks.
+ */
+bool startLightSleep() {
+  esp_pm_config_esp32_t pm = { 240, 240, true };
+  if (esp_pm_configure(&pm) != ESP_OK) {
+    Serial.println("Light sleep unavailable; staying awake between fixes");
+    return false;
+  }
+  esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "gps", &gpsAwakeLock);
+  gpio_wakeup_enable((gpio_num_t)GPS_RX_PIN, GPIO_INTR_LOW_LEVEL);  // A start bit
+  esp_sleep_enable_gpio_wakeup();
+  esp_bt_sleep_enable();
+  Serial.println("Light sleep on between GPS bursts and Bluetooth traffic");
+  return true;
+}
+
+#endif
+/**
+ * @brief Prints the periodic report: GPS parse load, link, loop, power, clock, trail and fences.
+ * 
+ * Runs on the receiving side, which owns most of what it reports.
+ * 
+ * @param nowMs Current time.
+ * 
+ * @return void
+ */
+void report(uint32_t nowMs) {
+  float bytesPerSec, fixesPerSec;
+  gpsLoad.sample(nowMs, &bytesPerSec, &fixesPerSec);
+  serialPrintf("GPS parse load: %.0f B/s, %.1f fixes/s\n", bytesPerSec, fixesPerSec);
+  const LinkStats& ls = masterLink.stats;
+  serialPrintf("Link: %s, up %lu s, %lu drops, %lu failures, reconnect last/mean/max %lu/%lu/%lu ms\n",
+               link_state_name(masterLink.state), (unsigned long)(masterLink.connectedMs(nowMs) / 1000),
+               (unsigned long)ls.drops, (unsigned long)ls.failures, (unsigned long)ls.lastReconnectMs,
+               (unsigned long)masterLink.meanReconnectMs(), (unsigned long)ls.maxReconnectMs);
+#if PROFILER
+  serialPrintf("Loop: mean %lu us, jitter %lu us, %lu stalls, longest %lu us in %s\n",
+               (unsigned long)profiler.meanPeriodUs(), (unsigned long)profiler.jitterUs(),
+               (unsigned long)profiler.stalls, (unsigned long)profiler.worstStallUs,
+               profiler.worstStallStage < PROF_STAGES ? PROF_STAGE_NAMES[profiler.worstStallStage] : "-");
+#endif
+#if POWER_SAVE
+  float wakesPerSec[POWER_WAKE_CAUSES];
+  float awake = duty.sample(micros(), wakesPerSec);
+  serialPrintf("Power: awake %.1f%%, wakes/s timer %.1f gps %.1f bt %.1f usb %.1f, light sleep %s\n", awake,
+               wakesPerSec[POWER_WAKE_TIMER], wakesPerSec[POWER_WAKE_GPS], wakesPerSec[POWER_WAKE_BT],
+               wakesPerSec[POWER_WAKE_USB], lightSleepOn ? "on" : "unavailable");
+#endif
+#if LINK_CLOCK
+  if (masterClock.synced()) {
+    serialPrintf("Clock: rtt last %ld us, mean %ld us, min %ld us, one-way %ld us, master offset %+ld us\n",
+                 (long)masterClock.rttUs, (long)masterClock.rttMeanUs, (long)masterClock.bestRttUs,
+                 (long)masterClock.oneWayUs(), (long)masterClock.offsetUs);
+  }
+  if (agedFixes) {
+    serialPrintf("Master position age: last %ld ms, mean %ld ms, max %ld ms over %lu positions\n",
+                 (long)(masterAgeUs / 1000), (long)(masterAgeMeanUs / 1000), (long)(masterAgeMaxUs / 1000),
+                 (unsigned long)agedFixes);
+  }
+#endif
+#if LINK_DELTA_STREAM
+  serialPrintf("Stream: %lu fixes, %lu rebuilt, %lu lost, %lu stale, %lu CRC errors, %lu keyframe requests\n",
+               (unsigned long)frameDecoder.frames, (unsigned long)frameDecoder.recovered,
+               (unsigned long)frameDecoder.lost, (unsigned long)frameDecoder.stale,
+               (unsigned long)frameDecoder.crcErrors, (unsigned long)keyRequests);
+#elif LINK_BINARY_FRAMES
+  serialPrintf("Frames: %lu decoded, %lu CRC errors\n", (unsigned long)frameDecoder.frames,
+               (unsigned long)frameDecoder.crcErrors);
+#endif
+  serialPrintf("Snapshots: %lu master and %lu own positions published, %lu reads retried\n",
+               (unsigned long)masterShared.version(), (unsigned long)ownShared.version(),
+               (unsigned long)(masterShared.retries.load() + ownShared.retries.load()));
+#if OWN_FILTER
+  serialPrintf("Own fix: %lu taken, %lu outliers, %lu weak, %lu restarts, %lu passed on, %lu held within %.1f m\n",
+               (unsigned long)ownFilter.fixes, (unsigned long)ownFilter.rejected, (unsigned long)ownFilter.weak,
+               (unsigned long)ownFilter.restarts, (unsigned long)ownGate.passed, (unsigned long)ownGate.held,
+               (double)OWN_MOVE_M);
+#endif
+  serialPrintf("Navigation: %lu passes redone, %lu skipped with neither position moved\n",
+               (unsigned long)navRuns.load(), (unsigned long)navSkips.load());
+  reportTrail();
+  serialPrintf("Fences: %u in %u cell listings, master inside %u, tested %lu of %lu fixes, here tested %lu of %lu\n",
+               (unsigned)fences.count, (unsigned)fences.used, (unsigned)masterFences.insideCount(),
+               (unsigned long)(masterFences.updates - masterFences.skipped), (unsigned long)masterFences.updates,
+               (unsigned long)(myFences.updates - myFences.skipped), (unsigned long)myFences.updates);
+#if CAPTURE
+  if (captureFile) {
+    serialPrintf("Capture: %lu bytes on flash, %lu bytes dropped\n", (unsigned long)captureWritten,
+                 (unsigned long)capture.dropped.load());
+  }
+#endif
+  if (!bootReported && (boot.reached(BOOT_LIVE) || nowMs >= BOOT_REPORT_MS)) {
+    bootReported = true;
+    char stages[192];
+    boot.format(stages, sizeof(stages));
+#if WARM_START
+    const char* kind = warmLoaded ? "warm" : "cold";
+#else
+    const char* kind = "cold";
+#endif
+    serialPrintf("Boot (%s): %s\n", kind, stages);
+  }
+  reportHeap();
+}
+
+/**
+ * @brief Prints the heap watermarks and the allocations made since setup().
+ * 
+ * @return void
+ */
+void reportHeap() {
+  uint32_t largest = ESP.getMaxAllocHeap();
+  if (largest < heapLargestMin) {
+    heapLargestMin = largest;
+  }
+#if HEAP_WATCH_COUNTS
+  serialPrintf("Heap: %lu B free, %lu B min free, largest block %lu B (min %lu B), %lu allocations since setup\n",
+               (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap(), (unsigned long)largest,
+               (unsigned long)heapLargestMin, (unsigned long)heap_watch_allocations());
+#else
+  serialPrintf("Heap: %lu B free, %lu B min free, largest block %lu B (min %lu B)\n", (unsigned long)ESP.getFreeHeap(),
+               (unsigned long)ESP.getMinFreeHeap(), (unsigned long)largest, (unsigned long)heapLargestMin);
+#endif
+}
+
+/**
+ * @brief One pass of the receiving side: the link, the master's positions and the GPS.
+ * 
+ * Publishes each master position and own fix for loop(), which does not
+ * touch the link, the GPS parser or what they feed.
+ * 
+ * @return void
+ */
+void ingest() {
+  // Track the link and restart the Bluetooth server when its backoff is over; never waits
+  serviceLink();
+
+#if PROFILER
+  // Stats dump on request from the serial monitor
+  while (Serial.available()) {
+    if (usbProfRequest.push((uint8_t)Serial.read())) {
+      sendProfile(Serial, usbProfRequest.flags);
+    }
+  }
+#endif
+
+  // Drain the Bluetooth link and the GPS UART on every pass so nothing backs up between updates
+  if (MasterConnected) {
+    receiveMaster();
+  }
+#if LINK_CLOCK
+  if (MasterConnected) {
+    sendClock();
+  }
+#endif
+#if WARM_START && LINK_CLOCK
+  if (warmAidPending) {
+    aidGpsTime();
+  }
+#endif
+  readGPS();
+  getGPSData();
+
+  if (millis() - lastLoadReport >= GPS_LOAD_REPORT_INTERVAL) {
+    lastLoadReport = millis();
+    report(lastLoadReport);
+#if WARM_START
+    saveWarmState(lastLoadReport);  // At the report's pace; WarmSaver writes far less often
+#endif
+  }
+}
+
+#if DUAL_CORE
+/**
+ * @brief Runs ingest() on core 0, next to the Bluetooth stack, while loop() navigates on core 1.
+ * 
+ * With POWER_SAVE it blocks until a callback or one of its timers has work
+ * for it, as loop() does.
+ * 
+ * @param arg Unused.
+ * 
+ * @return void
+ */
+void ingestTask(void* arg) {
+  (void)arg;
+#if POWER_SAVE
+  duty.wake(micros(), POWER_WAKE_TIMER);
+#endif
+  for (;;) {
+#if POWER_SAVE
+    ingestWait(ingestMsUntilWork());
+#else
+    vTaskDelay(1);  // Poll every tick; the UART and SPP buffers hold far more than that
+#endif
+    ingest();
+  }
+}
+
+#endif
+/**
+ * @brief Initializes hardware components and configurations.
+ * 
+ * This function configures the serial communication, Bluetooth, GPS, and LCD 
+ * components at the start of the program. The LCD comes first, showing the
+ * state stored before power-off when there is one.
+ * 
+ * @return void
+ */
+void setup() {
+  Serial.begin(115200);       // Sets the data rate for serial data transmission, allowing communication with the Serial Monitor
+  pinMode(LED_BT, OUTPUT);    // Set LED pin as output to indicate Bluetooth connection status
+  digitalWrite(LED_BT, LOW);  // Start with LED off, indicating no Bluetooth connection
+  xTaskCreatePinnedToCore(logTask, "log", 4096, NULL, tskIDLE_PRIORITY + 1, &logTaskHandle, 0);  // Before anything logs
+
+  //Initialize the size of the display. 16 Columns (0-15) 2 Rows (0-1)
   lcd.begin(16, 2);            // Initialize the LCD display with 16 columns and 2 rows
   lcd.clear();                 // Clear any previous content on the display
-  display(10.00, 90.00, "Z");  // Call the display function with empty data  (0.0, 0.0) for initial view
+  lcdShadow.cleared();         // The framebuffer now matches the blank display
+#if WARM_START
+  loadWarmStart();             // Last fixes from before power-off, published for loop()
+#endif
+  showBootScreen();            // Within milliseconds of power-up, before the radio and the GPS
+
+  // Initialize Bluetooth module
+  linkEvents = xQueueCreate(8, sizeof(LinkEvent));  // Before the callback can fire
+  initBluetooth();  // Calls the initBluetooth function to set up Bluetooth communication.
+  const uint8_t* ownAddress = esp_bt_dev_get_address();
+  if (ownAddress) {
+    masterLink.seed(ownAddress, 6);  // Clients that lose the master together retry at different times
+  }
+  masterLink.connecting(millis());  // Listening for the master
+#if POWER_SAVE
+  loopTaskHandle = xTaskGetCurrentTaskHandle();  // setup() and loop() run in the same task
+  duty.wake(micros(), POWER_WAKE_TIMER);
+#endif
+#if !DUAL_CORE
+  ingestTaskHandle = xTaskGetCurrentTaskHandle();  // loop() receives too
+#endif
+#if PROFILER
+  profiler.begin(PROF_STAGE_NAMES, PROF_STAGES, ESP.getCpuFreqMHz());
+#endif
+
+  // Initialize the GPS serial communication
+  gpsSerial.begin(GPS_BAUD_RATE, SERIAL_8N1, GPS_RX_PIN, GPS_TX_PIN);  // Initialize GPS module with RX and TX pins 16 and 17
+#if GPS_CONFIG
+  configureGPS();  // Faster baud and fix rate, RMC and GGA only
+#if WARM_START
+  aidGPS();        // The stored fix, so the receiver knows where to look
+#endif
+#endif
+#if POWER_SAVE
+  gpsSerial.onReceive(onGpsReceive);  // Wake the receiving side for GPS bytes
+#if PROFILER
+  Serial.onReceive(onUsbReceive);     // And for stats requests
+#endif
+  lightSleepOn = startLightSleep();
+  gpsBursts.begin(micros());
+#endif
+#if CAPTURE
+  startCapture();  // After the GPS baud is settled, which the capture records
+#endif
+  for (size_t i = 0; i < sizeof(FENCES) / sizeof(FENCES[0]); i++) {
+    if (fences.add(FENCES[i].lat_e6, FENCES[i].lon_e6, FENCES[i].radiusM) < 0) {
+      serialPrintf("Fences: no room for fence %u\n", (unsigned)i);
+    }
+  }
+  Serial.println("Initialization complete.");                          // Log completion of setup
+#if DUAL_CORE
+  // Radio and GPS on core 0 with the Bluetooth stack, above logTask(); loop() stays on core 1.
+  // The stack is the Arduino loop task's, for the report's printf
+  xTaskCreatePinnedToCore(ingestTask, "ingest", 8192, NULL, 2, &ingestTaskHandle, 0);
+#endif
+  // From here on nothing of the sketch's should touch the heap
+  TaskHandle_t tasks[] = { xTaskGetCurrentTaskHandle(), ingestTaskHandle, logTaskHandle };
+  heap_watch_arm(tasks, sizeof(tasks) / sizeof(tasks[0]), HEAP_TRAP);
 }
 
 /**
- * @brief Main loop for checking Bluetooth and GPS status.
+ * @brief Main loop: navigation and the LCD.
  * 
- * This function continuously checks the Bluetooth connection status and 
- * retrieves GPS data. It also updates the LCD display with the latest 
- * information.
+ * With DUAL_CORE this runs on core 1 and only reads the master's and this
+ * client's positions from the snapshots ingestTask() publishes on core 0.
+ * Otherwise it runs ingest() first on every pass. It updates the LCD with
+ * the distance and direction to the master.
  * 
  * @return void
  */
 void loop() {
-  static unsigned long lastUpdateTime = 0;  // Tracks the last time the loop executed specific tasks
-  unsigned long lastBtCheck = 0;            // Variable to track when to check Bluetooth status
-
-  // Periodically check Bluetooth status every BT_CHECK_INTERVAL (5 seconds).
-  if (millis() - lastBtCheck >= BT_CHECK_INTERVAL) {
-    lastBtCheck = millis();  // Update the last Bluetooth check time
-    if (!MasterConnected) {  // If Bluetooth is disconnected, attempt to reconnect
-      reconnectBluetooth();  // Call the reconnection function if disconnected
-    }
+#if POWER_SAVE
+#if DUAL_CORE
+  navWait();  // Block, and let the core idle, until there is something to do
+#else
+  uint32_t ingestMs = ingestMsUntilWork(), navMs = navMsUntilWork();
+  ingestWait(ingestMs < navMs ? ingestMs : navMs);  // Block, and let the chip sleep, until there is something to do
+#endif
+#endif
+  PROF_LOOP(profiler);  // Loop period and stalls
+#if !DUAL_CORE
+  ingest();
+#endif
+
+  // Send a few changed LCD cells per pass instead of blocking on a full redraw
+  flushLcd();
+
+  bool masterUpdated = takeMaster();
+
+#if DEAD_RECKONING
+  // Between updates, move the master along its velocity at the local display rate
+  bool masterMoved = !masterUpdated && masterTrack.moving(millis()) && millis() - lastPredictTime >= DR_REFRESH_INTERVAL;
+  if (masterMoved || (masterTrack.valid && millis() - lastUpdateTime >= UPDATE_INTERVAL)) {
+    lastPredictTime = millis();
+    predictMaster();
   }
+#endif
 
-  // Check if it's time to perform an update
-  if (millis() - lastUpdateTime >= UPDATE_INTERVAL) {
+  // Check if it's time to perform an update, or a new master position just arrived
+  if (masterUpdated || millis() - lastUpdateTime >= UPDATE_INTERVAL) {
     lastUpdateTime = millis();  // Reset the last update time
 
-    getGPSData();  // Fetches GPS data from getGPSData from the GPS module
-
-    // If Bluetooth is connected, handle incoming data
-    if (MasterConnected) {
-      // BT: Check if data is available from the Bluetooth
-      if (SerialBT.available()) {
-        Serial.println(gpsData);
-        size_t maxLen = sizeof(gpsData) - 1;  // Max buffer size, leaving space for null-terminator
-        if (SerialBT.available() > maxLen) {  // If incoming data is larger than the buffer size, handle error
-          Serial.println("Error: Incoming data too large.");
-          SerialBT.flush();  // Clear the Bluetooth buffer to discard the oversized data
-          return;
-        }
-        int len = SerialBT.readBytesUntil('\n', gpsData, maxLen);  // Read GPS data until newline character or buffer is full
-        gpsData[len] = '\0';                                       // Null-terminate the string
-
-        if (len > 0) {                        // If the received data length is greater than 0 (valid data)
-          if (!gps_parse(String(gpsData))) {  // Ensure gps_parse returns success
-            Serial.println("Error: Failed to parse GPS data.");
-          }
-        } else {
-          Serial.println("Error: Received empty or invalid GPS data.");
-        }
-      }
-    } else {
-      Serial.println("Waiting for Master to connect...");  // Print message if Bluetooth is disconnected
+    takeOwnFix();  // This client's newest fix, as the receiving side published it
+
+    if (!MasterConnected) {
+      LOG(WAITING);  // Bluetooth is disconnected
     }
 
     // Check Master GPS coordinates are available before calculating distance
+#if NAV_FIXED_POINT
+    if (Master_lat_e6 == 0 && Master_lng_e6 == 0) {
+#else
     if (Master_latitude == 0.0 && Master_longitude == 0.0) {
-      Serial.println("Warning: Master GPS coordinates are not set.");  // Alert if Master GPS data is not set
-      return;                                                          // Exit the loop if Master coordinates are missing
+#endif
+      LOG(MASTER_UNSET);  // Alert if Master GPS data is not set
+      return;             // Exit the loop if Master coordinates are missing
     }
 
     // Proceed only if GPS data is valid
-    if (!gps.location.isValid()) {
-      Serial.println("Warning: GPS data is invalid or not updated.");  // Alert if GPS data is invalid
-      return;                                                          // Exit if the GPS location is invalid.
+    if (!ownSeen) {
+      LOG(GPS_INVALID);  // Alert if GPS data is invalid
+      return;            // Exit if the GPS location is invalid.
     }
 
     // Update the LCD display with the current distance and direction.
-    updateDisplay();
+    bool redone = updateDisplay(true);
+    if (ownSeen != storedOwn && masterSeen != storedMaster) {
+      boot.mark(BOOT_LIVE, millis());  // Nothing on the screen comes from NVS any more
+    }
 
     // Log additional data to the serial monitor
-    Serial.printf("Current Location:\t Lat: %.11lf, Long: %.11lf\n", my_lat, my_lng);
-    Serial.printf("Master Location:\t Lat: %.11lf, Long: %.11lf\n", Master_latitude, Master_longitude);
+    if (redone) {
+#if NAV_FIXED_POINT
+      LOG(LOCATIONS, my_lat_e6, my_lng_e6, Master_lat_e6, Master_lng_e6);
+#else
+      LOG(LOCATIONS, frame_to_e6(my_lat), frame_to_e6(my_lng), frame_to_e6(Master_latitude), frame_to_e6(Master_longitude));
+#endif
+    }
   }
+#if DEAD_RECKONING
+  else if (masterMoved && ownSeen) {
+    updateDisplay(false);  // Quietly, several times per second
+  }
+#endif
 }
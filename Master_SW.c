@@ -1,99 +1,1116 @@
-#include "BluetoothSerial.h"
+#include "esp_bt_device.h"
+#include "esp_bt_main.h"
+#include "esp_gap_bt_api.h"
+#include "esp_spp_api.h"
+#include "esp_bt.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include "LittleFS.h"
 #include "TinyGPS++.h"
+#include "src/PositionFrame.h"
+#include "src/PositionStream.h"
+#include "src/DeadReckoning.h"
+#include "src/SessionManager.h"
+#include "src/LinkClock.h"
+#include "src/GeoBatch.h"
+#include "src/GpsConfig.h"
+#include "src/Profiler.h"
+#include "src/LogEvents.h"
+#include "src/PowerManager.h"
+#include "src/Capture.h"
+#include "src/HeapWatch.h"
 
 #define RXD2 16
 #define TXD2 17
 #define GPS_BAUD 9600
+// 1 = send binary position frames, 0 = legacy "Latitude: ... Longitude: ..." text
+// Must match LINK_BINARY_FRAMES in Client_SW.c
+#ifndef LINK_BINARY_FRAMES
+#define LINK_BINARY_FRAMES 1
+#endif
+// 1 = send keyframes plus varint deltas (needs LINK_BINARY_FRAMES), 0 = a full frame per fix
+// Must match LINK_DELTA_STREAM in Client_SW.c
+#ifndef LINK_DELTA_STREAM
+#define LINK_DELTA_STREAM 1
+#endif
+// 1 = each delta also carries the step before it, so a client that missed one frame
+// rebuilds it from the next instead of waiting for a keyframe (needs LINK_DELTA_STREAM;
+// clients decode both), 0 = plain deltas, 3 to 5 bytes smaller
+#ifndef LINK_REDUNDANCY
+#define LINK_REDUNDANCY 1
+#endif
+// 1 = the master skips fixes the clients can extrapolate from speed and course (needs
+// LINK_BINARY_FRAMES), 0 = every fix is sent
+// Must match DEAD_RECKONING in Client_SW.c
+#ifndef DEAD_RECKONING
+#define DEAD_RECKONING 1
+#endif
+// 1 = exchange clock frames with every client for round-trip time, clock offset and
+// the client's position (src/LinkClock.h; needs LINK_BINARY_FRAMES), 0 = positions only
+// Must match LINK_CLOCK in Client_SW.c
+#ifndef LINK_CLOCK
+#define LINK_CLOCK 1
+#endif
+// 1 = at startup, ask the GPS receiver for RMC and GGA only, a higher baud and
+// a faster fix rate (PMTK or UBX), 0 = use it at its 9600 baud defaults
+#ifndef GPS_CONFIG
+#define GPS_CONFIG 1
+#endif
+// 1 = the log task writes binary records for host/tools/log_decode, 0 = text lines
+#ifndef LOG_BINARY
+#define LOG_BINARY 0
+#endif
+// 1 = every task blocks until it has work and the chip light-sleeps in between
+// (src/PowerManager.h), 0 = loop() polls every 10 ms
+#ifndef POWER_SAVE
+#define POWER_SAVE 1
+#endif
+// 1 = record GPS input and link traffic to a LittleFS file for host/tools/replay
+// (src/Capture.h), 0 = no capture
+#ifndef CAPTURE
+#define CAPTURE 0
+#endif
+// 1 = stop at the first heap allocation any of the sketch's tasks makes after setup()
+// (src/HeapWatch.h), 0 = count them for the periodic report
+#ifndef HEAP_TRAP
+#define HEAP_TRAP 0
+#endif
+#if !LINK_BINARY_FRAMES
+#undef LINK_DELTA_STREAM
+#define LINK_DELTA_STREAM 0
+#undef DEAD_RECKONING
+#define DEAD_RECKONING 0
+#undef LINK_CLOCK
+#define LINK_CLOCK 0
+#endif
 
 TinyGPSPlus gps;
 HardwareSerial gpsSerial(2);
-BluetoothSerial SerialBT;
 
-unsigned long previousMillisReconnect;
-bool SlaveConnected = false;
-int recatt = 0;
+#define GPS_RX_THRESHOLD 16           // UART FIFO level that wakes the GPS task
+#define FIX_QUEUE_LEN 4               // Fixes waiting for the transmit task
+#define SPP_SERVER_CHANNEL 1          // RFCOMM channel of a BluetoothSerial slave's SPP server
+#define LATENCY_REPORT_INTERVAL 10000 // ms between per-client throughput/latency reports
+#define NEAREST_REPORTED 3            // Clients listed by distance in the periodic report
+#define SERIAL_LINE_MAX 256           // Longest line serialPrintf() writes
+#define MAC_STRING_LEN 18             // "1C:69:20:C6:5E:32" and its NUL
+#define CAPTURE_MAX_BYTES (512 * 1024)  // Largest capture file; about five minutes of RMC and GGA at 10 fixes/s
+#if POWER_SAVE
+#define LOG_DRAIN_MS 250              // How often the log task writes out queued events; rarely, so the chip can sleep
+#define RETRY_INTERVAL 10             // ms between retries of frames a congested link turned down
+#else
+#define LOG_DRAIN_MS 20               // How often the log task writes out queued events
+#endif
+
+uint8_t txSeq = 0;  // Sequence number of the next position frame
+uint32_t fixesDropped = 0;  // Fixes replaced by a newer one before they were sent
+uint32_t fixesCovered = 0;  // Fixes not sent because the clients' extrapolation was close enough
+PositionFix clientView;     // The last fix sent, as the clients hold it
+bool clientViewValid = false;
+GpsLoad gpsLoad;            // NMEA bytes and fixes parsed, for the periodic report
+unsigned long previousMillisReport;
+
+TaskHandle_t gpsTaskHandle;
+TaskHandle_t transmitTaskHandle;
+TaskHandle_t linkTaskHandle;
+TaskHandle_t logTaskHandle;
+TaskHandle_t loopTaskHandle;
+uint32_t heapLargestMin = UINT32_MAX;  // Smallest largest free block seen by the report
+QueueHandle_t fixQueue;
+SemaphoreHandle_t sessionLock;  // Guards `sessions` between the tasks and the SPP callback
+EventRing<LOG_RING_SIZE> eventLog;  // LOG() events from every task, waiting for logTask()
+SessionManager sessions;
+#if LINK_DELTA_STREAM
+StreamEncoder streamEncoder;  // Shared by every client, like the frames it encodes
+#endif
+#if LINK_CLOCK
+LinkClock clientClocks[SESSION_MAX_CLIENTS];  // Round trip, offset and position of each client, by slot; guarded by sessionLock
+#endif
+#if POWER_SAVE
+std::atomic<uint8_t> wakeCauses{0};         // PowerWake bits of the callbacks since loop() last woke
+GpsBurstClock gpsBursts;                    // When the GPS receiver's next burst is due; GPS task only
+DutyCycle duty;                             // Share of time the tasks keep the chip awake
+esp_pm_lock_handle_t gpsAwakeLock = nullptr;  // Held while a GPS burst is due, so the UART misses nothing
+bool gpsAwake = false;                      // Whether gpsAwakeLock is held
+bool lightSleepOn = false;                  // Automatic light sleep could be enabled
+#endif
+#if CAPTURE
+CaptureWriter<CAPTURE_BLOCKS> capture;      // Records waiting for logTask() to write them to flash
+SemaphoreHandle_t captureLock;              // Serializes capture.put() between the tasks and the SPP callback
+File captureFile;                           // Open while capturing
+size_t captureWritten = 0;                  // Bytes in captureFile
+size_t captureLimit = 0;                    // Size at which the capture stops
+#endif
+
+// Stages timed by the profiler (PROFILER in src/Profiler.h), in the order of PROF_STAGE_NAMES.
+// Each runs in one task; the stage blamed for a loop() stall is the slowest one anywhere.
+enum ProfStage {
+  PROF_GPS_PARSE,  // NMEA parsed per UART wake-up in the GPS task
+  PROF_ENCODE,     // Fix encoded and published by the transmit task
+  PROF_BT_WRITE,   // Session frames handed to the SPP stack
+  PROF_BT_EVENT,   // SPP callback
+  PROF_REPORT,     // Periodic serial report
+  PROF_STAGES
+};
+#if PROFILER
+const char* const PROF_STAGE_NAMES[PROF_STAGES] = { "gps parse", "encode", "bt write", "bt event", "report" };
+Profiler profiler;
+ProfRequestMatcher usbProfRequest;  // Stats requests from the serial monitor
+#endif
+
+// A parsed fix and when its last NMEA byte was read from the UART
+struct QueuedFix {
+  PositionFix fix;
+  int64_t rxUs;
+};
+
+/*
+ * Sends session frames over the ESP-IDF SPP API. BluetoothSerial only
+ * manages one link, so the master drives the SPP handles itself, one per
+ * client.
+ */
+struct SppTransport {
+  bool congested[SESSION_MAX_CLIENTS];  // Stack asked us to stop writing to this client
+
+  bool connect(uint8_t slot, const uint8_t address[6]) {
+    congested[slot] = false;
+    return esp_spp_connect(ESP_SPP_SEC_NONE, ESP_SPP_ROLE_MASTER, SPP_SERVER_CHANNEL, (uint8_t*)address) == ESP_OK;
+  }
+
+  bool send(uint8_t slot, const uint8_t* data, size_t len) {
+    if (congested[slot]) {
+      return false;
+    }
+    return esp_spp_write(sessions.clients[slot].handle, (int)len, (uint8_t*)data) == ESP_OK;
+  }
+};
+SppTransport spp;
+
+// The GPS UART as GpsConfigurator sees it
+struct GpsUartLink {
+  void setBaud(uint32_t baud) {
+    gpsSerial.updateBaudRate(baud);
+  }
+
+  int read() {
+    return gpsSerial.read();
+  }
+
+  void write(const uint8_t* data, size_t len) {
+    gpsSerial.write(data, len);
+  }
+};
 
 String myName = "ESP32-BT-Master";
-String slaveName = "ESP32-BT-Slave";
-String MACadd = "1C:69:20:C6:5E:32";  // Adjust as needed
-uint8_t address[6] = { 0x1C, 0x69, 0x20, 0xC6, 0x5E, 0x32 };  // MAC address of the slave device
+// Clients in the group, one line each. Adjust as needed
+uint8_t clientAddresses[][6] = {
+  { 0x1C, 0x69, 0x20, 0xC6, 0x5E, 0x32 },  // MAC address of the slave device
+};
 
-// Bluetooth status callback function
+// Formats a Bluetooth address as "1C:69:20:C6:5E:32" into `text`, MAC_STRING_LEN bytes, and returns it
+const char* macString(const uint8_t* mac, char* text) {
+  snprintf(text, MAC_STRING_LEN, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  return text;
+}
+
+/**
+ * @brief printf() to the serial monitor without the heap.
+ *
+ * The core's Print::printf() formats into a 64-byte buffer on the stack
+ * and mallocs one for anything longer, which most report lines are. This
+ * formats into a stack buffer of SERIAL_LINE_MAX bytes instead and cuts
+ * off what does not fit.
+ *
+ * @param format printf() format.
+ *
+ * @return void
+ */
+void serialPrintf(const char* format, ...) {
+  char line[SERIAL_LINE_MAX];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (len > 0) {
+    Serial.write((const uint8_t*)line, len < (int)sizeof(line) ? len : sizeof(line) - 1);
+  }
+}
+
+/**
+ * @brief Marks the calling task blocked, for the duty-cycle report.
+ *
+ * @return void
+ */
+void taskBlocked() {
+#if POWER_SAVE
+  duty.sleep(micros());
+#endif
+}
+
+/**
+ * @brief Marks the calling task running again, for the duty-cycle report.
+ *
+ * @param cause What unblocked it.
+ *
+ * @return void
+ */
+void taskRunning(PowerWake cause) {
+#if POWER_SAVE
+  duty.wake(micros(), cause);
+#endif
+}
+
+/**
+ * @brief Wakes loop() from a driver callback.
+ *
+ * @param cause What has work for loop(), for the duty-cycle report.
+ *
+ * @return void
+ */
+void wakeLoop(PowerWake cause) {
+#if POWER_SAVE
+  wakeCauses.fetch_or(1 << cause);
+  xTaskNotifyGive(loopTaskHandle);
+#endif
+}
+
+// UART receive event on the serial monitor: USB input for loop()
+void onUsbReceive() {
+  wakeLoop(POWER_WAKE_USB);
+}
+
+/**
+ * @brief Records bytes in the capture; safe to call from any task.
+ *
+ * @param source What the bytes are (CaptureSource).
+ * @param data The bytes.
+ * @param len Their number.
+ *
+ * @return void
+ */
+void captureBytes(uint8_t source, const uint8_t* data, size_t len) {
+#if CAPTURE
+  xSemaphoreTake(captureLock, portMAX_DELAY);
+  capture.put(source, micros(), data, len);
+  xSemaphoreGive(captureLock);
+#else
+  (void)source;
+  (void)data;
+  (void)len;
+#endif
+}
+
+/**
+ * @brief Publishes the frame built in `sessions.nextFrame()`; the caller holds `sessionLock`.
+ *
+ * @param len Length of the frame.
+ * @param timeUs Timestamp latency is measured from.
+ *
+ * @return void
+ */
+void publishFrame(size_t len, uint32_t timeUs) {
+  captureBytes(CAPTURE_BT_TX, sessions.nextFrame(), len);
+  sessions.publish(len, timeUs);
+}
+
+/**
+ * @brief Copies bytes into the next frame and publishes it; the caller holds `sessionLock`.
+ *
+ * @param data The bytes, at most SESSION_FRAME_MAX.
+ * @param len Their number.
+ * @param timeUs Timestamp latency is measured from.
+ *
+ * @return void
+ */
+void publishBytes(const uint8_t* data, size_t len, uint32_t timeUs) {
+  captureBytes(CAPTURE_BT_TX, data, len);
+  sessions.publish(data, len, timeUs);
+}
+
+/**
+ * @brief SPP event callback; keeps the session table in step with the stack.
+ *
+ * Runs in the Bluetooth task, so it only updates the table and wakes the
+ * link supervisor.
+ *
+ * @param event The SPP event that occurred.
+ * @param param Parameters associated with the event.
+ *
+ * @return void
+ */
 void Bt_Status(esp_spp_cb_event_t event, esp_spp_cb_param_t *param) {
-  if (event == ESP_SPP_OPEN_EVT) {
-    Serial.println("Client Connected");
-    SlaveConnected = true;
-    recatt = 0;
+  PROF_SCOPE(profiler, PROF_BT_EVENT);
+  int slot;
+  switch (event) {
+    case ESP_SPP_CL_INIT_EVT:
+      xSemaphoreTake(sessionLock, portMAX_DELAY);
+      if (sessions.connecting >= 0) {
+        sessions.clients[sessions.connecting].handle = param->cl_init.handle;
+      }
+      xSemaphoreGive(sessionLock);
+      break;
+    case ESP_SPP_OPEN_EVT:
+      xSemaphoreTake(sessionLock, portMAX_DELAY);
+      slot = sessions.find(param->open.rem_bda);
+      if (slot >= 0) {
+        bool wasDown = sessions.clients[slot].link.down;
+        sessions.opened(slot, param->open.handle, millis());
+#if LINK_CLOCK
+        clientClocks[slot].reset();  // It may have restarted
+#endif
+        if (wasDown) {
+          LOG(CLIENT_RECONNECTED, LOG_MAC(param->open.rem_bda), sessions.clients[slot].link.stats.lastReconnectMs);
+        }
+      }
+#if LINK_DELTA_STREAM
+      // The new client has no base for deltas; send one now rather than at the next fix
+      if (slot >= 0) {
+        size_t len = streamEncoder.repeatKeyframe(millis(), sessions.nextFrame());
+        if (len) {
+          publishFrame(len, (uint32_t)esp_timer_get_time());
+        }
+      }
+#endif
+      xSemaphoreGive(sessionLock);
+      if (slot < 0) {
+        LOG(CLIENT_UNKNOWN, LOG_MAC(param->open.rem_bda));
+        break;
+      }
+      LOG(CLIENT_CONNECTED, LOG_MAC(param->open.rem_bda));
+      xTaskNotifyGive(linkTaskHandle);  // Free to page the next client
+      break;
+    case ESP_SPP_CLOSE_EVT:
+      xSemaphoreTake(sessionLock, portMAX_DELAY);
+      slot = sessions.findHandle(param->close.handle);
+      if (slot >= 0) {
+        bool wasConnected = sessions.clients[slot].link.state == LINK_CONNECTED;
+        uint32_t now = millis();
+        sessions.closed(slot, now);
+        const ClientSession& c = sessions.clients[slot];
+        if (wasConnected) {
+          LOG(CLIENT_DISCONNECTED, LOG_MAC(c.address));
+        }
+        LOG(CLIENT_RETRY, LOG_MAC(c.address), c.link.waitMs(now));
+      }
+      xSemaphoreGive(sessionLock);
+      xTaskNotifyGive(linkTaskHandle);  // Let the supervisor start reconnecting
+      break;
+    case ESP_SPP_WRITE_EVT:
+    case ESP_SPP_CONG_EVT:
+      xSemaphoreTake(sessionLock, portMAX_DELAY);
+      slot = sessions.findHandle(event == ESP_SPP_WRITE_EVT ? param->write.handle : param->cong.handle);
+      if (slot >= 0) {
+        spp.congested[slot] = event == ESP_SPP_WRITE_EVT ? param->write.cong : param->cong.cong;
+        if (!spp.congested[slot]) {
+          wakeLoop(POWER_WAKE_BT);  // Retry what the link turned down
+        }
+      }
+      xSemaphoreGive(sessionLock);
+      break;
+    case ESP_SPP_DATA_IND_EVT:
+      captureBytes(CAPTURE_BT_RX, param->data_ind.data, param->data_ind.len);
+#if LINK_CLOCK
+      {
+        // Clients send each clock frame in a write of its own
+        ClockFrame clock;
+        if (clock_find_frame(param->data_ind.data, param->data_ind.len, &clock)) {
+          uint32_t rxUs = (uint32_t)esp_timer_get_time();
+          xSemaphoreTake(sessionLock, portMAX_DELAY);
+          slot = sessions.findHandle(param->data_ind.handle);
+          if (slot >= 0) {
+            clientClocks[slot].receive(clock, rxUs);
+          }
+          xSemaphoreGive(sessionLock);
+          break;
+        }
+      }
+#endif
+#if LINK_DELTA_STREAM
+      if (stream_find_request(param->data_ind.data, param->data_ind.len)) {
+        xSemaphoreTake(sessionLock, portMAX_DELAY);
+        streamEncoder.requestKeyframe();  // A client lost its place in the delta stream
+        xSemaphoreGive(sessionLock);
+        break;
+      }
+#endif
+      Serial.write(param->data_ind.data, param->data_ind.len);  // Client to USB passthrough
+      break;
+    default:
+      break;
   }
-  else if (event == ESP_SPP_CLOSE_EVT) {
-    Serial.println("Client Disconnected");
-    SlaveConnected = false;
+}
+
+/**
+ * @brief Wakes the GPS task from the UART driver's receive event.
+ *
+ * @return void
+ */
+void onGpsReceive() {
+  xTaskNotifyGive(gpsTaskHandle);
+}
+
+/**
+ * @brief Brings the GPS receiver to its fastest useful settings.
+ *
+ * Runs before the GPS task starts, so it has the UART to itself. Takes
+ * about two seconds with a receiver that answers, and up to six while it
+ * probes every baud for one that does not.
+ *
+ * @return void
+ */
+void configureGps() {
+  GpsUartLink link;
+  GpsConfigurator config;
+  while (!config.step(link, millis())) {
+    delay(10);
   }
+  const GpsConfigResult& r = config.result;
+  serialPrintf("GPS: %s receiver at %lu baud, %u fixes/s, %s, %u commands refused\n", gps_dialect_name(r.dialect),
+               (unsigned long)r.baud, r.rateHz, r.filtered ? "RMC and GGA only" : "default sentences", r.refused);
 }
 
+#if CAPTURE
+/**
+ * @brief Opens the next free capture file on LittleFS and starts recording.
+ *
+ * @return void
+ */
+void startCapture() {
+  captureLock = xSemaphoreCreateMutex();
+  if (!LittleFS.begin(true)) {
+    Serial.println("Capture: no LittleFS partition");
+    capture.stopped = true;
+    return;
+  }
+  char path[24];
+  for (int i = 0; i < 100; i++) {
+    snprintf(path, sizeof(path), "/capture-%02d.bin", i);
+    if (!LittleFS.exists(path)) {
+      captureFile = LittleFS.open(path, FILE_WRITE);
+      break;
+    }
+  }
+  if (!captureFile) {
+    Serial.println("Capture: cannot create a file; delete old captures");
+    capture.stopped = true;
+    return;
+  }
+  // Leave a block free for the file system itself
+  size_t free = LittleFS.totalBytes() - LittleFS.usedBytes();
+  free = free > 2 * CAPTURE_BLOCK_SIZE ? free - 2 * CAPTURE_BLOCK_SIZE : 0;
+  captureLimit = free < CAPTURE_MAX_BYTES ? free : CAPTURE_MAX_BYTES;
+  uint8_t meta[CAPTURE_META_LEN];
+  uint8_t link = (LINK_BINARY_FRAMES ? CAPTURE_LINK_BINARY : 0) | (LINK_DELTA_STREAM ? CAPTURE_LINK_DELTA : 0);
+  captureBytes(CAPTURE_META, meta, capture_encode_meta(CAPTURE_MASTER, link, gpsSerial.baudRate(), meta));
+  serialPrintf("Capture: recording to %s\n", path);
+}
+
+/**
+ * @brief Writes sealed capture blocks to flash; runs in logTask().
+ *
+ * Stops the capture once the next block would not fit in `captureLimit`.
+ *
+ * @return void
+ */
+void flushCapture() {
+  if (!captureFile) {
+    return;
+  }
+  captureWritten += capture_drain(capture, captureFile, captureLimit - captureWritten);
+  if (captureLimit - captureWritten < CAPTURE_BLOCK_SIZE) {
+    capture.stopped = true;
+    captureFile.close();
+    serialPrintf("Capture: stopped at %lu bytes\n", (unsigned long)captureWritten);
+  }
+}
+
+#endif
+#if POWER_SAVE
+/**
+ * @brief Holds off light sleep while a GPS burst is due, and releases it after.
+ *
+ * @param hold true while GpsBurstClock::holdAwake() says so.
+ *
+ * @return void
+ */
+void holdGpsAwake(bool hold) {
+  if (hold == gpsAwake) {
+    return;
+  }
+  gpsAwake = hold;
+  if (gpsAwakeLock) {
+    if (hold) {
+      esp_pm_lock_acquire(gpsAwakeLock);
+    } else {
+      esp_pm_lock_release(gpsAwakeLock);
+    }
+  }
+  if (hold) {
+    duty.wake(micros(), POWER_WAKE_TIMER);
+  } else {
+    duty.sleep(micros());
+  }
+}
+
+/**
+ * @brief Turns on automatic light sleep with the GPS RX pin as a wake-up source.
+ *
+ * The CPU stays at full speed so the UART baud rates do not change, and
+ * the Bluetooth controller keeps the SPP links in modem sleep.
+ *
+ * @return true If light sleep is enabled.
+ * @return false If the firmware does not support it; the tasks still block.
+ */
+bool startLightSleep() {
+  esp_pm_config_esp32_t pm = { 240, 240, true };
+  if (esp_pm_configure(&pm) != ESP_OK) {
+    Serial.println("Light sleep unavailable; staying awake between fixes");
+    return false;
+  }
+  esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "gps", &gpsAwakeLock);
+  gpio_wakeup_enable((gpio_num_t)RXD2, GPIO_INTR_LOW_LEVEL);  // A start bit
+  esp_sleep_enable_gpio_wakeup();
+  esp_bt_sleep_enable();
+  Serial.println("Light sleep on between GPS bursts and Bluetooth traffic");
+  return true;
+}
+
+#endif
 void setup() {
+  loopTaskHandle = xTaskGetCurrentTaskHandle();  // setup() and loop() run in the same task
+  taskRunning(POWER_WAKE_TIMER);
   Serial.begin(115200);
-  gpsSerial.begin(GPS_BAUD, SERIAL_8N1, RXD2, TXD2);
+  gpsSerial.begin(GPS_BAUD, SERIAL_8N1, RXD2, TXD2, false, 20000UL, GPS_RX_THRESHOLD);
+#if GPS_CONFIG
+  configureGps();
+#endif
+#if CAPTURE
+  startCapture();  // After the GPS baud is settled, which the capture records
+#endif
 
-  //Set up Bluetooth callback
-  SerialBT.register_callback(Bt_Status);
-  SerialBT.begin(myName, true);
-  Serial.printf("The device \"%s\" started in master mode\n", myName.c_str());
-  
-  //Try connecting to the slave
- SlaveConnect();  
-}
+#if PROFILER
+  profiler.begin(PROF_STAGE_NAMES, PROF_STAGES, ESP.getCpuFreqMHz());
+#endif
+  sessionLock = xSemaphoreCreateMutex();
+#if LINK_DELTA_STREAM
+  streamEncoder.redundant = LINK_REDUNDANCY;
+#endif
+  for (size_t i = 0; i < sizeof(clientAddresses) / sizeof(clientAddresses[0]); i++) {
+    sessions.add(clientAddresses[i]);
+  }
 
-void SlaveConnect() {
-  Serial.println("Connecting to slave BT device...");
-  Serial.printf("Connecting to \"%s\" with MAC \"%s\"...\n", slaveName.c_str(), MACadd.c_str());
-  SerialBT.connect(address);
+  //Set up Bluetooth in master mode with a callback
+  btStart();
+  esp_bluedroid_init();
+  esp_bluedroid_enable();
+  esp_bt_dev_set_device_name(myName.c_str());
+  esp_spp_register_callback(Bt_Status);
+  esp_spp_init(ESP_SPP_MODE_CB);
+  serialPrintf("The device \"%s\" started in master mode with %u clients\n", myName.c_str(), sessions.count);
+
+#if POWER_SAVE
+  lightSleepOn = startLightSleep();  // Before the GPS task can take the lock
+  gpsBursts.begin(micros());
+#endif
+  fixQueue = xQueueCreate(FIX_QUEUE_LEN, sizeof(QueuedFix));
+  xTaskCreatePinnedToCore(gpsTask, "gps", 4096, NULL, 3, &gpsTaskHandle, 1);
+  xTaskCreatePinnedToCore(transmitTask, "transmit", 4096, NULL, 2, &transmitTaskHandle, 1);
+  xTaskCreatePinnedToCore(linkTask, "link", 4096, NULL, 1, &linkTaskHandle, 0);
+  xTaskCreatePinnedToCore(logTask, "log", 4096, NULL, tskIDLE_PRIORITY + 1, &logTaskHandle, 0);
+  gpsSerial.onReceive(onGpsReceive);
+#if POWER_SAVE
+  Serial.onReceive(onUsbReceive);
+#endif
+  // From here on nothing of the sketch's should touch the heap
+  TaskHandle_t tasks[] = { loopTaskHandle, gpsTaskHandle, transmitTaskHandle, linkTaskHandle, logTaskHandle };
+  heap_watch_arm(tasks, sizeof(tasks) / sizeof(tasks[0]), HEAP_TRAP);
 }
 
+// GPS time of day of the current fix in milliseconds
+uint32_t fixTimeOfDay() {
+  return ((gps.time.hour() * 60UL + gps.time.minute()) * 60UL + gps.time.second()) * 1000UL + gps.time.centisecond() * 10UL;
+}
 
-void getGPSData() {
-  while (gpsSerial.available() > 0) {
-    gps.encode(gpsSerial.read());
-    delay(10);
-    if (gps.location.isUpdated()) {
-      String gpsData = "Latitude: " + String(gps.location.lat(), 8) + " Longitude: " + String(gps.location.lng(), 8);
-      Serial.println(gpsData);  // Print GPS data to serial monitor
-      if (SlaveConnected) {
-        SerialBT.println(gpsData);  // Send GPS data to the slave via Bluetooth
+/**
+ * @brief Queues a fix for the transmit task, dropping the oldest if full.
+ *
+ * A stale fix is worth less than the newest one, so the queue never blocks
+ * the GPS task.
+ *
+ * @param item The fix to queue.
+ *
+ * @return void
+ */
+void queueFix(const QueuedFix& item) {
+  if (xQueueSend(fixQueue, &item, 0) != pdPASS) {
+    QueuedFix oldest;
+    xQueueReceive(fixQueue, &oldest, 0);
+    fixesDropped++;
+    xQueueSend(fixQueue, &item, 0);
+  }
+}
 
+/**
+ * @brief Parses NMEA as soon as the UART has some, and queues new fixes.
+ *
+ * Blocks on a task notification from the UART receive event, so it uses no
+ * CPU between bursts. RMC and GGA both update the location for the same
+ * epoch; only the first one is queued. With POWER_SAVE it also holds off
+ * light sleep while a burst is due, and wakes up in time to take the lock.
+ *
+ * @param arg Unused.
+ *
+ * @return void
+ */
+void gpsTask(void* arg) {
+  (void)arg;
+  uint32_t lastTime = UINT32_MAX;
+  taskRunning(POWER_WAKE_TIMER);
+  for (;;) {
+#if POWER_SAVE
+    uint32_t changeUs;
+    holdGpsAwake(gpsBursts.holdAwake(micros(), &changeUs));
+    TickType_t wait = changeUs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS((changeUs + 999) / 1000);
+#else
+    TickType_t wait = portMAX_DELAY;
+#endif
+    taskBlocked();
+    bool woken = ulTaskNotifyTake(pdTRUE, wait) > 0;
+    taskRunning(woken ? POWER_WAKE_GPS : POWER_WAKE_TIMER);
+    if (!woken) {
+      continue;  // Only the lock changes
+    }
+    PROF_SCOPE(profiler, PROF_GPS_PARSE);
+    uint32_t count = 0;
+    uint8_t chunk[64];
+    size_t n;
+    while ((n = gpsSerial.read(chunk, sizeof(chunk))) > 0) {
+      captureBytes(CAPTURE_GPS_RX, chunk, n);
+      count += n;
+      gpsLoad.bytes += n;
+      for (size_t i = 0; i < n; i++) {
+        gps.encode(chunk[i]);
+        if (gps.location.isUpdated()) {
+          QueuedFix item;
+          item.fix.seq = 0;  // Assigned when sent
+          item.fix.lat_e6 = frame_to_e6(gps.location.lat());
+          item.fix.lon_e6 = frame_to_e6(gps.location.lng());
+          item.fix.time_ms = gps.time.isValid() ? fixTimeOfDay() : 0;
+          dr_set_velocity(gps.speed.isValid() ? gps.speed.mps() : 0.0f, gps.course.deg(), &item.fix);
+          item.rxUs = esp_timer_get_time();
+          if (item.fix.time_ms != lastTime || item.fix.time_ms == 0) {
+            lastTime = item.fix.time_ms;
+            gpsLoad.fixes++;
+            queueFix(item);
+          }
+        }
       }
     }
+#if POWER_SAVE
+    gpsBursts.read(micros(), count, 10000000UL / gpsSerial.baudRate(), true);  // Only the UART wakes this task
+#endif
   }
 }
 
-void loop() {
-  // Check if connected to slave
-  if (!SlaveConnected) {
-    if (millis() - previousMillisReconnect >= 10000) {
-      previousMillisReconnect = millis();
-      recatt++;
-      Serial.print("Reconnection attempt: ");
-      Serial.println(recatt);
-      
-      if (recatt <= 5) {  // Limit the reconnection attempts to prevent overheating
-        SlaveConnect();
-      } else {
-        Serial.println("Max reconnection attempts reached.");
-      }
+/**
+ * @brief Sends a clock frame to each connected client that is due one; the caller holds `sessionLock`.
+ *
+ * Goes straight to the transport rather than through the session ring,
+ * since each client gets its own echo. A frame the link turns down is not
+ * retried; the next one is due a second later.
+ *
+ * @param item The newest fix, which ties this master's GPS time to its clock.
+ *
+ * @return void
+ */
+void sendClocks(const QueuedFix& item) {
+#if LINK_CLOCK
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  for (uint8_t i = 0; i < sessions.count; i++) {
+    if (sessions.clients[i].link.state != LINK_CONNECTED || !clientClocks[i].due(now)) {
+      continue;
+    }
+    ClockFrame f;
+    clientClocks[i].prepare(now, &f);
+    f.fixUs = (uint32_t)item.rxUs;
+    f.fixMs = item.fix.time_ms ? item.fix.time_ms : CLOCK_NO_FIX;
+    f.lat_e6 = item.fix.lat_e6;
+    f.lon_e6 = item.fix.lon_e6;
+    uint8_t frame[CLOCK_FRAME_LEN];
+    spp.send(i, frame, clock_encode(f, frame));
+  }
+#endif
+}
+
+/**
+ * @brief Hands queued session frames to the SPP stack; the caller holds `sessionLock`.
+ *
+ * @return void
+ */
+void serviceSessions() {
+  PROF_SCOPE(profiler, PROF_BT_WRITE);
+  sessions.service(spp, (uint32_t)esp_timer_get_time());
+}
+
+/**
+ * @brief Encodes each queued fix once and fans it out to every client.
+ *
+ * @param arg Unused.
+ *
+ * @return void
+ */
+void transmitTask(void* arg) {
+  (void)arg;
+  QueuedFix item;
+  taskRunning(POWER_WAKE_TIMER);
+  for (;;) {
+    taskBlocked();
+    bool received = xQueueReceive(fixQueue, &item, portMAX_DELAY) == pdPASS;
+    taskRunning(POWER_WAKE_GPS);  // Only the GPS task fills the queue
+    if (!received) {
+      continue;
+    }
+    // Published even with no client connected, so one that connects later starts from the newest fix
+    xSemaphoreTake(sessionLock, portMAX_DELAY);
+    sendClocks(item);  // Before the fix may be skipped, so clocks keep going while the master stands still
+#if DEAD_RECKONING
+#if LINK_DELTA_STREAM
+    bool resync = streamEncoder.keyRequested;
+#else
+    bool resync = false;
+#endif
+    // Steady motion: the clients' extrapolation is still close enough
+    if (clientViewValid && !resync && dr_covers(clientView, item.fix)) {
+      fixesCovered++;
+      xSemaphoreGive(sessionLock);
+      continue;
+    }
+#endif
+    {
+      PROF_SCOPE(profiler, PROF_ENCODE);
+#if LINK_BINARY_FRAMES
+      item.fix.seq = txSeq++;
+#if LINK_DELTA_STREAM
+      publishFrame(streamEncoder.encode(item.fix, millis(), sessions.nextFrame()), (uint32_t)item.rxUs);
+      clientView = streamEncoder.base;
+#else
+      publishFrame(frame_encode(item.fix, sessions.nextFrame()), (uint32_t)item.rxUs);
+      clientView = item.fix;
+#endif
+      clientViewValid = true;
+#else
+      char gpsData[64];
+      int len = snprintf(gpsData, sizeof(gpsData), "Latitude: %.8f Longitude: %.8f\r\n",
+                         item.fix.lat_e6 / (double)FRAME_DEG_SCALE, item.fix.lon_e6 / (double)FRAME_DEG_SCALE);
+      publishBytes((const uint8_t*)gpsData, len, (uint32_t)item.rxUs);
+#endif
+    }
+    serviceSessions();  // Send GPS data to the clients via Bluetooth
+    xSemaphoreGive(sessionLock);
+    LOG(FIX, item.fix.seq, item.fix.lat_e6, item.fix.lon_e6);
+  }
+}
+
+/**
+ * @brief Writes out the events LOG() queued from every task and the SPP callback.
+ *
+ * The serial port's wait for room falls on this task instead of the
+ * GPS, transmit and link tasks.
+ *
+ * @param arg Unused.
+ *
+ * @return void
+ */
+void logTask(void* arg) {
+  (void)arg;
+  taskRunning(POWER_WAKE_TIMER);
+  for (;;) {
+    log_drain(eventLog, Serial, LOG_BINARY, millis());
+#if CAPTURE
+    flushCapture();
+#endif
+    taskBlocked();
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+    taskRunning(POWER_WAKE_TIMER);
+  }
+}
+
+/**
+ * @brief Connection supervisor for the whole group.
+ *
+ * Pages one client at a time, whichever client's backoff ran out first,
+ * and sleeps until the next one is due or an SPP event wakes it. Connects
+ * complete asynchronously in Bt_Status(); a client is retried for as long
+ * as the master runs.
+ *
+ * @param arg Unused.
+ *
+ * @return void
+ */
+void linkTask(void* arg) {
+  (void)arg;
+  taskRunning(POWER_WAKE_TIMER);
+  for (;;) {
+    xSemaphoreTake(sessionLock, portMAX_DELAY);
+    int slot = sessions.maintain(spp, millis());
+    uint32_t waitMs = sessions.nextDueMs(millis());
+    uint8_t attempts = slot >= 0 ? sessions.clients[slot].link.attempts : 0;
+    xSemaphoreGive(sessionLock);
+    if (slot >= 0) {
+      LOG(CLIENT_CONNECTING, LOG_MAC(clientAddresses[slot]), attempts + 1);
+    }
+    taskBlocked();
+    bool woken = ulTaskNotifyTake(pdTRUE, waitMs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(waitMs)) > 0;
+    taskRunning(woken ? POWER_WAKE_BT : POWER_WAKE_TIMER);
+  }
+}
+
+/**
+ * @brief Prints the clients nearest the master, nearest first.
+ *
+ * Takes the position each connected client last sent in its clock frames
+ * and measures them from the master's last sent fix in one batch
+ * (src/GeoBatch.h), then picks the nearest without sorting the rest.
+ *
+ * @return void
+ */
+void reportNearest() {
+#if LINK_CLOCK
+  int32_t lat[SESSION_MAX_CLIENTS], lon[SESSION_MAX_CLIENTS];
+  uint8_t slot[SESSION_MAX_CLIENTS];
+  size_t n = 0;
+  xSemaphoreTake(sessionLock, portMAX_DELAY);
+  bool located = clientViewValid;
+  PositionFix own = clientView;
+  for (uint8_t i = 0; i < sessions.count; i++) {
+    if (sessions.clients[i].link.state == LINK_CONNECTED && clientClocks[i].peerFix) {
+      lat[n] = clientClocks[i].lat_e6;
+      lon[n] = clientClocks[i].lon_e6;
+      slot[n++] = i;
     }
   }
+  xSemaphoreGive(sessionLock);
+  if (!located || n == 0) {
+    return;
+  }
+  float dist[SESSION_MAX_CLIENTS], bearing[SESSION_MAX_CLIENTS];
+  uint32_t nearest[NEAREST_REPORTED];
+  geo_batch_e6(geo_origin_e6(own.lat_e6, own.lon_e6), lat, lon, n, dist, bearing);
+  size_t k = geo_nearest_k(dist, n, NEAREST_REPORTED, nearest);
+  Serial.print("Nearest clients:");
+  for (size_t j = 0; j < k; j++) {
+    uint32_t t = nearest[j];
+    char mac[MAC_STRING_LEN];
+    serialPrintf(" %s %.0f m at %.0f deg%s", macString(sessions.clients[slot[t]].address, mac), dist[t], bearing[t],
+                 j + 1 < k ? "," : "\n");
+  }
+#endif
+}
 
-  // Get GPS data
-  getGPSData();
+/**
+ * @brief Prints throughput and publish-to-air latency for every client.
+ *
+ * @return void
+ */
+void reportSessions() {
+  PROF_SCOPE(profiler, PROF_REPORT);
+  // Copied under the lock and printed after, so the transmit task and the SPP
+  // callback are not held up while the lines go out
+  struct SessionReport {
+    uint8_t address[6];
+    LinkState state;
+    uint32_t upMs;
+    SessionStats stats;
+    LinkStats link;
+    uint32_t meanReconnectMs;
+  };
+  SessionReport rows[SESSION_MAX_CLIENTS];
+  xSemaphoreTake(sessionLock, portMAX_DELAY);
+  uint32_t now = millis();
+  uint8_t count = sessions.count;
+  for (uint8_t i = 0; i < count; i++) {
+    const ClientSession& c = sessions.clients[i];
+    SessionReport& r = rows[i];
+    memcpy(r.address, c.address, sizeof(r.address));
+    r.state = c.link.state;
+    r.upMs = c.link.connectedMs(now);
+    r.stats = c.stats;
+    r.link = c.link.stats;
+    r.meanReconnectMs = c.link.meanReconnectMs();
+  }
+#if LINK_DELTA_STREAM
+  uint32_t keyframes = streamEncoder.keyframes, deltas = streamEncoder.deltas;
+  uint32_t streamBytes = streamEncoder.bytes;
+#endif
+  xSemaphoreGive(sessionLock);
+  for (uint8_t i = 0; i < count; i++) {
+    const SessionReport& r = rows[i];
+    const SessionStats& st = r.stats;
+    char mac[MAC_STRING_LEN];
+    serialPrintf("Client %s: %s, %lu frames, %lu B/s, latency last %lu us, mean %lu us, max %lu us, %lu dropped\n",
+                 macString(r.address, mac), link_state_name(r.state), (unsigned long)st.frames,
+                 (unsigned long)(r.upMs ? (uint64_t)st.bytes * 1000 / r.upMs : 0), (unsigned long)st.lastUs,
+                 (unsigned long)(st.frames ? st.totalUs / st.frames : 0), (unsigned long)st.maxUs,
+                 (unsigned long)st.dropped);
+    const LinkStats& ls = r.link;
+    if (ls.drops || ls.failures) {
+      serialPrintf("  %lu drops, %lu failed connects, reconnect last %lu ms, mean %lu ms, max %lu ms\n",
+                   (unsigned long)ls.drops, (unsigned long)ls.failures, (unsigned long)ls.lastReconnectMs,
+                   (unsigned long)r.meanReconnectMs, (unsigned long)ls.maxReconnectMs);
+    }
+  }
+#if LINK_DELTA_STREAM
+  uint32_t encoded = keyframes + deltas;
+  if (encoded) {
+    serialPrintf("Stream: %lu keyframes, %lu deltas, %lu.%02lu bytes per fix\n", (unsigned long)keyframes,
+                 (unsigned long)deltas, (unsigned long)(streamBytes / encoded),
+                 (unsigned long)(streamBytes * 100UL / encoded % 100));
+  }
+#endif
+#if LINK_CLOCK
+  // From a copy, so the transmit task is not held up while the lines go out
+  for (uint8_t i = 0; i < sessions.count; i++) {
+    xSemaphoreTake(sessionLock, portMAX_DELAY);
+    bool up = sessions.clients[i].link.state == LINK_CONNECTED;
+    LinkClock k = clientClocks[i];
+    xSemaphoreGive(sessionLock);
+    if (!up || !k.synced()) {
+      continue;
+    }
+    char mac[MAC_STRING_LEN];
+    serialPrintf("Client %s clock: rtt last %ld us, mean %ld us, min %ld us, one-way %ld us, offset %+ld us\n",
+                 macString(sessions.clients[i].address, mac), (long)k.rttUs, (long)k.rttMeanUs,
+                 (long)k.bestRttUs, (long)k.oneWayUs(), (long)k.offsetUs);
+    if (k.peerFix) {
+      uint32_t ageMs = ((uint32_t)esp_timer_get_time() - k.toLocalUs(k.fixUs)) / 1000;
+      serialPrintf("  position %.6f, %.6f, %lu ms old\n", k.lat_e6 / (double)FRAME_DEG_SCALE,
+                   k.lon_e6 / (double)FRAME_DEG_SCALE, (unsigned long)ageMs);
+    }
+  }
+  reportNearest();
+#endif
+  if (fixesDropped) {
+    serialPrintf("%lu fixes replaced before they were sent\n", (unsigned long)fixesDropped);
+  }
+  if (fixesCovered) {
+    serialPrintf("%lu fixes left to the clients' dead reckoning\n", (unsigned long)fixesCovered);
+  }
+  float bytesPerSec, fixesPerSec;
+  gpsLoad.sample(now, &bytesPerSec, &fixesPerSec);
+  serialPrintf("GPS parse load: %.0f B/s, %.1f fixes/s\n", bytesPerSec, fixesPerSec);
+#if PROFILER
+  serialPrintf("Loop: mean %lu us, jitter %lu us, %lu stalls, longest %lu us in %s\n",
+               (unsigned long)profiler.meanPeriodUs(), (unsigned long)profiler.jitterUs(),
+               (unsigned long)profiler.stalls, (unsigned long)profiler.worstStallUs,
+               profiler.worstStallStage < PROF_STAGES ? PROF_STAGE_NAMES[profiler.worstStallStage] : "-");
+#endif
+#if POWER_SAVE
+  float wakesPerSec[POWER_WAKE_CAUSES];
+  float awake = duty.sample(micros(), wakesPerSec);
+  serialPrintf("Power: awake %.1f%%, wakes/s timer %.1f gps %.1f bt %.1f usb %.1f, light sleep %s\n", awake,
+               wakesPerSec[POWER_WAKE_TIMER], wakesPerSec[POWER_WAKE_GPS], wakesPerSec[POWER_WAKE_BT],
+               wakesPerSec[POWER_WAKE_USB], lightSleepOn ? "on" : "unavailable");
+#endif
+#if CAPTURE
+  if (captureFile) {
+    serialPrintf("Capture: %lu bytes on flash, %lu bytes dropped\n", (unsigned long)captureWritten,
+                 (unsigned long)capture.dropped.load());
+  }
+#endif
+  reportHeap();
+}
 
-  // Bluetooth data communication
+/**
+ * @brief Prints the heap watermarks and the allocations made since setup().
+ *
+ * @return void
+ */
+void reportHeap() {
+  uint32_t largest = ESP.getMaxAllocHeap();
+  if (largest < heapLargestMin) {
+    heapLargestMin = largest;
+  }
+#if HEAP_WATCH_COUNTS
+  serialPrintf("Heap: %lu B free, %lu B min free, largest block %lu B (min %lu B), %lu allocations since setup\n",
+               (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap(), (unsigned long)largest,
+               (unsigned long)heapLargestMin, (unsigned long)heap_watch_allocations());
+#else
+  serialPrintf("Heap: %lu B free, %lu B min free, largest block %lu B (min %lu B)\n", (unsigned long)ESP.getFreeHeap(),
+               (unsigned long)ESP.getMinFreeHeap(), (unsigned long)largest, (unsigned long)heapLargestMin);
+#endif
+}
+
+#if PROFILER
+/**
+ * @brief Writes the profiler's binary dump to the serial monitor.
+ *
+ * @param flags Flags of the request; PROF_REQUEST_RESET starts a new interval.
+ *
+ * @return void
+ */
+void sendProfile(uint8_t flags) {
+  static uint8_t dump[PROF_DUMP_MAX];
+  Serial.write(dump, profiler.dump(esp_bt_dev_get_address(), millis(), dump));
+  if (flags & PROF_REQUEST_RESET) {
+    profiler.reset();
+  }
+}
+
+#endif
+
+void loop() {
+  PROF_LOOP(profiler);  // Loop period and stalls
+
+  // USB to Bluetooth passthrough, fanned out like a fix
   if (Serial.available()) {
-    SerialBT.write(Serial.read());
+    uint8_t text[SESSION_FRAME_MAX];
+    size_t n = 0;
+    while (n < sizeof(text) && Serial.available()) {
+      text[n++] = Serial.read();
+    }
+#if PROFILER
+    // A stats request gets this master's dump here and still goes out, so every
+    // client answers too; their dumps come back through the passthrough in Bt_Status()
+    for (size_t i = 0; i < n; i++) {
+      if (usbProfRequest.push(text[i])) {
+        sendProfile(usbProfRequest.flags);
+      }
+    }
+#endif
+    xSemaphoreTake(sessionLock, portMAX_DELAY);
+    publishBytes(text, n, (uint32_t)esp_timer_get_time());
+    xSemaphoreGive(sessionLock);
   }
 
-  if (SerialBT.available()) {
-    Serial.write(SerialBT.read());
+  // Retry frames a congested link turned down
+  xSemaphoreTake(sessionLock, portMAX_DELAY);
+  serviceSessions();
+  xSemaphoreGive(sessionLock);
+
+  if (millis() - previousMillisReport >= LATENCY_REPORT_INTERVAL) {
+    previousMillisReport = millis();
+    reportSessions();
   }
 
-  delay(1000);  // Send data every 10 seconds
+#if POWER_SAVE
+  // Sleep until USB input, a link that can take frames again or the next report
+  xSemaphoreTake(sessionLock, portMAX_DELAY);
+  bool backlog = sessions.backlog();
+  xSemaphoreGive(sessionLock);
+  uint32_t sinceReport = millis() - previousMillisReport;
+  uint32_t wait = sinceReport >= LATENCY_REPORT_INTERVAL ? 0 : LATENCY_REPORT_INTERVAL - sinceReport;
+  if (backlog && wait > RETRY_INTERVAL) {
+    wait = RETRY_INTERVAL;  // In case the link never reports that it is free
+  }
+  if (wait && !Serial.available()) {
+    PROF_IDLE(profiler);  // The wait is not a stall
+    taskBlocked();
+    bool woken = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait)) > 0;
+    uint8_t causes = wakeCauses.exchange(0);
+    taskRunning(!woken ? POWER_WAKE_TIMER : (causes & (1 << POWER_WAKE_USB)) ? POWER_WAKE_USB : POWER_WAKE_BT);
+  }
+#else
+  delay(10);
+#endif
 }
@@ -0,0 +1,197 @@
+// Checks and times the batched distance and bearing of src/GeoBatch.h:
+//   - every distance and bearing against the double-precision reference,
+//     for teams spread over 20 km and over 2000 km, against the bounds of
+//     src/Geodesy.h
+//   - geo_nearest_k() against a full sort, for several k
+//   - host nanoseconds per target for 1 to 10,000 targets: one
+//     geo_distance_e6() and geo_bearing_e6() call per target, the batch,
+//     and nearest-k next to sorting every target
+//
+// Exits with status 1 if any check fails.
+//
+// Usage: batch_bench [--repeat N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "src/GeoBatch.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+static double angleDiff(double a, double b) {
+  double d = fabs(a - b);
+  return d > 180.0 ? 360.0 - d : d;
+}
+
+static uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct Team {
+  int32_t ownLat, ownLon;
+  std::vector<int32_t> lat, lon;
+};
+
+// `n` targets uniformly within `spreadE6` micro-degrees of the own position
+static Team makeTeam(size_t n, int32_t ownLat, int32_t ownLon, int32_t spreadE6) {
+  Team t;
+  t.ownLat = ownLat;
+  t.ownLon = ownLon;
+  for (size_t i = 0; i < n; i++) {
+    int32_t lat = ownLat + (int32_t)((rand() / (RAND_MAX + 1.0) * 2 - 1) * spreadE6);
+    int32_t lon = ownLon + (int32_t)((rand() / (RAND_MAX + 1.0) * 2 - 1) * spreadE6);
+    if (lon > 180000000) {
+      lon -= 360000000;
+    } else if (lon < -180000000) {
+      lon += 360000000;
+    }
+    t.lat.push_back(std::max(-80000000, std::min(80000000, lat)));
+    t.lon.push_back(lon);
+  }
+  return t;
+}
+
+/**
+ * @brief Worst errors of the batch against the double haversine and bearing.
+ *
+ * @return size_t Targets that took the exact path.
+ */
+static size_t checkTeam(const char* name, const Team& t, double distBound, double bearingBound) {
+  size_t n = t.lat.size();
+  std::vector<float> dist(n), bearing(n);
+  size_t far = geo_batch_e6(geo_origin_e6(t.ownLat, t.ownLon), t.lat.data(), t.lon.data(), n, dist.data(),
+                            bearing.data());
+  double worstRel = 0, worstBearing = 0;
+  for (size_t i = 0; i < n; i++) {
+    double lat1 = t.ownLat * 1e-6, lon1 = t.ownLon * 1e-6, lat2 = t.lat[i] * 1e-6, lon2 = t.lon[i] * 1e-6;
+    double ref = geo_haversine(lat1, lon1, lat2, lon2);
+    if (ref < 1.0) {
+      continue;
+    }
+    worstRel = std::max(worstRel, fabs(dist[i] - ref) / ref);
+    worstBearing = std::max(worstBearing, angleDiff(bearing[i], geo_bearing_d(lat1, lon1, lat2, lon2)));
+    check(bearing[i] >= 0.0f && bearing[i] < 360.0f, "bearings are in [0, 360)");
+  }
+  printf("%-22s %8zu %8zu %10.2e %10.2e %10.4f %10.4f\n", name, n, far, worstRel, distBound, worstBearing,
+         bearingBound);
+  check(worstRel < distBound && worstBearing < bearingBound, name);
+  return far;
+}
+
+static void checkNearest() {
+  Team t = makeTeam(5000, 42319000, -83236000, 50000);
+  std::vector<float> dist(5000), bearing(5000);
+  geo_batch_e6(geo_origin_e6(t.ownLat, t.ownLon), t.lat.data(), t.lon.data(), 5000, dist.data(), bearing.data());
+  dist[17] = dist[4000];  // A tie, which goes by index
+  std::vector<uint32_t> all(5000);
+  for (uint32_t i = 0; i < 5000; i++) {
+    all[i] = i;
+  }
+  std::sort(all.begin(), all.end(), [&](uint32_t a, uint32_t b) {
+    return dist[a] < dist[b] || (dist[a] == dist[b] && a < b);
+  });
+  static const size_t KS[] = { 1, 2, 5, 16, 100, 5000, 6000 };
+  for (size_t i = 0; i < sizeof(KS) / sizeof(KS[0]); i++) {
+    std::vector<uint32_t> out(KS[i]);
+    size_t got = geo_nearest_k(dist.data(), 5000, KS[i], out.data());
+    check(got == std::min<size_t>(KS[i], 5000), "nearest-k returns min(k, n) targets");
+    check(std::equal(out.begin(), out.begin() + got, all.begin()), "nearest-k matches a full sort");
+  }
+  uint32_t none;
+  check(geo_nearest_k(dist.data(), 0, 3, &none) == 0 && geo_nearest_k(dist.data(), 5000, 0, &none) == 0,
+        "nearest-k of nothing is empty");
+  printf("nearest-k: k = 1 to 6000 of 5000 targets match a full sort\n");
+}
+
+static volatile float sink;
+
+static void timeTeam(size_t n, long repeat) {
+  Team t = makeTeam(n, 42319000, -83236000, 20000);  // A team within about 2 km
+  std::vector<float> dist(n), bearing(n);
+  std::vector<uint32_t> order(n), nearest(5);
+  long reps = std::max(1L, repeat / (long)n);
+
+  uint64_t t0 = nowNs();
+  for (long r = 0; r < reps; r++) {
+    for (size_t i = 0; i < n; i++) {
+      dist[i] = geo_distance_e6(t.ownLat, t.ownLon, t.lat[i], t.lon[i]);
+      bearing[i] = geo_bearing_e6(t.ownLat, t.ownLon, t.lat[i], t.lon[i]);
+    }
+    sink = dist[r % n] + bearing[r % n];
+  }
+  double scalarNs = (double)(nowNs() - t0) / reps / n;
+
+  t0 = nowNs();
+  for (long r = 0; r < reps; r++) {
+    geo_batch_e6(geo_origin_e6(t.ownLat, t.ownLon + (int32_t)(r & 1)), t.lat.data(), t.lon.data(), n, dist.data(),
+                 bearing.data());
+    sink = dist[r % n] + bearing[r % n];
+  }
+  double batchNs = (double)(nowNs() - t0) / reps / n;
+
+  t0 = nowNs();
+  for (long r = 0; r < reps; r++) {
+    size_t k = geo_nearest_k(dist.data(), n, 5, nearest.data());
+    sink = (float)nearest[k - 1];
+  }
+  double nearestNs = (double)(nowNs() - t0) / reps / n;
+
+  t0 = nowNs();
+  for (long r = 0; r < reps; r++) {
+    for (uint32_t i = 0; i < n; i++) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return dist[a] < dist[b]; });
+    sink = (float)order[0];
+  }
+  double sortNs = (double)(nowNs() - t0) / reps / n;
+
+  printf("%8zu %12.2f %12.2f %9.1fx %12.2f %12.2f\n", n, scalarNs, batchNs, scalarNs / batchNs, nearestNs, sortNs);
+}
+
+int main(int argc, char** argv) {
+  long repeat = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = atol(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--repeat N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  srand(1);
+  printf("%-22s %8s %8s %10s %10s %10s %10s\n", "team", "targets", "exact", "rel err", "bound", "bearing",
+         "bound");
+  checkTeam("walk, 2 km", makeTeam(10000, 42319000, -83236000, 20000), 5e-5, 0.01);
+  checkTeam("arctic, 15 km", makeTeam(10000, 69649200, 18955300, 100000), 5e-5, 0.01);
+  checkTeam("antimeridian, 10 km", makeTeam(10000, -16500000, 179990000, 60000), 5e-5, 0.01);
+  size_t far = checkTeam("country, 2000 km", makeTeam(10000, 42319000, -83236000, 15000000), 1e-4, 0.01);
+  check(far > 0, "targets beyond the flat band take the exact path");
+  checkNearest();
+
+  printf("\n%8s %12s %12s %10s %12s %12s\n", "targets", "per call", "batch", "speedup", "nearest-5", "full sort");
+  printf("%8s %12s %12s %10s %12s %12s\n", "", "(ns/target)", "", "", "", "");
+  static const size_t SIZES[] = { 1, 10, 100, 1000, 10000 };
+  for (size_t i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); i++) {
+    timeTeam(SIZES[i], repeat);
+  }
+
+  printf("\n%s\n", failures ? "batch_bench: FAILED" : "batch_bench: all checks passed");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,273 @@
+// Fans position frames out to 1..16 clients through src/SessionManager.h
+// over a local loopback transport and reports:
+//   - host nanoseconds per fix to encode once and queue it for every
+//     client, against re-encoding the frame for each client
+//   - that every client decoded every frame, in sequence
+//   - per-client throughput and publish-to-send latency when one client's
+//     link keeps refusing frames, which must not hold up the others
+//   - that clients which all drop at once and then fail to connect many
+//     times keep being retried, at jittered times and capped waits, and
+//     how long each took to come back
+//
+// Exits with status 1 if any check fails.
+//
+// Usage: fanout_bench [--fixes N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/PositionFrame.h"
+#include "src/SessionManager.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+static uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Receiving end of one loopback link
+struct LoopbackClient {
+  uint8_t last[SESSION_FRAME_MAX];  // What a socket buffer would hold; keeps the copy honest
+  uint32_t bytes = 0;
+  bool decode = false;              // Run every frame through a FrameDecoder
+  FrameDecoder decoder;
+  uint32_t frames = 0;
+  uint32_t seqErrors = 0;
+  uint8_t nextSeq = 0;
+  uint32_t refuseEvery = 0;         // Refuse all but every Nth send; 0 = accept all
+  uint32_t calls = 0;
+  uint32_t failConnects = 0;        // Connects to refuse before one is accepted
+};
+
+// Connects at once and delivers by copying into the client's buffer
+struct LoopbackTransport {
+  LoopbackClient clients[SESSION_MAX_CLIENTS];
+
+  bool connect(uint8_t slot, const uint8_t*) {
+    if (clients[slot].failConnects) {
+      clients[slot].failConnects--;
+      return false;
+    }
+    return true;
+  }
+
+  bool send(uint8_t slot, const uint8_t* data, size_t len) {
+    LoopbackClient& c = clients[slot];
+    if (c.refuseEvery && ++c.calls % c.refuseEvery != 0) {
+      return false;
+    }
+    memcpy(c.last, data, len);
+    c.bytes += len;
+    if (c.decode) {
+      PositionFix fix;
+      for (size_t i = 0; i < len; i++) {
+        if (c.decoder.push(data[i], &fix)) {
+          c.seqErrors += fix.seq != c.nextSeq;
+          c.nextSeq = fix.seq + 1;
+          c.frames++;
+        }
+      }
+    }
+    return true;
+  }
+};
+
+// Adds `n` clients and opens every connection
+static void connectAll(SessionManager& sessions, LoopbackTransport& transport, int n) {
+  for (int i = 0; i < n; i++) {
+    uint8_t address[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, (uint8_t)i };
+    sessions.add(address);
+  }
+  int slot;
+  while ((slot = sessions.maintain(transport, 0)) >= 0) {
+    sessions.opened((uint8_t)slot, (uint32_t)slot + 1, 0);
+  }
+}
+
+static PositionFix fixAt(long i) {
+  PositionFix fix = {};
+  fix.seq = (uint8_t)i;
+  fix.lat_e6 = 42319000 + (int32_t)(i % 1000);
+  fix.lon_e6 = -83236000 - (int32_t)(i % 1000);
+  fix.time_ms = (uint32_t)(i * 1000);
+  return fix;
+}
+
+// ns per fix to encode once and fan out to `n` clients
+static double timeFanout(int n, long fixes, bool decode, LoopbackTransport& transport) {
+  SessionManager sessions;
+  connectAll(sessions, transport, n);
+  for (int i = 0; i < n; i++) {
+    transport.clients[i].decode = decode;
+  }
+  uint64_t t0 = nowNs();
+  for (long i = 0; i < fixes; i++) {
+    sessions.publish(frame_encode(fixAt(i), sessions.nextFrame()), 0);
+    sessions.service(transport, 0);
+  }
+  return (double)(nowNs() - t0) / fixes;
+}
+
+// ns per fix when every client gets its own freshly encoded frame
+static double timePerClientEncode(int n, long fixes, LoopbackTransport& transport) {
+  uint64_t t0 = nowNs();
+  for (long i = 0; i < fixes; i++) {
+    PositionFix fix = fixAt(i);
+    for (int c = 0; c < n; c++) {
+      uint8_t frame[FRAME_LEN];
+      transport.send((uint8_t)c, frame, frame_encode(fix, frame));
+    }
+  }
+  return (double)(nowNs() - t0) / fixes;
+}
+
+static void checkDelivery(int n, long fixes) {
+  LoopbackTransport transport;
+  timeFanout(n, fixes, true, transport);
+  char what[128];
+  for (int i = 0; i < n; i++) {
+    const LoopbackClient& c = transport.clients[i];
+    snprintf(what, sizeof(what), "%d clients: client %d got %lu of %ld frames, %lu out of sequence", n, i,
+             (unsigned long)c.frames, fixes, (unsigned long)c.seqErrors);
+    check(c.frames == (uint32_t)fixes && c.seqErrors == 0 && c.decoder.crcErrors == 0, what);
+  }
+}
+
+// One client accepts only every 4th send; the rest must see every frame on time
+static void checkSlowClient(long fixes) {
+  const int n = 4;
+  LoopbackTransport transport;
+  SessionManager sessions;
+  connectAll(sessions, transport, n);
+  for (int i = 0; i < n; i++) {
+    transport.clients[i].decode = true;
+  }
+  transport.clients[0].refuseEvery = 4;
+  for (long i = 0; i < fixes; i++) {
+    // A fix every second; the fan-out runs 10 ms after it was received
+    uint32_t rxUs = (uint32_t)(i * 1000000);
+    sessions.publish(frame_encode(fixAt(i), sessions.nextFrame()), rxUs);
+    sessions.service(transport, rxUs + 10000);
+  }
+  uint32_t upMs = (uint32_t)(fixes * 1000);
+  printf("\n%-8s %8s %8s %8s %8s %10s %10s\n", "client", "frames", "B/s", "dropped", "refused", "mean (us)",
+         "max (us)");
+  for (int i = 0; i < n; i++) {
+    const SessionStats& st = sessions.clients[i].stats;
+    printf("%-8d %8lu %8.1f %8lu %8lu %10.0f %10lu\n", i, (unsigned long)st.frames, st.bytes * 1000.0 / upMs,
+           (unsigned long)st.dropped, (unsigned long)st.refused, st.frames ? (double)st.totalUs / st.frames : 0.0,
+           (unsigned long)st.maxUs);
+  }
+  const SessionStats& slow = sessions.clients[0].stats;
+  check(slow.frames > 0 && slow.frames < (uint32_t)fixes, "slow client is throttled");
+  check(slow.dropped + slow.frames + (sessions.published - sessions.clients[0].cursor) == (uint32_t)fixes,
+        "slow client's frames are sent, queued or counted as dropped");
+  for (int i = 1; i < n; i++) {
+    const SessionStats& st = sessions.clients[i].stats;
+    check(st.frames == (uint32_t)fixes && st.dropped == 0 && st.maxUs == 10000, "fast clients are not held up");
+    check(transport.clients[i].seqErrors == 0, "fast clients see every frame in sequence");
+  }
+}
+
+// Wait the backoff draws from after `failures` failed connects in a row
+static uint32_t backoffCeiling(int failures) {
+  if (!failures) {
+    return LINK_RECONNECT_MS;
+  }
+  uint64_t w = (uint64_t)LINK_BACKOFF_MIN_MS << (failures - 1);
+  return w < LINK_BACKOFF_MAX_MS ? (uint32_t)w : LINK_BACKOFF_MAX_MS;
+}
+
+// Every client drops at once and refuses its next `refused` connects
+static void checkReconnect(int refused) {
+  const int n = 4;
+  const uint32_t dropMs = 1000;
+  LoopbackTransport transport;
+  SessionManager sessions;
+  connectAll(sessions, transport, n);
+  for (int i = 0; i < n; i++) {
+    sessions.closed((uint8_t)i, dropMs);
+    transport.clients[i].failConnects = (uint32_t)refused;
+  }
+  uint32_t lastTry[n], firstTry[n];
+  int tries[n] = {};
+  bool inBand = true;
+  uint32_t now = dropMs;
+  while (sessions.connectedCount() < n && now < dropMs + 3600000) {
+    int slot = sessions.maintain(transport, now);
+    if (slot < 0) {
+      uint32_t wait = sessions.nextDueMs(now);
+      now += wait ? wait : 1;
+      continue;
+    }
+    // The wait before this try must lie in the upper half of its doubling step
+    uint32_t ceiling = backoffCeiling(tries[slot]);
+    uint32_t gap = now - (tries[slot] ? lastTry[slot] : dropMs);
+    inBand &= gap >= ceiling / 2 && gap <= ceiling;
+    if (!tries[slot]) {
+      firstTry[slot] = now;
+    }
+    lastTry[slot] = now;
+    tries[slot]++;
+    if (sessions.clients[slot].link.state == LINK_CONNECTING) {
+      sessions.opened((uint8_t)slot, (uint32_t)slot + 1, now);
+    }
+  }
+
+  printf("\n%-8s %8s %8s %10s %14s\n", "client", "tries", "failed", "first (ms)", "reconnect (ms)");
+  int distinct = 0;
+  for (int i = 0; i < n; i++) {
+    const LinkStateMachine& l = sessions.clients[i].link;
+    printf("%-8d %8d %8lu %10lu %14lu\n", i, tries[i], (unsigned long)l.stats.failures,
+           (unsigned long)(firstTry[i] - dropMs), (unsigned long)l.stats.lastReconnectMs);
+    check(l.state == LINK_CONNECTED && l.stats.failures == (uint32_t)refused, "clients are retried until they connect");
+    check(l.stats.reconnects == 1 && l.stats.lastReconnectMs == lastTry[i] - dropMs, "reconnect time is recorded");
+    bool unique = true;
+    for (int j = 0; j < i; j++) {
+      unique &= firstTry[j] != firstTry[i];
+    }
+    distinct += unique;
+  }
+  check(inBand, "every wait is within its jittered, capped backoff step");
+  check(distinct > n / 2, "clients that dropped together do not retry together");
+}
+
+int main(int argc, char** argv) {
+  long fixes = 200000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--fixes") && i + 1 < argc) {
+      fixes = atol(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--fixes N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  printf("%-8s %14s %14s %14s\n", "clients", "fan-out", "per client", "re-encode");
+  printf("%-8s %14s %14s %14s\n", "", "(ns/fix)", "(ns/client)", "(ns/fix)");
+  for (int n = 1; n <= SESSION_MAX_CLIENTS; n *= 2) {
+    LoopbackTransport fanout, reencode;
+    double shared = timeFanout(n, fixes, false, fanout);
+    double each = timePerClientEncode(n, fixes, reencode);
+    printf("%-8d %14.1f %14.1f %14.1f\n", n, shared, shared / n, each);
+    checkDelivery(n, 1000);
+  }
+
+  checkSlowClient(600);
+  checkReconnect(8);
+
+  printf("\n%s\n", failures ? "fanout_bench: FAILED" : "fanout_bench: all checks passed");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,223 @@
+// Runs synthetic GPS tracks through the client's own-position filter
+// (src/PositionFilter.h) and reports, for raw and filtered fixes:
+//   - RMS and largest error against the true position
+//   - how many positions a MoveGate passes on, i.e. how often navigation
+//     and the LCD would be redone
+// for a receiver standing still, one walking, and one walking with
+// outliers. Also checks that a jump of the true position restarts the
+// filter, that fixes with too few satellites are left out, and times one
+// update.
+//
+// Noise is white with a 1-sigma of FILTER_UERE_M times HDOP on top of a
+// slow wander, as GPS errors are correlated over tens of seconds.
+//
+// Exits with status 1 if any check fails.
+//
+// Usage: filter_bench [--minutes N] [--rate HZ] [--gate-m M]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "src/PositionFilter.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+static double nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Standard normal, Box-Muller
+static float gauss() {
+  float u = (rand() + 1.0f) / (RAND_MAX + 2.0f);
+  float v = rand() / (RAND_MAX + 1.0f);
+  return sqrtf(-2.0f * logf(u)) * cosf(2.0f * (float)M_PI * v);
+}
+
+const int32_t LAT0 = 42319000, LON0 = -83236000;
+const float COS_LAT0 = 0.7390f;
+
+struct Options {
+  double minutes = 10;
+  double rateHz = 1;
+  float gateM = 3;
+};
+
+struct Track {
+  bool walking = false;
+  double outlierPct = 0;
+};
+
+struct Errors {
+  double sumSq = 0;
+  double max = 0;
+  long n = 0;
+
+  void add(double e) {
+    sumSq += e * e;
+    max = std::max(max, e);
+    n++;
+  }
+
+  double rms() const { return n ? sqrt(sumSq / n) : 0; }
+};
+
+struct Result {
+  Errors raw, filtered;
+  uint32_t rawPassed = 0, filteredPassed = 0;
+  long outliers = 0;
+  PositionFilter filter;
+};
+
+static double errorM(int32_t lat, int32_t lon, double north, double east) {
+  double dn = (lat - LAT0) / DR_E6_PER_M - north;
+  double de = (lon - LON0) / DR_E6_PER_M * COS_LAT0 - east;
+  return sqrt(dn * dn + de * de);
+}
+
+static Result run(const Options& o, const Track& t) {
+  Result r;
+  MoveGate rawGate(o.gateM), filteredGate(o.gateM);
+  srand(5);
+  long fixes = (long)(o.minutes * 60 * o.rateHz);
+  uint32_t stepMs = (uint32_t)(1000 / o.rateHz);
+  double north = 0, east = 0, heading = 0.6;
+  float wanderN = 0, wanderE = 0;
+  float decay = expf(-1.0f / (30.0f * (float)o.rateHz));  // Wander correlated over 30 s
+  for (long i = 0; i < fixes; i++) {
+    if (t.walking) {
+      if (i % (long)(90 * o.rateHz) == 0) {
+        heading += gauss();
+      }
+      north += 1.4 / o.rateHz * cos(heading);
+      east += 1.4 / o.rateHz * sin(heading);
+    }
+    float hdop = 0.9f + 0.4f * (rand() % 3) / 2.0f;
+    uint8_t sats = (uint8_t)(7 + rand() % 3);
+    wanderN = wanderN * decay + sqrtf(1 - decay * decay) * 1.5f * gauss();
+    wanderE = wanderE * decay + sqrtf(1 - decay * decay) * 1.5f * gauss();
+    double mn = north + wanderN + FILTER_UERE_M * hdop * 0.5f * gauss();
+    double me = east + wanderE + FILTER_UERE_M * hdop * 0.5f * gauss();
+    if (rand() < t.outlierPct / 100.0 * RAND_MAX) {
+      mn += 40 + rand() % 60;  // Multipath
+      r.outliers++;
+    }
+    int32_t lat = LAT0 + (int32_t)lround(mn * DR_E6_PER_M);
+    int32_t lon = LON0 + (int32_t)lround(me * DR_E6_PER_M / COS_LAT0);
+    r.raw.add(errorM(lat, lon, north, east));
+    r.rawPassed += rawGate.pass(lat, lon);
+    r.filter.update(lat, lon, hdop, sats, (uint32_t)i * stepMs);
+    int32_t flat, flon;
+    r.filter.position(&flat, &flon);
+    if (i >= (long)(10 * o.rateHz)) {  // After the filter has settled
+      r.filtered.add(errorM(flat, flon, north, east));
+    }
+    r.filteredPassed += filteredGate.pass(flat, flon);
+  }
+  return r;
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--minutes") && i + 1 < argc) {
+      o.minutes = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+      o.rateHz = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--gate-m") && i + 1 < argc) {
+      o.gateM = (float)atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--minutes N] [--rate HZ] [--gate-m M]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  printf("filter_bench: %.0f minutes at %.0f Hz, positions passed on after %.1f m\n\n", o.minutes, o.rateHz, o.gateM);
+  printf("%-20s %10s %10s %10s %10s %9s %9s %9s\n", "track", "raw rms", "max", "filtered", "max", "raw", "filtered",
+         "rejected");
+  printf("%-20s %10s %10s %10s %10s %9s %9s %9s\n", "", "(m)", "", "", "", "(passed)", "", "");
+  static const char* NAMES[] = { "standing", "walking", "walking, outliers" };
+  Track tracks[3];
+  tracks[1].walking = true;
+  tracks[2].walking = true;
+  tracks[2].outlierPct = 2;
+  Result results[3];
+  for (int k = 0; k < 3; k++) {
+    Result& r = results[k];
+    r = run(o, tracks[k]);
+    printf("%-20s %10.2f %10.2f %10.2f %10.2f %9u %9u %9u\n", NAMES[k], r.raw.rms(), r.raw.max, r.filtered.rms(),
+           r.filtered.max, r.rawPassed, r.filteredPassed, r.filter.rejected);
+  }
+  check(results[0].filtered.rms() < results[0].raw.rms(), "standing still, the filter is closer than the raw fixes");
+  check(results[0].filteredPassed * 4 < results[0].rawPassed,
+        "standing still, the filter passes on under a quarter of the positions");
+  check(results[1].filtered.rms() < results[1].raw.rms(), "walking, the filter is closer than the raw fixes");
+  check(results[1].filteredPassed <= results[1].rawPassed, "walking, the filter passes on no more positions");
+  check(results[2].filter.rejected >= results[2].outliers * 9 / 10, "nine in ten outliers are rejected");
+  check(results[2].filtered.max < results[1].filtered.max + 5, "outliers barely move the estimate");
+  check(results[2].filter.restarts == 0, "outliers alone never restart the filter");
+
+  // The receiver is suddenly 500 m away, as after a cold start with a wrong first fix
+  PositionFilter jump;
+  for (uint32_t i = 0; i < 60; i++) {
+    jump.update(LAT0, LON0, 1.0f, 8, i * 1000);
+  }
+  int32_t farLat = LAT0 + (int32_t)(500 * DR_E6_PER_M);
+  int fixesToFollow = 0;
+  for (uint32_t i = 60; i < 80; i++) {
+    jump.update(farLat, LON0, 1.0f, 8, i * 1000);
+    int32_t lat, lon;
+    jump.position(&lat, &lon);
+    if (errorM(lat, lon, 500, 0) < 10) {
+      fixesToFollow = (int)(i - 59);
+      break;
+    }
+  }
+  printf("\njump of 500 m: followed after %d fixes, %u restarts\n", fixesToFollow, jump.restarts);
+  check(fixesToFollow > 0 && fixesToFollow <= FILTER_REJECTS_MAX + 1, "a jump restarts the filter");
+
+  // Fixes from too few satellites are left out, however far off
+  PositionFilter weak;
+  weak.update(LAT0, LON0, 1.0f, 8, 0);
+  FilterResult res = weak.update(farLat, LON0, 1.0f, FILTER_MIN_SATS - 1, 1000);
+  int32_t lat, lon;
+  weak.position(&lat, &lon);
+  check(res == FILTER_WEAK && weak.weak == 1 && lat == LAT0 && lon == LON0, "weak fixes are left out");
+  // A poor fix moves the estimate less than a good one
+  PositionFilter good, poor;
+  good.update(LAT0, LON0, 1.0f, 8, 0);
+  poor.update(LAT0, LON0, 1.0f, 8, 0);
+  int32_t offLat = LAT0 + (int32_t)(3 * DR_E6_PER_M);
+  good.update(offLat, LON0, 1.0f, 8, 1000);
+  poor.update(offLat, LON0, 3.0f, 5, 1000);
+  int32_t goodLat, poorLat;
+  good.position(&goodLat, &lon);
+  poor.position(&poorLat, &lon);
+  check(poorLat - LAT0 < goodLat - LAT0, "HDOP and satellite count weight the fixes");
+
+  PositionFilter timed;
+  const long N = 1000000;
+  double t0 = nowNs();
+  for (long i = 0; i < N; i++) {
+    timed.update(LAT0 + (int32_t)(i % 7) - 3, LON0 + (int32_t)(i % 5) - 2, 1.1f, 8, (uint32_t)i * 100);
+  }
+  double ns = (nowNs() - t0) / N;
+  timed.position(&lat, &lon);
+  printf("update: %.1f ns on the host (%ld fixes, ends at %d, %d)\n", ns, N, (int)lat, (int)lon);
+
+  printf("\n%s\n", failures ? "filter_bench: FAILED" : "filter_bench: all checks passed");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,243 @@
+// Checks the geodesy kernel in src/Geodesy.h against reference values and
+// times each formula:
+//   - distance and bearing for fixed pairs against precomputed spherical
+//     values (R = 6371 km), including bearings in every quadrant and a pair
+//     across the antimeridian
+//   - worst error of every mode against the double-precision reference over
+//     random pairs in each distance band, against the documented bounds
+//   - host nanoseconds and cycles per call (the ESP32's soft-float doubles
+//     make the float paths relatively cheaper there than on the host)
+//
+// Exits with status 1 if any check fails.
+//
+// Usage: geo_bench [--iterations N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define GEO_BENCH_CYCLES 1
+#endif
+
+#include "src/Geodesy.h"
+
+struct RefPair {
+  const char* name;
+  double lat1, lon1, lat2, lon2;
+  double distanceM;
+  double bearingDeg;
+};
+
+static const RefPair REFS[] = {
+  { "walk NE", 42.3190, -83.2360, 42.3195, -83.2355, 69.1450, 36.4792 },
+  { "walk W", 42.3190, -83.2360, 42.3190, -83.2370, 82.2184, 270.0003 },
+  { "walk SW", 42.3190, -83.2360, 42.3150, -83.2400, 553.1670, 216.4817 },
+  { "walk SE", 42.3190, -83.2360, 42.3100, -83.2200, 1652.9617, 127.2545 },
+  { "NW 8.6 km", 42.0, -83.0, 42.05, -83.08, 8635.8541, 310.1024 },
+  { "arctic 10 km", 69.6492, 18.9553, 69.6800, 19.2000, 10056.7845, 69.9751 },
+  { "1 deg north", 0.0, 0.0, 1.0, 0.0, 111194.9266, 0.0 },
+  { "antimeridian", 0.0, 179.99, 0.0, -179.99, 2223.8985, 90.0 },
+  { "London-Paris", 51.5007, -0.1246, 48.8584, 2.2945, 340538.9201, 148.6821 },
+  { "Sydney-Auckland", -33.8688, 151.2093, -36.8485, 174.7633, 2155898.3260, 105.5757 },
+  { "LAX-JFK", 33.9425, -118.408056, 40.639722, -73.778889, 3974203.2461, 65.8706 },
+};
+
+static int failures = 0;
+
+static double angleDiff(double a, double b) {
+  double d = fabs(a - b);
+  return d > 180.0 ? 360.0 - d : d;
+}
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+static const char* modeName(GeoMode mode) {
+  switch (mode) {
+    case GEO_FLAT:
+      return "flat";
+    case GEO_HAVERSINE_F:
+      return "haversine-f";
+    case GEO_HAVERSINE:
+      return "haversine";
+    default:
+      return "auto";
+  }
+}
+
+static void checkReferences() {
+  printf("%-16s %-12s %14s %10s %10s %9s\n", "pair", "mode", "distance (m)", "rel err", "bearing", "err (deg)");
+  for (size_t i = 0; i < sizeof(REFS) / sizeof(REFS[0]); i++) {
+    const RefPair& r = REFS[i];
+    GeoMode mode = geo_select(geo_delta(r.lat1, r.lon1, r.lat2, r.lon2));
+    double d = geo_distance(r.lat1, r.lon1, r.lat2, r.lon2);
+    double b = geo_bearing(r.lat1, r.lon1, r.lat2, r.lon2);
+    double relErr = fabs(d - r.distanceM) / r.distanceM;
+    double bErr = angleDiff(b, r.bearingDeg);
+    printf("%-16s %-12s %14.3f %10.2e %10.4f %9.4f\n", r.name, modeName(mode), d, relErr, b, bErr);
+    check(relErr < (mode == GEO_FLAT ? 5e-5 : 1e-5), r.name);
+    check(bErr < 0.01, r.name);
+  }
+}
+
+// The micro-degree variants see positions rounded to 1e-6 deg (up to
+// 0.08 m per coordinate), so their distance check allows for that
+static void checkFixedPoint() {
+  printf("\n%-16s %14s %10s %10s %9s\n", "pair (e6)", "distance (m)", "err (m)", "bearing", "err (deg)");
+  for (size_t i = 0; i < sizeof(REFS) / sizeof(REFS[0]); i++) {
+    const RefPair& r = REFS[i];
+    int32_t lat1 = (int32_t)lround(r.lat1 * 1e6), lon1 = (int32_t)lround(r.lon1 * 1e6);
+    int32_t lat2 = (int32_t)lround(r.lat2 * 1e6), lon2 = (int32_t)lround(r.lon2 * 1e6);
+    double d = geo_distance_e6(lat1, lon1, lat2, lon2);
+    double b = geo_bearing_e6(lat1, lon1, lat2, lon2);
+    double err = fabs(d - r.distanceM);
+    double bErr = angleDiff(b, r.bearingDeg);
+    printf("%-16s %14.3f %10.3f %10.4f %9.4f\n", r.name, d, err, b, bErr);
+    check(err < 0.25 + 1e-4 * r.distanceM, r.name);
+    check(bErr < 0.2, r.name);
+  }
+}
+
+// Uniform random number in [lo, hi)
+static double uniform(double lo, double hi) {
+  return lo + (hi - lo) * (rand() / (RAND_MAX + 1.0));
+}
+
+// Worst error of one mode against the double reference for pairs up to
+// `maxM` apart, with the first point anywhere up to 80 deg latitude
+static void sweep(GeoMode mode, double minM, double maxM, double distBound, double bearingBound) {
+  double worstRel = 0, worstBearing = 0;
+  for (int i = 0; i < 200000; i++) {
+    double lat1 = uniform(-80.0, 80.0);
+    double lon1 = uniform(-180.0, 180.0);
+    double dist = uniform(minM, maxM);
+    double course = uniform(0.0, 2.0 * M_PI);
+    // Destination on the sphere
+    double delta = dist / GEO_EARTH_RADIUS_M;
+    double phi1 = lat1 * M_PI / 180.0;
+    double phi2 = asin(sin(phi1) * cos(delta) + cos(phi1) * sin(delta) * cos(course));
+    double dLon = atan2(sin(course) * sin(delta) * cos(phi1), cos(delta) - sin(phi1) * sin(phi2));
+    double lat2 = phi2 * 180.0 / M_PI;
+    double lon2 = lon1 + dLon * 180.0 / M_PI;
+    if (fabs(lat2) > 80.0) {
+      continue;
+    }
+    if (lon2 > 180.0) {
+      lon2 -= 360.0;
+    } else if (lon2 < -180.0) {
+      lon2 += 360.0;
+    }
+    double ref = geo_haversine(lat1, lon1, lat2, lon2);
+    double rel = fabs(geo_distance(lat1, lon1, lat2, lon2, mode) - ref) / ref;
+    double bErr = angleDiff(geo_bearing(lat1, lon1, lat2, lon2, mode), geo_bearing_d(lat1, lon1, lat2, lon2));
+    worstRel = rel > worstRel ? rel : worstRel;
+    worstBearing = bErr > worstBearing ? bErr : worstBearing;
+  }
+  printf("%-12s %9.0f - %-9.0f %10.2e %10.2e %10.4f %10.4f\n", modeName(mode), minM, maxM, worstRel, distBound,
+         worstBearing, bearingBound);
+  char what[64];
+  snprintf(what, sizeof(what), "%s sweep %.0f-%.0f m", modeName(mode), minM, maxM);
+  check(worstRel < distBound && worstBearing < bearingBound, what);
+}
+
+static uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// The haversine the client used before the geodesy kernel, for comparison
+static double legacyDistance(double lat1, double lon1, double lat2, double lon2) {
+  double lat1_rad = lat1 * M_PI / 180.0;
+  double lat2_rad = lat2 * M_PI / 180.0;
+  double dlat = lat2_rad - lat1_rad;
+  double dlon = (lon2 - lon1) * M_PI / 180.0;
+  double a = sin(dlat / 2.0) * sin(dlat / 2.0) + cos(lat1_rad) * cos(lat2_rad) * sin(dlon / 2.0) * sin(dlon / 2.0);
+  return GEO_EARTH_RADIUS_M * 2.0 * atan2(sqrt(a), sqrt(1.0 - a));
+}
+
+static volatile double sink;
+
+template <typename Fn>
+static void timeCall(const char* label, long iterations, Fn fn) {
+  // A short walk so every call sees slightly different inputs
+  double lat = 42.3190, lon = -83.2360;
+  uint64_t t0 = nowNs();
+#ifdef GEO_BENCH_CYCLES
+  uint64_t c0 = __rdtsc();
+#endif
+  double acc = 0;
+  for (long i = 0; i < iterations; i++) {
+    double step = (i & 1023) * 1e-6;
+    acc += fn(lat, lon, lat + 0.0005 + step, lon + 0.0005 - step);
+  }
+#ifdef GEO_BENCH_CYCLES
+  uint64_t cycles = __rdtsc() - c0;
+#endif
+  uint64_t ns = nowNs() - t0;
+  sink = acc;
+#ifdef GEO_BENCH_CYCLES
+  printf("%-22s %9.2f %9.1f\n", label, (double)ns / iterations, (double)cycles / iterations);
+#else
+  printf("%-22s %9.2f %9s\n", label, (double)ns / iterations, "-");
+#endif
+}
+
+int main(int argc, char** argv) {
+  long iterations = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+      iterations = atol(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--iterations N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  checkReferences();
+  checkFixedPoint();
+
+  printf("\n%-12s %21s %10s %10s %10s %10s\n", "mode", "range (m)", "dist err", "bound", "brg err", "bound");
+  srand(1);
+  sweep(GEO_FLAT, 1.0, GEO_FLAT_MAX_M, 5e-5, 0.01);
+  sweep(GEO_HAVERSINE_F, GEO_FLAT_MAX_M, GEO_HAVERSINE_F_MAX_M, 1e-5, 0.01);
+  sweep(GEO_AUTO, 1.0, 20000000.0, 5e-5, 0.01);
+
+  printf("\n%-22s %9s %9s\n", "per call", "ns", "cycles");
+  timeCall("legacy distance", iterations, legacyDistance);
+  timeCall("distance flat", iterations, [](double a, double b, double c, double d) {
+    return geo_distance(a, b, c, d, GEO_FLAT);
+  });
+  timeCall("distance haversine-f", iterations, [](double a, double b, double c, double d) {
+    return geo_distance(a, b, c, d, GEO_HAVERSINE_F);
+  });
+  timeCall("distance haversine", iterations, [](double a, double b, double c, double d) {
+    return geo_distance(a, b, c, d, GEO_HAVERSINE);
+  });
+  timeCall("distance auto", iterations, [](double a, double b, double c, double d) {
+    return geo_distance(a, b, c, d);
+  });
+  timeCall("distance e6", iterations, [](double a, double b, double c, double d) {
+    return (double)geo_distance_e6((int32_t)(a * 1e6), (int32_t)(b * 1e6), (int32_t)(c * 1e6), (int32_t)(d * 1e6));
+  });
+  timeCall("bearing flat", iterations, [](double a, double b, double c, double d) {
+    return geo_bearing(a, b, c, d, GEO_FLAT);
+  });
+  timeCall("bearing great-circle", iterations, [](double a, double b, double c, double d) {
+    return geo_bearing(a, b, c, d, GEO_HAVERSINE);
+  });
+  timeCall("bearing auto", iterations, [](double a, double b, double c, double d) {
+    return geo_bearing(a, b, c, d);
+  });
+
+  printf("\n%s\n", failures ? "geo_bench: FAILED" : "geo_bench: all checks passed");
+  return failures ? 1 : 0;
+}
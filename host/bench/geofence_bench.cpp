@@ -0,0 +1,187 @@
+// Runs a walk through 10 to 5000 fences with src/Geofence.h and reports,
+// for each fence count:
+//   - fence updates per second with the grid index and the tracker's skip
+//     distance, and with every fence tested on every fix
+//   - fence tests per update and the share of updates that tested none
+//   - index memory
+//   - that both produce the same enter and exit events
+//
+// Fences are scattered over a 10 km square: waypoints of 20 yards and zones
+// of 50 to 300 m. The walk is 10 fixes per second at walking pace with
+// +-1 m of GPS noise, turning now and then, inside the same square.
+//
+// Exits with status 1 if any check fails.
+//
+// Usage: geofence_bench [--fixes N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "src/Geofence.h"
+
+typedef FenceIndex<5000, 65000, 16384> Index;
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+static double nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Uniform in [-1, 1]
+static float noise() {
+  return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+struct Position {
+  int32_t lat;
+  int32_t lon;
+};
+
+// Every fence tested on every fix, with the same rule as the tracker
+struct BruteForce {
+  std::vector<bool> inside;
+
+  size_t update(const Index& index, const Position& p, std::vector<FenceEvent>* events) {
+    inside.resize(index.count);
+    float cosLat = geo_lat_trig(p.lat * GEO_E6_TO_DEG_F).cosLat;
+    size_t n = 0;
+    for (uint16_t f = 0; f < index.count; f++) {
+      const Fence& fence = index.fences[f];
+      float dx = (float)(fence.lon_e6 - p.lon) * cosLat * GF_M_PER_E6;
+      float dy = (float)(fence.lat_e6 - p.lat) * GF_M_PER_E6;
+      float d = sqrtf(dx * dx + dy * dy);
+      bool now = inside[f] ? d <= fence.radiusM + GF_HYSTERESIS_M : d < fence.radiusM;
+      if (now != inside[f]) {
+        inside[f] = now;
+        events->push_back({ f, (uint8_t)(now ? FENCE_ENTER : FENCE_EXIT) });
+        n++;
+      }
+    }
+    return n;
+  }
+};
+
+int main(int argc, char** argv) {
+  long fixes = 200000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--fixes") && i + 1 < argc) {
+      fixes = atol(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--fixes N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  const int32_t lat0 = 42320000, lon0 = -83235000;
+  const float sideM = 10000.0f;
+  float cosLat = cosf(lat0 * GEO_E6_TO_DEG_F * GEO_DEG_TO_RAD_F);
+  int32_t sideLat = (int32_t)(sideM * DR_E6_PER_M), sideLon = (int32_t)(sideM * DR_E6_PER_M / cosLat);
+
+  // One walk for every fence count
+  srand(1);
+  std::vector<Position> walk;
+  walk.reserve(fixes);
+  float north = sideM / 2, east = sideM / 2, heading = 0.3f;
+  for (long t = 0; t < fixes; t++) {
+    if (rand() % 600 == 0) {
+      heading += noise() * 2.0f;
+    }
+    north += 0.14f * cosf(heading);
+    east += 0.14f * sinf(heading);
+    if (north < 0 || north > sideM || east < 0 || east > sideM) {
+      heading += (float)M_PI;  // Turn back at the edge
+    }
+    walk.push_back({ lat0 + (int32_t)lroundf((north + noise()) * DR_E6_PER_M),
+                     lon0 + (int32_t)lroundf((east + noise()) * DR_E6_PER_M / cosLat) });
+  }
+
+  printf("geofence_bench: %ld fixes, cell %d udeg, hysteresis %.0f m\n\n", fixes, GF_CELL_E6, GF_HYSTERESIS_M);
+  printf("%7s %9s %14s %14s %8s %12s %9s %8s %8s\n", "fences", "entries", "grid upd/s", "brute upd/s", "speedup",
+         "tests/upd", "skipped", "events", "memory");
+  const size_t COUNTS[] = { 10, 100, 1000, 2000, 5000 };
+  Index* index = new Index();
+  srand(2);
+  for (size_t c = 0; c < sizeof(COUNTS) / sizeof(COUNTS[0]); c++) {
+    while (index->count < COUNTS[c]) {
+      bool waypoint = rand() % 4 == 0;
+      float radius = waypoint ? 18.3f : 50.0f + rand() % 250;
+      if (index->add(lat0 + rand() % sideLat, lon0 + rand() % sideLon, radius) < 0) {
+        check(false, "index has room for every fence");
+        break;
+      }
+    }
+
+    FenceTracker<Index>* tracker = new FenceTracker<Index>();
+    std::vector<FenceEvent> gridEvents, bruteEvents;
+    FenceEvent out[64];
+    double start = nowNs();
+    for (long t = 0; t < fixes; t++) {
+      size_t n = tracker->update(*index, walk[t].lat, walk[t].lon, out, 64);
+      gridEvents.insert(gridEvents.end(), out, out + n);
+    }
+    double gridNs = nowNs() - start;
+
+    BruteForce brute;
+    long bruteFixes = std::min(fixes, COUNTS[c] > 1000 ? 20000L : fixes);
+    start = nowNs();
+    for (long t = 0; t < bruteFixes; t++) {
+      brute.update(*index, walk[t], &bruteEvents);
+    }
+    double bruteNs = nowNs() - start;
+
+    // The grid's events over the fixes both ran must match
+    size_t gridPrefix = 0;
+    FenceTracker<Index>* replay = new FenceTracker<Index>();
+    for (long t = 0; t < bruteFixes; t++) {
+      gridPrefix += replay->update(*index, walk[t].lat, walk[t].lon, out, 64);
+    }
+    bool same = gridPrefix == bruteEvents.size();
+    for (size_t i = 0; same && i < gridPrefix; i++) {
+      same = gridEvents[i].fence == bruteEvents[i].fence && gridEvents[i].type == bruteEvents[i].type;
+    }
+    // Events of one fix come in a different order; compare as sets per fix if the order differs
+    if (!same && gridPrefix == bruteEvents.size()) {
+      std::vector<FenceEvent> a(gridEvents.begin(), gridEvents.begin() + gridPrefix), b(bruteEvents);
+      auto less = [](const FenceEvent& x, const FenceEvent& y) {
+        return x.fence != y.fence ? x.fence < y.fence : x.type < y.type;
+      };
+      std::stable_sort(a.begin(), a.end(), less);
+      std::stable_sort(b.begin(), b.end(), less);
+      same = true;
+      for (size_t i = 0; same && i < a.size(); i++) {
+        same = a[i].fence == b[i].fence && a[i].type == b[i].type;
+      }
+    }
+
+    size_t memory = sizeof(Fence) * index->count + sizeof(Index::Entry) * index->used + sizeof(index->heads);
+    printf("%7u %9u %14.0f %14.0f %7.0fx %12.2f %8.1f%% %8zu %7zuK\n", (unsigned)index->count, (unsigned)index->used,
+           fixes / gridNs * 1e9, bruteFixes / bruteNs * 1e9, (bruteNs / bruteFixes) / (gridNs / fixes),
+           (double)tracker->tests / tracker->updates, 100.0 * tracker->skipped / tracker->updates, gridEvents.size(),
+           memory / 1024);
+    char what[80];
+    snprintf(what, sizeof(what), "grid and brute force agree with %u fences", (unsigned)index->count);
+    check(same, what);
+    check(COUNTS[c] < 1000 || gridNs / fixes < 0.1 * bruteNs / bruteFixes, "the grid is 10x faster from 1000 fences");
+    delete tracker;
+    delete replay;
+  }
+  delete index;
+
+  printf("\n%s\n", failures ? "geofence_bench: FAILED" : "geofence_bench: all checks passed");
+  return failures ? 1 : 0;
+}
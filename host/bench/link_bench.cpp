@@ -0,0 +1,222 @@
+// Streams a 10 Hz walk through the delta stream in src/PositionStream.h over
+// the lossy-link emulator in host/include/sim/LinkEmulator.h, with and
+// without redundant deltas, and reports for each loss rate:
+//   - the share of fixes that reached the client while they were the
+//     newest, and how many more were rebuilt late from a redundant delta
+//   - staleness: how old the client's newest position is, sampled every
+//     10 ms, from the fix being sent to now
+//   - keyframe requests, stale frames dropped and bytes per fix
+// Keyframe requests go back over an emulated link with the same
+// impairments, at most one a second, as the client sends them.
+// Checks that no wrong fix is ever produced, that redundancy never delivers
+// fewer fixes, and that with single losses every frame that arrives is
+// applied, without a keyframe request.
+//
+// Exits with status 1 if any check fails.
+//
+// Usage: link_bench [--fixes N] [--ber RATE] [--reorder PCT] [--air-ms N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "sim/LinkEmulator.h"
+#include "src/PositionStream.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+const uint64_t FIX_US = 100000;            // 10 fixes per second, as configured on the master's receiver
+const uint64_t TICK_US = 10000;            // How often staleness is sampled
+const uint64_t KEY_REQUEST_US = 1000000;   // Client's shortest time between keyframe requests
+
+struct Options {
+  long fixes = 36000;
+  double ber = 1e-5;
+  double reorderPct = 1;
+  uint64_t airUs = 15000;
+};
+
+struct Result {
+  long sent = 0;
+  long delivered = 0;      // Fixes the decoder produced as its newest
+  long wrong = 0;
+  long requests = 0;
+  long bytes = 0;
+  StreamDecoder decoder;
+  std::vector<double> staleMs;
+
+  double percentile(double p) {
+    if (staleMs.empty()) {
+      return 0;
+    }
+    size_t k = std::min(staleMs.size() - 1, (size_t)(p / 100.0 * staleMs.size()));
+    std::nth_element(staleMs.begin(), staleMs.begin() + k, staleMs.end());
+    return staleMs[k];
+  }
+};
+
+/**
+ * @brief Streams `o.fixes` fixes over an emulated link.
+ *
+ * @param lossPct Writes lost in each direction, in percent.
+ * @param redundant Whether deltas carry the step before them.
+ * @param dropEvery If not 0, lose exactly every dropEvery-th position frame
+ *        instead, and nothing else.
+ */
+static Result run(const Options& o, double lossPct, bool redundant, long dropEvery) {
+  sim::LinkEmulator down(7), up(11);
+  if (!dropEvery) {
+    down.impairment.lossPct = up.impairment.lossPct = lossPct;
+    down.impairment.bitErrorRate = up.impairment.bitErrorRate = o.ber;
+    down.impairment.reorderPct = o.reorderPct;
+  }
+  StreamEncoder encoder;
+  encoder.redundant = redundant;
+  Result r;
+  StreamDecoder& decoder = r.decoder;
+  srand(3);
+
+  PositionFix sent[256];
+  uint64_t sentAt[256];
+  std::multimap<uint64_t, std::vector<uint8_t>> inFlight;  // Position frames by arrival time
+  std::multimap<uint64_t, bool> requests;                   // Keyframe requests by arrival at the master
+  PositionFix fix = { 0, 42319000, -83236000, 12 * 3600000, 0, 0 };
+  bool haveFix = false;
+  uint64_t heldSentAt = 0;
+  uint64_t lastRequest = 0;
+  bool requested = false;
+  uint64_t end = (uint64_t)o.fixes * FIX_US;
+
+  for (uint64_t now = 0; now < end; now += TICK_US) {
+    for (std::multimap<uint64_t, bool>::iterator it = requests.begin(); it != requests.end() && it->first <= now;) {
+      encoder.requestKeyframe();
+      requests.erase(it++);
+    }
+    if (now % FIX_US == 0) {
+      long i = (long)(now / FIX_US);
+      fix.seq = (uint8_t)i;
+      fix.lat_e6 += rand() % 7 - 3;
+      fix.lon_e6 += rand() % 7 - 3;
+      fix.time_ms += (uint32_t)(FIX_US / 1000);
+      fix.vn_cms = (int16_t)(fix.vn_cms + rand() % 7 - 3);
+      fix.ve_cms = (int16_t)(fix.ve_cms + rand() % 7 - 3);
+      std::vector<uint8_t> frame(STREAM_FRAME_MAX);
+      frame.resize(encoder.encode(fix, (uint32_t)(now / 1000), frame.data()));
+      sent[fix.seq] = fix;
+      sentAt[fix.seq] = now;
+      r.sent++;
+      r.bytes += (long)frame.size();
+      uint64_t extraUs = 0;
+      bool pass = dropEvery ? (i + 1) % dropEvery != 0 : down.pass(frame.data(), frame.size(), &extraUs);
+      if (pass) {
+        inFlight.insert(std::make_pair(now + o.airUs + extraUs, frame));
+      }
+    }
+    for (std::multimap<uint64_t, std::vector<uint8_t>>::iterator it = inFlight.begin();
+         it != inFlight.end() && it->first <= now;) {
+      PositionFix out;
+      for (size_t k = 0; k < it->second.size(); k++) {
+        if (decoder.push(it->second[k], &out)) {
+          const PositionFix& want = sent[out.seq];
+          r.delivered++;
+          r.wrong += out.lat_e6 != want.lat_e6 || out.lon_e6 != want.lon_e6 || out.time_ms != want.time_ms ||
+                     abs(out.vn_cms - want.vn_cms) > STREAM_VELOCITY_BAND ||
+                     abs(out.ve_cms - want.ve_cms) > STREAM_VELOCITY_BAND;
+          haveFix = true;
+          heldSentAt = sentAt[out.seq];
+        }
+      }
+      decoder.reset();  // A write that ends mid-frame was cut short by a bit error
+      inFlight.erase(it++);
+    }
+    if (decoder.needKeyframe && (!requested || now - lastRequest >= KEY_REQUEST_US)) {
+      requested = true;
+      lastRequest = now;
+      r.requests++;
+      uint8_t request[STREAM_REQUEST_LEN];
+      stream_encode_request(decoder.last.seq, request);
+      uint64_t extraUs = 0;
+      if (up.pass(request, sizeof(request), &extraUs) && stream_find_request(request, sizeof(request))) {
+        requests.insert(std::make_pair(now + o.airUs + extraUs, true));
+      }
+    }
+    if (haveFix) {
+      r.staleMs.push_back((now - heldSentAt) / 1000.0);
+    }
+  }
+  return r;
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--fixes") && i + 1 < argc) {
+      o.fixes = atol(argv[++i]);
+    } else if (!strcmp(argv[i], "--ber") && i + 1 < argc) {
+      o.ber = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--reorder") && i + 1 < argc) {
+      o.reorderPct = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--air-ms") && i + 1 < argc) {
+      o.airUs = (uint64_t)(atof(argv[++i]) * 1000);
+    } else {
+      fprintf(stderr, "usage: %s [--fixes N] [--ber RATE] [--reorder PCT] [--air-ms N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  printf("link_bench: %ld fixes at 10 Hz, bit error rate %g, %.1f%% of writes reordered, %.0f ms air latency\n\n",
+         o.fixes, o.ber, o.reorderPct, o.airUs / 1000.0);
+  printf("%6s %-10s %10s %10s %9s %9s %8s %8s %8s %8s\n", "loss", "deltas", "delivered", "recovered", "requests",
+         "stale", "p50", "p99", "max", "B/fix");
+  printf("%6s %-10s %10s %10s %9s %9s %8s %8s %8s %8s\n", "", "", "", "", "", "", "(ms)", "", "", "");
+  static const double LOSSES[] = { 0, 1, 2, 5, 10, 20, 30 };
+  bool sawStale = false;
+  for (size_t i = 0; i < sizeof(LOSSES) / sizeof(LOSSES[0]); i++) {
+    Result plain = run(o, LOSSES[i], false, 0);
+    Result redundant = run(o, LOSSES[i], true, 0);
+    Result* results[] = { &plain, &redundant };
+    for (int k = 0; k < 2; k++) {
+      Result& r = *results[k];
+      printf("%5.0f%% %-10s %9.2f%% %10u %9ld %9u %8.0f %8.0f %8.0f %8.2f\n", LOSSES[i], k ? "redundant" : "plain",
+             100.0 * r.delivered / r.sent, r.decoder.recovered, r.requests, r.decoder.stale, r.percentile(50),
+             r.percentile(99), r.percentile(100), (double)r.bytes / r.sent);
+      check(r.wrong == 0, "no wrong fix is ever produced");
+      sawStale |= r.decoder.stale > 0;
+    }
+    check(redundant.delivered + (long)redundant.decoder.recovered >= plain.delivered,
+          "redundant deltas never deliver fewer fixes");
+  }
+  check(o.reorderPct == 0 || sawStale, "reordered frames are dropped as stale");
+
+  // Every tenth frame lost, nothing else: each loss costs plain deltas a keyframe round trip
+  Options single = o;
+  single.ber = 0;
+  single.reorderPct = 0;
+  Result clean = run(single, 0, true, 0);
+  check(clean.delivered == clean.sent && clean.decoder.stale == 0, "a clean link delivers every fix");
+  Result plain = run(single, 0, false, 10);
+  Result redundant = run(single, 0, true, 10);
+  printf("\nevery 10th frame lost: plain %.2f%% delivered, %ld requests; redundant %.2f%% delivered, "
+         "%u recovered, %ld requests\n",
+         100.0 * plain.delivered / plain.sent, plain.requests, 100.0 * redundant.delivered / redundant.sent,
+         redundant.decoder.recovered, redundant.requests);
+  long arrived = redundant.sent - redundant.sent / 10;
+  check(redundant.delivered == arrived && redundant.requests == 0,
+        "with redundant deltas a single loss costs no other fix");
+  check(plain.requests > 0, "without them a single loss needs a keyframe");
+
+  printf("\n%s\n", failures ? "link_bench: FAILED" : "link_bench: all checks passed");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,487 @@
+// Runs Master_SW and Client_SW together on the simulator, plays recorded
+// NMEA into both GPS UARTs through simulated receivers (PMTK on the master,
+// UBX on the client by default) and reports:
+//   - host CPU time per loop() call on each device
+//   - fix-to-transmit latency: master fix available to the parser until the
+//     first SPP write after it
+//   - fix-to-LCD latency: the same master fix until the first character the
+//     client writes to its LCD after it has read that transmission and
+//     before it reads the next one; fixes that leave the display unchanged
+//     are counted separately
+//   - bytes the master hands to the SPP stack per write
+//   - with POWER_SAVE, the share of each device's time spent in light sleep,
+//     its light-sleep wake-ups per second and the GPS bytes lost while asleep
+//   - with --profile, the on-device profiler dumps of both sketches,
+//     requested on the master's USB port near the end of the run
+//   - with LINK_CLOCK, the client's estimate of the master's clock offset
+//     next to the true one, and the age of the master's positions
+// The client's clock runs --clock-offset-ms ahead of the master's (default
+// 2000), as if it had been switched on first. Clock frames are not counted
+// as transmits.
+// --flash DIR keeps the devices' LittleFS partitions and NVS in DIR/master
+// and DIR/client, e.g. for captures (CAPTURE=1) to replay with
+// host/tools/replay, or for the client's warm-start state. Run twice with
+// the same DIR to compare a cold and a warm boot: the client boot line
+// gives the times from power-up to its first LCD write, its first fix and
+// the first LCD write from a live fix and a live master position.
+// --client-ttff-s N makes the client's receiver take N seconds to its
+// first fix, or --client-aided-ttff-s M (default 5) from aiding.
+// --link-loss, --link-ber and --link-reorder impair every SPP write in both
+// directions through host/include/sim/LinkEmulator.h; the client's stream
+// line then shows what the decoder lost, rebuilt and dropped as stale. The
+// fix-to-LCD pairing counts bytes, so it is only exact on a clean link.
+//
+// Exits with status 1 if the client lost GPS bytes while asleep, i.e. its
+// burst clock let the chip sleep through a burst.
+//
+// Usage: loop_bench [--master-nmea FILE] [--client-nmea FILE] [--seconds N]
+//                   [--master-gps nmea|mtk|ubx] [--client-gps nmea|mtk|ubx]
+//                   [--quantum-us N] [--air-ms N] [--clock-offset-ms N] [--profile] [--flash DIR]
+//                   [--client-ttff-s N] [--client-aided-ttff-s N] [--link-loss PCT]
+//                   [--link-ber RATE] [--link-reorder PCT] [--verbose]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Arduino.h"
+#include "BluetoothSerial.h"
+#include "LiquidCrystal.h"
+#include "sim/GpsReceiver.h"
+#include "sim/NmeaFeed.h"
+#include "sim/Sim.h"
+#include "src/LinkClock.h"
+#include "src/Profiler.h"
+
+// Must match LINK_BINARY_FRAMES, LINK_DELTA_STREAM and LINK_CLOCK in the sketches
+#ifndef LINK_BINARY_FRAMES
+#define LINK_BINARY_FRAMES 1
+#endif
+#ifndef LINK_DELTA_STREAM
+#define LINK_DELTA_STREAM 1
+#endif
+#ifndef LINK_CLOCK
+#define LINK_CLOCK 1
+#endif
+#if !LINK_BINARY_FRAMES
+#undef LINK_DELTA_STREAM
+#define LINK_DELTA_STREAM 0
+#undef LINK_CLOCK
+#define LINK_CLOCK 0
+#endif
+
+namespace master {
+void setup();
+void loop();
+extern HardwareSerial gpsSerial;
+}  // namespace master
+
+namespace client {
+void setup();
+void loop();
+extern HardwareSerial gpsSerial;
+extern LiquidCrystal lcd;
+#if LINK_DELTA_STREAM
+extern StreamDecoder frameDecoder;
+extern uint32_t keyRequests;
+#endif
+#if LINK_CLOCK
+extern LinkClock masterClock;
+extern int32_t masterAgeMeanUs;
+extern int32_t masterAgeMaxUs;
+extern uint32_t agedFixes;
+#endif
+}  // namespace client
+
+// MAC address the master sketch connects to
+static const uint8_t CLIENT_ADDRESS[6] = { 0x1C, 0x69, 0x20, 0xC6, 0x5E, 0x32 };
+
+struct Samples {
+  std::vector<double> v;
+
+  void add(double x) { v.push_back(x); }
+  double mean() const {
+    double s = 0;
+    for (size_t i = 0; i < v.size(); i++) {
+      s += v[i];
+    }
+    return v.empty() ? 0 : s / v.size();
+  }
+  double pct(double p) {
+    if (v.empty()) {
+      return 0;
+    }
+    std::sort(v.begin(), v.end());
+    size_t i = (size_t)(p * (v.size() - 1) + 0.5);
+    return v[i];
+  }
+};
+
+// Index of the first event in [fixes[i], fixes[i + 1]), or -1
+static long firstEventFor(const std::vector<sim::Micros>& fixes, size_t i, const std::vector<sim::Micros>& events) {
+  sim::Micros limit = (i + 1 < fixes.size()) ? fixes[i + 1] : sim::FOREVER;
+  std::vector<sim::Micros>::const_iterator it = std::lower_bound(events.begin(), events.end(), fixes[i]);
+  if (it == events.end() || *it >= limit) {
+    return -1;
+  }
+  return (long)(it - events.begin());
+}
+
+static void printLatency(const char* label, Samples s, size_t fixes) {
+  size_t n = s.v.size();
+  printf("%-16s %5zu/%-5zu %9.2f %9.2f %9.2f %9.2f\n", label, n, fixes, s.mean(), s.pct(0.5), s.pct(0.99),
+         s.pct(1.0));
+}
+
+static void printLoops(const char* label, Samples s, double longestMs, const sim::Device& dev) {
+  double total = (double)(dev.busyUs + dev.idleUs);
+  printf("%-8s %10llu %9.2f %9.2f %9.2f %9.2f %10.1f %7.1f%% %7.1f%% %8.1f\n", label, (unsigned long long)dev.loops,
+         s.mean(), s.pct(0.5), s.pct(0.99), s.pct(1.0), longestMs, total > 0 ? 100.0 * dev.busyUs / total : 0.0,
+         total > 0 ? 100.0 * dev.sleepUs / total : 0.0, total > 0 ? dev.sleeps * 1e6 / total : 0.0);
+}
+
+static size_t getVarint(const uint8_t* p, const uint8_t* end, uint64_t* v) {
+  uint64_t value = 0;
+  size_t n = 0;
+  do {
+    if (p + n >= end || n == 10) {
+      return 0;
+    }
+    value |= (uint64_t)(p[n] & 0x7F) << (7 * n);
+  } while (p[n++] & 0x80);
+  *v = value;
+  return n;
+}
+
+// Decodes a histogram; false if the body ends first
+static bool getHistogram(const uint8_t** p, const uint8_t* end, uint8_t buckets, ProfHistogram* h) {
+  uint64_t v[3 + PROF_BUCKETS];
+  for (uint8_t i = 0; i < 3 + buckets; i++) {
+    size_t n = getVarint(*p, end, &v[i]);
+    if (!n) {
+      return false;
+    }
+    *p += n;
+  }
+  h->count = (uint32_t)v[0];
+  h->maxCycles = (uint32_t)v[1];
+  h->totalCycles = v[2];
+  for (uint8_t i = 0; i < buckets && i < PROF_BUCKETS; i++) {
+    h->buckets[i] = (uint32_t)v[3 + i];
+  }
+  return true;
+}
+
+// Upper bound in cycles of the bucket holding quantile q, at most the maximum
+static uint64_t bucketQuantile(const ProfHistogram& h, double q) {
+  uint64_t want = (uint64_t)(q * h.count + 0.5), seen = 0;
+  for (int i = 0; i + 1 < PROF_BUCKETS; i++) {
+    seen += h.buckets[i];
+    if (seen >= want && seen) {
+      return std::min<uint64_t>(1ULL << (i + PROF_MIN_SHIFT), h.maxCycles);
+    }
+  }
+  return h.maxCycles;
+}
+
+// Share of the uptime is left out where it means nothing, e.g. for the loop period
+static void printHistogram(const char* name, const ProfHistogram& h, double mhz, double uptimeUs) {
+  printf("%-12s %10lu %10.2f %10.1f %10.1f %10.1f", name, (unsigned long)h.count,
+         h.count ? h.totalCycles / mhz / h.count : 0.0, bucketQuantile(h, 0.5) / mhz, bucketQuantile(h, 0.99) / mhz,
+         h.maxCycles / mhz);
+  if (uptimeUs > 0) {
+    printf(" %8.3f%%", 100.0 * h.totalCycles / mhz / uptimeUs);
+  }
+  printf("\n");
+}
+
+/**
+ * @brief Prints every profiler dump found in a device's USB output.
+ *
+ * @return size_t Number of dumps found.
+ */
+static size_t printProfiles(const std::vector<uint8_t>& out) {
+  size_t found = 0;
+  for (size_t i = 0; i + 6 <= out.size(); i++) {
+    const uint8_t* f = &out[i];
+    size_t len = 6 + (size_t)(f[2] | (f[3] << 8));
+    if (f[0] != FRAME_SYNC0 || f[1] != PROF_MARKER || i + len > out.size() || !stream_check_crc(f, len)) {
+      continue;
+    }
+    const uint8_t* p = f + 4;
+    const uint8_t* end = f + len - 2;
+    if (p[0] != PROF_VERSION || end - p < 17) {
+      continue;
+    }
+    const uint8_t* address = p + 1;
+    double mhz = (double)(p[7] | (p[8] << 8));
+    uint32_t uptimeMs = frame_get32(p + 9);
+    uint8_t stages = p[13], buckets = p[14];
+    p += 15;
+    ProfHistogram period;
+    uint64_t sumSqUs, stalls, worstUs, worstAtMs;
+    size_t n;
+    if (buckets > PROF_BUCKETS || !getHistogram(&p, end, buckets, &period) || !((n = getVarint(p, end, &sumSqUs))) ||
+        !(p += n, (n = getVarint(p, end, &stalls))) || !(p += n, (n = getVarint(p, end, &worstUs))) ||
+        !(p += n, (n = getVarint(p, end, &worstAtMs))) || (p += n) >= end) {
+      continue;
+    }
+    uint8_t worstStage = *p++;
+    double uptimeUs = uptimeMs * 1000.0;
+    printf("\nprofile of %02X:%02X:%02X:%02X:%02X:%02X at %.1f s, %.0f MHz\n", address[0], address[1], address[2],
+           address[3], address[4], address[5], uptimeMs / 1000.0, mhz);
+    printf("%-12s %10s %10s %10s %10s %10s %9s\n", "stage", "count", "mean (us)", "p50 (us)", "p99 (us)", "max (us)",
+           "of time");
+    printHistogram("loop period", period, mhz, 0);
+    std::string worstName = "-";
+    for (uint8_t s = 0; s < stages && p < end; s++) {
+      const uint8_t* name = p;
+      while (p < end && *p) {
+        p++;
+      }
+      std::string stageName((const char*)name, p - name);
+      ProfHistogram h;
+      if (++p > end || !getHistogram(&p, end, buckets, &h)) {
+        break;
+      }
+      printHistogram(stageName.c_str(), h, mhz, uptimeUs);
+      if (s == worstStage) {
+        worstName = stageName;
+      }
+    }
+    double mean = period.count ? period.totalCycles / mhz / period.count : 0;
+    double var = period.count ? (double)sumSqUs / period.count - mean * mean : 0;
+    printf("loop jitter %.1f us, %llu stalls over %d ms, longest %.1f ms at %.1f s in %s\n", var > 0 ? sqrt(var) : 0.0,
+           (unsigned long long)stalls, PROF_STALL_US / 1000, worstUs / 1000.0, worstAtMs / 1000.0, worstName.c_str());
+    found++;
+    i += len - 1;
+  }
+  return found;
+}
+
+int main(int argc, char** argv) {
+  const char* masterNmea = WALKIE_DATA_DIR "/walk.nmea";
+  const char* clientNmea = WALKIE_DATA_DIR "/stationary.nmea";
+  double seconds = 0;
+  bool profile = false;
+  double clockOffsetMs = 2000;
+  const char* flashDir = nullptr;
+  double ttffS = 0, aidedTtffS = 5;
+  sim::GpsReceiver::Commands masterGps = sim::GpsReceiver::MTK, clientGps = sim::GpsReceiver::UBX;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--master-nmea") && i + 1 < argc) {
+      masterNmea = argv[++i];
+    } else if (!strcmp(argv[i], "--client-nmea") && i + 1 < argc) {
+      clientNmea = argv[++i];
+    } else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--master-gps") && i + 1 < argc &&
+               sim::GpsReceiver::parseCommands(argv[i + 1], &masterGps)) {
+      i++;
+    } else if (!strcmp(argv[i], "--client-gps") && i + 1 < argc &&
+               sim::GpsReceiver::parseCommands(argv[i + 1], &clientGps)) {
+      i++;
+    } else if (!strcmp(argv[i], "--quantum-us") && i + 1 < argc) {
+      sim::config().loopQuantumUs = strtoull(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "--air-ms") && i + 1 < argc) {
+      sim::config().btAirUs = (sim::Micros)(atof(argv[++i]) * 1000);
+    } else if (!strcmp(argv[i], "--clock-offset-ms") && i + 1 < argc) {
+      clockOffsetMs = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--profile")) {
+      profile = true;
+    } else if (!strcmp(argv[i], "--flash") && i + 1 < argc) {
+      flashDir = argv[++i];
+    } else if (!strcmp(argv[i], "--client-ttff-s") && i + 1 < argc) {
+      ttffS = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--client-aided-ttff-s") && i + 1 < argc) {
+      aidedTtffS = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--link-loss") && i + 1 < argc) {
+      sim::btEmulator().impairment.lossPct = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--link-ber") && i + 1 < argc) {
+      sim::btEmulator().impairment.bitErrorRate = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--link-reorder") && i + 1 < argc) {
+      sim::btEmulator().impairment.reorderPct = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--verbose")) {
+      sim::config().echoSerial = true;
+    } else {
+      fprintf(stderr, "usage: %s [--master-nmea FILE] [--client-nmea FILE] [--seconds N] [--quantum-us N] "
+                      "[--master-gps nmea|mtk|ubx] [--client-gps nmea|mtk|ubx] [--air-ms N] [--clock-offset-ms N] "
+                      "[--profile] [--flash DIR] [--client-ttff-s N] [--client-aided-ttff-s N] [--link-loss PCT] "
+                      "[--link-ber RATE] [--link-reorder PCT] [--verbose]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  sim::NmeaFeed masterFeed, clientFeed;
+  if (!masterFeed.load(masterNmea) || !clientFeed.load(clientNmea)) {
+    fprintf(stderr, "cannot read NMEA recordings\n");
+    return 1;
+  }
+  if (seconds <= 0) {
+    seconds = masterFeed.epochs() + 2;
+  }
+
+  sim::Device clientDev("client");
+  sim::Device masterDev("master");
+  memcpy(clientDev.btAddress, CLIENT_ADDRESS, 6);
+  clientDev.clockOffsetUs = (sim::Micros)(clockOffsetMs * 1000);
+  if (flashDir) {
+    masterDev.flashDir = std::string(flashDir) + "/master";
+    clientDev.flashDir = std::string(flashDir) + "/client";
+  }
+
+  Samples masterCpu, clientCpu;
+  double masterLongest = 0, clientLongest = 0;
+  masterDev.onLoop = [&](uint64_t cpuNs, sim::Micros start, sim::Micros end) {
+    masterCpu.add(cpuNs / 1000.0);
+    masterLongest = std::max(masterLongest, (end - start) / 1000.0);
+  };
+  clientDev.onLoop = [&](uint64_t cpuNs, sim::Micros start, sim::Micros end) {
+    clientCpu.add(cpuNs / 1000.0);
+    clientLongest = std::max(clientLongest, (end - start) / 1000.0);
+  };
+
+  // SPP delivers bytes in order, so the client has received a transmission
+  // once it has read as many bytes as the master had sent by its end
+  std::vector<sim::Micros> transmits, lcdWrites, readAt, clientRx;
+  std::vector<uint64_t> sentThrough;
+  std::vector<uint8_t> masterUsb;
+  uint64_t sent = 0, received = 0, positionBytes = 0;
+  sim::setTrace([&](const sim::TraceEvent& ev) {
+    if (profile && ev.kind == sim::TRACE_SERIAL_TX && ev.device == &masterDev) {
+      masterUsb.insert(masterUsb.end(), ev.data, ev.data + ev.len);
+    }
+    if (ev.kind == sim::TRACE_BT_TX && ev.device == &masterDev) {
+      sent += ev.len;
+      if (ev.len == CLOCK_FRAME_LEN && ev.data[0] == FRAME_SYNC0 && ev.data[1] == CLOCK_MARKER) {
+        return;  // Not a position
+      }
+      positionBytes += ev.len;
+      transmits.push_back(ev.time);
+      sentThrough.push_back(sent);
+    } else if (ev.kind == sim::TRACE_BT_RX && ev.device == &clientDev) {
+      clientRx.push_back(ev.time);
+      received += ev.len;
+      while (readAt.size() < sentThrough.size() && sentThrough[readAt.size()] <= received) {
+        readAt.push_back(ev.time);
+      }
+    } else if (ev.kind == sim::TRACE_LCD_DATA && ev.device == &clientDev) {
+      lcdWrites.push_back(ev.time);
+    }
+  });
+
+  sim::GpsReceiver masterReceiver(masterFeed, master::gpsSerial, masterDev, masterGps);
+  sim::GpsReceiver clientReceiver(clientFeed, client::gpsSerial, clientDev, clientGps);
+  clientReceiver.setTimeToFix((sim::Micros)(ttffS * 1e6), (sim::Micros)(aidedTtffS * 1e6));
+  masterReceiver.start(0);
+  clientReceiver.start(0);
+
+  clientDev.start(client::setup, client::loop);
+  masterDev.start(master::setup, master::loop);
+  if (profile) {
+    // Typed into the master's serial monitor; the master passes it on to the client
+    uint8_t request[PROF_REQUEST_LEN];
+    prof_encode_request(0, request);
+    sim::Micros at = (sim::Micros)(std::max(seconds - 2, seconds / 2) * 1e6);
+    for (size_t i = 0; i < sizeof(request); i++) {
+      masterDev.usbRx.push(at, request[i]);
+    }
+  }
+  sim::run((sim::Micros)(seconds * 1e6));
+  const std::vector<sim::Micros>& fixes = masterReceiver.fixTimes();
+
+  printf("loop_bench: %.0f s simulated, %zu master fixes, loop quantum %llu us, air latency %.1f ms\n\n", seconds,
+         fixes.size(), (unsigned long long)sim::config().loopQuantumUs, sim::config().btAirUs / 1000.0);
+  Samples toTransmit, toLcd;
+  size_t lcdUnchanged = 0;
+  for (size_t i = 0; i < fixes.size(); i++) {
+    if (fixes[i] == sim::FOREVER) {
+      continue;
+    }
+    long tx = firstEventFor(fixes, i, transmits);
+    if (tx < 0) {
+      continue;
+    }
+    toTransmit.add((transmits[tx] - fixes[i]) / 1000.0);
+    if ((size_t)tx >= readAt.size()) {
+      continue;
+    }
+    sim::Micros nextRead = ((size_t)tx + 1 < readAt.size()) ? readAt[tx + 1] : sim::FOREVER;
+    std::vector<sim::Micros>::const_iterator lcd = std::lower_bound(lcdWrites.begin(), lcdWrites.end(), readAt[tx]);
+    if (lcd != lcdWrites.end() && *lcd < nextRead) {
+      toLcd.add((*lcd - fixes[i]) / 1000.0);
+    } else {
+      lcdUnchanged++;
+    }
+  }
+
+  printf("%-8s %10s %9s %9s %9s %9s %10s %8s %8s %8s\n", "device", "loops", "cpu mean", "p50", "p99", "max", "longest",
+         "busy", "asleep", "wakes");
+  printf("%-8s %10s %9s %9s %9s %9s %10s %8s %8s %8s\n", "", "", "(us)", "", "", "", "(ms)", "", "", "(/s)");
+  printLoops("master", masterCpu, masterLongest, masterDev);
+  printLoops("client", clientCpu, clientLongest, clientDev);
+  printf("\n%-16s %11s %9s %9s %9s %9s\n", "latency (ms)", "fixes", "mean", "p50", "p99", "max");
+  printLatency("fix-to-transmit", toTransmit, fixes.size());
+  printLatency("fix-to-LCD", toLcd, fixes.size());
+  printf("%zu fixes received without changing the LCD\n", lcdUnchanged);
+  printf("master SPP: %llu position bytes in %zu writes, %.1f bytes per write, %llu bytes in all\n",
+         (unsigned long long)positionBytes, transmits.size(), transmits.empty() ? 0.0 : (double)positionBytes / transmits.size(),
+         (unsigned long long)sent);
+  printf("\nGPS UART bytes dropped: master %llu, client %llu\n", (unsigned long long)master::gpsSerial.simDropped(),
+         (unsigned long long)client::gpsSerial.simDropped());
+  printf("GPS UART bytes lost asleep: master %llu, client %llu\n", (unsigned long long)master::gpsSerial.simLostAsleep(),
+         (unsigned long long)client::gpsSerial.simLostAsleep());
+  printf("GPS receivers: master %lu baud %.0f Hz, client %lu baud %.0f Hz\n", masterReceiver.baud(),
+         1e6 / masterReceiver.period(), clientReceiver.baud(), 1e6 / clientReceiver.period());
+  printf("client LCD: [%s] [%s], %llu data writes, %llu commands\n", client::lcd.simRow(0).c_str(),
+         client::lcd.simRow(1).c_str(), (unsigned long long)client::lcd.simDataWrites(),
+         (unsigned long long)client::lcd.simCommands());
+  // Power-up to the LCD, to the first fix, and to the LCD from a live fix and a master position read
+  const std::vector<sim::Micros>& clientFixes = clientReceiver.fixTimes();
+  printf("client boot: first LCD write %.1f ms", lcdWrites.empty() ? -1.0 : lcdWrites[0] / 1000.0);
+  if (clientReceiver.aidedAt() != sim::FOREVER) {
+    printf(", GPS aided at %.2f s", clientReceiver.aidedAt() / 1e6);
+  }
+  if (clientFixes.empty() || readAt.empty()) {
+    printf(", %s\n", clientFixes.empty() ? "no fix" : "no master position");
+  } else {
+    sim::Micros ready = std::max(clientFixes[0], readAt[0]);
+    std::vector<sim::Micros>::const_iterator live = std::lower_bound(lcdWrites.begin(), lcdWrites.end(), ready);
+    printf(", first fix %.2f s, first master bytes %.2f s, live LCD %.2f s\n", clientFixes[0] / 1e6,
+           clientRx.empty() ? -1.0 : clientRx[0] / 1e6, live == lcdWrites.end() ? -1.0 : *live / 1e6);
+  }
+#if LINK_CLOCK
+  const LinkClock& clock = client::masterClock;
+  if (clock.synced()) {
+    printf("client clock: master offset %+.3f ms (true %+.3f ms), rtt min %.1f ms, mean %.1f ms\n",
+           clock.offsetUs / 1000.0, -clockOffsetMs, clock.bestRttUs / 1000.0, clock.rttMeanUs / 1000.0);
+    printf("master positions %.1f ms old on average when applied, %.1f ms at most, %lu of them aged\n",
+           client::masterAgeMeanUs / 1000.0, client::masterAgeMaxUs / 1000.0, (unsigned long)client::agedFixes);
+  } else {
+    printf("client clock: no round trip measured\n");
+  }
+#endif
+  const sim::LinkEmulator& emulator = sim::btEmulator();
+  if (emulator.impairment.any()) {
+    printf("link emulator: %llu writes, %llu lost, %llu corrupted, %llu reordered\n",
+           (unsigned long long)emulator.writes, (unsigned long long)emulator.lost,
+           (unsigned long long)emulator.corrupted, (unsigned long long)emulator.reordered);
+  }
+#if LINK_DELTA_STREAM
+  const StreamDecoder& decoder = client::frameDecoder;
+  printf("client stream: %lu fixes, %lu rebuilt, %lu lost, %lu stale, %lu CRC errors, %lu keyframe requests\n",
+         (unsigned long)decoder.frames, (unsigned long)decoder.recovered, (unsigned long)decoder.lost,
+         (unsigned long)decoder.stale, (unsigned long)decoder.crcErrors, (unsigned long)client::keyRequests);
+#endif
+  if (profile && printProfiles(masterUsb) == 0) {
+    printf("\nno profiler dump received (built with PROFILER=0?)\n");
+  }
+  if (client::gpsSerial.simLostAsleep()) {
+    printf("\nloop_bench: FAILED, the client slept through GPS bytes\n");
+    return 1;
+  }
+  return 0;
+}
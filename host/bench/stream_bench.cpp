@@ -0,0 +1,145 @@
+// Runs synthetic tracks through the delta stream in src/PositionStream.h
+// and reports:
+//   - bytes per update for walking, cycling and driving speeds, against the
+//     22-byte full frame
+//   - that every fix the decoder produces matches what was sent, with
+//     frames lost and bits flipped on the way, and how many fixes were
+//     lost to keyframe recovery
+//
+// Exits with status 1 if any check fails.
+//
+// Usage: stream_bench [--fixes N] [--loss PCT]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/PositionStream.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+struct Profile {
+  const char* name;
+  int32_t stepE6;  // Largest per-fix move in micro-degrees on each axis
+};
+
+// ~1.4 m/s, ~6 m/s and ~30 m/s at one fix per second
+static const Profile PROFILES[] = {
+  { "walking", 15 },
+  { "cycling", 60 },
+  { "driving", 300 },
+};
+
+struct Result {
+  long sent = 0;
+  long bytes = 0;
+  long decoded = 0;
+  long wrong = 0;
+  long requests = 0;
+  uint32_t keyframes = 0;
+  uint32_t gaps = 0;
+};
+
+/**
+ * @brief Streams `fixes` fixes over a link that loses `lossPct` percent of
+ * frames and corrupts one in a hundred; the client's keyframe requests
+ * reach the encoder one fix later.
+ */
+static Result run(const Profile& p, long fixes, int lossPct) {
+  StreamEncoder encoder;
+  StreamDecoder decoder;
+  Result r;
+  PositionFix fix = { 0, 42319000, -83236000, 12 * 3600000, 0, 0 };
+  bool requestPending = false;
+  for (long i = 0; i < fixes; i++) {
+    fix.seq = (uint8_t)i;
+    fix.lat_e6 += rand() % (2 * p.stepE6 + 1) - p.stepE6;
+    fix.lon_e6 += rand() % (2 * p.stepE6 + 1) - p.stepE6;
+    fix.time_ms += 1000;
+    // Velocity wanders by a few cm/s per fix, like GPS Doppler speed
+    fix.vn_cms = (int16_t)(fix.vn_cms + rand() % 7 - 3);
+    fix.ve_cms = (int16_t)(fix.ve_cms + rand() % 7 - 3);
+    if (requestPending) {
+      encoder.requestKeyframe();
+      requestPending = false;
+    }
+    uint8_t frame[FRAME_LEN];
+    size_t len = encoder.encode(fix, (uint32_t)(i * 1000), frame);
+    r.sent++;
+    r.bytes += (long)len;
+    if (rand() % 100 < lossPct) {
+      continue;
+    }
+    if (lossPct && rand() % 100 == 0) {
+      frame[rand() % len] ^= (uint8_t)(1 << (rand() % 8));
+    }
+    PositionFix out;
+    for (size_t k = 0; k < len; k++) {
+      if (decoder.push(frame[k], &out)) {
+        r.decoded++;
+        r.wrong += out.seq != fix.seq || out.lat_e6 != fix.lat_e6 || out.lon_e6 != fix.lon_e6 ||
+                   out.time_ms != fix.time_ms || abs(out.vn_cms - fix.vn_cms) > STREAM_VELOCITY_BAND ||
+                   abs(out.ve_cms - fix.ve_cms) > STREAM_VELOCITY_BAND;
+      }
+    }
+    if (decoder.needKeyframe) {
+      requestPending = true;
+      r.requests++;
+    }
+  }
+  r.keyframes = encoder.keyframes;
+  r.gaps = decoder.gaps;
+  return r;
+}
+
+int main(int argc, char** argv) {
+  long fixes = 100000;
+  int lossPct = 2;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--fixes") && i + 1 < argc) {
+      fixes = atol(argv[++i]);
+    } else if (!strcmp(argv[i], "--loss") && i + 1 < argc) {
+      lossPct = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--fixes N] [--loss PCT]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  srand(1);
+  printf("%-10s %6s %12s %10s %10s\n", "profile", "loss", "bytes/fix", "vs frame", "keyframes");
+  for (size_t i = 0; i < sizeof(PROFILES) / sizeof(PROFILES[0]); i++) {
+    Result clean = run(PROFILES[i], fixes, 0);
+    double perFix = (double)clean.bytes / clean.sent;
+    printf("%-10s %5d%% %12.2f %9.0f%% %10u\n", PROFILES[i].name, 0, perFix, 100.0 * perFix / FRAME_LEN,
+           clean.keyframes);
+    check(clean.decoded == clean.sent && clean.wrong == 0, "lossless stream decodes every fix");
+    if (PROFILES[i].stepE6 <= 60) {
+      check(perFix < 10.0, "single-digit bytes per update up to cycling speed");
+    }
+  }
+
+  printf("\n%-10s %6s %10s %10s %10s %10s %10s\n", "profile", "loss", "decoded", "wrong", "gaps", "requests",
+         "recovery");
+  for (size_t i = 0; i < sizeof(PROFILES) / sizeof(PROFILES[0]); i++) {
+    Result lossy = run(PROFILES[i], fixes, lossPct);
+    long lost = (long)(fixes * lossPct / 100.0);
+    // Fixes that arrived intact but were dropped while waiting for a keyframe
+    long recovery = lossy.sent - lossy.decoded - lost;
+    printf("%-10s %5d%% %10ld %10ld %10u %10ld %10ld\n", PROFILES[i].name, lossPct, lossy.decoded, lossy.wrong,
+           lossy.gaps, lossy.requests, recovery > 0 ? recovery : 0);
+    check(lossy.wrong == 0, "no wrong fix is ever produced");
+    check(!lossPct || lossy.gaps > 0, "losses are detected as sequence gaps");
+  }
+
+  printf("\n%s\n", failures ? "stream_bench: FAILED" : "stream_bench: all checks passed");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,152 @@
+// Runs a synthetic walk through the client's breadcrumb trail
+// (src/Breadcrumbs.h) and reports:
+//   - points kept, bytes per point and how many hours of walking the ring
+//     holds
+//   - how far the fixes the trail dropped lie from it
+//   - distance travelled and average speed against the true path
+//   - time per add() and per query
+//
+// The walk is one fix per second at walking pace with GPS noise, turns
+// every minute or two and stops of a few minutes.
+//
+// Exits with status 1 if any check fails.
+//
+// Usage: trail_bench [--hours N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "src/Breadcrumbs.h"
+
+static const size_t TRAIL_BYTES = 2048;  // Must match TRAIL_BYTES in Client_SW.c
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+static double nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Uniform in [-1, 1]
+static float noise() {
+  return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+int main(int argc, char** argv) {
+  double hours = 4;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--hours") && i + 1 < argc) {
+      hours = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--hours N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  srand(1);
+  const float speed = 1.4f;  // m/s
+  const float noiseM = 1.0f;
+  float cosLat = cosf(42.32f * GEO_DEG_TO_RAD_F);
+  double north = 0, east = 0, trueM = 0;
+  float heading = 0.7f;
+  long fixes = (long)(hours * 3600);
+  long nextTurn = 60, stopUntil = 0;
+  std::vector<TrailPoint> sent;
+  sent.reserve(fixes);
+  Breadcrumbs<TRAIL_BYTES>* trail = new Breadcrumbs<TRAIL_BYTES>();
+  double addNs = 0;
+  for (long t = 0; t < fixes; t++) {
+    if (t == nextTurn) {
+      heading += noise() * 1.5f;
+      nextTurn = t + 60 + rand() % 60;
+      if (rand() % 10 == 0) {
+        stopUntil = t + 120 + rand() % 240;
+      }
+    }
+    if (t >= stopUntil) {
+      north += speed * cosf(heading);
+      east += speed * sinf(heading);
+      trueM += speed;
+    }
+    int32_t lat = 42320000 + (int32_t)lroundf((float)(north + noise() * noiseM) * DR_E6_PER_M);
+    int32_t lon = -83235000 + (int32_t)lroundf((float)(east + noise() * noiseM) * DR_E6_PER_M / cosLat);
+    uint32_t ms = (uint32_t)(t * 1000);
+    sent.push_back({ lat, lon, ms });
+    double start = nowNs();
+    trail->add(lat, lon, ms);
+    addNs += nowNs() - start;
+  }
+
+  // Query cost, which must not depend on the trail's length
+  volatile float sink = 0;
+  double start = nowNs();
+  for (int i = 0; i < 100000; i++) {
+    sink = sink + trail->distanceM() + trail->averageSpeedMps();
+  }
+  double queryNs = (nowNs() - start) / 100000;
+
+  // Decode the trail and measure each dropped fix against the segment it falls in
+  std::vector<TrailPoint> points;
+  Breadcrumbs<TRAIL_BYTES>::Cursor cursor;
+  while (trail->next(&cursor)) {
+    points.push_back(cursor.point);
+  }
+  bool ordered = true;
+  for (size_t i = 1; i < points.size(); i++) {
+    ordered = ordered && points[i].timeMs > points[i - 1].timeMs;
+  }
+  const TrailPoint& last = points.back();
+  std::vector<float> errors;
+  size_t seg = 0;
+  for (size_t i = 0; i < sent.size() && points.size() > 1; i++) {
+    if (sent[i].timeMs < points.front().timeMs || sent[i].timeMs > points.back().timeMs) {
+      continue;
+    }
+    while (seg + 2 < points.size() && points[seg + 1].timeMs < sent[i].timeMs) {
+      seg++;
+    }
+    errors.push_back(bc_segment_distance(points[seg], points[seg + 1], sent[i]));
+  }
+  std::sort(errors.begin(), errors.end());
+  float p99 = errors.empty() ? 0 : errors[(size_t)(0.99 * (errors.size() - 1))];
+  float worst = errors.empty() ? 0 : errors.back();
+  double spanH = (points.back().timeMs - points.front().timeMs) / 3.6e6;
+  double bytesPerPoint = points.size() > 1 ? (double)trail->used / (points.size() - 1) : 0;
+
+  printf("trail_bench: %.1f h walk, %ld fixes, %zu-byte ring, tolerance %.1f m, GPS noise +-%.1f m\n\n", hours,
+         fixes, TRAIL_BYTES, BC_TOLERANCE_M, noiseM);
+  printf("trail: %zu points in %zu bytes, %.2f bytes per point, covering the last %.2f h\n", points.size(),
+         trail->used, bytesPerPoint, spanH);
+  printf("dropped fixes from the trail: p99 %.2f m, max %.2f m\n", p99, worst);
+  printf("distance: %.0f m, true %.0f m (%+.1f%%); average speed %.2f m/s, true %.2f m/s\n", trail->distanceM(),
+         trueM, 100.0 * (trail->distanceM() - trueM) / trueM, trail->averageSpeedMps(),
+         trueM / fixes);
+  printf("add(): %.0f ns mean, distance and speed query: %.1f ns\n", addNs / fixes, queryNs);
+
+  check(ordered, "trail points decode in time order");
+  check(last.lat_e6 == trail->anchor.lat_e6 && last.lon_e6 == trail->anchor.lon_e6 &&
+            last.timeMs == trail->anchor.timeMs,
+        "decoded trail ends at the anchor");
+  check(p99 <= BC_TOLERANCE_M, "99% of dropped fixes within the tolerance");
+  check(bytesPerPoint < 6.0, "under 6 bytes per point at walking pace");
+  check(hours < 2 || spanH >= 2.0, "the ring holds at least 2 h of walking");
+  check(fabs(trail->distanceM() - trueM) < 0.05 * trueM, "distance within 5% of the true path");
+
+  printf("\n%s\n", failures ? "trail_bench: FAILED" : "trail_bench: all checks passed");
+  delete trail;
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,24 @@
+set(ARDUINO_SKETCH_GENERATOR ${CMAKE_CURRENT_LIST_DIR}/GenerateSketch.cmake)
+
+# arduino_sketch_source(<out-var> <sketch> [NAMESPACE <name>])
+#
+# Generates a compilable C++ source for an Arduino sketch and stores its
+# path in <out-var>. See GenerateSketch.cmake.
+function(arduino_sketch_source out_var sketch)
+  cmake_parse_arguments(ARG "" "NAMESPACE" "" ${ARGN})
+  get_filename_component(name ${sketch} NAME_WE)
+  if(ARG_NAMESPACE)
+    set(generated ${CMAKE_CURRENT_BINARY_DIR}/sketches/${name}.${ARG_NAMESPACE}.cpp)
+  else()
+    set(generated ${CMAKE_CURRENT_BINARY_DIR}/sketches/${name}.cpp)
+  endif()
+  add_custom_command(
+    OUTPUT ${generated}
+    COMMAND ${CMAKE_COMMAND} -DSKETCH=${sketch} -DOUTPUT=${generated} -DNAMESPACE=${ARG_NAMESPACE}
+            -P ${ARDUINO_SKETCH_GENERATOR}
+    DEPENDS ${sketch} ${ARDUINO_SKETCH_GENERATOR}
+    COMMENT "Generating Arduino prototypes for ${name}"
+    VERBATIM)
+  set_source_files_properties(${generated} PROPERTIES COMPILE_OPTIONS "-Wno-write-strings")
+  set(${out_var} ${generated} PARENT_SCOPE)
+endfunction()
@@ -0,0 +1,65 @@
+# Turns an Arduino sketch into a C++ translation unit, the way the Arduino
+# builder does: prototypes for every top-level function are inserted before
+# the first function definition so functions can be called before they are
+# defined.
+#
+# With NAMESPACE set, the sketch body is wrapped in that namespace so two
+# sketches can be linked into one program. Every #include of the sketch is
+# hoisted above the namespace; the copies left inside are no-ops thanks to
+# include guards.
+#
+# Usage: cmake -DSKETCH=<file> -DOUTPUT=<file> [-DNAMESPACE=<name>] -P GenerateSketch.cmake
+
+file(READ "${SKETCH}" body)
+set(text "\n${body}")
+
+string(REGEX MATCHALL "\n[A-Za-z_][^\n;(){}#=]*[ \t*&][A-Za-z_][A-Za-z0-9_]*\\([^\n;{}]*\\)[ \t]*{" defs "${text}")
+
+set(prototypes "")
+set(first "")
+foreach(def IN LISTS defs)
+  string(REGEX REPLACE "^\n" "" proto "${def}")
+  string(REGEX REPLACE "[ \t]*{$" ";" proto "${proto}")
+  string(REGEX MATCH "([A-Za-z_][A-Za-z0-9_]*)\\(" name "${proto}")
+  if(name MATCHES "^(if|while|for|switch|return|sizeof)\\($")
+    continue()
+  endif()
+  if(first STREQUAL "")
+    set(first "${def}")
+  endif()
+  string(APPEND prototypes "${proto}\n")
+endforeach()
+
+set(out "// Generated from ${SKETCH} by GenerateSketch.cmake; do not edit.\n#include <Arduino.h>\n")
+if(NAMESPACE)
+  string(REGEX MATCHALL "\n[ \t]*#[ \t]*include[^\n]*" includes "${text}")
+  foreach(inc IN LISTS includes)
+    string(APPEND out "${inc}")
+  endforeach()
+  string(APPEND out "\nnamespace ${NAMESPACE} {\n")
+endif()
+
+if(first STREQUAL "")
+  string(APPEND out "#line 1 \"${SKETCH}\"\n${body}")
+else()
+  string(FIND "${text}" "${first}" pos)
+  math(EXPR split "${pos} + 1")
+  string(SUBSTRING "${text}" 1 ${pos} head)
+  string(SUBSTRING "${text}" ${split} -1 tail)
+  string(REGEX REPLACE "[^\n]" "" newlines "${head}")
+  string(LENGTH "${newlines}" line)
+  math(EXPR line "${line} + 1")
+  string(APPEND out "#line 1 \"${SKETCH}\"\n${head}${prototypes}#line ${line} \"${SKETCH}\"\n${tail}")
+endif()
+
+if(NAMESPACE)
+  string(APPEND out "\n}  // namespace ${NAMESPACE}\n")
+endif()
+
+if(EXISTS "${OUTPUT}")
+  file(READ "${OUTPUT}" previous)
+  if(previous STREQUAL out)
+    return()
+  endif()
+endif()
+file(WRITE "${OUTPUT}" "${out}")
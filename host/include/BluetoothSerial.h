@@ -0,0 +1,77 @@
+#ifndef BLUETOOTHSERIAL_H
+#define BLUETOOTHSERIAL_H
+
+#include <functional>
+
+#include "Arduino.h"
+#include "esp_spp_api.h"
+
+/**
+ * @brief SPP stand-in that links endpoints through the simulator.
+ *
+ * A master's connect() finds a listening slave whose device address
+ * matches, blocks for the configured connect time and then raises the
+ * usual open events on both sides. Writes reach the peer after the
+ * configured air latency and land in a 512-byte receive queue; a
+ * registered callback also gets ESP_SPP_DATA_IND_EVT for them.
+ *
+ * The raw esp_spp_* calls in esp_spp_api.h create initiator endpoints of
+ * this class internally, one per handle, that report through the device's
+ * registered esp_spp callback instead of a receive queue.
+ */
+class BluetoothSerial : public Stream {
+ public:
+  BluetoothSerial();
+  ~BluetoothSerial();
+
+  bool begin(String localName = String(), bool isMaster = false);
+  void end();
+  esp_err_t register_callback(esp_spp_cb_t callback);
+
+  bool connect(String remoteName);
+  bool connect(uint8_t remoteAddress[], int channel = 0, esp_spp_sec_t sec_mask = ESP_SPP_SEC_NONE,
+               esp_spp_role_t role = ESP_SPP_ROLE_MASTER);
+  bool connect();
+  bool connected(int timeout = 0);
+  bool hasClient();
+  bool disconnect();
+  bool isReady(bool checkMaster = false, int timeout = 0);
+
+  int available() override;
+  int peek() override;
+  int read() override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  void flush() override;
+
+  // Host-only introspection
+  sim::Device* simDevice() const { return owner_; }
+  BluetoothSerial* simPeer() const { return peer_; }
+  const String& simName() const { return name_; }
+  uint64_t simDropped() const { return rx_.dropped; }
+  uint32_t simHandle() const { return handle_; }
+
+ private:
+  void link(BluetoothSerial* peer);
+  void unlink();
+  void raise(esp_spp_cb_event_t event, esp_spp_status_t status = ESP_SPP_SUCCESS);
+  void raiseData(sim::Micros at, const uint8_t* data, size_t len);
+
+  friend esp_err_t esp_spp_connect(esp_spp_sec_t, esp_spp_role_t, uint8_t, esp_bd_addr_t);
+  friend esp_err_t esp_spp_disconnect(uint32_t);
+  friend esp_err_t esp_spp_write(uint32_t, int, uint8_t*);
+
+  sim::Device* owner_ = nullptr;
+  String name_;
+  bool begun_ = false;
+  bool isMaster_ = false;
+  BluetoothSerial* peer_ = nullptr;
+  uint8_t lastRemote_[6] = { 0 };
+  esp_spp_cb_t callback_ = nullptr;
+  uint32_t handle_ = 0;
+  bool raw_ = false;  // Created by esp_spp_connect(); received data raises ESP_SPP_DATA_IND_EVT
+  sim::RxQueue rx_;
+};
+
+#endif
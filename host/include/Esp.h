@@ -0,0 +1,19 @@
+#ifndef ESP_H
+#define ESP_H
+
+#include <stdint.h>
+
+class EspClass {
+ public:
+  void restart();
+  uint32_t getHeapSize();
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  uint32_t getCpuFreqMHz() { return 240; }
+  uint32_t getCycleCount();
+};
+
+extern EspClass ESP;
+
+#endif
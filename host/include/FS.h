@@ -0,0 +1,65 @@
+#ifndef FS_H
+#define FS_H
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+
+#include "Stream.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+/**
+ * @brief File on the simulated flash, backed by a host file.
+ *
+ * Writes are charged as busy time: one Config::flashSectorUs for every
+ * flash sector (4 KB) they start.
+ */
+class File : public Stream {
+ public:
+  File() {}
+  File(FILE* f, const std::string& path);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t* buffer, size_t size);
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  void flush() override;
+
+  size_t size() const;
+  const char* path() const { return path_.c_str(); }
+  void close();
+  operator bool() const { return file_ != nullptr; }
+
+ private:
+  std::shared_ptr<FILE> file_;
+  std::string path_;
+  size_t written_ = 0;  // Bytes written through this handle, to find sector starts
+  size_t start_ = 0;    // File size when it was opened
+};
+
+class FS {
+ public:
+  File open(const char* path, const char* mode = FILE_READ, const bool create = false);
+  bool exists(const char* path);
+  bool remove(const char* path);
+
+ protected:
+  // Host path of a flash path, or empty if the device has no flash
+  std::string hostPath(const char* path);
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef HARDWARESERIAL_H
+#define HARDWARESERIAL_H
+
+#include <functional>
+
+#include "Stream.h"
+#include "sim/Sim.h"
+
+#define SERIAL_8N1 0x800001c
+
+typedef std::function<void(void)> OnReceiveCb;
+
+/**
+ * @brief UART stand-in backed by the simulator.
+ *
+ * Received bytes are scheduled with simFeed() at wire speed and land in a
+ * bounded receive buffer; anything that arrives while it is full is lost,
+ * and so is anything that arrives while the device light-sleeps. If the RX
+ * pin is a wake-up source (driver/gpio.h), the first byte of each burst
+ * wakes the device. UART 0 is the USB Serial port and keeps separate state
+ * per device.
+ */
+class HardwareSerial : public Stream {
+ public:
+  explicit HardwareSerial(int uart_nr);
+
+  void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1,
+             bool invert = false, unsigned long timeout_ms = 20000UL, uint8_t rxfifo_full_thrhd = 112);
+  void end();
+  void updateBaudRate(unsigned long baud);
+  unsigned long baudRate();
+  size_t setRxBufferSize(size_t new_size);
+  void onReceive(OnReceiveCb function, bool onlyOnTimeout = false);
+
+  int available() override;
+  int peek() override;
+  int read() override;
+  size_t read(uint8_t* buffer, size_t size);
+  void flush() override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  int availableForWrite();
+  operator bool() const { return true; }
+
+  // Host-only: schedules bytes on the RX pin starting at `start`, at `baud`
+  void simFeed(const uint8_t* data, size_t len, sim::Micros start, unsigned long baud);
+  // Host-only: called with every block the sketch transmits
+  std::function<void(const uint8_t*, size_t)> simOnTx;
+  uint64_t simDropped() { return rx().dropped; }
+  uint64_t simLostAsleep() { return rx().lostAsleep; }
+  // Host-only: false = bytes arriving during light sleep are kept
+  void simSetSleepLoses(bool loses) { rx().sleepLoses = loses; }
+  // Host-only: withdraws bytes scheduled to arrive at or after `from`
+  void simCancelFrom(sim::Micros from);
+  // Host-only: called when the sketch changes the baud rate
+  std::function<void(unsigned long)> simOnBaud;
+
+ private:
+  sim::RxQueue& rx();
+  sim::TxFifo& tx();
+  void scheduleRxEvents();
+
+  int uart_nr_;
+  sim::Device* owner_ = nullptr;
+  sim::RxQueue rx_;
+  sim::TxFifo tx_;
+  size_t rxBufferSize_ = 256;
+  OnReceiveCb onReceive_;
+  bool onlyOnTimeout_ = false;
+  uint8_t rxThreshold_ = 112;
+  int8_t rxPin_ = -1;
+  sim::Micros lastFedAt_ = 0;
+  sim::Micros eventsThrough_ = 0;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef LIQUIDCRYSTAL_H
+#define LIQUIDCRYSTAL_H
+
+#include "Arduino.h"
+
+#define LCD_5x8DOTS 0x00
+#define LCD_5x10DOTS 0x04
+
+/**
+ * @brief HD44780 stand-in in 4-bit mode.
+ *
+ * Keeps a copy of display RAM so tests can read back what is shown, and
+ * charges the same busy-wait time per bus transfer as the Arduino library
+ * (two enable pulses of ~100 us each, plus 2 ms for clear/home).
+ */
+class LiquidCrystal : public Print {
+ public:
+  LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3);
+
+  void begin(uint8_t cols, uint8_t rows, uint8_t charsize = LCD_5x8DOTS);
+  void clear();
+  void home();
+  void noDisplay();
+  void display();
+  void noCursor();
+  void cursor();
+  void noBlink();
+  void blink();
+  void setCursor(uint8_t col, uint8_t row);
+  void createChar(uint8_t location, uint8_t charmap[]);
+  void command(uint8_t value);
+  size_t write(uint8_t value) override;
+  using Print::write;
+
+  // Host-only introspection
+  String simRow(uint8_t row) const;
+  uint64_t simDataWrites() const { return dataWrites_; }
+  uint64_t simCommands() const { return commands_; }
+
+ private:
+  void send(uint8_t value, bool isData);
+
+  uint8_t cols_ = 16;
+  uint8_t rows_ = 2;
+  uint8_t addr_ = 0;
+  bool cgram_ = false;
+  char ddram_[128];
+  uint64_t dataWrites_ = 0;
+  uint64_t commands_ = 0;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef LITTLEFS_H
+#define LITTLEFS_H
+
+#include "FS.h"
+
+namespace fs {
+
+/**
+ * @brief LittleFS partition of the current device, kept in the host
+ * directory set in sim::Device::flashDir.
+ *
+ * begin() fails on a device without one, like a firmware without a
+ * LittleFS partition.
+ */
+class LittleFSFS : public FS {
+ public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+             const char* partitionLabel = "spiffs");
+  void end() {}
+  size_t totalBytes();
+  size_t usedBytes();
+};
+
+}  // namespace fs
+
+extern fs::LittleFSFS LittleFS;
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef PREFERENCES_H
+#define PREFERENCES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+/**
+ * @brief NVS key-value storage of the current device, as in the ESP32
+ * Arduino core; only the byte-blob calls are provided.
+ *
+ * Keys live in memory for the life of the device. With
+ * sim::Device::flashDir set they are also kept as files in its `nvs`
+ * subdirectory, one per namespace and key, so they survive into the next
+ * run like NVS survives a power cycle. Each put is charged
+ * Config::nvsWriteUs of busy time.
+ */
+class Preferences {
+ public:
+  bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+  void end();
+  bool clear();
+  bool remove(const char* key);
+  bool isKey(const char* key);
+  size_t putBytes(const char* key, const void* value, size_t len);
+  size_t getBytesLength(const char* key);
+  size_t getBytes(const char* key, void* buf, size_t maxLen);
+
+ private:
+  std::string name_;
+  bool open_ = false;
+  bool readOnly_ = false;
+};
+
+#endif
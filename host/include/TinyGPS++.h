@@ -0,0 +1,204 @@
+#ifndef TINYGPSPLUS_MOCK_H
+#define TINYGPSPLUS_MOCK_H
+
+#include "Arduino.h"
+
+/*
+ * Host re-implementation of the TinyGPS++ API subset the sketches use.
+ * Parses $--RMC and $--GGA with checksum validation and follows the
+ * library's commit/updated semantics: values become visible when a
+ * sentence with a valid checksum ends, and reading lat()/lng() or the time
+ * fields clears the matching updated flag.
+ */
+
+#define _GPS_MAX_FIELD_SIZE 15
+#define _GPS_KMPH_PER_KNOT 1.852
+#define _GPS_MPH_PER_KNOT 1.15077945
+#define _GPS_MPS_PER_KNOT 0.51444444
+#define _GPS_EARTH_RADIUS 6372795
+
+struct RawDegrees {
+  uint16_t deg;
+  uint32_t billionths;
+  bool negative;
+
+ public:
+  RawDegrees() : deg(0), billionths(0), negative(false) {}
+};
+
+struct TinyGPSLocation {
+  friend class TinyGPSPlus;
+
+ public:
+  bool isValid() const { return valid; }
+  bool isUpdated() const { return updated; }
+  uint32_t age() const { return valid ? millis() - lastCommitTime : (uint32_t)ULONG_MAX; }
+  const RawDegrees& rawLat() { updated = false; return rawLatData; }
+  const RawDegrees& rawLng() { updated = false; return rawLngData; }
+  double lat();
+  double lng();
+
+  TinyGPSLocation() : valid(false), updated(false), lastCommitTime(0) {}
+
+ private:
+  bool valid, updated;
+  RawDegrees rawLatData, rawLngData, rawNewLatData, rawNewLngData;
+  uint32_t lastCommitTime;
+  void commit();
+  void setLatitude(const char* term);
+  void setLongitude(const char* term);
+};
+
+struct TinyGPSDate {
+  friend class TinyGPSPlus;
+
+ public:
+  bool isValid() const { return valid; }
+  bool isUpdated() const { return updated; }
+  uint32_t age() const { return valid ? millis() - lastCommitTime : (uint32_t)ULONG_MAX; }
+  uint32_t value() { updated = false; return date; }
+  uint16_t year();
+  uint8_t month();
+  uint8_t day();
+
+  TinyGPSDate() : valid(false), updated(false), date(0), newDate(0), lastCommitTime(0) {}
+
+ private:
+  bool valid, updated;
+  uint32_t date, newDate;
+  uint32_t lastCommitTime;
+  void commit();
+  void setDate(const char* term);
+};
+
+struct TinyGPSTime {
+  friend class TinyGPSPlus;
+
+ public:
+  bool isValid() const { return valid; }
+  bool isUpdated() const { return updated; }
+  uint32_t age() const { return valid ? millis() - lastCommitTime : (uint32_t)ULONG_MAX; }
+  uint32_t value() { updated = false; return time; }
+  uint8_t hour();
+  uint8_t minute();
+  uint8_t second();
+  uint8_t centisecond();
+
+  TinyGPSTime() : valid(false), updated(false), time(0), newTime(0), lastCommitTime(0) {}
+
+ private:
+  bool valid, updated;
+  uint32_t time, newTime;
+  uint32_t lastCommitTime;
+  void commit();
+  void setTime(const char* term);
+};
+
+struct TinyGPSDecimal {
+  friend class TinyGPSPlus;
+
+ public:
+  bool isValid() const { return valid; }
+  bool isUpdated() const { return updated; }
+  uint32_t age() const { return valid ? millis() - lastCommitTime : (uint32_t)ULONG_MAX; }
+  int32_t value() { updated = false; return val; }
+
+  TinyGPSDecimal() : valid(false), updated(false), lastCommitTime(0), val(0), newval(0) {}
+
+ private:
+  bool valid, updated;
+  uint32_t lastCommitTime;
+  int32_t val, newval;
+  void commit();
+  void set(const char* term);
+};
+
+struct TinyGPSInteger {
+  friend class TinyGPSPlus;
+
+ public:
+  bool isValid() const { return valid; }
+  bool isUpdated() const { return updated; }
+  uint32_t age() const { return valid ? millis() - lastCommitTime : (uint32_t)ULONG_MAX; }
+  uint32_t value() { updated = false; return val; }
+
+  TinyGPSInteger() : valid(false), updated(false), lastCommitTime(0), val(0), newval(0) {}
+
+ private:
+  bool valid, updated;
+  uint32_t lastCommitTime;
+  uint32_t val, newval;
+  void commit();
+  void set(const char* term);
+};
+
+struct TinyGPSSpeed : TinyGPSDecimal {
+  double knots() { return value() / 100.0; }
+  double mph() { return _GPS_MPH_PER_KNOT * value() / 100.0; }
+  double mps() { return _GPS_MPS_PER_KNOT * value() / 100.0; }
+  double kmph() { return _GPS_KMPH_PER_KNOT * value() / 100.0; }
+};
+
+struct TinyGPSCourse : public TinyGPSDecimal {
+  double deg() { return value() / 100.0; }
+};
+
+struct TinyGPSAltitude : TinyGPSDecimal {
+  double meters() { return value() / 100.0; }
+  double feet() { return 3.2808399 * value() / 100.0; }
+};
+
+struct TinyGPSHDOP : TinyGPSDecimal {
+  double hdop() { return value() / 100.0; }
+};
+
+class TinyGPSPlus {
+ public:
+  TinyGPSPlus();
+  bool encode(char c);
+  TinyGPSPlus& operator<<(char c) { encode(c); return *this; }
+
+  TinyGPSLocation location;
+  TinyGPSDate date;
+  TinyGPSTime time;
+  TinyGPSSpeed speed;
+  TinyGPSCourse course;
+  TinyGPSAltitude altitude;
+  TinyGPSInteger satellites;
+  TinyGPSHDOP hdop;
+
+  static const char* libraryVersion() { return "1.0.3-host"; }
+
+  static double distanceBetween(double lat1, double long1, double lat2, double long2);
+  static double courseTo(double lat1, double long1, double lat2, double long2);
+  static const char* cardinal(double course);
+
+  static int32_t parseDecimal(const char* term);
+  static void parseDegrees(const char* term, RawDegrees& deg);
+
+  uint32_t charsProcessed() const { return encodedCharCount; }
+  uint32_t sentencesWithFix() const { return sentencesWithFixCount; }
+  uint32_t failedChecksum() const { return failedChecksumCount; }
+  uint32_t passedChecksum() const { return passedChecksumCount; }
+
+ private:
+  enum { GPS_SENTENCE_GGA, GPS_SENTENCE_RMC, GPS_SENTENCE_OTHER };
+
+  uint8_t parity;
+  bool isChecksumTerm;
+  char term[_GPS_MAX_FIELD_SIZE];
+  uint8_t curSentenceType;
+  uint8_t curTermNumber;
+  uint8_t curTermOffset;
+  bool sentenceHasFix;
+
+  uint32_t encodedCharCount;
+  uint32_t sentencesWithFixCount;
+  uint32_t failedChecksumCount;
+  uint32_t passedChecksumCount;
+
+  int fromHex(char a);
+  bool endOfTermHandler();
+};
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef TINYGPSPLUS_H
+#define TINYGPSPLUS_H
+
+#include "TinyGPS++.h"
+
+#endif
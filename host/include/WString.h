@@ -0,0 +1,68 @@
+#ifndef WSTRING_H
+#define WSTRING_H
+
+#include <string>
+
+#include "sim/Heap.h"
+
+// Heap-backed String with the subset of the Arduino API the sketches use. Its
+// storage is charged to the simulated device's heap (sim/Heap.h).
+class String {
+ public:
+  typedef std::basic_string<char, std::char_traits<char>, sim::HeapAllocator<char>> Storage;
+
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  String(const std::string& s) : s_(s.data(), s.size()) {}
+  String(const Storage& s) : s_(s) {}
+  String(char c) : s_(1, c) {}
+  String(int value, unsigned char base = 10);
+  String(unsigned int value, unsigned char base = 10);
+  String(long value, unsigned char base = 10);
+  String(unsigned long value, unsigned char base = 10);
+  String(float value, unsigned int decimalPlaces = 2);
+  String(double value, unsigned int decimalPlaces = 2);
+
+  const char* c_str() const { return s_.c_str(); }
+  unsigned int length() const { return (unsigned int)s_.length(); }
+  bool isEmpty() const { return s_.empty(); }
+  void reserve(unsigned int size) { s_.reserve(size); }
+
+  char charAt(unsigned int index) const { return index < s_.length() ? s_[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+
+  int indexOf(char ch, unsigned int fromIndex = 0) const;
+  int indexOf(const String& str, unsigned int fromIndex = 0) const;
+  int lastIndexOf(char ch) const;
+  String substring(unsigned int beginIndex) const;
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+  bool startsWith(const String& prefix) const;
+  bool endsWith(const String& suffix) const;
+  void trim();
+  void toUpperCase();
+  void toLowerCase();
+
+  long toInt() const;
+  float toFloat() const;
+  double toDouble() const;
+
+  bool equals(const String& other) const { return s_ == other.s_; }
+  bool operator==(const String& other) const { return s_ == other.s_; }
+  bool operator==(const char* other) const { return s_ == (other ? other : ""); }
+  bool operator!=(const String& other) const { return s_ != other.s_; }
+
+  String& operator+=(const String& rhs) { s_ += rhs.s_; return *this; }
+  String& operator+=(const char* rhs) { s_ += rhs ? rhs : ""; return *this; }
+  String& operator+=(char rhs) { s_ += rhs; return *this; }
+  bool concat(const String& rhs) { s_ += rhs.s_; return true; }
+
+  friend String operator+(const String& lhs, const String& rhs) { return String(lhs.s_ + rhs.s_); }
+  friend String operator+(const String& lhs, const char* rhs) { return String(lhs.s_ + (rhs ? rhs : "")); }
+  friend String operator+(const char* lhs, const String& rhs) { return String((lhs ? lhs : "") + rhs.s_); }
+  friend String operator+(const String& lhs, char rhs) { return String(lhs.s_ + rhs); }
+
+ private:
+  Storage s_;
+};
+
+#endif
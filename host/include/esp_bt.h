@@ -0,0 +1,9 @@
+#ifndef ESP_BT_H
+#define ESP_BT_H
+
+#include "esp_err.h"
+
+// Controller modem sleep between the link's sniff/poll slots; accepted and ignored
+esp_err_t esp_bt_sleep_enable();
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef ESP_BT_DEVICE_H
+#define ESP_BT_DEVICE_H
+
+#include "esp_bt_defs.h"
+
+esp_err_t esp_bt_dev_set_device_name(const char* name);
+// Address of the calling device
+const uint8_t* esp_bt_dev_get_address();
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef ESP_BT_MAIN_H
+#define ESP_BT_MAIN_H
+
+#include "esp_bt_defs.h"
+
+typedef enum {
+  ESP_BLUEDROID_STATUS_UNINITIALIZED = 0,
+  ESP_BLUEDROID_STATUS_INITIALIZED,
+  ESP_BLUEDROID_STATUS_ENABLED,
+} esp_bluedroid_status_t;
+
+// Bluedroid host stack bring-up; the simulated stack is always available
+esp_bluedroid_status_t esp_bluedroid_get_status();
+esp_err_t esp_bluedroid_init();
+esp_err_t esp_bluedroid_enable();
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef ESP_SLEEP_H
+#define ESP_SLEEP_H
+
+#include "esp_err.h"
+
+// Arms the pins set up with gpio_wakeup_enable() as light-sleep wake-up sources
+esp_err_t esp_sleep_enable_gpio_wakeup();
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef ESP_SPP_API_H
+#define ESP_SPP_API_H
+
+#include <stdint.h>
+
+#include "esp_bt_defs.h"
+
+/*
+ * Handle-based SPP API of the ESP-IDF Bluedroid stack, as used directly by
+ * firmware that needs more than the one link BluetoothSerial manages.
+ *
+ * Connections are simulated with the same endpoints as BluetoothSerial, so
+ * a raw initiator can reach a BluetoothSerial acceptor. Every call returns
+ * at once; results arrive as events on the device's system task.
+ */
+
+typedef enum {
+  ESP_SPP_SUCCESS = 0,
+  ESP_SPP_FAILURE,
+  ESP_SPP_BUSY,
+  ESP_SPP_NO_DATA,
+  ESP_SPP_NO_RESOURCE,
+  ESP_SPP_NEED_INIT,
+  ESP_SPP_NEED_DEINIT,
+  ESP_SPP_NO_CONNECTION,
+  ESP_SPP_NO_SERVER,
+} esp_spp_status_t;
+
+typedef enum {
+  ESP_SPP_INIT_EVT = 0,
+  ESP_SPP_UNINIT_EVT = 1,
+  ESP_SPP_DISCOVERY_COMP_EVT = 8,
+  ESP_SPP_OPEN_EVT = 26,
+  ESP_SPP_CLOSE_EVT = 27,
+  ESP_SPP_START_EVT = 28,
+  ESP_SPP_CL_INIT_EVT = 29,
+  ESP_SPP_DATA_IND_EVT = 30,
+  ESP_SPP_CONG_EVT = 31,
+  ESP_SPP_WRITE_EVT = 33,
+  ESP_SPP_SRV_OPEN_EVT = 34,
+  ESP_SPP_SRV_STOP_EVT = 35,
+} esp_spp_cb_event_t;
+
+typedef union {
+  struct {
+    esp_spp_status_t status;
+  } init;
+  struct {
+    esp_spp_status_t status;
+    uint32_t handle;
+    int fd;
+    esp_bd_addr_t rem_bda;
+  } open;
+  struct {
+    esp_spp_status_t status;
+    uint32_t handle;
+    uint32_t new_listen_handle;
+    int fd;
+    esp_bd_addr_t rem_bda;
+  } srv_open;
+  struct {
+    esp_spp_status_t status;
+    uint32_t port_status;
+    uint32_t handle;
+    bool async;
+  } close;
+  struct {
+    esp_spp_status_t status;
+    uint32_t handle;
+    uint8_t sec_id;
+    bool use_co;
+  } cl_init;
+  struct {
+    esp_spp_status_t status;
+    uint32_t handle;
+    int len;
+    bool cong;
+  } write;
+  struct {
+    esp_spp_status_t status;
+    uint32_t handle;
+    uint16_t len;
+    uint8_t* data;
+  } data_ind;
+  struct {
+    esp_spp_status_t status;
+    uint32_t handle;
+    bool cong;
+  } cong;
+} esp_spp_cb_param_t;
+
+typedef void (*esp_spp_cb_t)(esp_spp_cb_event_t event, esp_spp_cb_param_t* param);
+
+typedef enum {
+  ESP_SPP_ROLE_MASTER = 0,
+  ESP_SPP_ROLE_SLAVE = 1,
+} esp_spp_role_t;
+
+typedef enum {
+  ESP_SPP_MODE_CB = 0,
+  ESP_SPP_MODE_VFS = 1,
+} esp_spp_mode_t;
+
+#define ESP_SPP_SEC_NONE 0x0000
+typedef uint16_t esp_spp_sec_t;
+
+esp_err_t esp_spp_register_callback(esp_spp_cb_t callback);
+// Raises ESP_SPP_INIT_EVT
+esp_err_t esp_spp_init(esp_spp_mode_t mode);
+// Raises ESP_SPP_CL_INIT_EVT with the new handle, then ESP_SPP_OPEN_EVT once
+// the peer accepts or ESP_SPP_CLOSE_EVT with a failure status after the
+// page timeout
+esp_err_t esp_spp_connect(esp_spp_sec_t sec_mask, esp_spp_role_t role, uint8_t remote_scn, esp_bd_addr_t peer_bd_addr);
+esp_err_t esp_spp_disconnect(uint32_t handle);
+// Copies the data and raises ESP_SPP_WRITE_EVT
+esp_err_t esp_spp_write(uint32_t handle, int len, uint8_t* p_data);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+// Subset of the ESP32 Arduino sdkconfig that the sketches check for
+#define CONFIG_IDF_TARGET_ESP32 1
+#define CONFIG_BT_ENABLED 1
+#define CONFIG_BLUEDROID_ENABLED 1
+#define CONFIG_BT_SPP_ENABLED 1
+#define CONFIG_FREERTOS_HZ 1000
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef SIM_GPSRECEIVER_H
+#define SIM_GPSRECEIVER_H
+
+#include <stdint.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "HardwareSerial.h"
+#include "sim/NmeaFeed.h"
+#include "sim/Sim.h"
+
+namespace sim {
+
+/**
+ * @brief GPS receiver that plays a recording into a UART and takes
+ * configuration commands from the sketch.
+ *
+ * It starts at 9600 baud, one fix a second, with every sentence of the
+ * recording enabled. Depending on its command set it understands PMTK
+ * (314 sentence filter, 220 fix interval, 251 baud) or UBX (CFG-MSG,
+ * CFG-RATE, CFG-PRT) and acknowledges them like the real modules; the
+ * NMEA-only kind ignores everything. Fixes between recorded seconds are
+ * interpolated. While the UART and the receiver disagree on the baud, each
+ * side only sees garbage from the other. An epoch that cannot start within
+ * one fix interval because the line is still busy is dropped.
+ *
+ * With setTimeToFix() it also models acquisition: until the first fix, RMC
+ * and GGA go out without a position (status V, quality 0). Aiding, a
+ * PMTK741 or UBX MGA-INI-POS_LLH, brings the first fix forward to the
+ * aided time to fix after it arrives.
+ */
+class GpsReceiver {
+ public:
+  enum Commands { NMEA_ONLY, MTK, UBX };
+
+  GpsReceiver(const NmeaFeed& feed, HardwareSerial& port, Device& device, Commands commands);
+
+  // Starts emitting the recording at virtual time `at`
+  void start(Micros at);
+
+  /**
+   * @brief Sets the time from start() to the first fix; call before start().
+   *
+   * @param coldUs Without aiding; 0, the default, has fixes from the start.
+   * @param aidedUs From the aiding message, if one arrives earlier.
+   */
+  void setTimeToFix(Micros coldUs, Micros aidedUs);
+  // When the first fix is due, as things stand
+  Micros firstFixAt() const { return firstFix_; }
+  // When aiding arrived, or FOREVER
+  Micros aidedAt() const { return aidedAt_; }
+
+  /**
+   * @brief Per epoch sent, the virtual time at which its first position
+   * sentence (RMC or GGA) has fully arrived, i.e. when the fix becomes
+   * available to the parser.
+   */
+  const std::vector<Micros>& fixTimes() const { return fixTimes_; }
+  unsigned long baud() const { return baud_; }
+  Micros period() const { return period_; }
+
+  static bool parseCommands(const char* name, Commands* out);
+
+ private:
+  void scheduleEpoch(Micros at);
+  void emitEpoch(Micros at);
+  void feed(const std::string& bytes, Micros at, std::vector<size_t>* lineEnds);
+  void restart(Micros from, const std::string& reply);
+  void onTx(const uint8_t* data, size_t len);
+  void mtkCommand(const std::string& sentence, Micros at);
+  void ubxCommand(const std::string& frame, Micros at);
+  void aid(Micros at);
+  std::string sentence(const std::string& line, size_t nextLine, double frac) const;
+
+  const NmeaFeed& feed_;
+  HardwareSerial& port_;
+  Device& device_;
+  Commands commands_;
+  unsigned long baud_ = 9600;
+  Micros period_ = 1000000;
+  Micros start_ = 0;
+  Micros lineFree_ = 0;            // When the receiver's TX line is next idle
+  Micros coldUs_ = 0;              // Time to first fix without aiding
+  Micros aidedUs_ = 0;             // And from aiding
+  Micros firstFix_ = 0;            // Epochs before this have no position
+  Micros aidedAt_ = FOREVER;
+  uint64_t generation_ = 0;        // Invalidates posted epochs after a rate change
+  std::set<std::string> disabled_; // Sentence types switched off, e.g. "GSV"
+  std::vector<Micros> fixTimes_;
+  std::vector<Micros> lineStarts_; // Start of each sentence still pending, to cut between sentences
+  std::string command_;            // Command bytes received so far
+};
+
+}  // namespace sim
+
+#endif
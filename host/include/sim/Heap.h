@@ -0,0 +1,89 @@
+#ifndef SIM_HEAP_H
+#define SIM_HEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+/*
+ * Heap model of a simulated ESP32.
+ *
+ * The host has no ESP32 heap, so each Device keeps figures that start at
+ * those of a freshly booted Bluetooth-enabled sketch and move with the
+ * allocations the ESP32 core would make on the device's behalf: String
+ * storage and Print::printf() lines longer than its 64-byte stack buffer.
+ * Every block costs its size rounded up to 4 bytes plus a block header, as
+ * in multi_heap. Fragmentation is not modelled; the largest free block is
+ * the free heap less what the Bluetooth stack fragments at boot.
+ *
+ * heap_watch_arm() of src/HeapWatch.h starts counting the allocations made
+ * by the tasks it names, and optionally stops the program at the first.
+ */
+namespace sim {
+
+struct Task;
+
+struct HeapModel {
+  static const uint32_t SIZE = 327680;
+  static const uint32_t BOOT_FREE = 180000;
+  static const uint32_t BOOT_MIN_FREE = 170000;  // Bluetooth start-up dips below the steady state
+  static const uint32_t FRAGMENTED = 69420;       // Free but not in the largest block, after boot
+  static const uint32_t BLOCK_HEADER = 8;
+  static const size_t WATCH_TASKS = 8;           // As HEAP_WATCH_TASKS
+
+  uint32_t freeBytes = BOOT_FREE;
+  uint32_t minFreeBytes = BOOT_MIN_FREE;
+  uint64_t allocations = 0;   // Every block allocated since boot
+
+  // Set by heap_watch_arm()
+  Task* watched[WATCH_TASKS] = {};
+  size_t watchedCount = 0;
+  bool trap = false;
+  uint32_t watchedAllocations = 0;  // By the watched tasks since then
+
+  uint32_t largestBlock() const { return freeBytes > FRAGMENTED ? freeBytes - FRAGMENTED : 0; }
+};
+
+// Charges an allocation of `bytes` to the current device, or credits it back
+void heapAllocated(size_t bytes);
+void heapFreed(size_t bytes);
+
+// std::allocator that charges the current device's heap, for the String stand-in
+template <class T>
+struct HeapAllocator : std::allocator<T> {
+  typedef T value_type;
+
+  template <class U>
+  struct rebind {
+    typedef HeapAllocator<U> other;
+  };
+
+  HeapAllocator() {}
+  template <class U>
+  HeapAllocator(const HeapAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    heapAllocated(n * sizeof(T));
+    return std::allocator<T>::allocate(n);
+  }
+
+  void deallocate(T* p, size_t n) {
+    heapFreed(n * sizeof(T));
+    std::allocator<T>::deallocate(p, n);
+  }
+};
+
+template <class T, class U>
+bool operator==(const HeapAllocator<T>&, const HeapAllocator<U>&) {
+  return true;
+}
+
+template <class T, class U>
+bool operator!=(const HeapAllocator<T>&, const HeapAllocator<U>&) {
+  return false;
+}
+
+}  // namespace sim
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef SIM_LINK_EMULATOR_H
+#define SIM_LINK_EMULATOR_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Lossy-link emulator for the simulated SPP link and for link_bench.
+ *
+ * The unit is one write, as the SPP stack hands it to the radio. A write
+ * can be lost whole, have single bits flipped, or be held back so that it
+ * arrives after the writes that follow it. RFCOMM retransmits on a real
+ * link, so none of this happens there unless the stack misbehaves or a
+ * receive buffer overflows; the emulator exists to show what the position
+ * stream does when it does.
+ *
+ * Each emulator has its own random sequence, so a run with the same seed
+ * and the same writes is repeatable.
+ */
+namespace sim {
+
+struct LinkImpairment {
+  double lossPct = 0;             // Writes lost whole, in percent
+  double bitErrorRate = 0;        // Chance of each bit being flipped
+  double reorderPct = 0;          // Writes held back behind later ones, in percent
+  uint64_t reorderUs = 150000;    // Extra delay of a held-back write
+
+  bool any() const { return lossPct > 0 || bitErrorRate > 0 || reorderPct > 0; }
+};
+
+class LinkEmulator {
+ public:
+  LinkImpairment impairment;
+  uint64_t writes = 0;
+  uint64_t lost = 0;          // Writes lost whole
+  uint64_t corrupted = 0;     // Writes with at least one bit flipped
+  uint64_t bitsFlipped = 0;
+  uint64_t reordered = 0;     // Writes held back
+
+  explicit LinkEmulator(uint64_t seed = 1) : state_(seed ? seed : 1) {}
+
+  /**
+   * @brief Passes one write through the impairments.
+   *
+   * @param data The bytes, which may have bits flipped in place.
+   * @param len Number of bytes.
+   * @param extraUs Receives the delay on top of the link's own latency.
+   *
+   * @return true If the write is delivered.
+   * @return false If it is lost.
+   */
+  bool pass(uint8_t* data, size_t len, uint64_t* extraUs) {
+    writes++;
+    *extraUs = 0;
+    if (chance(impairment.lossPct / 100.0)) {
+      lost++;
+      return false;
+    }
+    if (impairment.bitErrorRate > 0) {
+      // Geometric gaps between flipped bits, so the cost does not grow with the rate's inverse
+      bool hit = false;
+      for (uint64_t bit = gap(); bit < len * 8; bit += 1 + gap()) {
+        data[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+        bitsFlipped++;
+        hit = true;
+      }
+      corrupted += hit;
+    }
+    if (chance(impairment.reorderPct / 100.0)) {
+      reordered++;
+      *extraUs = impairment.reorderUs;
+    }
+    return true;
+  }
+
+  // Uniform in [0, 1)
+  double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+ private:
+  uint64_t state_;
+
+  // xorshift64*
+  uint64_t next() {
+    state_ ^= state_ >> 12;
+    state_ ^= state_ << 25;
+    state_ ^= state_ >> 27;
+    return state_ * 2685821657736338717ULL;
+  }
+
+  bool chance(double p) { return p > 0 && uniform() < p; }
+
+  // Bits until the next flipped one
+  uint64_t gap() {
+    double p = impairment.bitErrorRate;
+    if (p >= 1) {
+      return 0;
+    }
+    double u = 1.0 - uniform();
+    double bits = log1p(-p) < 0 ? log(u) / log1p(-p) : 1e18;
+    return bits < 1e18 ? (uint64_t)bits : UINT64_MAX / 2;
+  }
+};
+
+}  // namespace sim
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef SIM_NMEAFEED_H
+#define SIM_NMEAFEED_H
+
+#include <string>
+#include <vector>
+
+namespace sim {
+
+/**
+ * @brief Recorded NMEA that a simulated GPS receiver plays back.
+ *
+ * A recording is plain NMEA text, one fix per second. It is split into
+ * epochs at each RMC sentence, each epoch being the sentence set the
+ * receiver emitted for one fix.
+ */
+class NmeaFeed {
+ public:
+  bool load(const char* path);
+  size_t epochs() const { return epochStart_.size(); }
+
+  // Sentences of epoch `e` are lines [epochBegin(e), epochEnd(e)), each ending in CR LF
+  size_t epochBegin(size_t e) const { return epochStart_[e]; }
+  size_t epochEnd(size_t e) const { return e + 1 < epochStart_.size() ? epochStart_[e + 1] : lines_.size(); }
+  const std::string& line(size_t i) const { return lines_[i]; }
+
+ private:
+  std::vector<std::string> lines_;
+  std::vector<size_t> epochStart_;
+};
+
+}  // namespace sim
+
+#endif
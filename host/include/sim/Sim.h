@@ -0,0 +1,228 @@
+#ifndef SIM_SIM_H
+#define SIM_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Heap.h"
+#include "LinkEmulator.h"
+
+/*
+ * Discrete-event simulator behind the host build of the sketches.
+ *
+ * Every simulated ESP32 is a Device. Code runs in cooperative tasks (the
+ * Arduino loopTask plus a system task that stands in for the BT/UART driver
+ * tasks) on a single shared virtual clock. Tasks only give up the CPU when
+ * they wait: delay() and blocking driver calls are idle time, while
+ * delayMicroseconds() and peripheral bus waits are busy time. Code between
+ * waits takes no virtual time; its real cost is measured as host CPU time.
+ */
+namespace sim {
+
+typedef uint64_t Micros;
+const Micros FOREVER = UINT64_MAX;
+
+struct Task;
+class Device;
+
+// Kinds of peripheral activity reported to the trace hook
+enum TraceKind {
+  TRACE_BT_TX,       // Bytes handed to the SPP link
+  TRACE_BT_RX,       // Bytes read from the SPP link by the sketch
+  TRACE_LCD_DATA,    // Character written to the LCD
+  TRACE_LCD_CMD,     // Command written to the LCD
+  TRACE_UART_TX,     // Bytes written to a UART other than Serial
+  TRACE_UART_DROP,   // Bytes lost to a full receive buffer
+  TRACE_SERIAL_TX,   // Bytes written to the USB Serial port
+};
+
+struct TraceEvent {
+  Micros time;
+  Device* device;
+  TraceKind kind;
+  const uint8_t* data;
+  size_t len;
+};
+
+struct Config {
+  Micros loopQuantumUs = 100;         // Busy time charged to a loop() that never waits
+  Micros btConnectUs = 1200000;       // Page + SDP + RFCOMM setup for a reachable peer
+  Micros btPageTimeoutUs = 5120000;   // connect() to a peer that is not listening
+  Micros btAirUs = 15000;             // One-way SPP latency
+  bool echoSerial = false;            // Copy Serial output to stdout
+  Micros lightSleepMinUs = 3000;      // Idle time before the idle task light-sleeps (3 ticks)
+  Micros lightSleepWakeUs = 500;      // Wake-up until clocks and UARTs run again
+  Micros flashSectorUs = 45000;       // Erase and program one 4 KB flash sector
+  size_t flashBytes = 0x160000;       // LittleFS partition of the default partition table
+  Micros nvsWriteUs = 3000;           // Write one NVS key; page erases amortized over many writes
+};
+
+Config& config();
+
+// Impairments applied to every SPP write, in both directions; none by default
+LinkEmulator& btEmulator();
+
+/**
+ * @brief Receive queue with a wire-arrival schedule and a bounded buffer.
+ *
+ * Bytes are queued with the virtual time at which they arrive. They move
+ * into the bounded buffer lazily when the reader looks, and bytes that
+ * arrive while the buffer is full are dropped, just like a UART or SPP
+ * receive ring that nobody drains.
+ */
+struct RxQueue {
+  size_t capacity = 256;
+  uint64_t dropped = 0;
+  bool sleepLoses = false;  // A UART: bytes arriving while its device light-sleeps are lost
+  uint64_t lostAsleep = 0;
+  std::deque<std::pair<Micros, uint8_t>> pending;
+  std::deque<uint8_t> ready;
+
+  void push(Micros at, uint8_t b);
+  void settle(Micros now, Device* owner);
+  Micros nextArrival() const { return pending.empty() ? FOREVER : pending.front().first; }
+};
+
+/**
+ * @brief Transmit side of a UART: a FIFO drained at the configured baud.
+ *
+ * Writing more than fits in the FIFO busy-waits the caller until there is
+ * room, which is how the Arduino core behaves with no TX ring buffer.
+ */
+struct TxFifo {
+  unsigned long baud = 115200;
+  size_t fifo = 128;
+  Micros busyUntil = 0;
+
+  void write(size_t n);
+  Micros byteUs() const { return 10000000ULL / baud; }
+};
+
+// Tasks blocked until someone signals the object they are waiting on
+struct WaitList {
+  std::vector<Task*> waiters;
+};
+
+class Device {
+ public:
+  explicit Device(const char* name);
+
+  std::string name;
+  uint8_t btAddress[6];
+  int pins[64];
+
+  // Virtual time split, accumulated while the simulation advances
+  Micros busyUs = 0;  // At least one task busy-waiting
+  Micros idleUs = 0;  // Every task blocked or sleeping
+  Micros sleepUs = 0; // Part of idleUs in light sleep, without the wake-ups
+  uint64_t sleeps = 0;
+  uint64_t loops = 0;
+  bool halted = false;
+
+  // Called after each loop() with its host CPU time and virtual start/end
+  std::function<void(uint64_t cpuNs, Micros start, Micros end)> onLoop;
+
+  // Host directory behind the device's LittleFS partition; empty = none
+  std::string flashDir;
+
+  // Added to what millis(), micros() and esp_timer_get_time() read on this
+  // device, as if it had booted that much earlier than the simulation
+  Micros clockOffsetUs = 0;
+
+  // Behind ESP.getFreeHeap() and friends, and the allocation count of src/HeapWatch.h
+  HeapModel heap;
+
+  // USB Serial port state of this device
+  TxFifo usbTx;
+  RxQueue usbRx;
+  std::string usbLine;
+
+  /**
+   * @brief Starts the Arduino loopTask running setup() then loop() forever.
+   */
+  void start(std::function<void()> setup, std::function<void()> loop);
+
+  /**
+   * @brief Runs a function on the device's system task at a virtual time.
+   *
+   * Used for work that the real firmware does in driver tasks, such as SPP
+   * event callbacks.
+   */
+  void post(Micros at, std::function<void()> fn);
+
+  // Light sleep, set up through esp_pm.h and driver/gpio.h. The device
+  // sleeps through an idle stretch if, when it began, no lock was held and
+  // no task timer was due within Config::lightSleepMinUs.
+  bool lightSleep = false;
+  int pmLocks = 0;          // ESP_PM_NO_LIGHT_SLEEP locks held
+  uint64_t wakePins = 0;    // GPIOs that wake the device, one bit each
+
+  // True if the device was light-sleeping, or still waking up, at `t`
+  bool asleepAt(Micros t) const;
+
+  // Internal bookkeeping used by the scheduler
+  int busyTasks = 0;
+  Micros quietFrom = FOREVER;  // When the current idle stretch began
+  bool quietSleeps = false;    // Whether it is spent in light sleep
+  std::deque<std::pair<Micros, Micros>> sleepSpans;  // Recent sleeps, for asleepAt()
+  Task* sysTask = nullptr;
+  WaitList sysWait;
+  std::multimap<Micros, std::function<void()>> sysQueue;
+};
+
+Micros now();
+Device* current();
+// now() on the current device's own clock, with its clockOffsetUs
+Micros deviceNow();
+
+// Blocks the calling task; idle time for the device
+void sleep(Micros us);
+// Holds the CPU without doing anything else; busy time for the device
+void busyWait(Micros us);
+// Lets other tasks that are ready at the same time run first
+void yield();
+
+/**
+ * @brief Blocks the calling task until notified or the timeout elapses.
+ *
+ * @return true If notified.
+ * @return false If the timeout elapsed.
+ */
+bool wait(WaitList& list, Micros timeout);
+void notifyAll(WaitList& list);
+
+Task* spawn(Device* device, const char* name, std::function<void()> body, int priority = 1);
+Task* currentTask();
+// Ends a task; nullptr ends the calling task and does not return
+void exitTask(Task* task);
+
+// Direct-to-task notification counter, as used by ulTaskNotifyTake()
+void notifyGive(Task* task);
+uint32_t notifyTake(bool clearOnExit, Micros timeout);
+
+// Host CPU time consumed by the calling task so far
+uint64_t taskCpuNs();
+// Host wall time the calling task has been running; close to taskCpuNs()
+// and much cheaper to read, for clocks that are read on every pass
+uint64_t taskClockNs();
+
+/**
+ * @brief Advances the simulation until virtual time reaches `until`.
+ */
+void run(Micros until);
+
+// Stops every task of the current device (ESP.restart)
+void halt();
+
+void setTrace(std::function<void(const TraceEvent&)> hook);
+void trace(TraceKind kind, const uint8_t* data, size_t len);
+
+}  // namespace sim
+
+#endif
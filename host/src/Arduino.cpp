@@ -0,0 +1,64 @@
+#include "Arduino.h"
+
+#include "sim/Sim.h"
+
+EspClass ESP;
+
+unsigned long millis() {
+  return (unsigned long)(sim::deviceNow() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)sim::deviceNow();
+}
+
+int64_t esp_timer_get_time() {
+  return (int64_t)sim::deviceNow();
+}
+
+void delay(uint32_t ms) {
+  sim::sleep((sim::Micros)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+  sim::busyWait(us);
+}
+
+void yield() {
+  sim::yield();
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin < 64) {
+    sim::current()->pins[pin] = val;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < 64 ? sim::current()->pins[pin] : LOW;
+}
+
+char* dtostrf(double number, signed char width, unsigned char prec, char* s) {
+  sprintf(s, "%*.*f", width, prec, number);
+  return s;
+}
+
+void EspClass::restart() {
+  Serial.println("ets Jun  8 2016 00:22:57\r\nrst:0xc (SW_CPU_RESET)");
+  sim::halt();
+}
+
+// Figures of the device's heap model, sim/Heap.h
+uint32_t EspClass::getHeapSize() { return sim::HeapModel::SIZE; }
+uint32_t EspClass::getFreeHeap() { return sim::current()->heap.freeBytes; }
+uint32_t EspClass::getMinFreeHeap() { return sim::current()->heap.minFreeBytes; }
+uint32_t EspClass::getMaxAllocHeap() { return sim::current()->heap.largestBlock(); }
+
+// Code between waits takes no virtual time, so the time the calling task
+// has run on the host is counted on top; a profiled stage then costs what it
+// costs the host
+uint32_t EspClass::getCycleCount() {
+  return (uint32_t)(sim::now() * 240 + sim::taskClockNs() * 240 / 1000);
+}
@@ -0,0 +1,418 @@
+#include "BluetoothSerial.h"
+
+#include <string.h>
+
+#include <map>
+#include <vector>
+
+#include "esp_bt_device.h"
+#include "esp_bt_main.h"
+#include "esp_gap_bt_api.h"
+
+// Never destroyed: global BluetoothSerial objects detach from it at exit
+static std::vector<BluetoothSerial*>& endpoints() {
+  static std::vector<BluetoothSerial*>* list = new std::vector<BluetoothSerial*>();
+  return *list;
+}
+
+BluetoothSerial::BluetoothSerial() {
+  rx_.capacity = 512;
+}
+
+// Runs at program exit, after the simulated devices are gone, so it only
+// detaches from the registry without raising events
+BluetoothSerial::~BluetoothSerial() {
+  unlink();
+  std::vector<BluetoothSerial*>& list = endpoints();
+  for (size_t i = 0; i < list.size(); i++) {
+    if (list[i] == this) {
+      list.erase(list.begin() + i);
+      break;
+    }
+  }
+}
+
+bool BluetoothSerial::begin(String localName, bool isMaster) {
+  if (!begun_) {
+    endpoints().push_back(this);
+  }
+  owner_ = sim::current();
+  name_ = localName;
+  isMaster_ = isMaster;
+  begun_ = true;
+  return true;
+}
+
+void BluetoothSerial::end() {
+  disconnect();
+  if (begun_) {
+    std::vector<BluetoothSerial*>& list = endpoints();
+    for (size_t i = 0; i < list.size(); i++) {
+      if (list[i] == this) {
+        list.erase(list.begin() + i);
+        break;
+      }
+    }
+  }
+  begun_ = false;
+}
+
+esp_err_t BluetoothSerial::register_callback(esp_spp_cb_t callback) {
+  callback_ = callback;
+  return ESP_OK;
+}
+
+void BluetoothSerial::raise(esp_spp_cb_event_t event, esp_spp_status_t status) {
+  if (!callback_ || !owner_) {
+    return;
+  }
+  esp_spp_cb_t cb = callback_;
+  esp_spp_cb_param_t param;
+  memset(&param, 0, sizeof(param));
+  const uint8_t* remote = (peer_ && peer_->owner_) ? peer_->owner_->btAddress : lastRemote_;
+  switch (event) {
+    case ESP_SPP_OPEN_EVT:
+      param.open.status = status;
+      param.open.handle = handle_;
+      memcpy(param.open.rem_bda, remote, 6);
+      break;
+    case ESP_SPP_SRV_OPEN_EVT:
+      param.srv_open.status = status;
+      param.srv_open.handle = handle_;
+      memcpy(param.srv_open.rem_bda, remote, 6);
+      break;
+    case ESP_SPP_CLOSE_EVT:
+      param.close.status = status;
+      param.close.handle = handle_;
+      param.close.async = true;
+      break;
+    case ESP_SPP_CL_INIT_EVT:
+      param.cl_init.status = status;
+      param.cl_init.handle = handle_;
+      break;
+    default:
+      param.init.status = status;
+      break;
+  }
+  owner_->post(sim::now(), [cb, event, param]() mutable { cb(event, &param); });
+}
+
+// Delivers received bytes to the callback when they arrive
+void BluetoothSerial::raiseData(sim::Micros at, const uint8_t* data, size_t len) {
+  if (!callback_ || !owner_) {
+    return;
+  }
+  esp_spp_cb_t cb = callback_;
+  uint32_t handle = handle_;
+  std::vector<uint8_t> copy(data, data + len);
+  owner_->post(at, [cb, handle, copy]() mutable {
+    esp_spp_cb_param_t param;
+    memset(&param, 0, sizeof(param));
+    param.data_ind.handle = handle;
+    param.data_ind.len = (uint16_t)copy.size();
+    param.data_ind.data = copy.data();
+    cb(ESP_SPP_DATA_IND_EVT, &param);
+  });
+}
+
+static uint32_t nextHandle = 0x81;
+
+void BluetoothSerial::link(BluetoothSerial* peer) {
+  if (!handle_) {
+    handle_ = nextHandle++;
+  }
+  if (!peer->handle_) {
+    peer->handle_ = nextHandle++;
+  }
+  peer_ = peer;
+  peer->peer_ = this;
+  raise(ESP_SPP_OPEN_EVT);
+  peer->raise(ESP_SPP_SRV_OPEN_EVT);
+}
+
+void BluetoothSerial::unlink() {
+  if (peer_) {
+    peer_->peer_ = nullptr;
+    peer_ = nullptr;
+  }
+}
+
+// Finds a listening slave matching the address (or name when addr is null)
+static BluetoothSerial* findSlave(const uint8_t* addr, const String* name, BluetoothSerial* self) {
+  std::vector<BluetoothSerial*>& list = endpoints();
+  for (size_t i = 0; i < list.size(); i++) {
+    BluetoothSerial* e = list[i];
+    if (e == self || !e->isReady() || e->simPeer() || !e->simDevice() || e->simDevice()->halted) {
+      continue;
+    }
+    if (addr ? memcmp(addr, e->simDevice()->btAddress, 6) == 0 : e->simName() == *name) {
+      return e;
+    }
+  }
+  return nullptr;
+}
+
+bool BluetoothSerial::connect(uint8_t remoteAddress[], int, esp_spp_sec_t, esp_spp_role_t) {
+  if (!begun_ || !isMaster_) {
+    return false;
+  }
+  memcpy(lastRemote_, remoteAddress, 6);
+  if (!findSlave(remoteAddress, nullptr, this)) {
+    sim::sleep(sim::config().btPageTimeoutUs);
+    return false;
+  }
+  sim::sleep(sim::config().btConnectUs);
+  BluetoothSerial* peer = findSlave(remoteAddress, nullptr, this);
+  if (!peer) {
+    return false;
+  }
+  link(peer);
+  return true;
+}
+
+bool BluetoothSerial::connect(String remoteName) {
+  if (!begun_ || !isMaster_) {
+    return false;
+  }
+  BluetoothSerial* peer = findSlave(nullptr, &remoteName, this);
+  if (!peer) {
+    sim::sleep(sim::config().btPageTimeoutUs);
+    return false;
+  }
+  memcpy(lastRemote_, peer->owner_->btAddress, 6);
+  return connect(lastRemote_);
+}
+
+bool BluetoothSerial::connect() {
+  return connect(lastRemote_);
+}
+
+bool BluetoothSerial::connected(int timeout) {
+  sim::Micros deadline = sim::now() + (sim::Micros)timeout * 1000;
+  while (!peer_ && sim::now() < deadline) {
+    sim::sleep(10000);
+  }
+  return peer_ != nullptr;
+}
+
+bool BluetoothSerial::hasClient() {
+  return peer_ != nullptr;
+}
+
+bool BluetoothSerial::disconnect() {
+  if (!peer_) {
+    return false;
+  }
+  BluetoothSerial* peer = peer_;
+  raise(ESP_SPP_CLOSE_EVT);
+  peer->raise(ESP_SPP_CLOSE_EVT);
+  unlink();
+  return true;
+}
+
+bool BluetoothSerial::isReady(bool, int) {
+  return begun_;
+}
+
+int BluetoothSerial::available() {
+  rx_.settle(sim::now(), owner_);
+  return (int)rx_.ready.size();
+}
+
+int BluetoothSerial::peek() {
+  if (!available()) {
+    return -1;
+  }
+  return rx_.ready.front();
+}
+
+int BluetoothSerial::read() {
+  if (!available()) {
+    return -1;
+  }
+  uint8_t c = rx_.ready.front();
+  rx_.ready.pop_front();
+  sim::trace(sim::TRACE_BT_RX, &c, 1);
+  return c;
+}
+
+size_t BluetoothSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t BluetoothSerial::write(const uint8_t* buffer, size_t size) {
+  if (!peer_) {
+    return 0;
+  }
+  sim::trace(sim::TRACE_BT_TX, buffer, size);
+  sim::Micros at = sim::now() + sim::config().btAirUs;
+  sim::LinkEmulator& emulator = sim::btEmulator();
+  std::vector<uint8_t> impaired;
+  if (emulator.impairment.any()) {
+    impaired.assign(buffer, buffer + size);
+    uint64_t extraUs;
+    if (!emulator.pass(impaired.data(), size, &extraUs)) {
+      return size;  // Lost on the air; the sender cannot tell
+    }
+    at += extraUs;
+    buffer = impaired.data();
+  }
+  if (peer_->raw_) {
+    peer_->raiseData(at, buffer, size);
+  } else {
+    for (size_t i = 0; i < size; i++) {
+      peer_->rx_.push(at, buffer[i]);
+    }
+    peer_->raiseData(at, buffer, size);  // Like the real library, the callback sees data that is queued too
+  }
+  return size;
+}
+
+// Like the real library, flush() waits for transmission; it does not
+// discard received data
+void BluetoothSerial::flush() {}
+
+// Raw SPP API: the per-device callback and the links it created
+struct RawStack {
+  esp_spp_cb_t callback = nullptr;
+  bool initialized = false;
+  std::vector<BluetoothSerial*> links;
+};
+
+static RawStack& rawStack(sim::Device* device) {
+  static std::map<sim::Device*, RawStack> stacks;
+  return stacks[device];
+}
+
+static std::vector<BluetoothSerial*>::iterator findLink(RawStack& stack, uint32_t handle) {
+  std::vector<BluetoothSerial*>::iterator it = stack.links.begin();
+  for (; it != stack.links.end(); ++it) {
+    if ((*it)->simHandle() == handle) {
+      break;
+    }
+  }
+  return it;
+}
+
+bool btStart() {
+  return true;
+}
+
+esp_bluedroid_status_t esp_bluedroid_get_status() {
+  return ESP_BLUEDROID_STATUS_ENABLED;
+}
+
+esp_err_t esp_bluedroid_init() {
+  return ESP_OK;
+}
+
+esp_err_t esp_bluedroid_enable() {
+  return ESP_OK;
+}
+
+esp_err_t esp_bt_dev_set_device_name(const char*) {
+  return ESP_OK;
+}
+
+const uint8_t* esp_bt_dev_get_address() {
+  return sim::current()->btAddress;
+}
+
+esp_err_t esp_bt_gap_set_scan_mode(esp_bt_connection_mode_t, esp_bt_discovery_mode_t) {
+  return ESP_OK;
+}
+
+esp_err_t esp_spp_register_callback(esp_spp_cb_t callback) {
+  rawStack(sim::current()).callback = callback;
+  return ESP_OK;
+}
+
+esp_err_t esp_spp_init(esp_spp_mode_t) {
+  sim::Device* device = sim::current();
+  RawStack& stack = rawStack(device);
+  if (!stack.callback) {
+    return ESP_FAIL;
+  }
+  stack.initialized = true;
+  esp_spp_cb_t cb = stack.callback;
+  device->post(sim::now(), [cb]() {
+    esp_spp_cb_param_t param;
+    memset(&param, 0, sizeof(param));
+    cb(ESP_SPP_INIT_EVT, &param);
+  });
+  return ESP_OK;
+}
+
+esp_err_t esp_spp_connect(esp_spp_sec_t, esp_spp_role_t, uint8_t, esp_bd_addr_t peer_bd_addr) {
+  sim::Device* device = sim::current();
+  RawStack& stack = rawStack(device);
+  if (!stack.initialized) {
+    return ESP_FAIL;
+  }
+  BluetoothSerial* link = new BluetoothSerial();
+  link->owner_ = device;
+  link->begun_ = true;
+  link->isMaster_ = true;
+  link->raw_ = true;
+  link->callback_ = stack.callback;
+  link->handle_ = nextHandle++;
+  memcpy(link->lastRemote_, peer_bd_addr, 6);
+  stack.links.push_back(link);
+  link->raise(ESP_SPP_CL_INIT_EVT);
+
+  // Paging a device that is not listening only fails after the page timeout
+  bool reachable = findSlave(peer_bd_addr, nullptr, link) != nullptr;
+  sim::Micros at = sim::now() + (reachable ? sim::config().btConnectUs : sim::config().btPageTimeoutUs);
+  uint32_t handle = link->handle_;
+  device->post(at, [device, handle]() {
+    RawStack& stack = rawStack(device);
+    std::vector<BluetoothSerial*>::iterator it = findLink(stack, handle);
+    if (it == stack.links.end()) {
+      return;  // Cancelled by esp_spp_disconnect()
+    }
+    BluetoothSerial* link = *it;
+    BluetoothSerial* peer = findSlave(link->lastRemote_, nullptr, link);
+    if (peer) {
+      link->link(peer);
+      return;
+    }
+    link->raise(ESP_SPP_CLOSE_EVT, ESP_SPP_FAILURE);
+    stack.links.erase(it);
+    delete link;
+  });
+  return ESP_OK;
+}
+
+esp_err_t esp_spp_disconnect(uint32_t handle) {
+  RawStack& stack = rawStack(sim::current());
+  std::vector<BluetoothSerial*>::iterator it = findLink(stack, handle);
+  if (it == stack.links.end()) {
+    return ESP_FAIL;
+  }
+  BluetoothSerial* link = *it;
+  if (!link->disconnect()) {
+    link->raise(ESP_SPP_CLOSE_EVT, ESP_SPP_FAILURE);
+  }
+  stack.links.erase(it);
+  delete link;
+  return ESP_OK;
+}
+
+esp_err_t esp_spp_write(uint32_t handle, int len, uint8_t* p_data) {
+  RawStack& stack = rawStack(sim::current());
+  std::vector<BluetoothSerial*>::iterator it = findLink(stack, handle);
+  if (it == stack.links.end() || !(*it)->peer_ || len <= 0) {
+    return ESP_FAIL;
+  }
+  BluetoothSerial* link = *it;
+  link->write(p_data, (size_t)len);
+  esp_spp_cb_t cb = link->callback_;
+  link->owner_->post(sim::now(), [cb, handle, len]() {
+    esp_spp_cb_param_t param;
+    memset(&param, 0, sizeof(param));
+    param.write.handle = handle;
+    param.write.len = len;
+    cb(ESP_SPP_WRITE_EVT, &param);
+  });
+  return ESP_OK;
+}
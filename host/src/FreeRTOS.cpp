@@ -0,0 +1,174 @@
+#include <string.h>
+
+#include <deque>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sim/Sim.h"
+
+static sim::Micros ticksToUs(TickType_t ticks) {
+  return ticks == portMAX_DELAY ? sim::FOREVER : (sim::Micros)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char* pcName, uint32_t, void* pvParameters,
+                                   UBaseType_t uxPriority, TaskHandle_t* pvCreatedTask, BaseType_t) {
+  sim::Task* task = sim::spawn(sim::current(), pcName, [pvTaskCode, pvParameters]() {
+    pvTaskCode(pvParameters);
+  }, (int)uxPriority);
+  if (pvCreatedTask) {
+    *pvCreatedTask = (TaskHandle_t)task;
+  }
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth, void* pvParameters,
+                       UBaseType_t uxPriority, TaskHandle_t* pvCreatedTask) {
+  return xTaskCreatePinnedToCore(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pvCreatedTask,
+                                 tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete) {
+  sim::exitTask((sim::Task*)xTaskToDelete);
+}
+
+void vTaskDelay(TickType_t xTicksToDelay) {
+  sim::sleep(ticksToUs(xTicksToDelay));
+}
+
+void vTaskDelayUntil(TickType_t* pxPreviousWakeTime, TickType_t xTimeIncrement) {
+  TickType_t wake = *pxPreviousWakeTime + xTimeIncrement;
+  TickType_t now = xTaskGetTickCount();
+  if ((int32_t)(wake - now) > 0) {
+    sim::sleep(ticksToUs(wake - now));
+  }
+  *pxPreviousWakeTime = wake;
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)(sim::deviceNow() / (1000 * portTICK_PERIOD_MS));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return (TaskHandle_t)sim::currentTask();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) {
+  return 1024;
+}
+
+BaseType_t xPortGetCoreID() {
+  return 1;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+  return sim::notifyTake(xClearCountOnExit != pdFALSE, ticksToUs(xTicksToWait));
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify) {
+  sim::notifyGive((sim::Task*)xTaskToNotify);
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t* pxHigherPriorityTaskWoken) {
+  sim::notifyGive((sim::Task*)xTaskToNotify);
+  if (pxHigherPriorityTaskWoken) {
+    *pxHigherPriorityTaskWoken = pdTRUE;
+  }
+}
+
+struct QueueDefinition {
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  std::deque<std::vector<uint8_t>> items;
+  sim::WaitList notEmpty;
+  sim::WaitList notFull;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize) {
+  QueueDefinition* q = new QueueDefinition();
+  q->length = uxQueueLength;
+  q->itemSize = uxItemSize;
+  return q;
+}
+
+void vQueueDelete(QueueHandle_t xQueue) {
+  delete xQueue;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  QueueHandle_t q = xQueueCreate(1, 0);
+  xQueueGenericSend(q, NULL, 0, queueSEND_TO_BACK);
+  return q;
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t q, const void* pvItemToQueue, TickType_t xTicksToWait,
+                             BaseType_t xCopyPosition) {
+  sim::Micros timeout = ticksToUs(xTicksToWait);
+  sim::Micros deadline = timeout == sim::FOREVER ? sim::FOREVER : sim::now() + timeout;
+  for (;;) {
+    if (xCopyPosition == queueOVERWRITE && q->items.size() >= q->length) {
+      q->items.pop_back();
+    }
+    if (q->items.size() < q->length) {
+      std::vector<uint8_t> item(q->itemSize);
+      if (q->itemSize && pvItemToQueue) {
+        memcpy(item.data(), pvItemToQueue, q->itemSize);
+      }
+      if (xCopyPosition == queueSEND_TO_FRONT) {
+        q->items.push_front(item);
+      } else {
+        q->items.push_back(item);
+      }
+      sim::notifyAll(q->notEmpty);
+      return pdPASS;
+    }
+    if (sim::now() >= deadline || !sim::wait(q->notFull, deadline == sim::FOREVER ? sim::FOREVER : deadline - sim::now())) {
+      return errQUEUE_FULL;
+    }
+  }
+}
+
+static BaseType_t queueTake(QueueHandle_t q, void* pvBuffer, TickType_t xTicksToWait, bool remove) {
+  sim::Micros timeout = ticksToUs(xTicksToWait);
+  sim::Micros deadline = timeout == sim::FOREVER ? sim::FOREVER : sim::now() + timeout;
+  for (;;) {
+    if (!q->items.empty()) {
+      if (q->itemSize && pvBuffer) {
+        memcpy(pvBuffer, q->items.front().data(), q->itemSize);
+      }
+      if (remove) {
+        q->items.pop_front();
+        sim::notifyAll(q->notFull);
+      }
+      return pdPASS;
+    }
+    if (sim::now() >= deadline || !sim::wait(q->notEmpty, deadline == sim::FOREVER ? sim::FOREVER : deadline - sim::now())) {
+      return errQUEUE_EMPTY;
+    }
+  }
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait) {
+  return queueTake(xQueue, pvBuffer, xTicksToWait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait) {
+  return queueTake(xQueue, pvBuffer, xTicksToWait, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue) {
+  return (UBaseType_t)xQueue->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t xQueue) {
+  return xQueue->length - (UBaseType_t)xQueue->items.size();
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue) {
+  xQueue->items.clear();
+  sim::notifyAll(xQueue->notFull);
+  return pdPASS;
+}
@@ -0,0 +1,411 @@
+#include "sim/GpsReceiver.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace sim {
+
+const Micros PROCESS_US = 20000;        // From the last byte of a command to the receiver acting on it
+const Micros RECORDING_PERIOD = 1000000;
+
+static std::string sentenceType(const std::string& line) {
+  return line.size() > 6 && line[0] == '$' ? line.substr(3, 3) : std::string();
+}
+
+static std::string withChecksum(const std::string& body) {
+  uint8_t sum = 0;
+  for (size_t i = 0; i < body.size(); i++) {
+    sum ^= (uint8_t)body[i];
+  }
+  char tail[8];
+  snprintf(tail, sizeof(tail), "*%02X\r\n", sum);
+  return "$" + body + tail;
+}
+
+// Splits "$BODY*CS\r\n" into the comma-separated fields of BODY
+static std::vector<std::string> fields(const std::string& line) {
+  std::vector<std::string> out;
+  size_t end = line.find('*');
+  std::string body = line.substr(1, end == std::string::npos ? std::string::npos : end - 1);
+  size_t at = 0;
+  for (;;) {
+    size_t comma = body.find(',', at);
+    out.push_back(body.substr(at, comma == std::string::npos ? std::string::npos : comma - at));
+    if (comma == std::string::npos) {
+      return out;
+    }
+    at = comma + 1;
+  }
+}
+
+static std::string join(const std::vector<std::string>& parts) {
+  std::string out;
+  for (size_t i = 0; i < parts.size(); i++) {
+    out += (i ? "," : "") + parts[i];
+  }
+  return out;
+}
+
+// NMEA ddmm.mmmmm plus hemisphere to signed degrees
+static double parseCoord(const std::string& value, const std::string& hemisphere) {
+  double v = atof(value.c_str());
+  double deg = floor(v / 100);
+  double out = deg + (v - deg * 100) / 60;
+  return (hemisphere == "S" || hemisphere == "W") ? -out : out;
+}
+
+static std::string formatCoord(double degrees, int degDigits) {
+  double a = fabs(degrees);
+  int d = (int)floor(a);
+  double m = round((a - d) * 60 * 1e5) / 1e5;
+  if (m >= 60) {
+    d++;
+    m -= 60;
+  }
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%0*d%08.5f", degDigits, d, m);
+  return buf;
+}
+
+// Adds seconds to an NMEA hhmmss.ss time of day
+static std::string addTime(const std::string& hhmmss, double secs) {
+  if (hhmmss.size() < 6) {
+    return hhmmss;
+  }
+  double t = atoi(hhmmss.substr(0, 2).c_str()) * 3600 + atoi(hhmmss.substr(2, 2).c_str()) * 60 +
+             atof(hhmmss.substr(4).c_str()) + secs;
+  long long cs = llround(t * 100) % (86400LL * 100);
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%02d%02d%02d.%02d", (int)(cs / 360000), (int)(cs / 6000 % 60), (int)(cs / 100 % 60),
+           (int)(cs % 100));
+  return buf;
+}
+
+// RMC or GGA as sent while still acquiring: the time, but no position
+static std::string withoutFix(const std::string& line) {
+  std::string type = sentenceType(line);
+  std::vector<std::string> f = fields(line);
+  if (type == "RMC" && f.size() >= 9) {
+    f[2] = "V";
+    for (size_t i = 3; i <= 8; i++) {
+      f[i].clear();
+    }
+  } else if (type == "GGA" && f.size() >= 10) {
+    for (size_t i = 2; i <= 9; i++) {
+      f[i].clear();
+    }
+    f[6] = "0";
+    f[7] = "00";
+  } else {
+    return line;
+  }
+  return withChecksum(join(f));
+}
+
+static std::string ubxFrame(uint8_t cls, uint8_t id, const std::string& payload) {
+  std::string out;
+  out += (char)0xB5;
+  out += (char)0x62;
+  out += (char)cls;
+  out += (char)id;
+  out += (char)(uint8_t)payload.size();
+  out += (char)(uint8_t)(payload.size() >> 8);
+  out += payload;
+  uint8_t a = 0, b = 0;
+  for (size_t i = 2; i < out.size(); i++) {
+    a += (uint8_t)out[i];
+    b += a;
+  }
+  out += (char)a;
+  out += (char)b;
+  return out;
+}
+
+GpsReceiver::GpsReceiver(const NmeaFeed& feed, HardwareSerial& port, Device& device, Commands commands)
+  : feed_(feed), port_(port), device_(device), commands_(commands) {
+  port_.simOnTx = [this](const uint8_t* data, size_t len) { onTx(data, len); };
+  port_.simOnBaud = [this](unsigned long) { restart(now(), std::string()); };
+}
+
+bool GpsReceiver::parseCommands(const char* name, Commands* out) {
+  static const char* const names[] = { "nmea", "mtk", "ubx" };
+  for (int i = 0; i < 3; i++) {
+    if (!strcmp(name, names[i])) {
+      *out = (Commands)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+void GpsReceiver::setTimeToFix(Micros coldUs, Micros aidedUs) {
+  coldUs_ = coldUs;
+  aidedUs_ = aidedUs;
+}
+
+void GpsReceiver::start(Micros at) {
+  start_ = at;
+  firstFix_ = at + coldUs_;
+  lineFree_ = at;
+  scheduleEpoch(at);
+}
+
+void GpsReceiver::scheduleEpoch(Micros at) {
+  uint64_t generation = generation_;
+  device_.post(at, [this, generation, at]() {
+    if (generation != generation_) {
+      return;
+    }
+    emitEpoch(at);
+    if (at + period_ < start_ + feed_.epochs() * RECORDING_PERIOD) {
+      scheduleEpoch(at + period_);
+    }
+  });
+}
+
+// The recorded sentence, or for RMC and GGA between two recorded seconds,
+// the position interpolated towards the same sentence in the next epoch
+std::string GpsReceiver::sentence(const std::string& line, size_t nextEpoch, double frac) const {
+  std::string type = sentenceType(line);
+  if (frac == 0 || (type != "RMC" && type != "GGA") || nextEpoch >= feed_.epochs()) {
+    return line;
+  }
+  const std::string* next = nullptr;
+  for (size_t i = feed_.epochBegin(nextEpoch); i < feed_.epochEnd(nextEpoch) && !next; i++) {
+    if (sentenceType(feed_.line(i)) == type) {
+      next = &feed_.line(i);
+    }
+  }
+  std::vector<std::string> f = fields(line);
+  size_t lat = (type == "RMC") ? 3 : 2;
+  if (!next || f.size() < lat + 4 || f[lat].empty()) {
+    return line;
+  }
+  std::vector<std::string> g = fields(*next);
+  double la = parseCoord(f[lat], f[lat + 1]), lo = parseCoord(f[lat + 2], f[lat + 3]);
+  la += (parseCoord(g[lat], g[lat + 1]) - la) * frac;
+  lo += (parseCoord(g[lat + 2], g[lat + 3]) - lo) * frac;
+  f[1] = addTime(f[1], frac * RECORDING_PERIOD / 1e6);
+  f[lat] = formatCoord(la, 2);
+  f[lat + 1] = la < 0 ? "S" : "N";
+  f[lat + 2] = formatCoord(lo, 3);
+  f[lat + 3] = lo < 0 ? "W" : "E";
+  return withChecksum(join(f));
+}
+
+void GpsReceiver::emitEpoch(Micros at) {
+  Micros t = at - start_;
+  size_t e = (size_t)(t / RECORDING_PERIOD);
+  if (e >= feed_.epochs()) {
+    return;
+  }
+  double frac = (double)(t % RECORDING_PERIOD) / RECORDING_PERIOD;
+  std::string burst;
+  std::vector<size_t> lineStarts;
+  size_t fixEnd = std::string::npos;
+  bool fixed = at >= firstFix_;
+  for (size_t i = feed_.epochBegin(e); i < feed_.epochEnd(e); i++) {
+    std::string type = sentenceType(feed_.line(i));
+    if (disabled_.count(type)) {
+      continue;
+    }
+    lineStarts.push_back(burst.size());
+    burst += fixed ? sentence(feed_.line(i), e + 1, frac) : withoutFix(sentence(feed_.line(i), e + 1, frac));
+    if (fixed && fixEnd == std::string::npos && (type == "RMC" || type == "GGA")) {
+      fixEnd = burst.size();
+    }
+  }
+  Micros begin = std::max(at, lineFree_);
+  if (burst.empty() || begin >= at + period_) {
+    return;  // Still sending the previous epochs; the receiver drops this one
+  }
+  feed(burst, begin, &lineStarts);
+  if (fixEnd != std::string::npos && port_.baudRate() == baud_) {
+    fixTimes_.push_back(begin + fixEnd * (10000000ULL / baud_));
+  }
+}
+
+void GpsReceiver::feed(const std::string& bytes, Micros at, std::vector<size_t>* lineStarts) {
+  Micros byteUs = 10000000ULL / baud_;
+  std::string wire = bytes;
+  if (port_.baudRate() != baud_) {
+    for (size_t i = 0; i < wire.size(); i++) {
+      wire[i] = (char)(wire[i] | 0x80);  // Framing garbage; never valid NMEA
+    }
+  }
+  port_.simFeed((const uint8_t*)wire.data(), wire.size(), at, baud_);
+  Micros t = now();
+  lineStarts_.erase(lineStarts_.begin(), std::lower_bound(lineStarts_.begin(), lineStarts_.end(), t));
+  if (lineStarts) {
+    for (size_t i = 0; i < lineStarts->size(); i++) {
+      lineStarts_.push_back(at + (*lineStarts)[i] * byteUs);
+    }
+  } else {
+    lineStarts_.push_back(at);
+  }
+  lineFree_ = at + wire.size() * byteUs;
+}
+
+// Drops what has not been sent yet, from the first sentence boundary at or
+// after `from`, then sends `reply`. Later epochs follow the current settings.
+void GpsReceiver::restart(Micros from, const std::string& reply) {
+  std::vector<Micros>::iterator cutAt = std::lower_bound(lineStarts_.begin(), lineStarts_.end(), from);
+  Micros cut = cutAt != lineStarts_.end() ? *cutAt : std::max(from, lineFree_);
+  port_.simCancelFrom(cut);
+  lineStarts_.erase(cutAt, lineStarts_.end());
+  while (!fixTimes_.empty() && fixTimes_.back() > cut) {
+    fixTimes_.pop_back();
+  }
+  lineFree_ = std::min(lineFree_, cut);
+  if (!reply.empty()) {
+    feed(reply, std::max(lineFree_, from), nullptr);
+  }
+}
+
+void GpsReceiver::onTx(const uint8_t* data, size_t len) {
+  if (commands_ == NMEA_ONLY) {
+    return;
+  }
+  if (port_.baudRate() != baud_) {
+    command_.clear();  // Sent at the wrong baud; the receiver sees garbage
+    return;
+  }
+  Micros at = now() + len * (10000000ULL / baud_) + PROCESS_US;
+  command_.append((const char*)data, len);
+  if (commands_ == MTK) {
+    size_t eol;
+    while ((eol = command_.find('\n')) != std::string::npos) {
+      std::string line = command_.substr(0, eol);
+      command_.erase(0, eol + 1);
+      size_t dollar = line.find('$');
+      if (dollar != std::string::npos) {
+        mtkCommand(line.substr(dollar), at);
+      }
+    }
+    return;
+  }
+  for (;;) {
+    size_t sync = command_.find("\xB5\x62");
+    if (sync == std::string::npos) {
+      command_.erase(0, command_.empty() || command_.back() != '\xB5' ? command_.size() : command_.size() - 1);
+      return;
+    }
+    command_.erase(0, sync);
+    if (command_.size() < 6) {
+      return;
+    }
+    size_t total = 8 + ((uint8_t)command_[4] | (uint8_t)command_[5] << 8);
+    if (command_.size() < total) {
+      return;
+    }
+    std::string frame = command_.substr(0, total);
+    command_.erase(0, total);
+    ubxCommand(frame, at);
+  }
+}
+
+void GpsReceiver::mtkCommand(const std::string& sentence, Micros at) {
+  size_t star = sentence.find('*');
+  if (star == std::string::npos || star + 3 > sentence.size()) {
+    return;
+  }
+  std::string body = sentence.substr(1, star - 1);
+  if (withChecksum(body).compare(0, star + 3, sentence, 0, star + 3) != 0 || body.compare(0, 4, "PMTK") != 0) {
+    return;
+  }
+  std::vector<std::string> f = fields(sentence);
+  int cmd = atoi(f[0].c_str() + 4);
+  int flag = 1;  // Unsupported command
+  if (cmd == 314 && f.size() >= 7) {
+    static const char* const types[] = { "GLL", "RMC", "VTG", "GGA", "GSA", "GSV" };
+    for (int i = 0; i < 6; i++) {
+      if (atoi(f[1 + i].c_str()) == 0) {
+        disabled_.insert(types[i]);
+      } else {
+        disabled_.erase(types[i]);
+      }
+    }
+    flag = 3;
+  } else if (cmd == 220 && f.size() >= 2) {
+    int ms = atoi(f[1].c_str());
+    flag = (ms >= 100 && ms <= 10000) ? 3 : 2;
+    if (flag == 3 && (Micros)ms * 1000 != period_) {
+      period_ = (Micros)ms * 1000;
+      generation_++;
+      scheduleEpoch(start_ + (at - start_ + period_ - 1) / period_ * period_);
+    }
+  } else if (cmd == 741 && f.size() >= 10) {
+    aid(at);
+    flag = 3;
+  } else if (cmd == 251 && f.size() >= 2) {
+    long baud = atol(f[1].c_str());
+    baud_ = baud ? baud : 9600;
+    restart(at, std::string());  // Switches at once and never acknowledges
+    return;
+  }
+  char ack[32];
+  snprintf(ack, sizeof(ack), "PMTK001,%d,%d", cmd, flag);
+  restart(at, withChecksum(ack));
+}
+
+void GpsReceiver::ubxCommand(const std::string& frame, Micros at) {
+  const uint8_t* p = (const uint8_t*)frame.data();
+  size_t len = frame.size() - 8;
+  uint8_t a = 0, b = 0;
+  for (size_t i = 2; i < 6 + len; i++) {
+    a += p[i];
+    b += a;
+  }
+  if (a != p[6 + len] || b != p[7 + len]) {
+    return;
+  }
+  uint8_t cls = p[2], id = p[3];
+  const uint8_t* payload = p + 6;
+  if (cls == 0x13 && id == 0x40) {
+    if (len == 20 && payload[0] == 0x01) {
+      aid(at);  // MGA-INI-POS_LLH; MGA messages are not acknowledged unless asked to be
+    }
+    return;
+  }
+  bool ok = false;
+  if (cls == 0x06 && id == 0x01 && (len == 3 || len == 8) && payload[0] == 0xF0 && payload[1] <= 5) {
+    static const char* const types[] = { "GGA", "GLL", "GSA", "GSV", "RMC", "VTG" };
+    uint8_t rate = (len == 3) ? payload[2] : payload[3];  // The 8-byte form has a rate per port; UART1 is [3]
+    if (rate) {
+      disabled_.erase(types[payload[1]]);
+    } else {
+      disabled_.insert(types[payload[1]]);
+    }
+    ok = true;
+  } else if (cls == 0x06 && id == 0x08 && len == 6) {
+    Micros ms = payload[0] | payload[1] << 8;
+    ok = ms >= 50;
+    if (ok && ms * 1000 != period_) {
+      period_ = ms * 1000;
+      generation_++;
+      scheduleEpoch(start_ + (at - start_ + period_ - 1) / period_ * period_);
+    }
+  } else if (cls == 0x06 && id == 0x00 && len == 20 && payload[0] == 1) {
+    baud_ = payload[8] | payload[9] << 8 | payload[10] << 16 | (unsigned long)payload[11] << 24;
+    ok = true;  // Acknowledged at the new baud, which the sketch is not listening at yet
+  }
+  std::string ackPayload;
+  ackPayload += (char)cls;
+  ackPayload += (char)id;
+  restart(at, ubxFrame(0x05, ok ? 0x01 : 0x00, ackPayload));
+}
+
+void GpsReceiver::aid(Micros at) {
+  if (aidedAt_ == FOREVER) {
+    aidedAt_ = at;
+  }
+  if (coldUs_ && at + aidedUs_ < firstFix_) {
+    firstFix_ = std::max(at + aidedUs_, start_);
+  }
+}
+
+}  // namespace sim
@@ -0,0 +1,183 @@
+#include "HardwareSerial.h"
+
+#include <stdio.h>
+
+HardwareSerial Serial(0);
+
+HardwareSerial::HardwareSerial(int uart_nr)
+  : uart_nr_(uart_nr) {
+  rx_.sleepLoses = true;
+}
+
+sim::RxQueue& HardwareSerial::rx() {
+  return uart_nr_ == 0 ? sim::current()->usbRx : rx_;
+}
+
+sim::TxFifo& HardwareSerial::tx() {
+  return uart_nr_ == 0 ? sim::current()->usbTx : tx_;
+}
+
+void HardwareSerial::begin(unsigned long baud, uint32_t, int8_t rxPin, int8_t, bool, unsigned long,
+                           uint8_t rxfifo_full_thrhd) {
+  owner_ = sim::current();
+  rxPin_ = rxPin;
+  rxThreshold_ = rxfifo_full_thrhd ? rxfifo_full_thrhd : 1;
+  tx().baud = baud;
+  rx().capacity = rxBufferSize_ + 128;  // Ring buffer plus the hardware FIFO
+  scheduleRxEvents();
+  if (simOnBaud) {
+    simOnBaud(baud);
+  }
+}
+
+void HardwareSerial::end() {
+  owner_ = nullptr;
+}
+
+void HardwareSerial::updateBaudRate(unsigned long baud) {
+  tx().baud = baud;
+  if (simOnBaud) {
+    simOnBaud(baud);
+  }
+}
+
+unsigned long HardwareSerial::baudRate() {
+  return tx().baud;
+}
+
+size_t HardwareSerial::setRxBufferSize(size_t new_size) {
+  rxBufferSize_ = new_size;
+  rx().capacity = new_size + 128;
+  return new_size;
+}
+
+void HardwareSerial::onReceive(OnReceiveCb function, bool onlyOnTimeout) {
+  onReceive_ = function;
+  onlyOnTimeout_ = onlyOnTimeout;
+  scheduleRxEvents();
+}
+
+// Posts the UART driver's RX events for bytes fed so far: one each time
+// the FIFO reaches `rxfifo_full_thrhd` bytes and one when the line goes idle
+void HardwareSerial::scheduleRxEvents() {
+  if (!onReceive_ || !owner_) {
+    return;
+  }
+  const std::deque<std::pair<sim::Micros, uint8_t>>& pending = rx_.pending;
+  sim::Micros gap = 2 * tx_.byteUs();
+  size_t inBurst = 0;
+  for (size_t i = 0; i < pending.size(); i++) {
+    sim::Micros at = pending[i].first;
+    if (at <= eventsThrough_) {
+      continue;
+    }
+    inBurst++;
+    bool last = (i + 1 == pending.size()) || (pending[i + 1].first - at > gap);
+    if (last || (!onlyOnTimeout_ && inBurst % rxThreshold_ == 0)) {
+      OnReceiveCb cb = onReceive_;
+      owner_->post(last ? at + gap : at, [cb]() { cb(); });
+    }
+    if (last) {
+      inBurst = 0;
+    }
+    eventsThrough_ = at;
+  }
+}
+
+void HardwareSerial::simFeed(const uint8_t* data, size_t len, sim::Micros start, unsigned long baud) {
+  sim::Micros per = 10000000ULL / baud;
+  bool wakes = owner_ && rxPin_ >= 0 && (owner_->wakePins >> rxPin_ & 1);
+  for (size_t i = 0; i < len; i++) {
+    sim::Micros at = start + (i + 1) * per;
+    if (wakes && at - lastFedAt_ > 2 * per) {
+      owner_->post(at, []() {});  // The start bit of a burst wakes the device
+    }
+    rx().push(at, data[i]);
+    lastFedAt_ = at;
+  }
+  scheduleRxEvents();
+}
+
+void HardwareSerial::simCancelFrom(sim::Micros from) {
+  std::deque<std::pair<sim::Micros, uint8_t>>& pending = rx().pending;
+  while (!pending.empty() && pending.back().first >= from) {
+    pending.pop_back();
+  }
+  // Bytes fed later may arrive before the last RX event already posted
+  if (eventsThrough_ >= from) {
+    eventsThrough_ = from ? from - 1 : 0;
+  }
+}
+
+int HardwareSerial::available() {
+  sim::RxQueue& q = rx();
+  q.settle(sim::now(), sim::current());
+  return (int)q.ready.size();
+}
+
+int HardwareSerial::peek() {
+  if (!available()) {
+    return -1;
+  }
+  return rx().ready.front();
+}
+
+int HardwareSerial::read() {
+  if (!available()) {
+    return -1;
+  }
+  sim::RxQueue& q = rx();
+  uint8_t c = q.ready.front();
+  q.ready.pop_front();
+  return c;
+}
+
+size_t HardwareSerial::read(uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (n < size && available()) {
+    buffer[n++] = (uint8_t)read();
+  }
+  return n;
+}
+
+void HardwareSerial::flush() {
+  sim::TxFifo& t = tx();
+  if (t.busyUntil > sim::now()) {
+    sim::busyWait(t.busyUntil - sim::now());
+  }
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  tx().write(size);
+  if (uart_nr_ == 0) {
+    sim::trace(sim::TRACE_SERIAL_TX, buffer, size);
+    if (sim::config().echoSerial) {
+      sim::Device* dev = sim::current();
+      for (size_t i = 0; i < size; i++) {
+        if (buffer[i] == '\n') {
+          ::printf("[%8.3f %s] %s\n", sim::now() / 1e6, dev->name.c_str(), dev->usbLine.c_str());
+          dev->usbLine.clear();
+        } else if (buffer[i] != '\r') {
+          dev->usbLine += (char)buffer[i];
+        }
+      }
+    }
+  } else {
+    sim::trace(sim::TRACE_UART_TX, buffer, size);
+    if (simOnTx) {
+      simOnTx(buffer, size);
+    }
+  }
+  return size;
+}
+
+int HardwareSerial::availableForWrite() {
+  sim::TxFifo& t = tx();
+  sim::Micros now = sim::now();
+  size_t queued = t.busyUntil > now ? (size_t)((t.busyUntil - now) / t.byteUs()) : 0;
+  return queued >= t.fifo ? 0 : (int)(t.fifo - queued);
+}
@@ -0,0 +1,60 @@
+#include "sim/Heap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim/Sim.h"
+#include "src/HeapWatch.h"
+
+namespace sim {
+
+// multi_heap rounds every block up to 4 bytes and puts a header in front
+static uint32_t blockCost(size_t bytes) {
+  return (uint32_t)((bytes + 3) / 4 * 4) + HeapModel::BLOCK_HEADER;
+}
+
+void heapAllocated(size_t bytes) {
+  Device* dev = current();
+  HeapModel& h = dev->heap;
+  uint32_t cost = blockCost(bytes);
+  h.freeBytes = h.freeBytes > cost ? h.freeBytes - cost : 0;
+  if (h.freeBytes < h.minFreeBytes) {
+    h.minFreeBytes = h.freeBytes;
+  }
+  h.allocations++;
+  Task* task = currentTask();
+  for (size_t i = 0; i < h.watchedCount; i++) {
+    if (h.watched[i] == task) {
+      h.watchedAllocations++;
+      if (h.trap) {
+        fprintf(stderr, "%s: heap allocation of %zu bytes after setup()\n", dev->name.c_str(), bytes);
+        abort();
+      }
+      break;
+    }
+  }
+}
+
+void heapFreed(size_t bytes) {
+  HeapModel& h = current()->heap;
+  uint32_t cost = blockCost(bytes);
+  h.freeBytes = h.freeBytes + cost < HeapModel::SIZE ? h.freeBytes + cost : HeapModel::SIZE;
+}
+
+}  // namespace sim
+
+void heap_watch_arm(const TaskHandle_t* tasks, size_t count, bool trap) {
+  sim::HeapModel& h = sim::current()->heap;
+  h.watchedCount = 0;
+  for (size_t i = 0; i < count && h.watchedCount < sim::HeapModel::WATCH_TASKS; i++) {
+    if (tasks[i]) {
+      h.watched[h.watchedCount++] = (sim::Task*)tasks[i];
+    }
+  }
+  h.trap = trap;
+  h.watchedAllocations = 0;
+}
+
+uint32_t heap_watch_allocations() {
+  return sim::current()->heap.watchedAllocations;
+}
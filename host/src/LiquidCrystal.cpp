@@ -0,0 +1,108 @@
+#include "LiquidCrystal.h"
+
+#include <string.h>
+
+// HD44780 instructions
+#define LCD_CLEARDISPLAY 0x01
+#define LCD_RETURNHOME 0x02
+#define LCD_DISPLAYCONTROL 0x08
+#define LCD_SETCGRAMADDR 0x40
+#define LCD_SETDDRAMADDR 0x80
+
+// Enable pulse of the Arduino library: 1 us + 1 us + 100 us settle
+const uint32_t LCD_PULSE_US = 102;
+const uint32_t LCD_CLEAR_US = 2000;
+
+LiquidCrystal::LiquidCrystal(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t) {
+  memset(ddram_, ' ', sizeof(ddram_));
+}
+
+void LiquidCrystal::begin(uint8_t cols, uint8_t rows, uint8_t) {
+  cols_ = cols;
+  rows_ = rows;
+  // Power-on wait plus the 4-bit initialization sequence
+  delayMicroseconds(50000);
+  delayMicroseconds(4500 * 2 + 150);
+  send(0x28, false);  // Function set: 4-bit, 2 lines
+  send(LCD_DISPLAYCONTROL | 0x04, false);
+  clear();
+  send(0x06, false);  // Entry mode: increment, no shift
+}
+
+void LiquidCrystal::send(uint8_t value, bool isData) {
+  if (isData) {
+    if (!cgram_) {
+      ddram_[addr_ & 0x7F] = (char)value;
+      addr_ = (uint8_t)((addr_ + 1) & 0x7F);
+    }
+    dataWrites_++;
+    sim::trace(sim::TRACE_LCD_DATA, &value, 1);
+  } else {
+    if (value & LCD_SETDDRAMADDR) {
+      cgram_ = false;
+    } else if (value & LCD_SETCGRAMADDR) {
+      cgram_ = true;
+    }
+    commands_++;
+    sim::trace(sim::TRACE_LCD_CMD, &value, 1);
+  }
+  // Two nibbles per byte in 4-bit mode
+  delayMicroseconds(2 * LCD_PULSE_US);
+}
+
+void LiquidCrystal::clear() {
+  send(LCD_CLEARDISPLAY, false);
+  cgram_ = false;
+  memset(ddram_, ' ', sizeof(ddram_));
+  addr_ = 0;
+  delayMicroseconds(LCD_CLEAR_US);
+}
+
+void LiquidCrystal::home() {
+  send(LCD_RETURNHOME, false);
+  addr_ = 0;
+  delayMicroseconds(LCD_CLEAR_US);
+}
+
+void LiquidCrystal::noDisplay() { send(LCD_DISPLAYCONTROL, false); }
+void LiquidCrystal::display() { send(LCD_DISPLAYCONTROL | 0x04, false); }
+void LiquidCrystal::noCursor() { send(LCD_DISPLAYCONTROL | 0x04, false); }
+void LiquidCrystal::cursor() { send(LCD_DISPLAYCONTROL | 0x06, false); }
+void LiquidCrystal::noBlink() { send(LCD_DISPLAYCONTROL | 0x04, false); }
+void LiquidCrystal::blink() { send(LCD_DISPLAYCONTROL | 0x05, false); }
+
+void LiquidCrystal::setCursor(uint8_t col, uint8_t row) {
+  static const uint8_t rowOffsets[4] = { 0x00, 0x40, 0x00 + 16, 0x40 + 16 };
+  if (row >= rows_) {
+    row = rows_ - 1;
+  }
+  addr_ = (uint8_t)(col + rowOffsets[row & 3]);
+  send(LCD_SETDDRAMADDR | addr_, false);
+}
+
+void LiquidCrystal::createChar(uint8_t location, uint8_t charmap[]) {
+  send(LCD_SETCGRAMADDR | ((location & 0x7) << 3), false);
+  for (int i = 0; i < 8; i++) {
+    send(charmap[i], true);
+  }
+}
+
+void LiquidCrystal::command(uint8_t value) {
+  send(value, false);
+}
+
+size_t LiquidCrystal::write(uint8_t value) {
+  send(value, true);
+  return 1;
+}
+
+String LiquidCrystal::simRow(uint8_t row) const {
+  static const uint8_t rowOffsets[4] = { 0x00, 0x40, 0x00 + 16, 0x40 + 16 };
+  char line[41];
+  uint8_t base = rowOffsets[row & 3];
+  for (uint8_t i = 0; i < cols_ && i < 40; i++) {
+    line[i] = ddram_[(base + i) & 0x7F];
+  }
+  line[cols_ < 40 ? cols_ : 40] = '\0';
+  return String(line);
+}
@@ -0,0 +1,148 @@
+#include "LittleFS.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "sim/Sim.h"
+
+fs::LittleFSFS LittleFS;
+
+namespace fs {
+
+File::File(FILE* f, const std::string& path)
+  : file_(f, fclose), path_(path) {
+  long pos = ftell(f);
+  start_ = pos > 0 ? (size_t)pos : 0;
+}
+
+int File::available() {
+  if (!file_) {
+    return 0;
+  }
+  long pos = ftell(file_.get());
+  size_t total = size();
+  return pos >= 0 && (size_t)pos < total ? (int)(total - pos) : 0;
+}
+
+int File::read() {
+  if (!file_) {
+    return -1;
+  }
+  int c = fgetc(file_.get());
+  return c == EOF ? -1 : c;
+}
+
+int File::peek() {
+  int c = read();
+  if (c >= 0) {
+    ungetc(c, file_.get());
+  }
+  return c;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+  return file_ ? fread(buffer, 1, size, file_.get()) : 0;
+}
+
+size_t File::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+  if (!file_ || !size) {
+    return 0;
+  }
+  const size_t sector = 4096;
+  size_t first = (start_ + written_) / sector;
+  size_t last = (start_ + written_ + size - 1) / sector;
+  size_t n = fwrite(buffer, 1, size, file_.get());
+  written_ += n;
+  // Each sector the write reaches into is programmed once; appends of
+  // whole sectors cost one sector each
+  sim::busyWait((last - first + 1) * sim::config().flashSectorUs);
+  return n;
+}
+
+void File::flush() {
+  if (file_) {
+    fflush(file_.get());
+  }
+}
+
+size_t File::size() const {
+  struct stat st;
+  if (!file_ || fstat(fileno(file_.get()), &st) != 0) {
+    return 0;
+  }
+  return (size_t)st.st_size;
+}
+
+void File::close() {
+  file_.reset();
+}
+
+std::string FS::hostPath(const char* path) {
+  const std::string& dir = sim::current()->flashDir;
+  if (dir.empty()) {
+    return std::string();
+  }
+  return dir + (path[0] == '/' ? "" : "/") + path;
+}
+
+File FS::open(const char* path, const char* mode, const bool) {
+  std::string host = hostPath(path);
+  if (host.empty()) {
+    return File();
+  }
+  std::string m = std::string(mode) + "b";
+  FILE* f = fopen(host.c_str(), m.c_str());
+  return f ? File(f, path) : File();
+}
+
+bool FS::exists(const char* path) {
+  std::string host = hostPath(path);
+  struct stat st;
+  return !host.empty() && stat(host.c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path) {
+  std::string host = hostPath(path);
+  return !host.empty() && ::remove(host.c_str()) == 0;
+}
+
+bool LittleFSFS::begin(bool formatOnFail, const char*, uint8_t, const char*) {
+  const std::string& dir = sim::current()->flashDir;
+  if (dir.empty()) {
+    return false;
+  }
+  struct stat st;
+  if (stat(dir.c_str(), &st) == 0) {
+    return S_ISDIR(st.st_mode);
+  }
+  return formatOnFail && mkdir(dir.c_str(), 0777) == 0;
+}
+
+size_t LittleFSFS::totalBytes() {
+  return sim::config().flashBytes;
+}
+
+size_t LittleFSFS::usedBytes() {
+  const std::string& dir = sim::current()->flashDir;
+  DIR* d = dir.empty() ? nullptr : opendir(dir.c_str());
+  if (!d) {
+    return 0;
+  }
+  size_t used = 0;
+  struct dirent* e;
+  while ((e = readdir(d)) != nullptr) {
+    struct stat st;
+    std::string path = dir + "/" + e->d_name;
+    if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+      used += ((size_t)st.st_size + 4095) / 4096 * 4096;
+    }
+  }
+  closedir(d);
+  return used;
+}
+
+}  // namespace fs
@@ -0,0 +1,34 @@
+#include "sim/NmeaFeed.h"
+
+#include <fstream>
+
+namespace sim {
+
+static bool isSentence(const std::string& line, const char* type) {
+  return line.size() > 6 && line[0] == '$' && line.compare(3, 3, type) == 0;
+}
+
+bool NmeaFeed::load(const char* path) {
+  std::ifstream in(path);
+  if (!in) {
+    return false;
+  }
+  lines_.clear();
+  epochStart_.clear();
+  std::string line;
+  while (std::getline(in, line)) {
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
+      line.pop_back();
+    }
+    if (line.empty()) {
+      continue;
+    }
+    if (isSentence(line, "RMC") || epochStart_.empty()) {
+      epochStart_.push_back(lines_.size());
+    }
+    lines_.push_back(line + "\r\n");
+  }
+  return !lines_.empty();
+}
+
+}  // namespace sim
@@ -0,0 +1,81 @@
+#include <map>
+
+#include "driver/gpio.h"
+#include "esp_bt.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "sim/Sim.h"
+
+struct esp_pm_lock {
+  sim::Device* device;
+  esp_pm_lock_type_t type;
+  int count;
+};
+
+// Pins armed by gpio_wakeup_enable(), per device, until esp_sleep_enable_gpio_wakeup()
+static std::map<sim::Device*, uint64_t> g_wakeArmed;
+
+esp_err_t esp_pm_configure(const void* config) {
+  if (!config) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  sim::current()->lightSleep = ((const esp_pm_config_esp32_t*)config)->light_sleep_enable;
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int, const char*, esp_pm_lock_handle_t* out_handle) {
+  if (!out_handle) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *out_handle = new esp_pm_lock{ sim::current(), lock_type, 0 };
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) {
+  if (!handle) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (handle->count++ == 0 && handle->type == ESP_PM_NO_LIGHT_SLEEP) {
+    handle->device->pmLocks++;
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) {
+  if (!handle) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (handle->count == 0) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (--handle->count == 0 && handle->type == ESP_PM_NO_LIGHT_SLEEP) {
+    handle->device->pmLocks--;
+  }
+  return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio_num, gpio_int_type_t intr_type) {
+  if (gpio_num < 0 || gpio_num >= 64 || (intr_type != GPIO_INTR_LOW_LEVEL && intr_type != GPIO_INTR_HIGH_LEVEL)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  g_wakeArmed[sim::current()] |= 1ULL << gpio_num;
+  return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_disable(gpio_num_t gpio_num) {
+  if (gpio_num < 0 || gpio_num >= 64) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  g_wakeArmed[sim::current()] &= ~(1ULL << gpio_num);
+  sim::current()->wakePins &= ~(1ULL << gpio_num);
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup() {
+  sim::current()->wakePins = g_wakeArmed[sim::current()];
+  return ESP_OK;
+}
+
+esp_err_t esp_bt_sleep_enable() {
+  return ESP_OK;
+}
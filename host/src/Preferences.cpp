@@ -0,0 +1,158 @@
+#include "Preferences.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <vector>
+
+#include "sim/Sim.h"
+
+namespace {
+
+typedef std::map<std::string, std::vector<uint8_t>> Keys;  // "namespace/key" to value
+
+struct Store {
+  bool loaded = false;
+  Keys keys;
+};
+
+std::map<sim::Device*, Store> stores;
+
+std::string nvsDir() {
+  const std::string& dir = sim::current()->flashDir;
+  return dir.empty() ? std::string() : dir + "/nvs";
+}
+
+// File of a key, "namespace.key" in the nvs directory
+std::string keyPath(const std::string& id) {
+  std::string file = id;
+  file[file.find('/')] = '.';
+  return nvsDir() + "/" + file;
+}
+
+// The device's keys, read from its nvs directory the first time
+Keys& keys() {
+  Store& store = stores[sim::current()];
+  if (store.loaded) {
+    return store.keys;
+  }
+  store.loaded = true;
+  std::string dir = nvsDir();
+  DIR* d = dir.empty() ? nullptr : opendir(dir.c_str());
+  if (!d) {
+    return store.keys;
+  }
+  struct dirent* e;
+  while ((e = readdir(d)) != nullptr) {
+    std::string name = e->d_name;
+    size_t dot = name.find('.');
+    if (dot == std::string::npos || dot == 0) {
+      continue;
+    }
+    FILE* f = fopen((dir + "/" + name).c_str(), "rb");
+    if (!f) {
+      continue;
+    }
+    std::vector<uint8_t> value;
+    int c;
+    while ((c = fgetc(f)) != EOF) {
+      value.push_back((uint8_t)c);
+    }
+    fclose(f);
+    name[dot] = '/';
+    store.keys[name] = value;
+  }
+  closedir(d);
+  return store.keys;
+}
+
+}  // namespace
+
+bool Preferences::begin(const char* name, bool readOnly, const char*) {
+  if (!name || !*name || strlen(name) > 15 || strchr(name, '.') || strchr(name, '/')) {
+    return false;  // NVS namespaces are at most 15 characters
+  }
+  name_ = name;
+  readOnly_ = readOnly;
+  open_ = true;
+  keys();
+  return true;
+}
+
+void Preferences::end() {
+  open_ = false;
+}
+
+bool Preferences::clear() {
+  if (!open_ || readOnly_) {
+    return false;
+  }
+  Keys& k = keys();
+  std::string prefix = name_ + "/";
+  for (Keys::iterator it = k.begin(); it != k.end();) {
+    if (it->first.compare(0, prefix.size(), prefix) == 0) {
+      if (!nvsDir().empty()) {
+        ::remove(keyPath(it->first).c_str());
+      }
+      it = k.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return true;
+}
+
+bool Preferences::remove(const char* key) {
+  if (!open_ || readOnly_ || !keys().erase(name_ + "/" + key)) {
+    return false;
+  }
+  if (!nvsDir().empty()) {
+    ::remove(keyPath(name_ + "/" + key).c_str());
+  }
+  return true;
+}
+
+bool Preferences::isKey(const char* key) {
+  return open_ && keys().count(name_ + "/" + key) > 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+  if (!open_ || readOnly_ || !key || strlen(key) > 15 || !value || !len) {
+    return 0;
+  }
+  std::string id = name_ + "/" + key;
+  keys()[id].assign((const uint8_t*)value, (const uint8_t*)value + len);
+  std::string dir = nvsDir();
+  if (!dir.empty()) {
+    mkdir(sim::current()->flashDir.c_str(), 0777);
+    mkdir(dir.c_str(), 0777);
+    FILE* f = fopen(keyPath(id).c_str(), "wb");
+    if (f) {
+      fwrite(value, 1, len, f);
+      fclose(f);
+    }
+  }
+  sim::busyWait(sim::config().nvsWriteUs);
+  return len;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  if (!open_) {
+    return 0;
+  }
+  Keys& k = keys();
+  Keys::const_iterator it = k.find(name_ + "/" + key);
+  return it == k.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+  size_t len = getBytesLength(key);
+  if (!len || !buf || len > maxLen) {
+    return 0;
+  }
+  memcpy(buf, keys()[name_ + "/" + key].data(), len);
+  return len;
+}
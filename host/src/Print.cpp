@@ -0,0 +1,93 @@
+#include "Print.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sim/Heap.h"
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::write(const char* str) {
+  return str ? write((const uint8_t*)str, strlen(str)) : 0;
+}
+
+size_t Print::printf(const char* format, ...) {
+  char loc[64];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(loc, sizeof(loc), format, args);
+  va_end(args);
+  if (len < 0) {
+    return 0;
+  }
+  if ((size_t)len < sizeof(loc)) {
+    return write((const uint8_t*)loc, len);
+  }
+  // The core mallocs anything longer than its stack buffer
+  sim::heapAllocated(len + 1);
+  char* buf = new char[len + 1];
+  va_start(args, format);
+  vsnprintf(buf, len + 1, format, args);
+  va_end(args);
+  size_t n = write((const uint8_t*)buf, len);
+  delete[] buf;
+  sim::heapFreed(len + 1);
+  return n;
+}
+
+size_t Print::printNumber(unsigned long n, int base, bool negative) {
+  char buf[8 * sizeof(long) + 2];
+  char* p = buf + sizeof(buf) - 1;
+  *p = '\0';
+  if (base < 2) {
+    base = 10;
+  }
+  do {
+    unsigned long digit = n % base;
+    *--p = (char)(digit < 10 ? '0' + digit : 'A' + digit - 10);
+    n /= base;
+  } while (n);
+  if (negative) {
+    *--p = '-';
+  }
+  return write(p);
+}
+
+size_t Print::print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+size_t Print::print(const char* s) { return write(s); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(unsigned char n, int base) { return printNumber(n, base, false); }
+size_t Print::print(unsigned int n, int base) { return printNumber(n, base, false); }
+size_t Print::print(unsigned long n, int base) { return printNumber(n, base, false); }
+size_t Print::print(int n, int base) { return print((long)n, base); }
+
+size_t Print::print(long n, int base) {
+  if (base == 10 && n < 0) {
+    return printNumber(-(unsigned long)n, 10, true);
+  }
+  return printNumber((unsigned long)n, base, false);
+}
+
+size_t Print::print(double n, int digits) {
+  char buf[64];
+  int len = snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return write((const uint8_t*)buf, len < (int)sizeof(buf) ? len : sizeof(buf) - 1);
+}
+
+size_t Print::println() { return write("\r\n"); }
+size_t Print::println(const String& s) { return print(s) + println(); }
+size_t Print::println(const char* s) { return print(s) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char n, int base) { return print(n, base) + println(); }
+size_t Print::println(int n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned int n, int base) { return print(n, base) + println(); }
+size_t Print::println(long n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned long n, int base) { return print(n, base) + println(); }
+size_t Print::println(double n, int digits) { return print(n, digits) + println(); }
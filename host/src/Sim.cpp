@@ -0,0 +1,455 @@
+#include "sim/Sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+namespace sim {
+
+const size_t TASK_STACK_SIZE = 256 * 1024;
+
+struct Task {
+  Device* device;
+  const char* name;
+  std::function<void()> body;
+  ucontext_t ctx;
+  char* stack;
+  int priority;
+  Micros wake = 0;         // Virtual time at which the task can run again
+  uint64_t order = 0;      // FIFO order among tasks ready at the same time
+  bool busy = false;       // Waiting in busyWait() rather than blocked
+  bool done = false;
+  WaitList* waitingOn = nullptr;
+  uint64_t cpuNs = 0;
+  uint64_t wallNs = 0;     // Host wall time spent running, see taskClockNs()
+  uint32_t notifyValue = 0;
+  WaitList notifyWait;
+};
+
+static Config g_config;
+static Micros g_now = 0;
+static uint64_t g_order = 0;
+static std::vector<Task*> g_tasks;
+static std::vector<Device*> g_devices;
+static Task* g_running = nullptr;
+static ucontext_t g_schedulerCtx;
+static uint64_t g_sliceStartNs = 0;
+static uint64_t g_sliceStartWallNs = 0;
+static std::function<void(const TraceEvent&)> g_trace;
+static Device g_hostDevice("host");
+
+Config& config() {
+  return g_config;
+}
+
+LinkEmulator& btEmulator() {
+  static LinkEmulator emulator;
+  return emulator;
+}
+
+static uint64_t threadCpuNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t wallNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void RxQueue::push(Micros at, uint8_t b) {
+  if (pending.empty() || pending.back().first <= at) {
+    pending.push_back(std::make_pair(at, b));
+    return;
+  }
+  // Overtaken on the way, e.g. by the link emulator holding a write back
+  std::deque<std::pair<Micros, uint8_t>>::iterator it = pending.end();
+  while (it != pending.begin() && (it - 1)->first > at) {
+    --it;
+  }
+  pending.insert(it, std::make_pair(at, b));
+}
+
+void RxQueue::settle(Micros t, Device* owner) {
+  size_t lost = 0;
+  while (!pending.empty() && pending.front().first <= t) {
+    if (sleepLoses && owner && owner->asleepAt(pending.front().first)) {
+      lostAsleep++;
+    } else if (ready.size() < capacity) {
+      ready.push_back(pending.front().second);
+    } else {
+      lost++;
+    }
+    pending.pop_front();
+  }
+  if (lost) {
+    dropped += lost;
+    if (g_trace) {
+      TraceEvent ev = { t, owner, TRACE_UART_DROP, nullptr, lost };
+      g_trace(ev);
+    }
+  }
+}
+
+void TxFifo::write(size_t n) {
+  Micros t = now();
+  Micros per = byteUs();
+  if (busyUntil < t) {
+    busyUntil = t;
+  }
+  size_t queued = (size_t)((busyUntil - t + per - 1) / per);
+  if (queued + n > fifo) {
+    busyWait((queued + n - fifo) * per);
+  }
+  busyUntil += n * per;
+}
+
+Device::Device(const char* deviceName)
+  : name(deviceName) {
+  // Locally administered address derived from the name
+  uint32_t h = 2166136261u;
+  for (const char* p = deviceName; *p; p++) {
+    h = (h ^ (uint8_t)*p) * 16777619u;
+  }
+  btAddress[0] = 0x02;
+  btAddress[1] = 0x00;
+  btAddress[2] = (uint8_t)(h >> 24);
+  btAddress[3] = (uint8_t)(h >> 16);
+  btAddress[4] = (uint8_t)(h >> 8);
+  btAddress[5] = (uint8_t)h;
+  memset(pins, 0, sizeof(pins));
+  usbRx.capacity = 256;
+  if (strcmp(deviceName, "host") != 0) {
+    g_devices.push_back(this);
+  }
+}
+
+bool Device::asleepAt(Micros t) const {
+  if (quietSleeps && quietFrom != FOREVER && t >= quietFrom) {
+    return true;
+  }
+  for (size_t i = sleepSpans.size(); i-- > 0;) {
+    if (t >= sleepSpans[i].first && t < sleepSpans[i].second) {
+      return true;
+    }
+    if (t >= sleepSpans[i].second) {
+      break;
+    }
+  }
+  return false;
+}
+
+void Device::start(std::function<void()> setupFn, std::function<void()> loopFn) {
+  Device* self = this;
+  spawn(this, "loopTask", [self, setupFn, loopFn]() {
+    setupFn();
+    for (;;) {
+      uint64_t cpu0 = taskCpuNs();
+      Micros start = now();
+      loopFn();
+      uint64_t cpu = taskCpuNs() - cpu0;
+      self->loops++;
+      if (self->onLoop) {
+        self->onLoop(cpu, start, now());
+      }
+      if (now() == start) {
+        busyWait(g_config.loopQuantumUs);
+      } else {
+        yield();
+      }
+    }
+  });
+}
+
+void Device::post(Micros at, std::function<void()> fn) {
+  if (!sysTask) {
+    Device* self = this;
+    sysTask = spawn(this, "sysTask", [self]() {
+      for (;;) {
+        while (!self->sysQueue.empty() && self->sysQueue.begin()->first <= now()) {
+          std::function<void()> job = self->sysQueue.begin()->second;
+          self->sysQueue.erase(self->sysQueue.begin());
+          job();
+        }
+        if (self->sysQueue.empty()) {
+          wait(self->sysWait, FOREVER);
+        } else {
+          wait(self->sysWait, self->sysQueue.begin()->first - now());
+        }
+      }
+    }, 20);
+  }
+  sysQueue.insert(std::make_pair(at < g_now ? g_now : at, fn));
+  notifyAll(sysWait);
+}
+
+Micros now() {
+  return g_now;
+}
+
+Device* current() {
+  return g_running ? g_running->device : &g_hostDevice;
+}
+
+Micros deviceNow() {
+  return g_now + current()->clockOffsetUs;
+}
+
+// Hands control back to the scheduler until the task is picked again
+static void switchOut() {
+  Task* self = g_running;
+  if (!self) {
+    fprintf(stderr, "sim: blocking call outside of a task\n");
+    abort();
+  }
+  self->order = ++g_order;
+  swapcontext(&self->ctx, &g_schedulerCtx);
+}
+
+void sleep(Micros us) {
+  if (!g_running) {
+    g_now += us;
+    return;
+  }
+  g_running->wake = g_now + us;
+  switchOut();
+}
+
+void busyWait(Micros us) {
+  if (!g_running) {
+    g_now += us;
+    return;
+  }
+  Task* self = g_running;
+  self->wake = g_now + us;
+  self->busy = true;
+  self->device->busyTasks++;
+  switchOut();
+  self->busy = false;
+  self->device->busyTasks--;
+}
+
+void yield() {
+  sleep(0);
+}
+
+bool wait(WaitList& list, Micros timeout) {
+  Task* self = g_running;
+  if (!self) {
+    return false;
+  }
+  self->waitingOn = &list;
+  list.waiters.push_back(self);
+  self->wake = (timeout == FOREVER) ? FOREVER : g_now + timeout;
+  switchOut();
+  if (self->waitingOn) {
+    // Timed out: still on the list
+    for (size_t i = 0; i < list.waiters.size(); i++) {
+      if (list.waiters[i] == self) {
+        list.waiters.erase(list.waiters.begin() + i);
+        break;
+      }
+    }
+    self->waitingOn = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void notifyAll(WaitList& list) {
+  for (size_t i = 0; i < list.waiters.size(); i++) {
+    Task* t = list.waiters[i];
+    t->waitingOn = nullptr;
+    t->wake = g_now;
+    t->order = ++g_order;
+  }
+  list.waiters.clear();
+}
+
+static void taskEntry(unsigned int hi, unsigned int lo) {
+  Task* t = (Task*)(((uintptr_t)hi << 32) | (uintptr_t)lo);
+  t->body();
+  t->done = true;
+  swapcontext(&t->ctx, &g_schedulerCtx);
+}
+
+Task* spawn(Device* device, const char* name, std::function<void()> body, int priority) {
+  Task* t = new Task();
+  t->device = device;
+  t->name = name;
+  t->body = body;
+  t->priority = priority;
+  t->wake = g_now;
+  t->order = ++g_order;
+  t->stack = (char*)malloc(TASK_STACK_SIZE);
+  getcontext(&t->ctx);
+  t->ctx.uc_stack.ss_sp = t->stack;
+  t->ctx.uc_stack.ss_size = TASK_STACK_SIZE;
+  t->ctx.uc_link = nullptr;
+  uintptr_t p = (uintptr_t)t;
+  makecontext(&t->ctx, (void (*)())taskEntry, 2, (unsigned int)(p >> 32), (unsigned int)p);
+  g_tasks.push_back(t);
+  return t;
+}
+
+Task* currentTask() {
+  return g_running;
+}
+
+void exitTask(Task* task) {
+  if (!task) {
+    task = g_running;
+  }
+  if (!task) {
+    return;
+  }
+  task->done = true;
+  if (task == g_running) {
+    switchOut();
+  }
+}
+
+void notifyGive(Task* task) {
+  if (task) {
+    task->notifyValue++;
+    notifyAll(task->notifyWait);
+  }
+}
+
+uint32_t notifyTake(bool clearOnExit, Micros timeout) {
+  Task* self = g_running;
+  if (!self) {
+    return 0;
+  }
+  if (self->notifyValue == 0 && timeout > 0) {
+    wait(self->notifyWait, timeout);
+  }
+  uint32_t value = self->notifyValue;
+  if (value > 0) {
+    self->notifyValue = clearOnExit ? 0 : value - 1;
+  }
+  return value;
+}
+
+uint64_t taskCpuNs() {
+  if (!g_running) {
+    return threadCpuNs();
+  }
+  return g_running->cpuNs + (threadCpuNs() - g_sliceStartNs);
+}
+
+uint64_t taskClockNs() {
+  if (!g_running) {
+    return wallNs();
+  }
+  return g_running->wallNs + (wallNs() - g_sliceStartWallNs);
+}
+
+// Charges the interval [g_now, to) to each device as busy or idle time
+static void advanceTo(Micros to) {
+  if (to <= g_now) {
+    return;
+  }
+  Micros dt = to - g_now;
+  for (size_t i = 0; i < g_devices.size(); i++) {
+    if (g_devices[i]->busyTasks > 0) {
+      g_devices[i]->busyUs += dt;
+    } else {
+      g_devices[i]->idleUs += dt;
+    }
+  }
+  g_now = to;
+}
+
+// Ends a device's idle stretch as one of its tasks is about to run
+static void wakeDevice(Device* d) {
+  if (d->quietFrom == FOREVER) {
+    return;
+  }
+  if (d->quietSleeps && g_now > d->quietFrom) {
+    Micros span = g_now - d->quietFrom;
+    d->sleepUs += span > g_config.lightSleepWakeUs ? span - g_config.lightSleepWakeUs : 0;
+    d->sleeps++;
+    d->sleepSpans.push_back(std::make_pair(d->quietFrom, g_now + g_config.lightSleepWakeUs));
+    if (d->sleepSpans.size() > 64) {
+      d->sleepSpans.pop_front();
+    }
+  }
+  d->quietFrom = FOREVER;
+}
+
+// Starts an idle stretch after one of a device's tasks ran, and decides
+// whether the idle task would light-sleep through it: the driver events of
+// the system task are interrupts, so only the other tasks' timers count
+static void quietDevice(Device* d) {
+  d->quietFrom = g_now;
+  d->quietSleeps = false;
+  if (!d->lightSleep || d->pmLocks > 0 || d->busyTasks > 0) {
+    return;
+  }
+  for (size_t i = 0; i < g_tasks.size(); i++) {
+    Task* t = g_tasks[i];
+    if (t->device == d && !t->done && t != d->sysTask && t->wake < g_now + g_config.lightSleepMinUs) {
+      return;
+    }
+  }
+  d->quietSleeps = true;
+}
+
+void run(Micros until) {
+  for (;;) {
+    Task* next = nullptr;
+    for (size_t i = 0; i < g_tasks.size(); i++) {
+      Task* t = g_tasks[i];
+      if (t->done || t->device->halted || t->wake == FOREVER) {
+        continue;
+      }
+      if (!next || t->wake < next->wake ||
+          (t->wake == next->wake && (t->priority > next->priority ||
+                                     (t->priority == next->priority && t->order < next->order)))) {
+        next = t;
+      }
+    }
+    if (!next || next->wake > until) {
+      if (until != FOREVER) {
+        advanceTo(until);
+      }
+      return;
+    }
+    advanceTo(next->wake);
+    wakeDevice(next->device);
+    g_running = next;
+    g_sliceStartNs = threadCpuNs();
+    g_sliceStartWallNs = wallNs();
+    swapcontext(&g_schedulerCtx, &next->ctx);
+    next->cpuNs += threadCpuNs() - g_sliceStartNs;
+    next->wallNs += wallNs() - g_sliceStartWallNs;
+    g_running = nullptr;
+    quietDevice(next->device);
+  }
+}
+
+void halt() {
+  Device* dev = current();
+  dev->halted = true;
+  if (g_running) {
+    switchOut();
+  }
+}
+
+void setTrace(std::function<void(const TraceEvent&)> hook) {
+  g_trace = hook;
+}
+
+void trace(TraceKind kind, const uint8_t* data, size_t len) {
+  if (g_trace) {
+    TraceEvent ev = { g_now, current(), kind, data, len };
+    g_trace(ev);
+  }
+}
+
+}  // namespace sim
@@ -0,0 +1,81 @@
+// Runs a single sketch on a simulated ESP32 with Serial echoed to stdout and
+// a recorded NMEA file played into its GPS UART by a simulated receiver.
+//
+// --usb FILE also writes the raw Serial bytes to FILE, e.g. binary log
+// records (LOG_BINARY=1) for host/tools/log_decode.
+// --flash DIR keeps the device's LittleFS partition in the host directory
+// DIR, e.g. for captures (CAPTURE=1) to replay with host/tools/replay.
+//
+// Usage: <sketch> [--nmea FILE] [--gps nmea|mtk|ubx] [--seconds N] [--usb FILE] [--flash DIR]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Arduino.h"
+#include "sim/GpsReceiver.h"
+#include "sim/NmeaFeed.h"
+#include "sim/Sim.h"
+
+void setup();
+void loop();
+extern HardwareSerial gpsSerial;
+
+int main(int argc, char** argv) {
+  const char* nmea = SKETCH_NMEA;
+  double seconds = 30;
+  const char* usbPath = nullptr;
+  const char* flashDir = nullptr;
+  sim::GpsReceiver::Commands commands = sim::GpsReceiver::MTK;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--nmea") && i + 1 < argc) {
+      nmea = argv[++i];
+    } else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--usb") && i + 1 < argc) {
+      usbPath = argv[++i];
+    } else if (!strcmp(argv[i], "--flash") && i + 1 < argc) {
+      flashDir = argv[++i];
+    } else if (!strcmp(argv[i], "--gps") && i + 1 < argc && sim::GpsReceiver::parseCommands(argv[i + 1], &commands)) {
+      i++;
+    } else {
+      fprintf(stderr, "usage: %s [--nmea FILE] [--gps nmea|mtk|ubx] [--seconds N] [--usb FILE] [--flash DIR]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  sim::config().echoSerial = true;
+  FILE* usb = nullptr;
+  if (usbPath) {
+    usb = fopen(usbPath, "wb");
+    if (!usb) {
+      fprintf(stderr, "cannot write %s\n", usbPath);
+      return 1;
+    }
+    sim::setTrace([usb](const sim::TraceEvent& ev) {
+      if (ev.kind == sim::TRACE_SERIAL_TX) {
+        fwrite(ev.data, 1, ev.len, usb);
+      }
+    });
+  }
+  sim::Device device(SKETCH_NAME);
+  if (flashDir) {
+    device.flashDir = flashDir;
+  }
+
+  sim::NmeaFeed feed;
+  if (!feed.load(nmea)) {
+    fprintf(stderr, "cannot read %s\n", nmea);
+    return 1;
+  }
+  sim::GpsReceiver receiver(feed, gpsSerial, device, commands);
+  receiver.start(0);
+
+  device.start(setup, loop);
+  sim::run((sim::Micros)(seconds * 1e6));
+  if (usb) {
+    fclose(usb);
+  }
+  return 0;
+}
@@ -0,0 +1,123 @@
+#include "WString.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static String::Storage toBase(unsigned long value, unsigned char base, bool negative) {
+  char buf[8 * sizeof(long) + 2];
+  char* p = buf + sizeof(buf) - 1;
+  *p = '\0';
+  if (base < 2) {
+    base = 10;
+  }
+  do {
+    unsigned long digit = value % base;
+    *--p = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+    value /= base;
+  } while (value);
+  if (negative) {
+    *--p = '-';
+  }
+  return String::Storage(p);
+}
+
+String::String(int value, unsigned char base)
+  : s_(base == 10 && value < 0 ? toBase(-(long)value, 10, true) : toBase((unsigned int)value, base, false)) {}
+
+String::String(unsigned int value, unsigned char base)
+  : s_(toBase(value, base, false)) {}
+
+String::String(long value, unsigned char base)
+  : s_(base == 10 && value < 0 ? toBase(-(unsigned long)value, 10, true) : toBase((unsigned long)value, base, false)) {}
+
+String::String(unsigned long value, unsigned char base)
+  : s_(toBase(value, base, false)) {}
+
+String::String(float value, unsigned int decimalPlaces)
+  : String((double)value, decimalPlaces) {}
+
+String::String(double value, unsigned int decimalPlaces) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, value);
+  s_ = buf;
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+  size_t pos = s_.find(ch, fromIndex);
+  return pos == String::Storage::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String& str, unsigned int fromIndex) const {
+  size_t pos = s_.find(str.s_, fromIndex);
+  return pos == String::Storage::npos ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(char ch) const {
+  size_t pos = s_.rfind(ch);
+  return pos == String::Storage::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int beginIndex) const {
+  return substring(beginIndex, (unsigned int)s_.length());
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) {
+    unsigned int tmp = beginIndex;
+    beginIndex = endIndex;
+    endIndex = tmp;
+  }
+  if (beginIndex >= s_.length()) {
+    return String();
+  }
+  if (endIndex > s_.length()) {
+    endIndex = (unsigned int)s_.length();
+  }
+  return String(s_.substr(beginIndex, endIndex - beginIndex));
+}
+
+bool String::startsWith(const String& prefix) const {
+  return s_.compare(0, prefix.s_.length(), prefix.s_) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+  return s_.length() >= suffix.s_.length() &&
+         s_.compare(s_.length() - suffix.s_.length(), suffix.s_.length(), suffix.s_) == 0;
+}
+
+void String::trim() {
+  size_t begin = 0;
+  while (begin < s_.length() && isspace((unsigned char)s_[begin])) {
+    begin++;
+  }
+  size_t end = s_.length();
+  while (end > begin && isspace((unsigned char)s_[end - 1])) {
+    end--;
+  }
+  s_ = s_.substr(begin, end - begin);
+}
+
+void String::toUpperCase() {
+  for (size_t i = 0; i < s_.length(); i++) {
+    s_[i] = (char)toupper((unsigned char)s_[i]);
+  }
+}
+
+void String::toLowerCase() {
+  for (size_t i = 0; i < s_.length(); i++) {
+    s_[i] = (char)tolower((unsigned char)s_[i]);
+  }
+}
+
+long String::toInt() const {
+  return atol(s_.c_str());
+}
+
+float String::toFloat() const {
+  return (float)atof(s_.c_str());
+}
+
+double String::toDouble() const {
+  return atof(s_.c_str());
+}
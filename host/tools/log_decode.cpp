@@ -0,0 +1,88 @@
+// Turns a Serial capture from either sketch into readable text:
+//   - binary log records (LOG_BINARY=1, see src/EventLog.h) are formatted
+//     with the event table in src/LogEvents.h, one line each, prefixed
+//     with the device timestamp in seconds
+//   - profiler dumps (src/Profiler.h) are replaced by a one-line note
+//   - everything else, such as the sketches' direct prints, passes through
+//
+// Bytes that look like a record but fail the CRC are passed through as
+// text, so a corrupted record costs one line and decoding resyncs on the
+// next one.
+//
+// Usage: log_decode [FILE]   (standard input if no file is given)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#define PROF_CYCLES() 0u  // Only the dump framing is used here
+#include "src/LogEvents.h"
+#include "src/Profiler.h"
+
+int main(int argc, char** argv) {
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [FILE]\n", argv[0]);
+    return 2;
+  }
+  FILE* in = stdin;
+  if (argc == 2) {
+    in = fopen(argv[1], "rb");
+    if (!in) {
+      fprintf(stderr, "cannot read %s\n", argv[1]);
+      return 1;
+    }
+  }
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+    data.insert(data.end(), chunk, chunk + got);
+  }
+  if (in != stdin) {
+    fclose(in);
+  }
+
+  const uint8_t* b = data.data();
+  size_t n = data.size();
+  size_t records = 0, dumps = 0;
+  bool lineStart = true;
+  size_t i = 0;
+  while (i < n) {
+    if (b[i] == FRAME_SYNC0 && i + 4 <= n && b[i + 1] == LOG_MARKER && b[i + 3] <= LOG_MAX_ARGS) {
+      size_t len = 8 + 4 * (size_t)b[i + 3] + 2;
+      if (i + len <= n && stream_check_crc(b + i, len)) {
+        LogEvent ev;
+        ev.id = b[i + 2];
+        ev.argc = b[i + 3];
+        ev.ms = frame_get32(b + i + 4);
+        for (uint8_t a = 0; a < ev.argc; a++) {
+          ev.args[a] = frame_get32(b + i + 8 + 4 * a);
+        }
+        char line[LOG_LINE_MAX];
+        log_format(ev, LOG_FORMATS, LOG_EVENT_COUNT, line);
+        printf("%s[%8.3f] %s\n", lineStart ? "" : "\n", ev.ms / 1000.0, line);
+        lineStart = true;
+        records++;
+        i += len;
+        continue;
+      }
+    }
+    if (b[i] == FRAME_SYNC0 && i + 4 <= n && b[i + 1] == PROF_MARKER) {
+      size_t len = (size_t)frame_get16(b + i + 2) + 6;
+      if (i + len <= n && stream_check_crc(b + i, len)) {
+        printf("%s[profile dump, %zu bytes]\n", lineStart ? "" : "\n", len);
+        lineStart = true;
+        dumps++;
+        i += len;
+        continue;
+      }
+    }
+    putchar(b[i]);
+    lineStart = b[i] == '\n';
+    i++;
+  }
+  fprintf(stderr, "%zu log records, %zu profile dumps\n", records, dumps);
+  return 0;
+}
@@ -0,0 +1,316 @@
+// Replays a capture (CAPTURE=1, see src/Capture.h) through the sketch that
+// recorded it, on the simulator:
+//   - GPS bytes go into the sketch's GPS UART at the recorded baud, timed
+//     to finish arriving when the sketch originally read them
+//   - on a client, a stand-in master connects over the simulated SPP link
+//     and sends the bytes the client received, timed to arrive when it
+//     read them
+//   - on a master, a stand-in client takes whatever the master sends; it
+//     listens from the start, so it connects sooner than in the capture
+// The sketches are built with GPS_CONFIG=0: the receiver dialogue is not
+// part of a capture, so the replay starts with the UART at the captured
+// baud as if the receiver had already been configured. Link connects and
+// disconnects are not captured either; the stand-in master connects once.
+// Captured times are when the sketch read the bytes, not when they arrived,
+// so the replay cannot reproduce the arrivals light sleep depends on. Every
+// captured byte was read once, so none are lost to light sleep here.
+//
+// Runs as fast as possible by default; --speed X paces the virtual clock at
+// X times real time, 1 = as recorded. Reports the records per source, the
+// throughput, the sketch's link output next to the captured one and a
+// digest of its link output and LCD writes with their times, so two builds
+// can be checked for the same behaviour on the same input. Clock frames
+// (src/LinkClock.h) carry the sketch's own timestamps, so the comparison
+// with the captured output leaves them out.
+//
+// Usage: replay CAPTURE [--speed X] [--seconds N] [--verbose]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Arduino.h"
+#include "BluetoothSerial.h"
+#include "LiquidCrystal.h"
+#include "sim/Sim.h"
+#include "src/Capture.h"
+#include "src/LinkClock.h"
+
+namespace master {
+void setup();
+void loop();
+extern HardwareSerial gpsSerial;
+}  // namespace master
+
+namespace client {
+void setup();
+void loop();
+extern HardwareSerial gpsSerial;
+extern LiquidCrystal lcd;
+}  // namespace client
+
+// MAC address the master sketch connects to
+static const uint8_t CLIENT_ADDRESS[6] = { 0x1C, 0x69, 0x20, 0xC6, 0x5E, 0x32 };
+
+// Link options the sketches are built with. Must match LINK_BINARY_FRAMES and LINK_DELTA_STREAM in the sketches.
+#ifndef LINK_BINARY_FRAMES
+#define LINK_BINARY_FRAMES 1
+#endif
+#ifndef LINK_DELTA_STREAM
+#define LINK_DELTA_STREAM 1
+#endif
+
+// Link bytes without the clock frames in them
+static std::vector<uint8_t> withoutClockFrames(const std::vector<uint8_t>& bytes) {
+  std::vector<uint8_t> out;
+  for (size_t i = 0; i < bytes.size();) {
+    if (i + CLOCK_FRAME_LEN <= bytes.size() && bytes[i] == FRAME_SYNC0 && bytes[i + 1] == CLOCK_MARKER &&
+        stream_check_crc(&bytes[i], CLOCK_FRAME_LEN)) {
+      i += CLOCK_FRAME_LEN;
+    } else {
+      out.push_back(bytes[i++]);
+    }
+  }
+  return out;
+}
+
+static const char* const SOURCE_NAMES[CAPTURE_SOURCES] = { "GPS RX", "BT RX", "BT TX", "meta" };
+
+// FNV-1a, 64 bits
+struct Digest {
+  uint64_t h = 0xCBF29CE484222325ULL;
+
+  void add(const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+      h = (h ^ p[i]) * 0x100000001B3ULL;
+    }
+  }
+};
+
+static double wallSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+  const char* path = nullptr;
+  double speed = 0;
+  double seconds = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--speed") && i + 1 < argc) {
+      speed = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--verbose")) {
+      sim::config().echoSerial = true;
+    } else if (argv[i][0] != '-' && !path) {
+      path = argv[i];
+    } else {
+      path = nullptr;
+      break;
+    }
+  }
+  if (!path) {
+    fprintf(stderr, "usage: %s CAPTURE [--speed X] [--seconds N] [--verbose]\n", argv[0]);
+    return 2;
+  }
+
+  FILE* in = fopen(path, "rb");
+  if (!in) {
+    fprintf(stderr, "cannot read %s\n", path);
+    return 1;
+  }
+  std::vector<uint8_t> file;
+  uint8_t chunk[4096];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+    file.insert(file.end(), chunk, chunk + got);
+  }
+  fclose(in);
+
+  CaptureReader reader(file.data(), file.size());
+  std::vector<CaptureRecord> records;
+  CaptureRecord rec;
+  uint64_t count[CAPTURE_SOURCES] = {}, bytes[CAPTURE_SOURCES] = {};
+  bool haveMeta = false;
+  uint8_t role = CAPTURE_CLIENT, linkFlags = 0;
+  unsigned long baud = 9600;
+  while (reader.next(&rec)) {
+    if (rec.source >= CAPTURE_SOURCES) {
+      continue;
+    }
+    count[rec.source]++;
+    bytes[rec.source] += rec.len;
+    if (rec.source == CAPTURE_META) {
+      if (!haveMeta && rec.len >= CAPTURE_META_LEN && rec.data[0] == CAPTURE_VERSION) {
+        role = rec.data[1];
+        linkFlags = rec.data[2];
+        baud = frame_get32(rec.data + 4);
+        haveMeta = true;
+      }
+      continue;
+    }
+    records.push_back(rec);
+  }
+  if (!haveMeta) {
+    fprintf(stderr, "%s: no capture header; assuming a client at %lu baud\n", path, baud);
+  }
+  uint8_t buildFlags = (LINK_BINARY_FRAMES ? CAPTURE_LINK_BINARY : 0) | (LINK_DELTA_STREAM ? CAPTURE_LINK_DELTA : 0);
+  if (haveMeta && linkFlags != buildFlags) {
+    fprintf(stderr, "warning: captured with link flags %u, replaying with %u\n", linkFlags, buildFlags);
+  }
+  sim::Micros spanUs = records.empty() ? 0 : records.back().timeUs;
+  if (seconds <= 0) {
+    seconds = spanUs / 1e6 + 2;
+  }
+  bool isMaster = role == CAPTURE_MASTER;
+
+  sim::Device dev(isMaster ? "master" : "client");
+  sim::Device peer(isMaster ? "client" : "replay");
+  memcpy(isMaster ? peer.btAddress : dev.btAddress, CLIENT_ADDRESS, 6);
+  HardwareSerial& gpsSerial = isMaster ? master::gpsSerial : client::gpsSerial;
+  gpsSerial.simSetSleepLoses(false);
+
+  // What the sketch sends and shows, for the comparison and the digest
+  std::vector<uint8_t> sentBytes, capturedTx;
+  Digest digest;
+  sim::setTrace([&](const sim::TraceEvent& ev) {
+    if (ev.device != &dev ||
+        (ev.kind != sim::TRACE_BT_TX && ev.kind != sim::TRACE_LCD_DATA && ev.kind != sim::TRACE_LCD_CMD)) {
+      return;
+    }
+    if (ev.kind == sim::TRACE_BT_TX) {
+      sentBytes.insert(sentBytes.end(), ev.data, ev.data + ev.len);
+    }
+    uint8_t kind = (uint8_t)ev.kind;
+    digest.add(&ev.time, sizeof(ev.time));
+    digest.add(&kind, 1);
+    digest.add(ev.data, ev.len);
+  });
+
+  // GPS bytes back to back at the captured baud, the last one arriving when
+  // the sketch read the chunk; one post per record keeps the UART's queue short
+  sim::Micros byteUs = 10000000ULL / baud;
+  sim::Micros gpsEnd = 0;
+  bool first = true;
+  for (size_t i = 0; i < records.size(); i++) {
+    const CaptureRecord& r = records[i];
+    if (r.source == CAPTURE_GPS_RX) {
+      sim::Micros start = r.timeUs > r.len * byteUs ? r.timeUs - r.len * byteUs : 0;
+      start = std::max(start, gpsEnd);
+      gpsEnd = start + r.len * byteUs;
+      dev.post(start, [&gpsSerial, r, start, baud, first]() {
+        if (first && gpsSerial.baudRate() != baud) {
+          gpsSerial.updateBaudRate(baud);
+        }
+        gpsSerial.simFeed(r.data, r.len, start, baud);
+      });
+      first = false;
+    } else if (r.source == CAPTURE_BT_TX) {
+      capturedTx.insert(capturedTx.end(), r.data, r.data + r.len);
+    }
+  }
+
+  // The other end of the link
+  BluetoothSerial link;
+  size_t nextRx = 0;
+  uint64_t sentRx = 0, late = 0;
+  uint8_t clientAddress[6];
+  memcpy(clientAddress, CLIENT_ADDRESS, 6);
+  if (isMaster) {
+    peer.start([&]() { link.begin("client"); },
+               [&]() {
+                 while (link.available()) {
+                   link.read();
+                 }
+                 sim::sleep(10000);
+               });
+  } else {
+    peer.start([&]() { link.begin("replay", true); },
+               [&]() {
+                 if (!link.connected()) {
+                   link.connect(clientAddress);
+                   return;
+                 }
+                 while (nextRx < records.size() && records[nextRx].source != CAPTURE_BT_RX) {
+                   nextRx++;
+                 }
+                 if (nextRx == records.size()) {
+                   sim::sleep(1000000);
+                   return;
+                 }
+                 const CaptureRecord& r = records[nextRx];
+                 sim::Micros air = sim::config().btAirUs;
+                 sim::Micros due = r.timeUs > air ? r.timeUs - air : 0;
+                 if (due > sim::now()) {
+                   sim::sleep(due - sim::now());
+                   return;
+                 }
+                 if (sim::now() > due) {
+                   late++;
+                 }
+                 link.write(r.data, r.len);
+                 nextRx++;
+                 sentRx++;
+               });
+  }
+
+  dev.start(isMaster ? master::setup : client::setup, isMaster ? master::loop : client::loop);
+  double wallStart = wallSeconds();
+  sim::Micros until = (sim::Micros)(seconds * 1e6);
+  if (speed > 0) {
+    // Virtual time in 10 ms steps, each one held back until the wall clock catches up
+    for (sim::Micros t = 0; t < until;) {
+      t = std::min<sim::Micros>(t + 10000, until);
+      sim::run(t);
+      double ahead = t / 1e6 / speed - (wallSeconds() - wallStart);
+      if (ahead > 0) {
+        struct timespec ts = { (time_t)ahead, (long)((ahead - (time_t)ahead) * 1e9) };
+        nanosleep(&ts, nullptr);
+      }
+    }
+  } else {
+    sim::run(until);
+  }
+  double wall = wallSeconds() - wallStart;
+
+  printf("replay: %s, %s capture, GPS at %lu baud, link flags %u\n", path, isMaster ? "master" : "client", baud,
+         linkFlags);
+  printf("%u blocks, %u failed the CRC, %u missing\n", reader.blocks, reader.badBlocks, reader.missingBlocks);
+  printf("\n%-8s %10s %12s\n", "source", "records", "bytes");
+  for (uint8_t s = 0; s < CAPTURE_SOURCES; s++) {
+    printf("%-8s %10llu %12llu\n", SOURCE_NAMES[s], (unsigned long long)count[s], (unsigned long long)bytes[s]);
+  }
+  uint64_t total = 0;  // Captured bytes within the replayed time
+  for (size_t i = 0; i < records.size() && records[i].timeUs <= until; i++) {
+    total += records[i].len;
+  }
+  printf("\n%.1f s captured, %.1f s replayed in %.2f s wall: %.0fx real time, %.2f MB/s of captured bytes\n",
+         spanUs / 1e6, seconds, wall, wall > 0 ? seconds / wall : 0.0, wall > 0 ? total / wall / 1e6 : 0.0);
+  if (!isMaster) {
+    printf("link input: %llu of %llu records sent, %llu of them late\n", (unsigned long long)sentRx,
+           (unsigned long long)count[CAPTURE_BT_RX], (unsigned long long)late);
+  }
+  if (isMaster) {
+    // The capture holds each frame once as published, and which of them a
+    // client gets depends on when it connected
+    printf("link output: %zu bytes to the stand-in client, %zu published in the capture\n", sentBytes.size(),
+           capturedTx.size());
+  } else {
+    std::vector<uint8_t> sentData = withoutClockFrames(sentBytes), capturedData = withoutClockFrames(capturedTx);
+    printf("link output: %zu bytes, captured %zu, %s without clock frames\n", sentBytes.size(), capturedTx.size(),
+           sentData == capturedData ? "identical" : "differ");
+  }
+  printf("GPS UART bytes dropped: %llu\n", (unsigned long long)gpsSerial.simDropped());
+  if (!isMaster) {
+    printf("client LCD: [%s] [%s]\n", client::lcd.simRow(0).c_str(), client::lcd.simRow(1).c_str());
+  }
+  printf("digest %016llx\n", (unsigned long long)digest.h);
+  return 0;
+}
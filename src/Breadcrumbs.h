@@ -0,0 +1,233 @@
+#ifndef BREADCRUMBS_H
+#define BREADCRUMBS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "DeadReckoning.h"
+#include "Geodesy.h"
+#include "PositionStream.h"
+
+/*
+ * Breadcrumb trail of the master's positions in fixed memory, on the
+ * client.
+ *
+ * Fixes are thinned as they arrive, in the manner of Douglas-Peucker. The
+ * trail's newest point is the anchor, and the fixes received since it wait
+ * in a window. A new fix is tried as the end of a straight segment from the
+ * anchor. If every waiting fix lies within BC_TOLERANCE_M of that segment,
+ * the new fix joins the window. Otherwise the fix before it becomes a trail
+ * point and the new anchor. A straight or stationary stretch thus shrinks
+ * to its two ends, and the trail stays within BC_TOLERANCE_M of the fixes
+ * it replaces. A full window drops every other fix, so a long straight
+ * stretch is only checked against some of its fixes.
+ *
+ * Trail points are stored as deltas from the point before, in a byte ring:
+ *   zigzag varint latitude delta in micro-degrees
+ *   zigzag varint longitude delta in micro-degrees
+ *   varint time delta in units of BC_TIME_UNIT_MS
+ * Points kept a few tens of meters apart at walking pace take 4 to 5
+ * bytes, so 2 KB holds hours of walking. When the ring is full the oldest
+ * point is folded into the base point, and the trail covers the most
+ * recent stretch that fits.
+ *
+ * Distance travelled and average speed are running totals, updated as each
+ * fix arrives, so a query never walks the trail. The distance is measured
+ * along the thinned trail plus the leg from the anchor to the newest fix.
+ * That keeps GPS jitter out of it while the master stands still.
+ */
+
+#define BC_TOLERANCE_M 3.0f   // Largest distance of a dropped fix from the trail
+#define BC_WINDOW 16          // Fixes held since the last trail point
+#define BC_TIME_UNIT_MS 100   // Resolution of trail point times
+#define BC_RECORD_MAX 15      // Three 5-byte varints
+
+// Meters per micro-degree of latitude on the mean sphere
+const float BC_M_PER_E6 = 1.0f / DR_E6_PER_M;
+
+struct TrailPoint {
+  int32_t lat_e6;
+  int32_t lon_e6;
+  uint32_t timeMs;  // Local time it was received, a multiple of BC_TIME_UNIT_MS
+};
+
+/**
+ * @brief Distance in meters from a point to the segment between two others.
+ *
+ * Works in a flat projection around the segment's start, which is plenty
+ * over the few hundred meters between trail points.
+ */
+inline float bc_segment_distance(const TrailPoint& a, const TrailPoint& b, const TrailPoint& p) {
+  float cosLat = geo_lat_trig(a.lat_e6 * GEO_E6_TO_DEG_F).cosLat;
+  float bx = (float)(b.lon_e6 - a.lon_e6) * cosLat * BC_M_PER_E6;
+  float by = (float)(b.lat_e6 - a.lat_e6) * BC_M_PER_E6;
+  float px = (float)(p.lon_e6 - a.lon_e6) * cosLat * BC_M_PER_E6;
+  float py = (float)(p.lat_e6 - a.lat_e6) * BC_M_PER_E6;
+  float len2 = bx * bx + by * by;
+  float t = len2 > 0.0f ? (px * bx + py * by) / len2 : 0.0f;
+  t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+  float dx = px - t * bx;
+  float dy = py - t * by;
+  return sqrtf(dx * dx + dy * dy);
+}
+
+/**
+ * @brief Thinned, delta-compressed trail of positions.
+ *
+ * @tparam BYTES Size of the delta ring.
+ */
+template <size_t BYTES>
+struct Breadcrumbs {
+  static_assert(BYTES >= BC_RECORD_MAX, "Breadcrumbs needs room for one point");
+
+  uint8_t ring[BYTES];
+  size_t head = 0;             // Where the next delta goes
+  size_t used = 0;             // Bytes of deltas in the ring
+  uint16_t points = 0;         // Trail points, the base included
+  TrailPoint base = {};        // Oldest trail point
+  TrailPoint anchor = {};      // Newest trail point
+  TrailPoint window[BC_WINDOW];  // Fixes since the anchor, oldest first
+  uint8_t waiting = 0;
+  uint32_t firstMs = 0;        // First fix, for the average speed
+  float trailM = 0.0f;         // Path length up to the anchor, including points dropped from the ring
+  float legM = 0.0f;           // Anchor to the newest fix
+
+  /**
+   * @brief Adds a fix.
+   *
+   * @param lat Latitude in micro-degrees.
+   * @param lon Longitude in micro-degrees.
+   * @param nowMs Local time it was received.
+   */
+  void add(int32_t lat, int32_t lon, uint32_t nowMs) {
+    TrailPoint p = { lat, lon, nowMs - nowMs % BC_TIME_UNIT_MS };
+    if (!points) {
+      base = anchor = p;
+      points = 1;
+      firstMs = p.timeMs;
+      return;
+    }
+    if (waiting && !fits(p)) {
+      append(window[waiting - 1]);
+      waiting = 0;
+    }
+    if (waiting == BC_WINDOW) {
+      // Keep every other fix, the newest included
+      for (uint8_t i = 1; i < BC_WINDOW; i += 2) {
+        window[i / 2] = window[i];
+      }
+      waiting = BC_WINDOW / 2;
+    }
+    window[waiting++] = p;
+    legM = geo_distance_e6(anchor.lat_e6, anchor.lon_e6, lat, lon);
+  }
+
+  // The newest fix, trail point or not
+  const TrailPoint& latest() const { return waiting ? window[waiting - 1] : anchor; }
+
+  // Meters travelled since the first fix
+  float distanceM() const { return trailM + legM; }
+
+  // Over the time since the first fix; 0 before there is any
+  float averageSpeedMps() const {
+    uint32_t ms = latest().timeMs - firstMs;
+    return ms ? distanceM() * 1000.0f / ms : 0.0f;
+  }
+
+  /**
+   * @brief Time to cover a distance at the average speed.
+   *
+   * @param remainingM The distance in meters.
+   *
+   * @return float Seconds, or -1 if the average speed is too low to tell.
+   */
+  float etaSeconds(float remainingM) const {
+    float speed = averageSpeedMps();
+    return speed >= DR_MIN_SPEED_MPS ? remainingM / speed : -1.0f;
+  }
+
+  // Walks the trail from the oldest point
+  struct Cursor {
+    uint16_t index = 0;
+    size_t offset = 0;  // Into the deltas
+    TrailPoint point = {};
+  };
+
+  /**
+   * @brief Moves a cursor to the next trail point, oldest first.
+   *
+   * @return true With the point in `c->point`.
+   * @return false After the newest point.
+   */
+  bool next(Cursor* c) const {
+    if (c->index >= points) {
+      return false;
+    }
+    if (c->index == 0) {
+      c->point = base;
+    } else {
+      c->offset += decode((head + BYTES - used + c->offset) % BYTES, &c->point);
+    }
+    c->index++;
+    return true;
+  }
+
+ private:
+  // Whether every waiting fix is within BC_TOLERANCE_M of anchor -> p
+  bool fits(const TrailPoint& p) const {
+    for (uint8_t i = 0; i < waiting; i++) {
+      if (bc_segment_distance(anchor, p, window[i]) > BC_TOLERANCE_M) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void append(const TrailPoint& p) {
+    uint8_t record[BC_RECORD_MAX];
+    size_t n = stream_put_varint(record, stream_zigzag(p.lat_e6 - anchor.lat_e6));
+    n += stream_put_varint(record + n, stream_zigzag(p.lon_e6 - anchor.lon_e6));
+    n += stream_put_varint(record + n, (p.timeMs - anchor.timeMs) / BC_TIME_UNIT_MS);
+    while (BYTES - used < n) {
+      dropOldest();
+    }
+    for (size_t i = 0; i < n; i++) {
+      ring[head] = record[i];
+      head = (head + 1) % BYTES;
+    }
+    used += n;
+    points++;
+    trailM += geo_distance_e6(anchor.lat_e6, anchor.lon_e6, p.lat_e6, p.lon_e6);
+    anchor = p;
+  }
+
+  // Folds the oldest delta into the base point
+  void dropOldest() {
+    used -= decode((head + BYTES - used) % BYTES, &base);
+    points--;
+  }
+
+  // Applies the delta at `pos` to `p`; returns its length
+  size_t decode(size_t pos, TrailPoint* p) const {
+    uint32_t v[3];
+    size_t n = 0;
+    for (uint8_t k = 0; k < 3; k++) {
+      uint32_t value = 0;
+      uint8_t shift = 0;
+      uint8_t b;
+      do {
+        b = ring[(pos + n++) % BYTES];
+        value |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+      } while (b & 0x80);
+      v[k] = value;
+    }
+    p->lat_e6 += stream_unzigzag(v[0]);
+    p->lon_e6 += stream_unzigzag(v[1]);
+    p->timeMs += v[2] * BC_TIME_UNIT_MS;
+    return n;
+  }
+};
+
+#endif
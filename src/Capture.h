@@ -0,0 +1,313 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "PositionStream.h"
+
+/*
+ * Capture of a sketch's GPS input and link traffic, for replay on the host
+ * (host/tools/replay).
+ *
+ * The sketch appends records to a block in RAM. A full block is handed to
+ * a low-priority task that writes it to flash in one piece, so each write
+ * is a whole CAPTURE_BLOCK_SIZE block (one flash sector) and the file only
+ * ever grows. A block is also sealed early once it is CAPTURE_SEAL_US old,
+ * which bounds both the data a reset can lose and the extra writes of
+ * partly filled blocks. When every block is waiting for flash, new
+ * records are dropped and counted.
+ *
+ * The file is a sequence of blocks, each:
+ *   [0] 0xA5 sync  [1] 0x43 capture marker  [2..3] block sequence number
+ *   [4..7] time in us when the block was opened  [8..9] payload length
+ *   [10..] payload  [n-2..] CRC-16/CCITT-FALSE over bytes [2..n-3]
+ * and the payload a sequence of records:
+ *   source (CaptureSource), varint us since the previous record (or since
+ *   the block was opened), varint length, the bytes
+ * A record that does not fit the rest of a block continues in the next
+ * one as a second record. The first record of a capture is CAPTURE_META:
+ *   version, role (CaptureRole), link flags (CAPTURE_LINK_*), 0,
+ *   GPS baud (uint32)
+ * Times are the sketch's micros(), when it read or wrote the bytes.
+ */
+
+#define CAPTURE_MARKER 0x43
+#define CAPTURE_VERSION 1
+#define CAPTURE_BLOCK_SIZE 4096          // One flash sector
+#define CAPTURE_HEADER_LEN 10
+#define CAPTURE_RECORD_MAX_HEADER 11     // Source, two 5-byte varints
+#define CAPTURE_SEAL_US 10000000UL       // Oldest a block gets before it is written out partly filled
+#define CAPTURE_META_LEN 8
+#ifndef CAPTURE_BLOCKS
+#define CAPTURE_BLOCKS 3                 // Blocks in RAM: one filling, the rest waiting for flash
+#endif
+
+#define CAPTURE_LINK_BINARY 0x01  // LINK_BINARY_FRAMES
+#define CAPTURE_LINK_DELTA 0x02   // LINK_DELTA_STREAM
+
+enum CaptureSource {
+  CAPTURE_GPS_RX,  // Bytes read from the GPS UART
+  CAPTURE_BT_RX,   // Bytes received over SPP
+  CAPTURE_BT_TX,   // Bytes sent over SPP; on the master, each frame once as published
+  CAPTURE_META,
+  CAPTURE_SOURCES
+};
+
+enum CaptureRole { CAPTURE_MASTER, CAPTURE_CLIENT };
+
+/**
+ * @brief Blocks of records waiting to be written to flash.
+ *
+ * put() may be called by one task at a time (the master serializes its
+ * tasks with a mutex); sealed() and release() by one other task.
+ *
+ * @tparam N Blocks held in RAM.
+ */
+template <size_t N>
+struct CaptureWriter {
+  static_assert(N >= 2, "CaptureWriter needs a block to fill and one to write");
+
+  struct Block {
+    uint8_t data[CAPTURE_BLOCK_SIZE];
+    size_t len;
+  };
+
+  Block blocks[N];
+  std::atomic<uint32_t> sealedCount{0};  // Blocks handed over; the filling one is blocks[sealedCount % N]
+  std::atomic<uint32_t> writtenCount{0};
+  std::atomic<uint32_t> dropped{0};      // Bytes lost because every block was waiting
+  bool open = false;                     // The filling block has a header
+  std::atomic<bool> stopped{false};      // Set by the writing task once the file is full
+  uint32_t openedUs = 0;
+  uint32_t lastUs = 0;
+
+  /**
+   * @brief Appends a record.
+   *
+   * @param source What the bytes are.
+   * @param nowUs micros() when they were read or written.
+   * @param data The bytes.
+   * @param len Their number.
+   */
+  void put(uint8_t source, uint32_t nowUs, const uint8_t* data, size_t len) {
+    if (stopped.load(std::memory_order_relaxed)) {
+      return;
+    }
+    if (open && nowUs - openedUs >= CAPTURE_SEAL_US) {
+      seal();
+    }
+    do {
+      if (!open && !start(nowUs)) {
+        dropped.fetch_add((uint32_t)len, std::memory_order_relaxed);
+        return;
+      }
+      Block& b = blocks[sealedCount.load(std::memory_order_relaxed) % N];
+      size_t room = CAPTURE_BLOCK_SIZE - 2 - b.len;
+      if (room < CAPTURE_RECORD_MAX_HEADER + 1) {
+        seal();
+        continue;
+      }
+      size_t n = len < room - CAPTURE_RECORD_MAX_HEADER ? len : room - CAPTURE_RECORD_MAX_HEADER;
+      uint8_t* p = b.data + b.len;
+      *p++ = source;
+      p += stream_put_varint(p, nowUs - lastUs);
+      p += stream_put_varint(p, (uint32_t)n);
+      memcpy(p, data, n);
+      b.len = (size_t)(p + n - b.data);
+      lastUs = nowUs;
+      data += n;
+      len -= n;
+    } while (len);
+  }
+
+  // Hands the partly filled block over, e.g. before the capture is closed
+  void seal() {
+    if (!open) {
+      return;
+    }
+    Block& b = blocks[sealedCount.load(std::memory_order_relaxed) % N];
+    frame_put16(b.data + 8, (uint16_t)(b.len - CAPTURE_HEADER_LEN));
+    b.len += 2;
+    stream_put_crc(b.data, b.len);
+    open = false;
+    sealedCount.fetch_add(1, std::memory_order_release);
+  }
+
+  // The oldest block waiting for flash, or nullptr
+  const uint8_t* sealed(size_t* len) {
+    uint32_t w = writtenCount.load(std::memory_order_relaxed);
+    if (w == sealedCount.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    *len = blocks[w % N].len;
+    return blocks[w % N].data;
+  }
+
+  // The block from sealed() is on flash
+  void release() {
+    writtenCount.fetch_add(1, std::memory_order_release);
+  }
+
+ private:
+  bool start(uint32_t nowUs) {
+    uint32_t s = sealedCount.load(std::memory_order_relaxed);
+    if (s - writtenCount.load(std::memory_order_acquire) >= N) {
+      return false;
+    }
+    Block& b = blocks[s % N];
+    b.data[0] = FRAME_SYNC0;
+    b.data[1] = CAPTURE_MARKER;
+    frame_put16(b.data + 2, (uint16_t)s);
+    frame_put32(b.data + 4, nowUs);
+    b.len = CAPTURE_HEADER_LEN;
+    openedUs = nowUs;
+    lastUs = nowUs;
+    open = true;
+    return true;
+  }
+};
+
+// Payload of the CAPTURE_META record that starts a capture
+inline size_t capture_encode_meta(uint8_t role, uint8_t linkFlags, uint32_t gpsBaud, uint8_t* out) {
+  out[0] = CAPTURE_VERSION;
+  out[1] = role;
+  out[2] = linkFlags;
+  out[3] = 0;
+  frame_put32(out + 4, gpsBaud);
+  return CAPTURE_META_LEN;
+}
+
+/**
+ * @brief Writes every block waiting in a writer to a file.
+ *
+ * @param capture The writer.
+ * @param file Where to write, e.g. a LittleFS file; flushed after each block.
+ * @param room Bytes the file may still grow by; blocks that do not fit are kept.
+ *
+ * @return size_t Number of bytes written.
+ */
+template <class File, size_t N>
+size_t capture_drain(CaptureWriter<N>& capture, File& file, size_t room) {
+  size_t total = 0;
+  size_t len;
+  const uint8_t* block;
+  while ((block = capture.sealed(&len)) != nullptr && total + len <= room) {
+    file.write(block, len);
+    file.flush();
+    capture.release();
+    total += len;
+  }
+  return total;
+}
+
+// One record read back from a capture
+struct CaptureRecord {
+  uint8_t source;
+  uint64_t timeUs;  // Unwrapped from the sketch's 32-bit micros()
+  const uint8_t* data;
+  size_t len;
+};
+
+/**
+ * @brief Reads the records of a capture file held in memory.
+ *
+ * A block that fails its CRC is skipped and reading resyncs on the next
+ * block header; missing blocks are counted from the sequence numbers.
+ */
+struct CaptureReader {
+  const uint8_t* file;
+  size_t size;
+  size_t pos = 0;             // Next block header
+  const uint8_t* rec = nullptr;  // Next record in the current block
+  const uint8_t* end = nullptr;
+  uint64_t lastUs = 0;
+  uint64_t epochUs = 0;       // Added to 32-bit times after micros() wrapped
+  uint32_t blocks = 0;
+  uint32_t badBlocks = 0;     // Failed the CRC or were cut short
+  uint32_t missingBlocks = 0; // Gaps in the sequence numbers
+  uint16_t nextSeq = 0;
+
+  CaptureReader(const uint8_t* data, size_t len) : file(data), size(len) {}
+
+  bool next(CaptureRecord* out) {
+    while (rec == end && nextBlock()) {
+    }
+    if (rec == end) {
+      return false;
+    }
+    uint32_t delta, len;
+    size_t n;
+    out->source = *rec++;
+    if (!(n = getVarint(rec, end, &delta))) {
+      rec = end;  // A valid CRC makes this unreachable
+      return next(out);
+    }
+    rec += n;
+    if (!(n = getVarint(rec, end, &len)) || len > (size_t)(end - rec - n)) {
+      rec = end;
+      return next(out);
+    }
+    rec += n;
+    lastUs += delta;
+    out->timeUs = lastUs;
+    out->data = rec;
+    out->len = len;
+    rec += len;
+    return true;
+  }
+
+ private:
+  static size_t getVarint(const uint8_t* p, const uint8_t* end, uint32_t* v) {
+    uint32_t value = 0;
+    size_t n = 0;
+    do {
+      if (p + n >= end || n == 5) {
+        return 0;
+      }
+      value |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+    } while (p[n++] & 0x80);
+    *v = value;
+    return n;
+  }
+
+  bool nextBlock() {
+    while (pos + CAPTURE_HEADER_LEN + 2 <= size) {
+      const uint8_t* b = file + pos;
+      if (b[0] != FRAME_SYNC0 || b[1] != CAPTURE_MARKER) {
+        pos++;
+        continue;
+      }
+      size_t len = CAPTURE_HEADER_LEN + frame_get16(b + 8) + 2;
+      if (len > CAPTURE_BLOCK_SIZE || pos + len > size || !stream_check_crc(b, len)) {
+        badBlocks++;
+        pos++;
+        continue;
+      }
+      uint16_t seq = frame_get16(b + 2);
+      if (blocks) {
+        missingBlocks += (uint16_t)(seq - nextSeq);
+      }
+      nextSeq = seq + 1;
+      // 32-bit micros() wraps every 71 minutes
+      uint32_t opened = frame_get32(b + 4);
+      uint64_t t = epochUs + opened;
+      if (blocks && t + 0x80000000ULL < lastUs) {
+        epochUs += 0x100000000ULL;
+        t += 0x100000000ULL;
+      }
+      lastUs = t;
+      blocks++;
+      rec = b + CAPTURE_HEADER_LEN;
+      end = b + len - 2;
+      pos += len;
+      return true;
+    }
+    return false;
+  }
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef DEAD_RECKONING_H
+#define DEAD_RECKONING_H
+
+#include <stdint.h>
+#include <math.h>
+
+#include "Geodesy.h"
+#include "PositionFrame.h"
+
+/*
+ * Constant-velocity model of the master's position, shared by both
+ * sketches.
+ *
+ * The client extrapolates the last fix it received with the velocity the
+ * fix carries, so the displayed distance moves smoothly between updates.
+ * The master runs the same model on the last fix it sent and skips a fix
+ * when the clients' prediction is still within DR_TOLERANCE_M of it, so
+ * steady motion needs fewer updates. DR_HOLD_MS bounds how long it stays
+ * quiet, and a client stops extrapolating after DR_TIMEOUT_MS, which must
+ * be longer.
+ */
+
+const uint32_t DR_HOLD_MS = 5000;      // Longest the master skips fixes while the model holds
+const uint32_t DR_TIMEOUT_MS = 8000;   // Age at which a client stops extrapolating
+const float DR_TOLERANCE_M = 2.0f;     // Prediction error the master lets the clients have
+const float DR_MIN_SPEED_MPS = 0.3f;   // Below this the GPS course is noise and velocity is sent as zero
+
+// Micro-degrees of latitude per meter on the mean sphere
+const float DR_E6_PER_M = (float)(1e6 * 180.0 / (M_PI * GEO_EARTH_RADIUS_M));
+
+/**
+ * @brief Splits a GPS speed and course into north and east velocity.
+ *
+ * @param speedMps Speed over ground in m/s.
+ * @param courseDeg Course over ground in degrees from north.
+ * @param fix Receives vn_cms and ve_cms.
+ *
+ * @return void
+ */
+inline void dr_set_velocity(float speedMps, float courseDeg, PositionFix* fix) {
+  if (speedMps < DR_MIN_SPEED_MPS) {
+    fix->vn_cms = 0;
+    fix->ve_cms = 0;
+    return;
+  }
+  float course = courseDeg * GEO_DEG_TO_RAD_F;
+  fix->vn_cms = (int16_t)lroundf(speedMps * 100.0f * cosf(course));
+  fix->ve_cms = (int16_t)lroundf(speedMps * 100.0f * sinf(course));
+}
+
+/**
+ * @brief Position of a fix extrapolated at its velocity.
+ *
+ * @param fix The fix to start from.
+ * @param dtMs Time after the fix in milliseconds.
+ * @param lat Receives the latitude in micro-degrees.
+ * @param lon Receives the longitude in micro-degrees.
+ *
+ * @return void
+ */
+inline void dr_extrapolate(const PositionFix& fix, int32_t dtMs, int32_t* lat, int32_t* lon) {
+  float t = dtMs * 0.001f;
+  float north = fix.vn_cms * 0.01f * t * DR_E6_PER_M;
+  float east = fix.ve_cms * 0.01f * t * DR_E6_PER_M / geo_lat_trig(fix.lat_e6 * GEO_E6_TO_DEG_F).cosLat;
+  *lat = fix.lat_e6 + (int32_t)lroundf(north);
+  int32_t lonE6 = fix.lon_e6 + (int32_t)lroundf(east);
+  if (lonE6 > 180 * FRAME_DEG_SCALE) {
+    lonE6 -= 360 * FRAME_DEG_SCALE;
+  } else if (lonE6 < -180 * FRAME_DEG_SCALE) {
+    lonE6 += 360 * FRAME_DEG_SCALE;
+  }
+  *lon = lonE6;
+}
+
+/**
+ * @brief Tells the master whether the clients' model still covers a fix.
+ *
+ * @param sent The last fix the clients received, as they hold it.
+ * @param fix The new fix.
+ *
+ * @return true If the fix can be skipped.
+ * @return false If it must be sent.
+ */
+inline bool dr_covers(const PositionFix& sent, const PositionFix& fix) {
+  uint32_t dtMs = fix.time_ms - sent.time_ms;
+  if (fix.time_ms == 0 || dtMs >= DR_HOLD_MS) {
+    return false;  // No GPS time to extrapolate with, or quiet for long enough
+  }
+  int32_t lat, lon;
+  dr_extrapolate(sent, (int32_t)dtMs, &lat, &lon);
+  return geo_distance_e6(lat, lon, fix.lat_e6, fix.lon_e6) <= DR_TOLERANCE_M;
+}
+
+/**
+ * @brief The client's view of the master: last fix plus extrapolation.
+ */
+struct DeadReckoner {
+  PositionFix fix = {};   // Last fix received
+  uint32_t atMs = 0;      // Local time it was received
+  bool valid = false;
+
+  void update(const PositionFix& f, uint32_t nowMs) {
+    fix = f;
+    atMs = nowMs;
+    valid = true;
+  }
+
+  // True while extrapolating moves the position
+  bool moving(uint32_t nowMs) const {
+    return valid && (fix.vn_cms || fix.ve_cms) && nowMs - atMs < DR_TIMEOUT_MS;
+  }
+
+  /**
+   * @brief Predicted position at a local time.
+   *
+   * After DR_TIMEOUT_MS the prediction stops where it got to instead of
+   * running on with a velocity nobody has confirmed.
+   */
+  void predict(uint32_t nowMs, int32_t* lat, int32_t* lon) const {
+    uint32_t age = nowMs - atMs;
+    dr_extrapolate(fix, (int32_t)(age < DR_TIMEOUT_MS ? age : DR_TIMEOUT_MS), lat, lon);
+  }
+};
+
+#endif
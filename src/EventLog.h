@@ -0,0 +1,270 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "PositionStream.h"
+
+/*
+ * Deferred binary log.
+ *
+ * LOG(ID, args...) stores an event id, a millisecond timestamp and up to
+ * LOG_MAX_ARGS raw 32-bit arguments in a lock-free ring. It does no
+ * formatting and never waits: when the ring is full the event is dropped
+ * and counted. A low-priority task drains the ring later, either
+ * formatting each event on the device (log_format()) or writing it as a
+ * binary record that host/tools/log_decode formats on the host:
+ *   [0] 0xA5 sync  [1] 0x4C log marker  [2] event id  [3] argument count
+ *   [4..7] timestamp in ms  [8..] arguments (4 bytes each)
+ *   [n-2..] CRC-16/CCITT-FALSE over bytes [2..n-3]
+ *
+ * Events are declared once, with their level and printf-style format, in
+ * src/LogEvents.h. An event above LOG_LEVEL compiles to nothing. Formats
+ * take d, i, u, x, X and c with the usual flags, width, precision and
+ * length modifiers; f, e and g for floats (doubles are stored as float);
+ * E for micro-degrees printed as degrees; and M for a Bluetooth address
+ * passed as two arguments by LOG_MAC().
+ *
+ * The ring is a bounded multi-producer queue (one sequence number per
+ * slot), so the master's tasks and SPP callback can log concurrently; only
+ * one task may drain it.
+ */
+
+#define LOG_ERROR 1
+#define LOG_WARN 2
+#define LOG_INFO 3
+#define LOG_DEBUG 4
+// Events above this level compile to nothing
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_INFO
+#endif
+
+#define LOG_MARKER 0x4C
+#define LOG_MAX_ARGS 4
+#define LOG_RECORD_MAX (8 + LOG_MAX_ARGS * 4 + 2)
+#define LOG_LINE_MAX 128
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 64  // Events; a power of two
+#endif
+
+struct LogEvent {
+  uint8_t id;
+  uint8_t argc;
+  uint32_t ms;
+  uint32_t args[LOG_MAX_ARGS];
+};
+
+struct LogFormat {
+  uint8_t level;
+  const char* text;
+};
+
+// Raw argument bits: integers as themselves, floating point as a float
+template <class T>
+inline uint32_t log_arg(T v) {
+  return (uint32_t)v;
+}
+
+inline uint32_t log_arg(float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, 4);
+  return bits;
+}
+
+inline uint32_t log_arg(double v) {
+  return log_arg((float)v);
+}
+
+/**
+ * @brief Lock-free ring of events, written by any task and drained by one.
+ *
+ * @tparam N Capacity in events; must be a power of two.
+ */
+template <size_t N>
+struct EventRing {
+  static_assert((N & (N - 1)) == 0, "EventRing size must be a power of two");
+
+  struct Slot {
+    std::atomic<uint32_t> seq;  // Slot index when free, index + 1 once written
+    LogEvent ev;
+  };
+
+  Slot slots[N];
+  std::atomic<uint32_t> writePos{0};
+  uint32_t readPos = 0;
+  std::atomic<uint32_t> dropped{0};  // Events lost to a full ring since the last take
+
+  EventRing() {
+    for (uint32_t i = 0; i < N; i++) {
+      slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  template <class... A>
+  void put(uint8_t id, uint32_t ms, A... args) {
+    static_assert(sizeof...(A) <= LOG_MAX_ARGS, "too many log arguments");
+    uint32_t pos = writePos.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &slots[pos & (N - 1)];
+      int32_t diff = (int32_t)(slot->seq.load(std::memory_order_acquire) - pos);
+      if (diff == 0 && writePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+      if (diff < 0) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      if (diff > 0) {
+        pos = writePos.load(std::memory_order_relaxed);
+      }
+    }
+    uint32_t v[sizeof...(A) + 1] = { log_arg(args)... };
+    slot->ev.id = id;
+    slot->ev.argc = sizeof...(A);
+    slot->ev.ms = ms;
+    for (size_t i = 0; i < sizeof...(A); i++) {
+      slot->ev.args[i] = v[i];
+    }
+    slot->seq.store(pos + 1, std::memory_order_release);
+  }
+
+  // Takes the oldest event; only the draining task may call this
+  bool take(LogEvent* out) {
+    Slot& slot = slots[readPos & (N - 1)];
+    if (slot.seq.load(std::memory_order_acquire) != readPos + 1) {
+      return false;
+    }
+    *out = slot.ev;
+    slot.seq.store(readPos + N, std::memory_order_release);
+    readPos++;
+    return true;
+  }
+
+  uint32_t takeDropped() {
+    return dropped.exchange(0, std::memory_order_relaxed);
+  }
+};
+
+/**
+ * @brief Formats one event as a line of text, without the newline.
+ *
+ * @param ev The event.
+ * @param formats The event table, indexed by id.
+ * @param count Number of entries in the table.
+ * @param out Destination, at least LOG_LINE_MAX bytes.
+ *
+ * @return size_t Length of the text written.
+ */
+inline size_t log_format(const LogEvent& ev, const LogFormat* formats, size_t count, char* out) {
+  if (ev.id >= count) {
+    return (size_t)snprintf(out, LOG_LINE_MAX, "Unknown log event %u", ev.id);
+  }
+  const char* f = formats[ev.id].text;
+  size_t n = 0;
+  uint8_t arg = 0;
+  while (*f && n < LOG_LINE_MAX - 1) {
+    if (*f != '%') {
+      out[n++] = *f++;
+      continue;
+    }
+    // Copy the conversion spec without length modifiers
+    char spec[16];
+    size_t s = 0;
+    spec[s++] = *f++;
+    while (*f && strchr("-+ #0123456789.", *f) && s < sizeof(spec) - 3) {
+      spec[s++] = *f++;
+    }
+    while (*f == 'l' || *f == 'h') {
+      f++;
+    }
+    char conv = *f ? *f++ : '%';
+    size_t room = LOG_LINE_MAX - n;
+    int w = 0;
+    uint32_t a = arg < ev.argc ? ev.args[arg] : 0;
+    if (conv == '%') {
+      out[n++] = '%';
+      continue;
+    } else if (conv == 'E') {
+      uint32_t mag = (int32_t)a < 0 ? 0u - a : a;
+      w = snprintf(out + n, room, "%s%lu.%06lu", (int32_t)a < 0 ? "-" : "", (unsigned long)(mag / 1000000),
+                   (unsigned long)(mag % 1000000));
+      arg++;
+    } else if (conv == 'M') {
+      uint32_t lo = arg + 1 < ev.argc ? ev.args[arg + 1] : 0;
+      w = snprintf(out + n, room, "%02X:%02X:%02X:%02X:%02X:%02X", (unsigned)(a >> 8 & 0xFF), (unsigned)(a & 0xFF),
+                   (unsigned)(lo >> 24), (unsigned)(lo >> 16 & 0xFF), (unsigned)(lo >> 8 & 0xFF), (unsigned)(lo & 0xFF));
+      arg += 2;
+    } else if (conv == 'f' || conv == 'e' || conv == 'g') {
+      float v;
+      memcpy(&v, &a, 4);
+      spec[s++] = conv;
+      spec[s] = '\0';
+      w = snprintf(out + n, room, spec, (double)v);
+      arg++;
+    } else if (conv == 'd' || conv == 'i') {
+      spec[s++] = 'l';
+      spec[s++] = conv;
+      spec[s] = '\0';
+      w = snprintf(out + n, room, spec, (long)(int32_t)a);
+      arg++;
+    } else if (conv == 'c') {
+      spec[s++] = 'c';
+      spec[s] = '\0';
+      w = snprintf(out + n, room, spec, (int)a);
+      arg++;
+    } else {
+      spec[s++] = 'l';
+      spec[s++] = conv;
+      spec[s] = '\0';
+      w = snprintf(out + n, room, spec, (unsigned long)a);
+      arg++;
+    }
+    if (w > 0) {
+      n += (size_t)w < room ? (size_t)w : room - 1;
+    }
+  }
+  out[n] = '\0';
+  return n;
+}
+
+/**
+ * @brief Encodes one event as a binary record for the host decoder.
+ *
+ * @param out Destination, at least LOG_RECORD_MAX bytes.
+ *
+ * @return size_t Number of bytes written.
+ */
+inline size_t log_encode(const LogEvent& ev, uint8_t* out) {
+  out[0] = FRAME_SYNC0;
+  out[1] = LOG_MARKER;
+  out[2] = ev.id;
+  out[3] = ev.argc;
+  frame_put32(out + 4, ev.ms);
+  for (uint8_t i = 0; i < ev.argc; i++) {
+    frame_put32(out + 8 + 4 * i, ev.args[i]);
+  }
+  size_t len = 8 + 4 * (size_t)ev.argc + 2;
+  stream_put_crc(out, len);
+  return len;
+}
+
+// Bluetooth address as the two arguments %M expects
+#define LOG_MAC(mac) \
+  (uint32_t)(((mac)[0] << 8) | (mac)[1]), \
+  (uint32_t)(((uint32_t)(mac)[2] << 24) | ((uint32_t)(mac)[3] << 16) | ((uint32_t)(mac)[4] << 8) | (mac)[5])
+
+// Records event LOG_<id> in the sketch's `eventLog` unless its level is compiled out
+#define LOG(id, ...)                                     \
+  do {                                                   \
+    if (LOG_LEVEL_##id <= LOG_LEVEL) {                   \
+      eventLog.put(LOG_##id, millis(), ##__VA_ARGS__);   \
+    }                                                    \
+  } while (0)
+
+#endif
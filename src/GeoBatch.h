@@ -0,0 +1,189 @@
+#ifndef GEO_BATCH_H
+#define GEO_BATCH_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Geodesy.h"
+
+/*
+ * Distance and bearing from one position to many targets in one pass, for
+ * tracking a whole team rather than one master.
+ *
+ * Targets are given as two arrays, latitudes and longitudes in
+ * micro-degrees, rather than an array of points, so each step of the loop
+ * reads consecutive words. The own position's cos and sin are taken once
+ * per batch in a GeoOrigin. The loop body is the GEO_FLAT formula of
+ * Geodesy.h with no branches and no libm calls:
+ *   - cos and sin of the mid latitude come from the origin's by a
+ *     second-order Taylor step over half the latitude difference, which
+ *     is exact to 1e-9 within GEO_FLAT_MAX_M
+ *   - atan2 is a polynomial good to 1e-5 rad (0.0006 deg)
+ * so GCC vectorizes it on the host (from -O3, or -O2 with
+ * -fvect-cost-model=dynamic), and on the ESP32 it is straight
+ * single-precision FPU code. Targets the flat pass puts at GEO_FLAT_MAX_M
+ * or farther are done again one at a time with geo_distance_e6() and
+ * geo_bearing_e6(). The results stay within the bounds of Geodesy.h.
+ *
+ * geo_nearest_k() then picks the k nearest targets with a k-entry heap,
+ * O(n log k), without sorting all of them.
+ */
+
+const float GEO_E6_TO_RAD_F = (float)(M_PI / 180.0 / 1e6);
+const float GEO_E6_TO_DEG_HALF_F = 0.5e-6f;  // Half a micro-degree in degrees, for the convergence term
+
+// The position distances are measured from, with its trig taken once
+struct GeoOrigin {
+  int32_t lat_e6;
+  int32_t lon_e6;
+  float cosLat;
+  float sinLat;
+};
+
+inline GeoOrigin geo_origin_e6(int32_t lat_e6, int32_t lon_e6) {
+  GeoOrigin o;
+  o.lat_e6 = lat_e6;
+  o.lon_e6 = lon_e6;
+  o.cosLat = cosf(lat_e6 * GEO_E6_TO_RAD_F);
+  o.sinLat = sinf(lat_e6 * GEO_E6_TO_RAD_F);
+  return o;
+}
+
+/**
+ * @brief atan2 in degrees, from a polynomial rather than libm.
+ *
+ * Branch-free, so it vectorizes; within 1e-5 rad of atan2f().
+ *
+ * @return float The angle in degrees, [-180, 180].
+ */
+inline float geo_atan2_deg_f(float y, float x) {
+  float ax = fabsf(x), ay = fabsf(y);
+  float hi = ax > ay ? ax : ay;
+  float lo = ax > ay ? ay : ax;
+  float a = lo / (hi + 1e-30f);  // No select around the division, so it vectorizes
+  float s = a * a;
+  float r = a * (0.9998660f + s * (-0.3302995f + s * (0.1801410f + s * (-0.0851330f + s * 0.0208351f))));
+  r *= GEO_RAD_TO_DEG_F;
+  // Octant fix-ups as arithmetic on 0/1 flags: GCC will not if-convert float
+  // arithmetic that might trap, but it does vectorize comparisons and products
+  r += (float)(ay > ax) * (90.0f - 2.0f * r);
+  r += (float)(x < 0.0f) * (180.0f - 2.0f * r);
+  return r * (1.0f - 2.0f * (float)(y < 0.0f));
+}
+
+/**
+ * @brief Distances and bearings from the origin to n targets.
+ *
+ * @param o The origin, from geo_origin_e6().
+ * @param lat Target latitudes in micro-degrees.
+ * @param lon Target longitudes in micro-degrees.
+ * @param n Number of targets.
+ * @param distM Receives the distances in meters.
+ * @param bearingDeg Receives the initial bearings from the origin, degrees
+ *        clockwise from north in [0, 360).
+ *
+ * @return size_t Number of targets that were too far for the flat pass.
+ */
+inline size_t geo_batch_e6(const GeoOrigin& o, const int32_t* __restrict lat, const int32_t* __restrict lon, size_t n,
+                           float* __restrict distM, float* __restrict bearingDeg) {
+  const float c = o.cosLat, s = o.sinLat;
+  const float radius = (float)GEO_EARTH_RADIUS_M;
+  for (size_t i = 0; i < n; i++) {
+    int32_t dLatE6 = lat[i] - o.lat_e6;
+    int32_t dLonE6 = lon[i] - o.lon_e6;
+    dLonE6 += dLonE6 > 180000000 ? -360000000 : 0;
+    dLonE6 += dLonE6 < -180000000 ? 360000000 : 0;
+    float y = (float)dLatE6 * GEO_E6_TO_RAD_F;
+    float h = 0.5f * y;  // Origin to mid latitude
+    float h2 = 0.5f * h * h;
+    float cosMid = c - s * h - c * h2;
+    float sinMid = s + c * h - s * h2;
+    float x = (float)dLonE6 * GEO_E6_TO_RAD_F * cosMid;
+    distM[i] = x * x + y * y;  // Squared, in radians; sqrtf() may set errno, which stops vectorization
+    // Bearing at the midpoint, less half the meridian convergence, as geo_flat_bearing()
+    float b = geo_atan2_deg_f(x, y) - (float)dLonE6 * GEO_E6_TO_DEG_HALF_F * sinMid + 360.0f;
+    // Within a degree of [0, 720) here; truncating to a whole number of turns wraps it without a branch
+    bearingDeg[i] = b - 360.0f * (float)(int32_t)(b * (1.0f / 360.0f));
+  }
+  size_t far = 0;
+  for (size_t i = 0; i < n; i++) {
+    distM[i] = radius * sqrtf(distM[i]);
+    if (distM[i] >= GEO_FLAT_MAX_M) {
+      distM[i] = geo_distance_e6(o.lat_e6, o.lon_e6, lat[i], lon[i]);
+      bearingDeg[i] = geo_bearing_e6(o.lat_e6, o.lon_e6, lat[i], lon[i]);
+      far++;
+    }
+  }
+  return far;
+}
+
+/**
+ * @brief Indices of the k nearest targets, nearest first.
+ *
+ * Keeps the k nearest seen so far in a max-heap, so a target farther than
+ * all of them costs one comparison. Equal distances go by index.
+ *
+ * @param distM Distances, e.g. from geo_batch_e6().
+ * @param n Number of targets.
+ * @param k Most indices wanted.
+ * @param out Receives the indices, room for k.
+ *
+ * @return size_t Number of indices written, the smaller of k and n.
+ */
+inline size_t geo_nearest_k(const float* distM, size_t n, size_t k, uint32_t* out) {
+  if (k > n) {
+    k = n;
+  }
+  if (k == 0) {
+    return 0;
+  }
+  struct Heap {
+    const float* d;
+    uint32_t* h;
+
+    bool farther(uint32_t a, uint32_t b) const { return d[a] > d[b] || (d[a] == d[b] && a > b); }
+
+    void down(size_t i, size_t len) {
+      for (;;) {
+        size_t big = i, l = 2 * i + 1, r = l + 1;
+        if (l < len && farther(h[l], h[big])) {
+          big = l;
+        }
+        if (r < len && farther(h[r], h[big])) {
+          big = r;
+        }
+        if (big == i) {
+          return;
+        }
+        uint32_t t = h[i];
+        h[i] = h[big];
+        h[big] = t;
+        i = big;
+      }
+    }
+  };
+  Heap heap = { distM, out };
+  for (size_t i = 0; i < k; i++) {
+    out[i] = (uint32_t)i;
+  }
+  for (size_t i = k / 2; i-- > 0;) {
+    heap.down(i, k);
+  }
+  for (size_t i = k; i < n; i++) {
+    if (heap.farther(out[0], (uint32_t)i)) {
+      out[0] = (uint32_t)i;
+      heap.down(0, k);
+    }
+  }
+  // Heap sort: the farthest goes to the end each time
+  for (size_t len = k; len > 1; len--) {
+    uint32_t t = out[0];
+    out[0] = out[len - 1];
+    out[len - 1] = t;
+    heap.down(0, len - 1);
+  }
+  return k;
+}
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef GEODESY_H
+#define GEODESY_H
+
+#include <math.h>
+#include <stdint.h>
+
+/*
+ * Distance and bearing between two positions on a spherical Earth.
+ *
+ * The ESP32 has a single-precision FPU; double arithmetic and the double
+ * libm trig functions are done in software and cost several times more.
+ * The kernel therefore picks the cheapest formula that is accurate enough
+ * for the separation of the two points:
+ *
+ *   GEO_FLAT         Equirectangular projection around the mid latitude
+ *                    in float, with a cached cos/sin of the latitude.
+ *                    Used below GEO_FLAT_MAX_M (20 km), where the distance
+ *                    error against the exact spherical result stays below
+ *                    0.005 % (1 m at 20 km) up to 80 deg latitude.
+ *   GEO_HAVERSINE_F  Haversine and great-circle bearing in float. Used up
+ *                    to GEO_HAVERSINE_F_MAX_M (1000 km), where float
+ *                    rounding keeps the distance error below 0.001 %.
+ *   GEO_HAVERSINE    Haversine and great-circle bearing in double. Exact
+ *                    for the sphere; used for anything farther.
+ *
+ * Bearings are the great-circle initial bearing from the first point to
+ * the second, in degrees clockwise from true north in [0, 360), within
+ * 0.01 deg in every mode. host/bench/geo_bench checks all of these bounds.
+ */
+
+enum GeoMode {
+  GEO_AUTO,         // Pick by distance using the bounds above
+  GEO_FLAT,         // Equirectangular, float
+  GEO_HAVERSINE_F,  // Haversine, float
+  GEO_HAVERSINE,    // Haversine, double
+};
+
+const double GEO_EARTH_RADIUS_M = 6371000.0;   // Mean Earth radius
+const float GEO_FLAT_MAX_M = 20000.0f;          // Largest separation for GEO_FLAT
+const float GEO_HAVERSINE_F_MAX_M = 1000000.0f; // Largest separation for GEO_HAVERSINE_F
+const float GEO_COS_CACHE_DEG = 0.001f;         // Latitude change that refreshes the cached cos/sin
+
+const float GEO_DEG_TO_RAD_F = (float)(M_PI / 180.0);
+const float GEO_RAD_TO_DEG_F = (float)(180.0 / M_PI);
+
+// Latitude and longitude differences from point 1 to point 2, in degrees,
+// with the longitude difference wrapped to [-180, 180]
+struct GeoDelta {
+  float dLat;
+  float dLon;
+  float midLat;
+};
+
+inline GeoDelta geo_delta(double lat1, double lon1, double lat2, double lon2) {
+  GeoDelta d;
+  d.dLat = (float)(lat2 - lat1);
+  // Wrap before narrowing so pairs across the antimeridian keep full precision
+  double dLon = lon2 - lon1;
+  if (dLon > 180.0) {
+    dLon -= 360.0;
+  } else if (dLon < -180.0) {
+    dLon += 360.0;
+  }
+  d.dLon = (float)dLon;
+  d.midLat = (float)((lat1 + lat2) * 0.5);
+  return d;
+}
+
+struct GeoLatTrig {
+  float lat;  // Latitude the values were computed for, in degrees
+  float cosLat;
+  float sinLat;
+};
+
+/**
+ * @brief Returns cos and sin of a latitude, reusing the last values while
+ * the latitude stays within GEO_COS_CACHE_DEG of the one they were
+ * computed for.
+ *
+ * Both devices move slowly, so consecutive calls almost always hit. The
+ * relative error from the cache is at most tan(lat) * GEO_COS_CACHE_DEG
+ * in radians, 1e-4 at 80 deg.
+ *
+ * The cache is thread-local; ESP-IDF gives every FreeRTOS task its own
+ * copy. A shared one would race between the client's tasks on its two
+ * cores, and a reader could pair a new latitude with the old cosine.
+ *
+ * @param latDeg Latitude in degrees.
+ *
+ * @return const GeoLatTrig& The cached values.
+ */
+inline const GeoLatTrig& geo_lat_trig(float latDeg) {
+  static thread_local GeoLatTrig cache = { 1000.0f, 1.0f, 0.0f };
+  if (fabsf(latDeg - cache.lat) > GEO_COS_CACHE_DEG) {
+    cache.lat = latDeg;
+    cache.cosLat = cosf(latDeg * GEO_DEG_TO_RAD_F);
+    cache.sinLat = sinf(latDeg * GEO_DEG_TO_RAD_F);
+  }
+  return cache;
+}
+
+// Equirectangular distance in meters
+inline float geo_flat_distance(const GeoDelta& d) {
+  float x = d.dLon * geo_lat_trig(d.midLat).cosLat * GEO_DEG_TO_RAD_F;
+  float y = d.dLat * GEO_DEG_TO_RAD_F;
+  return (float)GEO_EARTH_RADIUS_M * sqrtf(x * x + y * y);
+}
+
+// Equirectangular bearing in degrees. The projection gives the bearing at
+// the midpoint; subtracting half the meridian convergence between the two
+// points turns it into the initial bearing.
+inline float geo_flat_bearing(const GeoDelta& d) {
+  const GeoLatTrig& trig = geo_lat_trig(d.midLat);
+  float bearing = atan2f(d.dLon * trig.cosLat, d.dLat) * GEO_RAD_TO_DEG_F - 0.5f * d.dLon * trig.sinLat;
+  if (bearing < 0.0f) {
+    bearing += 360.0f;
+  } else if (bearing >= 360.0f) {
+    bearing -= 360.0f;
+  }
+  return bearing;
+}
+
+inline float geo_haversine_f(float lat1, float lat2, const GeoDelta& d) {
+  float phi1 = lat1 * GEO_DEG_TO_RAD_F;
+  float phi2 = lat2 * GEO_DEG_TO_RAD_F;
+  float sLat = sinf(d.dLat * GEO_DEG_TO_RAD_F * 0.5f);
+  float sLon = sinf(d.dLon * GEO_DEG_TO_RAD_F * 0.5f);
+  float a = sLat * sLat + cosf(phi1) * cosf(phi2) * sLon * sLon;
+  return 2.0f * (float)GEO_EARTH_RADIUS_M * asinf(sqrtf(a < 1.0f ? a : 1.0f));
+}
+
+inline double geo_haversine(double lat1, double lon1, double lat2, double lon2) {
+  double phi1 = lat1 * M_PI / 180.0;
+  double phi2 = lat2 * M_PI / 180.0;
+  double sLat = sin((lat2 - lat1) * M_PI / 360.0);
+  double sLon = sin((lon2 - lon1) * M_PI / 360.0);
+  double a = sLat * sLat + cos(phi1) * cos(phi2) * sLon * sLon;
+  return 2.0 * GEO_EARTH_RADIUS_M * atan2(sqrt(a), sqrt(1.0 - a));
+}
+
+inline float geo_bearing_f(float lat1, float lat2, const GeoDelta& d) {
+  float phi1 = lat1 * GEO_DEG_TO_RAD_F;
+  float phi2 = lat2 * GEO_DEG_TO_RAD_F;
+  float dLon = d.dLon * GEO_DEG_TO_RAD_F;
+  float y = sinf(dLon) * cosf(phi2);
+  float x = cosf(phi1) * sinf(phi2) - sinf(phi1) * cosf(phi2) * cosf(dLon);
+  float bearing = atan2f(y, x) * GEO_RAD_TO_DEG_F;
+  return bearing < 0.0f ? bearing + 360.0f : bearing;
+}
+
+inline double geo_bearing_d(double lat1, double lon1, double lat2, double lon2) {
+  double phi1 = lat1 * M_PI / 180.0;
+  double phi2 = lat2 * M_PI / 180.0;
+  double dLon = (lon2 - lon1) * M_PI / 180.0;
+  double y = sin(dLon) * cos(phi2);
+  double x = cos(phi1) * sin(phi2) - sin(phi1) * cos(phi2) * cos(dLon);
+  double bearing = atan2(y, x) * 180.0 / M_PI;
+  return bearing < 0.0 ? bearing + 360.0 : bearing;
+}
+
+/**
+ * @brief Picks the formula for a pair of points.
+ *
+ * The flat estimate is cheap and close enough to the true distance to
+ * decide which band the pair falls in.
+ *
+ * @param d Deltas from geo_delta().
+ *
+ * @return GeoMode GEO_FLAT, GEO_HAVERSINE_F or GEO_HAVERSINE.
+ */
+inline GeoMode geo_select(const GeoDelta& d) {
+  // Beyond a few degrees the flat estimate is no longer needed to decide
+  if (fabsf(d.dLat) > 10.0f || fabsf(d.dLon) > 10.0f) {
+    return GEO_HAVERSINE;
+  }
+  float flat = geo_flat_distance(d);
+  if (flat < GEO_FLAT_MAX_M) {
+    return GEO_FLAT;
+  }
+  return flat < GEO_HAVERSINE_F_MAX_M ? GEO_HAVERSINE_F : GEO_HAVERSINE;
+}
+
+/**
+ * @brief Distance between two points.
+ *
+ * @param lat1 Latitude of the first point in degrees.
+ * @param lon1 Longitude of the first point in degrees.
+ * @param lat2 Latitude of the second point in degrees.
+ * @param lon2 Longitude of the second point in degrees.
+ * @param mode Formula to use; GEO_AUTO picks one by distance.
+ *
+ * @return double The distance in meters.
+ */
+inline double geo_distance(double lat1, double lon1, double lat2, double lon2, GeoMode mode = GEO_AUTO) {
+  GeoDelta d = geo_delta(lat1, lon1, lat2, lon2);
+  if (mode == GEO_AUTO) {
+    mode = geo_select(d);
+  }
+  switch (mode) {
+    case GEO_FLAT:
+      return geo_flat_distance(d);
+    case GEO_HAVERSINE_F:
+      return geo_haversine_f((float)lat1, (float)lat2, d);
+    default:
+      return geo_haversine(lat1, lon1, lat2, lon2);
+  }
+}
+
+/**
+ * @brief Initial bearing from the first point to the second.
+ *
+ * @param lat1 Latitude of the first point in degrees.
+ * @param lon1 Longitude of the first point in degrees.
+ * @param lat2 Latitude of the second point in degrees.
+ * @param lon2 Longitude of the second point in degrees.
+ * @param mode Formula to use; GEO_AUTO picks one by distance.
+ *
+ * @return double The bearing in degrees clockwise from north, [0, 360).
+ */
+inline double geo_bearing(double lat1, double lon1, double lat2, double lon2, GeoMode mode = GEO_AUTO) {
+  GeoDelta d = geo_delta(lat1, lon1, lat2, lon2);
+  if (mode == GEO_AUTO) {
+    mode = geo_select(d);
+  }
+  switch (mode) {
+    case GEO_FLAT:
+      return geo_flat_bearing(d);
+    case GEO_HAVERSINE_F:
+      return geo_bearing_f((float)lat1, (float)lat2, d);
+    default:
+      return geo_bearing_d(lat1, lon1, lat2, lon2);
+  }
+}
+
+/*
+ * Integer-input variants for fixed-point positions in micro-degrees (the
+ * unit of PositionFix). The deltas are taken in integer math, so nothing
+ * is computed in double. Pairs beyond GEO_HAVERSINE_F_MAX_M also use the
+ * float haversine, which is still within 0.01 % there.
+ */
+
+const float GEO_E6_TO_DEG_F = 1e-6f;
+
+inline GeoDelta geo_delta_e6(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2) {
+  GeoDelta d;
+  d.dLat = (float)(lat2 - lat1) * GEO_E6_TO_DEG_F;
+  int32_t dLon = lon2 - lon1;
+  if (dLon > 180000000) {
+    dLon -= 360000000;
+  } else if (dLon < -180000000) {
+    dLon += 360000000;
+  }
+  d.dLon = (float)dLon * GEO_E6_TO_DEG_F;
+  d.midLat = (float)((lat1 + lat2) / 2) * GEO_E6_TO_DEG_F;
+  return d;
+}
+
+/**
+ * @brief Distance between two points given in micro-degrees.
+ *
+ * @return float The distance in meters.
+ */
+inline float geo_distance_e6(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2) {
+  GeoDelta d = geo_delta_e6(lat1, lon1, lat2, lon2);
+  if (geo_select(d) == GEO_FLAT) {
+    return geo_flat_distance(d);
+  }
+  return geo_haversine_f(lat1 * GEO_E6_TO_DEG_F, lat2 * GEO_E6_TO_DEG_F, d);
+}
+
+/**
+ * @brief Initial bearing between two points given in micro-degrees.
+ *
+ * @return float The bearing in degrees clockwise from north, [0, 360).
+ */
+inline float geo_bearing_e6(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2) {
+  GeoDelta d = geo_delta_e6(lat1, lon1, lat2, lon2);
+  if (geo_select(d) == GEO_FLAT) {
+    return geo_flat_bearing(d);
+  }
+  return geo_bearing_f(lat1 * GEO_E6_TO_DEG_F, lat2 * GEO_E6_TO_DEG_F, d);
+}
+
+#endif
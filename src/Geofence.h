@@ -0,0 +1,251 @@
+#ifndef GEOFENCE_H
+#define GEOFENCE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "DeadReckoning.h"
+#include "Geodesy.h"
+
+/*
+ * Geofences and waypoints: circles with an enter and an exit event.
+ *
+ * A position enters a fence when it comes within the fence's radius and
+ * leaves it only once it is more than GF_HYSTERESIS_M beyond, so GPS
+ * jitter on the edge does not raise a stream of events. A waypoint is a
+ * fence with a small radius, such as a rally point.
+ *
+ * FenceIndex holds the fences in fixed memory with a uniform grid over
+ * latitude and longitude of GF_CELL_E6 micro-degrees. Each fence is listed
+ * in every cell its exit circle overlaps, and a hash table finds a cell's
+ * listings, so only occupied cells take memory.
+ *
+ * FenceTracker follows one moving position, such as the master's, against
+ * an index. It only tests the fences listed in the position's cell, since
+ * no other fence can be entered or left there. After each test it keeps
+ * the distance the position can move before any of them could change
+ * state, and skips the tests until it has moved that far or changed cell.
+ * On a cell change, fences it was inside that the new cell does not list
+ * are left at once.
+ *
+ * Distances use a flat projection around the position, accurate to well
+ * under a meter at fence scale. Fences across the antimeridian are not
+ * supported.
+ */
+
+#define GF_HYSTERESIS_M 3.0f  // Distance beyond the radius at which a fence is left
+#define GF_CELL_E6 2000       // Grid cell size, about 220 m of latitude
+#define GF_NONE 0xFFFF
+
+// Meters per micro-degree of latitude on the mean sphere
+const float GF_M_PER_E6 = 1.0f / DR_E6_PER_M;
+
+struct Fence {
+  int32_t lat_e6;
+  int32_t lon_e6;
+  float radiusM;
+};
+
+enum FenceEventType { FENCE_ENTER, FENCE_EXIT };
+
+struct FenceEvent {
+  uint16_t fence;
+  uint8_t type;  // FenceEventType
+};
+
+inline int32_t gf_cell(int32_t e6) {
+  return e6 >= 0 ? e6 / GF_CELL_E6 : -((-e6 + GF_CELL_E6 - 1) / GF_CELL_E6);
+}
+
+/**
+ * @brief Fences in a hashed uniform grid.
+ *
+ * @tparam FENCES Most fences.
+ * @tparam ENTRIES Most cell listings; a fence smaller than a cell takes up to 4.
+ * @tparam BUCKETS Hash table size, a power of two.
+ */
+template <size_t FENCES, size_t ENTRIES, size_t BUCKETS>
+struct FenceIndex {
+  static_assert(FENCES < GF_NONE && ENTRIES < GF_NONE, "FenceIndex ids are 16-bit");
+  static_assert((BUCKETS & (BUCKETS - 1)) == 0, "BUCKETS must be a power of two");
+  static const size_t MAX_FENCES = FENCES;
+
+  struct Entry {
+    int32_t cx;
+    int32_t cy;
+    uint16_t fence;
+    uint16_t next;
+  };
+
+  Fence fences[FENCES];
+  uint16_t count = 0;
+  Entry entries[ENTRIES];
+  uint16_t used = 0;
+  uint16_t heads[BUCKETS];
+
+  FenceIndex() {
+    for (size_t i = 0; i < BUCKETS; i++) {
+      heads[i] = GF_NONE;
+    }
+  }
+
+  /**
+   * @brief Adds a fence.
+   *
+   * @param lat Latitude of the center in micro-degrees.
+   * @param lon Longitude of the center in micro-degrees.
+   * @param radiusM Radius in meters.
+   *
+   * @return int The fence's id, or -1 if the index is full.
+   */
+  int add(int32_t lat, int32_t lon, float radiusM) {
+    float reachM = radiusM + GF_HYSTERESIS_M;
+    int32_t dLat = (int32_t)ceilf(reachM / GF_M_PER_E6);
+    int32_t dLon = (int32_t)ceilf(reachM / GF_M_PER_E6 / geo_lat_trig(lat * GEO_E6_TO_DEG_F).cosLat);
+    int32_t x0 = gf_cell(lon - dLon), x1 = gf_cell(lon + dLon);
+    int32_t y0 = gf_cell(lat - dLat), y1 = gf_cell(lat + dLat);
+    if (count == FENCES || used + (size_t)(x1 - x0 + 1) * (size_t)(y1 - y0 + 1) > ENTRIES) {
+      return -1;
+    }
+    uint16_t id = count++;
+    fences[id] = { lat, lon, radiusM };
+    for (int32_t cy = y0; cy <= y1; cy++) {
+      for (int32_t cx = x0; cx <= x1; cx++) {
+        uint16_t& head = heads[hash(cx, cy)];
+        entries[used] = { cx, cy, id, head };
+        head = used++;
+      }
+    }
+    return id;
+  }
+
+  // First entry of a bucket; follow Entry::next and skip entries of other cells
+  uint16_t bucket(int32_t cx, int32_t cy) const { return heads[hash(cx, cy)]; }
+
+  // Whether a fence is listed in a cell
+  bool listed(uint16_t fence, int32_t cx, int32_t cy) const {
+    for (uint16_t e = bucket(cx, cy); e != GF_NONE; e = entries[e].next) {
+      if (entries[e].fence == fence && entries[e].cx == cx && entries[e].cy == cy) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  static size_t hash(int32_t cx, int32_t cy) {
+    return ((uint32_t)cx * 73856093u ^ (uint32_t)cy * 19349663u) & (BUCKETS - 1);
+  }
+};
+
+/**
+ * @brief Inside/outside state of one moving position against a FenceIndex.
+ *
+ * @tparam Index The FenceIndex type.
+ */
+template <class Index>
+struct FenceTracker {
+  uint32_t inside[(Index::MAX_FENCES + 31) / 32] = {};
+  bool started = false;
+  bool behind = false;    // The last update ran out of room for events
+  int32_t cx = 0;         // Cell of the last full test
+  int32_t cy = 0;
+  int32_t lat = 0;        // Position of the last full test
+  int32_t lon = 0;
+  float safeM = 0.0f;     // Distance from there within which nothing can change
+  uint32_t updates = 0;
+  uint32_t skipped = 0;   // Updates that tested no fence
+  uint32_t tests = 0;     // Fence distance tests
+
+  bool isInside(uint16_t fence) const { return inside[fence / 32] >> (fence % 32) & 1; }
+
+  // Fences the position is in
+  uint16_t insideCount() const {
+    uint16_t n = 0;
+    for (size_t w = 0; w < sizeof(inside) / sizeof(inside[0]); w++) {
+      n += __builtin_popcount(inside[w]);
+    }
+    return n;
+  }
+
+  /**
+   * @brief Moves the position and reports the fences it entered and left.
+   *
+   * @param index The fences.
+   * @param latE6 New latitude in micro-degrees.
+   * @param lonE6 New longitude in micro-degrees.
+   * @param out Receives the events.
+   * @param max Room in `out`; events past it are reported on the next update.
+   *
+   * @return size_t Number of events.
+   */
+  size_t update(const Index& index, int32_t latE6, int32_t lonE6, FenceEvent* out, size_t max) {
+    updates++;
+    int32_t x = gf_cell(lonE6), y = gf_cell(latE6);
+    float cosLat = geo_lat_trig(latE6 * GEO_E6_TO_DEG_F).cosLat;
+    bool sameCell = started && x == cx && y == cy;
+    if (sameCell && !behind) {
+      float dx = (float)(lonE6 - lon) * cosLat * GF_M_PER_E6;
+      float dy = (float)(latE6 - lat) * GF_M_PER_E6;
+      if (dx * dx + dy * dy < safeM * safeM) {
+        skipped++;
+        return 0;
+      }
+    }
+    size_t n = 0;
+    bool complete = true;
+    if (started && (!sameCell || behind)) {
+      // Fences the new cell does not list are out of reach
+      for (size_t w = 0; w < sizeof(inside) / sizeof(inside[0]); w++) {
+        for (uint32_t bits = inside[w]; bits; bits &= bits - 1) {
+          uint16_t f = (uint16_t)(w * 32 + __builtin_ctz(bits));
+          if (!index.listed(f, x, y)) {
+            if (n == max) {
+              complete = false;
+              break;
+            }
+            inside[w] &= ~(1u << (f % 32));
+            out[n++] = { f, FENCE_EXIT };
+          }
+        }
+      }
+    }
+    float safe = 1e9f;
+    for (uint16_t e = index.bucket(x, y); e != GF_NONE; e = index.entries[e].next) {
+      if (index.entries[e].cx != x || index.entries[e].cy != y) {
+        continue;
+      }
+      uint16_t f = index.entries[e].fence;
+      const Fence& fence = index.fences[f];
+      float dx = (float)(fence.lon_e6 - lonE6) * cosLat * GF_M_PER_E6;
+      float dy = (float)(fence.lat_e6 - latE6) * GF_M_PER_E6;
+      float d = sqrtf(dx * dx + dy * dy);
+      tests++;
+      bool in = isInside(f);
+      bool now = in ? d <= fence.radiusM + GF_HYSTERESIS_M : d < fence.radiusM;
+      if (now != in) {
+        if (n == max) {
+          complete = false;
+          continue;
+        }
+        inside[f / 32] ^= 1u << (f % 32);
+        out[n++] = { f, (uint8_t)(now ? FENCE_ENTER : FENCE_EXIT) };
+      }
+      float margin = now ? fence.radiusM + GF_HYSTERESIS_M - d : d - fence.radiusM;
+      if (margin < safe) {
+        safe = margin;
+      }
+    }
+    started = true;
+    behind = !complete;  // Test everything again next time
+    cx = x;
+    cy = y;
+    lat = latE6;
+    lon = lonE6;
+    safeM = safe;
+    return n;
+  }
+};
+
+#endif
@@ -0,0 +1,516 @@
+#ifndef GPS_CONFIG_H
+#define GPS_CONFIG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Start-up configuration of the GPS receiver, shared by both sketches.
+ *
+ * Out of the box a receiver talks 9600 baud, computes one fix a second and
+ * sends every sentence it knows (GSV, GSA, VTG, GLL, ...), of which the
+ * sketches only use RMC and GGA. GpsConfigurator finds the baud the
+ * receiver is at, then tries the MediaTek PMTK commands and, if nothing
+ * acknowledges them, the u-blox UBX ones:
+ *   1. only RMC and GGA              PMTK314  / UBX CFG-MSG per sentence
+ *   2. GPS_CONFIG_BAUD               PMTK251  / UBX CFG-PRT
+ *   3. GPS_CONFIG_RATE_HZ fixes      PMTK220  / UBX CFG-RATE
+ * A command is sent up to GPS_CMD_TRIES times and counts once the receiver
+ * acknowledges it. A baud change has no usable acknowledgement, so it
+ * counts once valid sentences arrive at the new baud; otherwise the UART
+ * goes back to the old one. The rate asked for is cut to what the link
+ * carries. A receiver that acknowledges neither command set is left at its
+ * defaults.
+ *
+ * The configurator does no I/O itself. step() goes through a link that
+ * provides
+ *   void setBaud(uint32_t baud);
+ *   int read();                  // -1 when nothing is waiting
+ *   void write(const uint8_t* data, size_t len);
+ */
+
+const uint32_t GPS_DEFAULT_BAUD = 9600;
+const uint32_t GPS_CONFIG_BAUD = 115200;      // Baud asked for once the receiver answers
+const uint8_t GPS_CONFIG_RATE_HZ = 10;        // Fix rate asked for at GPS_CONFIG_BAUD
+const uint8_t GPS_CONFIG_SLOW_RATE_HZ = 5;    // Fix rate if RMC and GGA have to share 9600 baud
+const uint32_t GPS_LISTEN_MS = 1500;          // Time to hear a valid sentence at one baud; over one 1 Hz epoch
+const uint32_t GPS_ACK_MS = 300;              // Time to wait for an acknowledgement
+const uint32_t GPS_SWITCH_MS = 50;            // Time for a baud change command to leave the UART
+const uint8_t GPS_CMD_TRIES = 3;              // Sends of one command before it counts as refused
+
+// Bauds tried in order to find the receiver; a warm restart may leave it at GPS_CONFIG_BAUD
+const uint32_t GPS_PROBE_BAUDS[] = { GPS_DEFAULT_BAUD, GPS_CONFIG_BAUD, 38400, 57600 };
+
+#define GPS_UBX_SYNC0 0xB5
+#define GPS_UBX_SYNC1 0x62
+#define GPS_UBX_CLASS_ACK 0x05
+#define GPS_UBX_CLASS_CFG 0x06
+#define GPS_UBX_CFG_PRT 0x00
+#define GPS_UBX_CFG_MSG 0x01
+#define GPS_UBX_CFG_RATE 0x08
+#define GPS_UBX_CLASS_NMEA 0xF0
+#define GPS_UBX_CLASS_MGA 0x13
+#define GPS_UBX_MGA_INI 0x40
+#define GPS_UBX_PAYLOAD_MAX 32   // Longest UBX payload kept; longer frames are skipped
+#define GPS_NMEA_MAX 82          // Longest NMEA sentence, '$' to checksum
+
+enum GpsDialect {
+  GPS_DIALECT_NONE,  // No valid NMEA at any probed baud
+  GPS_DIALECT_NMEA,  // Sends NMEA but acknowledged neither command set
+  GPS_DIALECT_MTK,
+  GPS_DIALECT_UBX,
+};
+
+inline const char* gps_dialect_name(GpsDialect d) {
+  static const char* const names[] = { "no receiver", "NMEA only", "PMTK", "UBX" };
+  return names[d];
+}
+
+inline uint8_t gps_hex_digit(char c) {
+  if (c >= '0' && c <= '9') {
+    return (uint8_t)(c - '0');
+  }
+  if (c >= 'A' && c <= 'F') {
+    return (uint8_t)(c - 'A' + 10);
+  }
+  return 0xFF;
+}
+
+inline void gps_put32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+/**
+ * @brief Builds a PMTK command sentence.
+ *
+ * @param out Destination buffer, at least strlen(body) + 7 bytes.
+ * @param body Everything between '$' and '*', e.g. "PMTK220,100".
+ *
+ * @return size_t Length of the sentence including CR LF.
+ */
+inline size_t gps_pmtk(char* out, const char* body) {
+  uint8_t sum = 0;
+  for (const char* p = body; *p; p++) {
+    sum ^= (uint8_t)*p;
+  }
+  return (size_t)sprintf(out, "$%s*%02X\r\n", body, sum);
+}
+
+/**
+ * @brief Builds a UBX message with its Fletcher checksum.
+ *
+ * @param out Destination buffer, at least len + 8 bytes.
+ *
+ * @return size_t Length of the message.
+ */
+inline size_t gps_ubx(uint8_t* out, uint8_t cls, uint8_t id, const uint8_t* payload, uint16_t len) {
+  out[0] = GPS_UBX_SYNC0;
+  out[1] = GPS_UBX_SYNC1;
+  out[2] = cls;
+  out[3] = id;
+  out[4] = (uint8_t)len;
+  out[5] = (uint8_t)(len >> 8);
+  memcpy(out + 6, payload, len);
+  uint8_t a = 0, b = 0;
+  for (size_t i = 2; i < 6u + len; i++) {
+    a += out[i];
+    b += a;
+  }
+  out[6 + len] = a;
+  out[7 + len] = b;
+  return 8u + len;
+}
+
+/**
+ * @brief Picks valid NMEA sentences and command acknowledgements out of
+ * what the receiver sends.
+ *
+ * NMEA sentences count only with a correct checksum, so bytes received
+ * at the wrong baud never look like a receiver. `$PMTK001,<cmd>,<flag>`
+ * and UBX ACK-ACK / ACK-NAK are recorded in ackId and ackOk.
+ */
+struct GpsReplyScanner {
+  char line[GPS_NMEA_MAX + 1];
+  uint8_t lineLen = 0;
+  bool inLine = false;
+  uint8_t ubx[6 + GPS_UBX_PAYLOAD_MAX + 2];
+  uint16_t ubxLen = 0;   // Bytes of the UBX frame seen so far, 0 when outside one
+  uint16_t ubxWant = 0;  // Total length of the UBX frame once its header is in
+  uint32_t sentences = 0;
+  uint32_t acks = 0;
+  uint16_t ackId = 0;    // PMTK command number, or UBX class << 8 | id
+  bool ackOk = false;
+
+  void reset() {
+    inLine = false;
+    ubxLen = 0;
+    sentences = 0;
+    acks = 0;
+  }
+
+  void push(uint8_t b) {
+    if (ubxLen) {
+      pushUbx(b);
+    } else if (b == GPS_UBX_SYNC0) {
+      inLine = false;
+      ubx[0] = b;
+      ubxLen = 1;
+    } else if (b == '$') {
+      inLine = true;
+      lineLen = 0;
+    } else if (inLine && b == '\n') {
+      inLine = false;
+      line[lineLen] = '\0';
+      endLine();
+    } else if (inLine && b != '\r') {
+      if (lineLen == GPS_NMEA_MAX || b < 0x20 || b > 0x7E) {
+        inLine = false;  // Too long or not text: not a sentence
+      } else {
+        line[lineLen++] = (char)b;
+      }
+    }
+  }
+
+ private:
+  void endLine() {
+    char* star = strchr(line, '*');
+    if (!star || star + 3 != line + lineLen) {
+      return;
+    }
+    uint8_t sum = 0;
+    for (const char* p = line; p < star; p++) {
+      sum ^= (uint8_t)*p;
+    }
+    uint8_t hi = gps_hex_digit(star[1]), lo = gps_hex_digit(star[2]);
+    if (hi > 15 || lo > 15 || sum != (uint8_t)(hi << 4 | lo)) {
+      return;
+    }
+    sentences++;
+    unsigned cmd, flag;
+    if (sscanf(line, "PMTK001,%u,%u", &cmd, &flag) == 2) {
+      ack((uint16_t)cmd, flag == 3);  // 3 = valid command, action succeeded
+    }
+  }
+
+  void pushUbx(uint8_t b) {
+    if (ubxLen == 1 && b != GPS_UBX_SYNC1) {
+      ubxLen = 0;
+      push(b);
+      return;
+    }
+    if (ubxLen < sizeof(ubx)) {
+      ubx[ubxLen] = b;
+    }
+    ubxLen++;
+    if (ubxLen == 6) {
+      uint16_t payload = (uint16_t)(ubx[4] | ubx[5] << 8);
+      ubxWant = (uint16_t)(payload + 8);
+    }
+    if (ubxLen < 6 || ubxLen < ubxWant) {
+      return;
+    }
+    if (ubxWant <= sizeof(ubx) && ubx[2] == GPS_UBX_CLASS_ACK && ubxWant == 10) {
+      uint8_t a = 0, c = 0;
+      for (size_t i = 2; i < 8; i++) {
+        a += ubx[i];
+        c += a;
+      }
+      if (a == ubx[8] && c == ubx[9]) {
+        ack((uint16_t)(ubx[6] << 8 | ubx[7]), ubx[3] == 0x01);
+      }
+    }
+    ubxLen = 0;
+  }
+
+  void ack(uint16_t id, bool ok) {
+    ackId = id;
+    ackOk = ok;
+    acks++;
+  }
+};
+
+struct GpsConfigResult {
+  GpsDialect dialect = GPS_DIALECT_NONE;
+  uint32_t baud = GPS_DEFAULT_BAUD;
+  uint8_t rateHz = 1;
+  bool filtered = false;   // Only RMC and GGA are sent
+  uint8_t refused = 0;     // Commands that were not acknowledged or did not take
+};
+
+/**
+ * @brief Non-blocking state machine that configures the receiver.
+ *
+ * Call step() until it returns true, then read result. Each call only
+ * drains what the UART holds, so it can be polled from setup() with a
+ * short delay() in between.
+ */
+struct GpsConfigurator {
+  GpsConfigResult result;
+
+  template <typename Link>
+  bool step(Link& link, uint32_t nowMs) {
+    if (!started_) {
+      started_ = true;
+      listen(link, GPS_PROBE_BAUDS[0], nowMs);
+    }
+    int c;
+    while ((c = link.read()) >= 0) {
+      scanner_.push((uint8_t)c);
+    }
+    switch (op_) {
+      case OP_PROBE:
+        if (scanner_.sentences) {
+          result.baud = baud_;
+          result.dialect = GPS_DIALECT_NMEA;
+          begin(link, OP_MTK_FILTER, nowMs);
+        } else if ((int32_t)(nowMs - deadline_) >= 0) {
+          if (++probe_ < sizeof(GPS_PROBE_BAUDS) / sizeof(GPS_PROBE_BAUDS[0])) {
+            listen(link, GPS_PROBE_BAUDS[probe_], nowMs);
+          } else {
+            link.setBaud(GPS_DEFAULT_BAUD);
+            op_ = OP_DONE;
+          }
+        }
+        break;
+      case OP_VERIFY:
+        if (scanner_.sentences) {
+          result.baud = baud_;
+          begin(link, after_, nowMs);
+        } else if ((int32_t)(nowMs - deadline_) >= 0) {
+          result.refused++;
+          link.setBaud(result.baud);  // The receiver did not follow; it is still at the old baud
+          begin(link, after_, nowMs);
+        }
+        break;
+      case OP_SWITCH:
+        if ((int32_t)(nowMs - deadline_) >= 0) {
+          listen(link, GPS_CONFIG_BAUD, nowMs);
+          op_ = OP_VERIFY;
+        }
+        break;
+      case OP_DONE:
+        break;
+      default:
+        if (scanner_.acks && scanner_.ackId == ackId_) {
+          acknowledged(link, scanner_.ackOk, nowMs);
+        } else if ((int32_t)(nowMs - deadline_) >= 0) {
+          if (tries_ < GPS_CMD_TRIES) {
+            send(link, nowMs);
+          } else {
+            acknowledged(link, false, nowMs);
+          }
+        }
+        break;
+    }
+    return op_ == OP_DONE;
+  }
+
+ private:
+  enum Op {
+    OP_PROBE,       // Listening for NMEA at GPS_PROBE_BAUDS[probe_]
+    OP_MTK_FILTER,  // PMTK314: RMC and GGA only; an acknowledgement identifies MediaTek
+    OP_MTK_BAUD,    // PMTK251
+    OP_MTK_RATE,    // PMTK220
+    OP_UBX_GSV,     // CFG-MSG GSV off; an acknowledgement identifies u-blox
+    OP_UBX_GSA,
+    OP_UBX_VTG,
+    OP_UBX_GLL,
+    OP_UBX_BAUD,    // CFG-PRT on UART1
+    OP_UBX_RATE,    // CFG-RATE
+    OP_SWITCH,      // Waiting for a baud command to leave before following it
+    OP_VERIFY,      // Listening for NMEA at the new baud
+    OP_DONE,
+  };
+
+  GpsReplyScanner scanner_;
+  Op op_ = OP_PROBE;
+  Op after_ = OP_DONE;     // Where OP_VERIFY continues
+  uint32_t deadline_ = 0;
+  uint32_t baud_ = GPS_DEFAULT_BAUD;
+  uint16_t ackId_ = 0;
+  uint8_t probe_ = 0;
+  uint8_t tries_ = 0;
+  bool started_ = false;
+
+  template <typename Link>
+  void listen(Link& link, uint32_t baud, uint32_t nowMs) {
+    baud_ = baud;
+    link.setBaud(baud);
+    scanner_.reset();
+    deadline_ = nowMs + GPS_LISTEN_MS;
+  }
+
+  // Rate the link can carry: 10 Hz of RMC and GGA (~150 bytes each) needs
+  // more than 9600 baud, and the full default sentence set only fits once
+  uint8_t rateFor() const {
+    if (result.baud >= 38400) {
+      return GPS_CONFIG_RATE_HZ;
+    }
+    return result.filtered ? GPS_CONFIG_SLOW_RATE_HZ : 1;
+  }
+
+  template <typename Link>
+  void begin(Link& link, Op op, uint32_t nowMs) {
+    op_ = op;
+    tries_ = 0;
+    if ((op == OP_MTK_RATE || op == OP_UBX_RATE) && rateFor() == 1) {
+      op_ = OP_DONE;
+      return;
+    }
+    if (op != OP_DONE) {
+      send(link, nowMs);
+    }
+  }
+
+  template <typename Link>
+  void send(Link& link, uint32_t nowMs) {
+    uint8_t msg[64];  // Longest: PMTK314 with CR LF and the terminator sprintf adds
+    size_t len = 0;
+    uint8_t payload[20];
+    memset(payload, 0, sizeof(payload));
+    char body[40];
+    switch (op_) {
+      case OP_MTK_FILTER:
+        ackId_ = 314;  // GLL, RMC, VTG, GGA, GSA, GSV, ... sentences per fix
+        len = gps_pmtk((char*)msg, "PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0");
+        break;
+      case OP_MTK_BAUD:
+        ackId_ = 0;
+        sprintf(body, "PMTK251,%lu", (unsigned long)GPS_CONFIG_BAUD);
+        len = gps_pmtk((char*)msg, body);
+        break;
+      case OP_MTK_RATE:
+        ackId_ = 220;
+        sprintf(body, "PMTK220,%u", 1000u / rateFor());
+        len = gps_pmtk((char*)msg, body);
+        break;
+      case OP_UBX_GSV:
+      case OP_UBX_GSA:
+      case OP_UBX_VTG:
+      case OP_UBX_GLL: {
+        static const uint8_t ids[] = { 0x03, 0x02, 0x05, 0x01 };  // NMEA message ids, 0 rate = off
+        ackId_ = GPS_UBX_CLASS_CFG << 8 | GPS_UBX_CFG_MSG;
+        payload[0] = GPS_UBX_CLASS_NMEA;
+        payload[1] = ids[op_ - OP_UBX_GSV];
+        len = gps_ubx(msg, GPS_UBX_CLASS_CFG, GPS_UBX_CFG_MSG, payload, 3);
+        break;
+      }
+      case OP_UBX_BAUD:
+        ackId_ = 0;
+        payload[0] = 1;                                           // UART1
+        payload[4] = 0xC0;                                        // 8 data bits
+        payload[5] = 0x08;                                        // No parity, 1 stop bit
+        gps_put32(payload + 8, GPS_CONFIG_BAUD);                   // Baud, little-endian
+        payload[12] = payload[14] = 0x03;                         // UBX and NMEA in and out
+        len = gps_ubx(msg, GPS_UBX_CLASS_CFG, GPS_UBX_CFG_PRT, payload, 20);
+        break;
+      case OP_UBX_RATE:
+        ackId_ = GPS_UBX_CLASS_CFG << 8 | GPS_UBX_CFG_RATE;
+        payload[0] = (uint8_t)(1000 / rateFor());                 // measRate in ms, little-endian
+        payload[1] = (uint8_t)((1000 / rateFor()) >> 8);
+        payload[2] = 1;                                           // One fix per measurement
+        payload[4] = 1;                                           // GPS time
+        len = gps_ubx(msg, GPS_UBX_CLASS_CFG, GPS_UBX_CFG_RATE, payload, 6);
+        break;
+      default:
+        return;
+    }
+    link.write(msg, len);
+    tries_++;
+    scanner_.acks = 0;
+    if (op_ == OP_MTK_BAUD || op_ == OP_UBX_BAUD) {
+      after_ = (op_ == OP_MTK_BAUD) ? OP_MTK_RATE : OP_UBX_RATE;
+      op_ = OP_SWITCH;
+      deadline_ = nowMs + GPS_SWITCH_MS;
+    } else {
+      deadline_ = nowMs + GPS_ACK_MS;
+    }
+  }
+
+  template <typename Link>
+  void acknowledged(Link& link, bool ok, uint32_t nowMs) {
+    if (!ok && op_ != OP_MTK_FILTER && op_ != OP_UBX_GSV) {
+      result.refused++;
+    }
+    switch (op_) {
+      case OP_MTK_FILTER:
+        if (ok) {
+          result.dialect = GPS_DIALECT_MTK;
+          result.filtered = true;
+          begin(link, result.baud == GPS_CONFIG_BAUD ? OP_MTK_RATE : OP_MTK_BAUD, nowMs);
+        } else {
+          begin(link, OP_UBX_GSV, nowMs);
+        }
+        break;
+      case OP_UBX_GSV:
+        if (ok) {
+          result.dialect = GPS_DIALECT_UBX;
+          result.filtered = true;
+          begin(link, OP_UBX_GSA, nowMs);
+        } else {
+          op_ = OP_DONE;  // Neither command set: leave the receiver at its defaults
+        }
+        break;
+      case OP_UBX_GSA:
+      case OP_UBX_VTG:
+      case OP_UBX_GLL:
+        result.filtered = result.filtered && ok;
+        if (op_ == OP_UBX_GLL) {
+          begin(link, result.baud == GPS_CONFIG_BAUD ? OP_UBX_RATE : OP_UBX_BAUD, nowMs);
+        } else {
+          begin(link, (Op)(op_ + 1), nowMs);
+        }
+        break;
+      case OP_MTK_RATE:
+      case OP_UBX_RATE:
+        if (ok) {
+          result.rateHz = rateFor();
+        }
+        op_ = OP_DONE;
+        break;
+      default:
+        op_ = OP_DONE;
+        break;
+    }
+  }
+};
+
+/**
+ * @brief Bytes and fixes the NMEA parser handles per second.
+ *
+ * The sketches count into it as they parse and read it back once per
+ * report window.
+ */
+struct GpsLoad {
+  uint32_t bytes = 0;
+  uint32_t fixes = 0;
+  uint32_t windowBytes = 0;
+  uint32_t windowFixes = 0;
+  uint32_t windowStartMs = 0;
+
+  /**
+   * @brief Closes the current window.
+   *
+   * @param nowMs Current time.
+   * @param bytesPerSec Receives the bytes parsed per second in the window.
+   * @param fixesPerSec Receives the fixes per second in the window.
+   *
+   * @return void
+   */
+  void sample(uint32_t nowMs, float* bytesPerSec, float* fixesPerSec) {
+    uint32_t elapsed = nowMs - windowStartMs;
+    float secs = elapsed ? elapsed / 1000.0f : 1.0f;
+    *bytesPerSec = (bytes - windowBytes) / secs;
+    *fixesPerSec = (fixes - windowFixes) / secs;
+    windowBytes = bytes;
+    windowFixes = fixes;
+    windowStartMs = nowMs;
+  }
+};
+
+#endif
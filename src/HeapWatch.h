@@ -0,0 +1,126 @@
+#ifndef HEAP_WATCH_H
+#define HEAP_WATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Detects heap allocations made after setup().
+ *
+ * A sketch meant to run for days should not touch the heap once it is up:
+ * every malloc() takes the allocator's lock and a walk of the free list,
+ * and blocks of mixed sizes freed in a different order than they were
+ * taken fragment the heap until a large allocation, say the Bluetooth
+ * stack's, fails with plenty of memory free. The sketches format into
+ * fixed buffers for that reason. At the end of setup() they hand
+ * heap_watch_arm() the tasks they run, and from then on every allocation
+ * made on one of those tasks is counted, or, with `trap`, stops the
+ * program at the first one so the backtrace shows who made it.
+ *
+ * The count needs the ESP-IDF heap hooks (CONFIG_HEAP_USE_HOOKS, i.e.
+ * Arduino built as an ESP-IDF component with that option on); the stock
+ * Arduino libraries have them off, and there HEAP_WATCH_COUNTS is 0 and
+ * only the free-heap watermarks tell. Allocations the Bluetooth stack
+ * makes on its own tasks are not counted. The host simulator counts, for
+ * each simulated device, the allocations the ESP32 core would make:
+ * String storage and Print::printf() lines over 64 bytes.
+ */
+
+#define HEAP_WATCH_TASKS 8  // Most tasks heap_watch_arm() takes
+
+#if defined(ESP_PLATFORM) && CONFIG_HEAP_USE_HOOKS
+
+#include "esp_attr.h"
+#include "esp_system.h"
+
+#define HEAP_WATCH_COUNTS 1
+
+// Read by the hooks, which run inside every malloc(); plain words, no locks
+struct HeapWatchState {
+  TaskHandle_t tasks[HEAP_WATCH_TASKS];
+  volatile size_t count;
+  volatile bool trap;
+  volatile uint32_t allocations;
+};
+
+static HeapWatchState heapWatch;
+
+extern "C" void IRAM_ATTR esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) {
+  (void)ptr;
+  (void)size;
+  (void)caps;
+  if (!heapWatch.count) {
+    return;
+  }
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  for (size_t i = 0; i < heapWatch.count; i++) {
+    if (heapWatch.tasks[i] == self) {
+      heapWatch.allocations++;
+      if (heapWatch.trap) {
+        esp_system_abort("heap allocation after setup()");
+      }
+      return;
+    }
+  }
+}
+
+extern "C" void IRAM_ATTR esp_heap_trace_free_hook(void* ptr) {
+  (void)ptr;
+}
+
+inline void heap_watch_arm(const TaskHandle_t* tasks, size_t count, bool trap) {
+  heapWatch.count = 0;
+  heapWatch.trap = trap;
+  heapWatch.allocations = 0;
+  size_t n = 0;
+  for (size_t i = 0; i < count && n < HEAP_WATCH_TASKS; i++) {
+    if (tasks[i]) {
+      heapWatch.tasks[n++] = tasks[i];
+    }
+  }
+  heapWatch.count = n;  // Last, so the hooks never see a half-filled list
+}
+
+inline uint32_t heap_watch_allocations() {
+  return heapWatch.allocations;
+}
+
+#elif defined(ESP_PLATFORM)
+
+#define HEAP_WATCH_COUNTS 0
+
+inline void heap_watch_arm(const TaskHandle_t* tasks, size_t count, bool trap) {
+  (void)tasks;
+  (void)count;
+  (void)trap;
+}
+
+inline uint32_t heap_watch_allocations() {
+  return 0;
+}
+
+#else
+
+#define HEAP_WATCH_COUNTS 1
+
+/**
+ * @brief Starts counting the heap allocations made on the given tasks.
+ *
+ * @param tasks The sketch's tasks; null entries are skipped.
+ * @param count Number of entries, at most HEAP_WATCH_TASKS are kept.
+ * @param trap Whether to stop the program at the first allocation.
+ *
+ * @return void
+ */
+void heap_watch_arm(const TaskHandle_t* tasks, size_t count, bool trap);
+
+// Allocations made on the armed tasks since heap_watch_arm()
+uint32_t heap_watch_allocations();
+
+#endif
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef LCD_SHADOW_H
+#define LCD_SHADOW_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Shadow framebuffer for a character LCD.
+ *
+ * Text is rendered into `want`, which costs nothing on the bus. flush()
+ * then compares it with `shown`, a copy of what the display currently
+ * holds, and sends only the cells that differ, a few per call. Every
+ * HD44780 transfer in 4-bit mode blocks for tens of microseconds, so a
+ * field whose value changed by one digit costs one or two transfers
+ * instead of a cursor move plus the whole field.
+ */
+
+/**
+ * @brief Shadow copy of a character display with diff-based flushing.
+ *
+ * @tparam COLS Display columns.
+ * @tparam ROWS Display rows.
+ */
+template <uint8_t COLS, uint8_t ROWS>
+struct LcdShadow {
+  char want[ROWS][COLS];   // What should be on the display
+  char shown[ROWS][COLS];  // What the display holds
+  uint8_t cursorRow = 0xFF;
+  uint8_t cursorCol = 0xFF;  // Address the display will write next; 0xFF = unknown
+  uint8_t scanRow = 0;
+  uint8_t scanCol = 0;       // Where the next flush() resumes scanning
+  bool dirty = false;        // `want` may differ from `shown`
+
+  // Bus transfer counters
+  uint32_t dataWrites = 0;    // Characters sent
+  uint32_t cursorWrites = 0;  // Set-address commands sent
+  uint32_t naiveWrites = 0;   // Transfers a full rewrite of every rendered field would have needed
+
+  LcdShadow() {
+    memset(want, ' ', sizeof(want));
+    memset(shown, ' ', sizeof(shown));
+  }
+
+  /**
+   * @brief Marks the display as blank, e.g. right after lcd.clear().
+   */
+  void cleared() {
+    memset(shown, ' ', sizeof(shown));
+    dirty = true;
+    cursorRow = 0;
+    cursorCol = 0;
+  }
+
+  /**
+   * @brief Renders a field into the framebuffer, padded with spaces.
+   *
+   * @param col First column of the field.
+   * @param row Row of the field.
+   * @param text Text to show; clipped to the field.
+   * @param width Field width; the rest of the field after `text` is blanked.
+   */
+  void print(uint8_t col, uint8_t row, const char* text, uint8_t width) {
+    if (row >= ROWS || col >= COLS) {
+      return;
+    }
+    if (col + width > COLS) {
+      width = COLS - col;
+    }
+    uint8_t i = 0;
+    for (; i < width && text[i]; i++) {
+      want[row][col + i] = text[i];
+    }
+    naiveWrites += i + 1;  // The characters plus a cursor move
+    for (; i < width; i++) {
+      want[row][col + i] = ' ';
+    }
+    dirty = true;
+  }
+
+  // Transfers saved compared with rewriting every rendered field
+  uint32_t writesSaved() const {
+    uint32_t sent = dataWrites + cursorWrites;
+    return naiveWrites > sent ? naiveWrites - sent : 0;
+  }
+
+  // True when the display already shows the framebuffer
+  bool synced() const { return memcmp(want, shown, sizeof(want)) == 0; }
+
+  /**
+   * @brief Sends up to `budget` changed cells to the display.
+   *
+   * Scanning resumes where the previous call stopped, so a large change is
+   * spread over several calls instead of blocking one of them. A cursor
+   * move is only sent when the next changed cell is not where the display's
+   * address counter already points.
+   *
+   * @param lcd Display with setCursor(col, row) and write(uint8_t).
+   * @param budget Most character transfers to send in this call.
+   *
+   * @return true If the display now matches the framebuffer.
+   * @return false If changed cells remain for a later call.
+   */
+  template <class Lcd>
+  bool flush(Lcd& lcd, uint8_t budget) {
+    if (!dirty) {
+      return true;
+    }
+    for (uint16_t scanned = 0; scanned < ROWS * COLS; scanned++) {
+      uint8_t row = scanRow, col = scanCol;
+      if (++scanCol == COLS) {
+        scanCol = 0;
+        scanRow = (scanRow + 1) % ROWS;
+      }
+      if (want[row][col] == shown[row][col]) {
+        continue;
+      }
+      if (budget == 0) {
+        scanRow = row;
+        scanCol = col;
+        return false;
+      }
+      if (cursorRow != row || cursorCol != col) {
+        lcd.setCursor(col, row);
+        cursorWrites++;
+      }
+      lcd.write((uint8_t)want[row][col]);
+      dataWrites++;
+      shown[row][col] = want[row][col];
+      budget--;
+      // The address counter moves on by one, but rows are not contiguous
+      cursorRow = row;
+      cursorCol = (col + 1 < COLS) ? col + 1 : 0xFF;
+    }
+    dirty = false;
+    return true;
+  }
+};
+
+/**
+ * @brief Quantizes a displayed value and holds it inside a dead band.
+ *
+ * The shown value only moves when the input is more than half a step plus
+ * `band` away from it, so jitter around a step boundary does not make the
+ * display flicker between two values.
+ */
+struct Hysteresis {
+  int32_t shown = 0;   // Displayed value, a multiple of the step
+  bool valid = false;  // Nothing shown yet
+
+  /**
+   * @brief Feeds a new input value.
+   *
+   * @param value The input, in the same units as `step`.
+   * @param step Quantization step of the displayed value.
+   * @param band Extra dead band beyond half a step.
+   * @param wrap Period of a circular value such as a bearing, or 0.
+   *
+   * @return int32_t The value to display.
+   */
+  int32_t update(int32_t value, int32_t step, int32_t band, int32_t wrap = 0) {
+    int32_t diff = value - shown;
+    if (wrap) {
+      diff %= wrap;
+      if (diff > wrap / 2) {
+        diff -= wrap;
+      } else if (diff < -wrap / 2) {
+        diff += wrap;
+      }
+    }
+    if (diff < 0) {
+      diff = -diff;
+    }
+    if (!valid || diff > step / 2 + band) {
+      shown = (value + step / 2) / step * step;
+      if (wrap) {
+        shown %= wrap;
+      }
+      valid = true;
+    }
+    return shown;
+  }
+};
+
+#endif
@@ -0,0 +1,276 @@
+#ifndef LINK_CLOCK_H
+#define LINK_CLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "PositionStream.h"
+
+/*
+ * Timestamped clock frames in both directions of the link, for round-trip
+ * time, clock offset and the age of the peer's positions.
+ *
+ * Each side sends a clock frame every CLOCK_INTERVAL_US. It echoes the
+ * transmit time of the last frame it received from the peer, with how long
+ * it held it, as in NTP's symmetric mode:
+ *   [0]      0xA5 sync
+ *   [1]      0x54 clock marker
+ *   [2..5]   txUs: sender's clock when sent, in microseconds (uint32, wraps)
+ *   [6..9]   echoUs: txUs of the last clock frame received from the peer
+ *   [10..13] holdUs: sender's time from receiving that frame to sending
+ *            this one, or CLOCK_NO_ECHO before it has received one
+ *   [14..17] fixUs: sender's clock when its newest GPS fix arrived
+ *   [18..21] fixMs: GPS time of day of that fix, or CLOCK_NO_FIX
+ *   [22..25] latitude of that fix in micro-degrees (int32)
+ *   [26..29] longitude of that fix in micro-degrees (int32)
+ *   [30..31] CRC-16/CCITT-FALSE over bytes [2..29]
+ *
+ * A side that receives a frame with an echo at local time rx has a sample
+ *   rtt    = rx - echoUs - holdUs
+ *   offset = txUs - (rx - rtt / 2)      peer clock minus local clock
+ * LinkClock keeps the last CLOCK_SAMPLES and uses the offset of the one
+ * with the shortest round trip, which was delayed least by the stack and
+ * the radio, as NTP's clock filter does.
+ *
+ * fixUs and fixMs tie the peer's GPS time of day to its clock. Position
+ * frames carry GPS time, so with the offset the receiver knows when each
+ * position was taken in its own clock, and how old it is when it arrives.
+ * Both clocks are the ESP32's microsecond timer; their few ppm of drift
+ * are negligible between samples a second apart.
+ */
+
+#define CLOCK_MARKER 0x54
+#define CLOCK_FRAME_LEN 32
+#define CLOCK_NO_ECHO 0xFFFFFFFFUL
+#define CLOCK_NO_FIX 0xFFFFFFFFUL
+#define CLOCK_INTERVAL_US 1000000UL   // Time between clock frames from each side
+#define CLOCK_RTT_MAX_US 2000000L     // Longer round trips are not used
+#define CLOCK_ANCHOR_MAX_MS 60000L    // Furthest from the peer's last fix a GPS time is mapped
+#define CLOCK_SAMPLES 8
+#define CLOCK_DAY_MS 86400000L
+
+struct ClockFrame {
+  uint32_t txUs;
+  uint32_t echoUs;
+  uint32_t holdUs;
+  uint32_t fixUs;
+  uint32_t fixMs;
+  int32_t lat_e6;
+  int32_t lon_e6;
+};
+
+/**
+ * @brief Encodes a clock frame.
+ *
+ * @param f The frame's fields.
+ * @param out Destination buffer, at least CLOCK_FRAME_LEN bytes.
+ *
+ * @return size_t Number of bytes written (always CLOCK_FRAME_LEN).
+ */
+inline size_t clock_encode(const ClockFrame& f, uint8_t* out) {
+  out[0] = FRAME_SYNC0;
+  out[1] = CLOCK_MARKER;
+  frame_put32(out + 2, f.txUs);
+  frame_put32(out + 6, f.echoUs);
+  frame_put32(out + 10, f.holdUs);
+  frame_put32(out + 14, f.fixUs);
+  frame_put32(out + 18, f.fixMs);
+  frame_put32(out + 22, (uint32_t)f.lat_e6);
+  frame_put32(out + 26, (uint32_t)f.lon_e6);
+  stream_put_crc(out, CLOCK_FRAME_LEN);
+  return CLOCK_FRAME_LEN;
+}
+
+inline void clock_decode(const uint8_t* p, ClockFrame* f) {
+  f->txUs = frame_get32(p + 2);
+  f->echoUs = frame_get32(p + 6);
+  f->holdUs = frame_get32(p + 10);
+  f->fixUs = frame_get32(p + 14);
+  f->fixMs = frame_get32(p + 18);
+  f->lat_e6 = (int32_t)frame_get32(p + 22);
+  f->lon_e6 = (int32_t)frame_get32(p + 26);
+}
+
+/**
+ * @brief Looks for a clock frame in bytes received from a client.
+ *
+ * @return true With the last valid frame in `data` in `out`.
+ */
+inline bool clock_find_frame(const uint8_t* data, size_t len, ClockFrame* out) {
+  bool found = false;
+  for (size_t i = 0; i + CLOCK_FRAME_LEN <= len; i++) {
+    if (data[i] == FRAME_SYNC0 && data[i + 1] == CLOCK_MARKER && stream_check_crc(data + i, CLOCK_FRAME_LEN)) {
+      clock_decode(data + i, out);
+      found = true;
+    }
+  }
+  return found;
+}
+
+/**
+ * @brief Picks clock frames out of a byte stream, one byte at a time.
+ *
+ * Runs next to the position decoder, which skips these bytes as garbage.
+ */
+struct ClockMatcher {
+  uint8_t buf[CLOCK_FRAME_LEN];
+  uint8_t len = 0;
+  ClockFrame frame = {};  // The last frame matched
+
+  bool push(uint8_t b) {
+    if ((len == 0 && b != FRAME_SYNC0) || (len == 1 && b != CLOCK_MARKER)) {
+      len = b == FRAME_SYNC0 ? 1 : 0;
+      return false;
+    }
+    buf[len++] = b;
+    if (len < CLOCK_FRAME_LEN) {
+      return false;
+    }
+    len = 0;
+    if (!stream_check_crc(buf, CLOCK_FRAME_LEN)) {
+      return false;
+    }
+    clock_decode(buf, &frame);
+    return true;
+  }
+};
+
+/**
+ * @brief Round trip, offset and fix anchor of one peer's clock.
+ */
+struct LinkClock {
+  // Echo state for the next frame we send
+  bool heard = false;
+  uint32_t peerTxUs = 0;     // txUs of the peer's last frame
+  uint32_t peerRxUs = 0;     // Local time it arrived
+  bool sent = false;
+  uint32_t lastTxUs = 0;     // When we last sent a frame
+
+  // Round-trip samples, oldest overwritten first
+  int32_t rtts[CLOCK_SAMPLES];
+  int32_t offsets[CLOCK_SAMPLES];
+  uint8_t samples = 0;
+  uint8_t next = 0;
+  int32_t rttUs = 0;         // Last round trip
+  int32_t rttMeanUs = 0;     // Smoothed over about 8 samples
+  int32_t bestRttUs = 0;     // Shortest round trip held
+  int32_t offsetUs = 0;      // Peer clock minus local clock, from that sample
+
+  // The peer's newest fix, as it last reported it
+  bool peerFix = false;
+  uint32_t fixUs = 0;        // Peer clock
+  uint32_t fixMs = 0;        // GPS time of day
+  int32_t lat_e6 = 0;
+  int32_t lon_e6 = 0;
+
+  uint32_t frames = 0;       // Clock frames received
+  uint32_t rejected = 0;     // Echoes with an impossible round trip
+
+  // Forgets the peer, e.g. when the link drops; it may have restarted
+  void reset() { *this = LinkClock(); }
+
+  bool synced() const { return samples > 0; }
+
+  // True once CLOCK_INTERVAL_US has passed since the last frame we sent
+  bool due(uint32_t nowUs) const { return !sent || nowUs - lastTxUs >= CLOCK_INTERVAL_US; }
+
+  /**
+   * @brief Fills in the timing fields of the next frame to send.
+   *
+   * The caller fills in fixUs, fixMs and the position.
+   *
+   * @param nowUs Local time the frame is sent.
+   * @param f The frame.
+   */
+  void prepare(uint32_t nowUs, ClockFrame* f) {
+    f->txUs = nowUs;
+    f->echoUs = heard ? peerTxUs : 0;
+    f->holdUs = heard ? nowUs - peerRxUs : CLOCK_NO_ECHO;
+    sent = true;
+    lastTxUs = nowUs;
+  }
+
+  /**
+   * @brief Takes in a frame from the peer.
+   *
+   * @param f The frame.
+   * @param rxUs Local time it arrived.
+   *
+   * @return true If it gave a round-trip sample.
+   */
+  bool receive(const ClockFrame& f, uint32_t rxUs) {
+    frames++;
+    heard = true;
+    peerTxUs = f.txUs;
+    peerRxUs = rxUs;
+    peerFix = f.fixMs != CLOCK_NO_FIX;
+    if (peerFix) {
+      fixUs = f.fixUs;
+      fixMs = f.fixMs;
+      lat_e6 = f.lat_e6;
+      lon_e6 = f.lon_e6;
+    }
+    if (f.holdUs == CLOCK_NO_ECHO || !sent) {
+      return false;
+    }
+    int32_t rtt = (int32_t)(rxUs - f.echoUs - f.holdUs);
+    if (rtt < 0 || rtt > CLOCK_RTT_MAX_US) {
+      rejected++;
+      return false;
+    }
+    rtts[next] = rtt;
+    offsets[next] = (int32_t)(f.txUs - (rxUs - (uint32_t)(rtt / 2)));
+    next = (next + 1) % CLOCK_SAMPLES;
+    rttMeanUs = samples ? rttMeanUs + (rtt - rttMeanUs) / 8 : rtt;
+    if (samples < CLOCK_SAMPLES) {
+      samples++;
+    }
+    rttUs = rtt;
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < samples; i++) {
+      if (rtts[i] < rtts[best]) {
+        best = i;
+      }
+    }
+    bestRttUs = rtts[best];
+    offsetUs = offsets[best];
+    return true;
+  }
+
+  // One-way delay estimate: half the shortest round trip held
+  int32_t oneWayUs() const { return bestRttUs / 2; }
+
+  // A time on the peer's clock in the local clock
+  uint32_t toLocalUs(uint32_t peerUs) const { return peerUs - (uint32_t)offsetUs; }
+
+  /**
+   * @brief Local time at which the peer's GPS read a time of day.
+   *
+   * Goes through the peer's last reported fix, so it needs a sample and a
+   * fix from the peer, and a time within CLOCK_ANCHOR_MAX_MS of that fix.
+   *
+   * @param gpsMs GPS time of day in milliseconds, e.g. of a position frame.
+   * @param localUs Receives the local time.
+   *
+   * @return true If the time could be mapped.
+   */
+  bool gpsToLocalUs(uint32_t gpsMs, uint32_t* localUs) const {
+    if (!synced() || !peerFix) {
+      return false;
+    }
+    int32_t dMs = (int32_t)(gpsMs - fixMs);
+    if (dMs > CLOCK_DAY_MS / 2) {
+      dMs -= CLOCK_DAY_MS;  // Across midnight
+    } else if (dMs < -CLOCK_DAY_MS / 2) {
+      dMs += CLOCK_DAY_MS;
+    }
+    if (dMs > CLOCK_ANCHOR_MAX_MS || dMs < -CLOCK_ANCHOR_MAX_MS) {
+      return false;
+    }
+    *localUs = toLocalUs(fixUs + (uint32_t)(dMs * 1000));
+    return true;
+  }
+};
+
+#endif
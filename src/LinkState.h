@@ -0,0 +1,180 @@
+#ifndef LINK_STATE_H
+#define LINK_STATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Connection state machine for one Bluetooth link, shared by the master's
+ * session table and the client.
+ *
+ *   IDLE ---------> CONNECTING ---opened()---> CONNECTED
+ *     due()           |   ^                       |
+ *                     |   | due()                 | closed()
+ *           failed()  v   |                       v
+ *                    BACKOFF <--------------------+
+ *
+ * A link never gives up. After a drop the first retry comes within
+ * LINK_RECONNECT_MS; each failure in a row then doubles the wait from
+ * LINK_BACKOFF_MIN_MS up to LINK_BACKOFF_MAX_MS. Every wait is drawn from
+ * its upper half at random, so clients that lost the master to the same
+ * interference do not all page it again at the same moment.
+ *
+ * The machine does no I/O and reads no clock. The owner starts an attempt
+ * when due() says so and reports the outcome from its SPP callback with
+ * opened(), failed() or closed(). opened() is accepted in any state: a
+ * client's SPP server keeps listening while it backs off.
+ */
+
+#define LINK_RECONNECT_MS 1000       // First retry after a connected link drops
+#define LINK_BACKOFF_MIN_MS 2000     // Wait after the first failed attempt
+#define LINK_BACKOFF_MAX_MS 60000
+
+enum LinkState {
+  LINK_IDLE,        // Never tried
+  LINK_CONNECTING,  // Attempt started, result pending
+  LINK_CONNECTED,
+  LINK_BACKOFF,     // Waiting for the next attempt
+};
+
+inline const char* link_state_name(LinkState s) {
+  static const char* const names[] = { "idle", "connecting", "connected", "backoff" };
+  return names[s];
+}
+
+struct LinkStats {
+  uint32_t connects = 0;          // Attempts that opened
+  uint32_t failures = 0;          // Attempts that failed or timed out
+  uint32_t drops = 0;             // Connected links that closed
+  uint32_t reconnects = 0;        // Drops followed by a new connection
+  uint32_t lastReconnectMs = 0;   // Drop to connected again
+  uint32_t maxReconnectMs = 0;
+  uint64_t totalReconnectMs = 0;
+  uint32_t connectedMs = 0;       // Time spent connected, up to the last drop
+};
+
+struct LinkStateMachine {
+  LinkState state = LINK_IDLE;
+  uint8_t attempts = 0;      // Failed attempts since the last connection
+  uint32_t sinceMs = 0;      // When the current state was entered
+  uint32_t retryAtMs = 0;    // When BACKOFF ends
+  uint32_t droppedAtMs = 0;  // When the link last dropped, while it is down
+  bool down = false;         // Dropped and not reconnected yet
+  uint32_t rng = 0x9E3779B9u;
+  LinkStats stats;
+
+  // Seeds the jitter, e.g. from the peer's or the device's own address
+  void seed(const uint8_t* bytes, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+      h = (h ^ bytes[i]) * 16777619u;
+    }
+    rng = h ? h : 1;
+  }
+
+  bool due(uint32_t nowMs) const {
+    return state == LINK_IDLE || (state == LINK_BACKOFF && (int32_t)(nowMs - retryAtMs) >= 0);
+  }
+
+  /**
+   * @brief Time until due() turns true.
+   *
+   * @return uint32_t 0 if due now, UINT32_MAX while connecting or connected.
+   */
+  uint32_t waitMs(uint32_t nowMs) const {
+    if (state == LINK_IDLE) {
+      return 0;
+    }
+    if (state != LINK_BACKOFF) {
+      return UINT32_MAX;
+    }
+    int32_t left = (int32_t)(retryAtMs - nowMs);
+    return left > 0 ? (uint32_t)left : 0;
+  }
+
+  // True once an attempt has been pending for `limitMs`
+  bool timedOut(uint32_t nowMs, uint32_t limitMs) const {
+    return state == LINK_CONNECTING && nowMs - sinceMs >= limitMs;
+  }
+
+  void connecting(uint32_t nowMs) {
+    state = LINK_CONNECTING;
+    sinceMs = nowMs;
+  }
+
+  void opened(uint32_t nowMs) {
+    if (state == LINK_CONNECTED) {
+      return;
+    }
+    if (down) {
+      uint32_t ms = nowMs - droppedAtMs;
+      stats.reconnects++;
+      stats.lastReconnectMs = ms;
+      stats.totalReconnectMs += ms;
+      if (ms > stats.maxReconnectMs) {
+        stats.maxReconnectMs = ms;
+      }
+      down = false;
+    }
+    state = LINK_CONNECTED;
+    sinceMs = nowMs;
+    attempts = 0;
+    stats.connects++;
+  }
+
+  void failed(uint32_t nowMs) {
+    if (state == LINK_CONNECTED) {
+      closed(nowMs);
+      return;
+    }
+    stats.failures++;
+    if (attempts < 31) {
+      attempts++;
+    }
+    backoff(nowMs);
+  }
+
+  // A pending attempt that closes has failed; a connected link has dropped
+  void closed(uint32_t nowMs) {
+    if (state == LINK_CONNECTING) {
+      failed(nowMs);
+      return;
+    }
+    if (state != LINK_CONNECTED) {
+      return;
+    }
+    stats.drops++;
+    stats.connectedMs += nowMs - sinceMs;
+    down = true;
+    droppedAtMs = nowMs;
+    backoff(nowMs);
+  }
+
+  // Time connected in total, including the current connection
+  uint32_t connectedMs(uint32_t nowMs) const {
+    return stats.connectedMs + (state == LINK_CONNECTED ? nowMs - sinceMs : 0);
+  }
+
+  uint32_t meanReconnectMs() const {
+    return stats.reconnects ? (uint32_t)(stats.totalReconnectMs / stats.reconnects) : 0;
+  }
+
+ private:
+  void backoff(uint32_t nowMs) {
+    uint32_t wait = LINK_RECONNECT_MS;
+    if (attempts) {
+      wait = LINK_BACKOFF_MAX_MS;
+      if (attempts <= 16 && ((uint32_t)LINK_BACKOFF_MIN_MS << (attempts - 1)) < wait) {
+        wait = (uint32_t)LINK_BACKOFF_MIN_MS << (attempts - 1);
+      }
+    }
+    rng ^= rng << 13;  // xorshift32
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    state = LINK_BACKOFF;
+    sinceMs = nowMs;
+    retryAtMs = nowMs + wait / 2 + rng % (wait / 2 + 1);
+  }
+};
+
+#endif
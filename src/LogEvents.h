@@ -0,0 +1,115 @@
+#ifndef LOG_EVENTS_H
+#define LOG_EVENTS_H
+
+#include "EventLog.h"
+
+/*
+ * Every deferred log event of Master_SW.c and Client_SW.c, with its level
+ * and format (see EventLog.h for the conversions). Ids are shared by both
+ * sketches so one decoder reads either; append new events at the end to
+ * keep old captures readable.
+ */
+#define LOG_EVENTS(X)                                                                     \
+  X(DROPPED, LOG_ERROR, "%u log events dropped")                                          \
+  /* Client */                                                                            \
+  X(MASTER_CONNECTED, LOG_INFO, "Master Connected")                                       \
+  X(MASTER_DISCONNECTED, LOG_INFO, "Master Disconnected")                                 \
+  X(TEXT_EMPTY, LOG_ERROR, "Error: Empty GPS Data")                                       \
+  X(TEXT_FORMAT, LOG_ERROR, "Error: Invalid GPS data format.")                            \
+  X(TEXT_NUMBERS, LOG_ERROR, "Error: Unable to parse latitude and longitude.")            \
+  X(TEXT_LAT_RANGE, LOG_ERROR, "Error: Latitude out of range.")                           \
+  X(TEXT_LON_RANGE, LOG_ERROR, "Error: Longitude out of range.")                          \
+  X(TEXT_FAILED, LOG_ERROR, "Error: Failed to parse GPS data.")                           \
+  X(TEXT_PARSED, LOG_INFO, "Parsed Latitude: %E, Longitude: %E")                          \
+  X(FRAME_RANGE, LOG_ERROR, "Error: Frame position out of range.")                        \
+  X(FRAME, LOG_INFO, "Frame %u: %ld %ld")                                                 \
+  X(KEY_REQUEST, LOG_INFO, "Keyframe requested after frame %u")                           \
+  X(MY_POSITION, LOG_DEBUG, "Current Latitude: %E, Longitude: %E")                        \
+  X(NO_GPS, LOG_WARN, "Warning: No GPS data available or signal is weak.")                \
+  X(DISTANCE, LOG_INFO, "Distance to Master: %lu.%02lu yards")                            \
+  X(DIRECTION, LOG_INFO, "Direction to Master: %d deg")                                   \
+  X(LCD_WRITES, LOG_DEBUG, "LCD: %lu bus writes, %lu saved")                              \
+  X(WAITING, LOG_WARN, "Waiting for Master to connect...")                                \
+  X(MASTER_UNSET, LOG_WARN, "Warning: Master GPS coordinates are not set.")               \
+  X(GPS_INVALID, LOG_WARN, "Warning: GPS data is invalid or not updated.")                \
+  X(LOCATIONS, LOG_DEBUG, "Current Location: %E, %E  Master Location: %E, %E")            \
+  /* Master */                                                                            \
+  X(CLIENT_CONNECTED, LOG_INFO, "Client %M Connected")                                    \
+  X(CLIENT_RECONNECTED, LOG_INFO, "Client %M reconnected after %lu ms")                   \
+  X(CLIENT_DISCONNECTED, LOG_INFO, "Client %M Disconnected")                              \
+  X(CLIENT_RETRY, LOG_INFO, "Client %M: retrying in %lu ms")                              \
+  X(CLIENT_CONNECTING, LOG_INFO, "Connecting to client %M, attempt %u")                   \
+  X(FIX, LOG_INFO, "Fix %u: %ld %ld")                                                     \
+  /* Client, fences */                                                                    \
+  X(MASTER_FENCE_ENTER, LOG_INFO, "Master entered fence %u")                              \
+  X(MASTER_FENCE_EXIT, LOG_INFO, "Master left fence %u")                                  \
+  X(FENCE_ENTER, LOG_INFO, "Entered fence %u")                                            \
+  X(FENCE_EXIT, LOG_INFO, "Left fence %u")                                                \
+  /* Client, warm start */                                                                \
+  X(WARM_SAVED, LOG_INFO, "Warm start state saved: %E, %E")                               \
+  X(WARM_OTHER_MASTER, LOG_INFO, "Master %M is not the stored one; stored position dropped") \
+  /* Master */                                                                            \
+  X(CLIENT_UNKNOWN, LOG_WARN, "Connection from %M, which is not a listed client")
+
+enum LogEventId {
+#define LOG_EVENT_ID(name, level, text) LOG_##name,
+  LOG_EVENTS(LOG_EVENT_ID)
+#undef LOG_EVENT_ID
+  LOG_EVENT_COUNT
+};
+
+enum LogEventLevel {
+#define LOG_EVENT_LEVEL(name, level, text) LOG_LEVEL_##name = level,
+  LOG_EVENTS(LOG_EVENT_LEVEL)
+#undef LOG_EVENT_LEVEL
+};
+
+const LogFormat LOG_FORMATS[LOG_EVENT_COUNT] = {
+#define LOG_EVENT_FORMAT(name, level, text) { level, text },
+  LOG_EVENTS(LOG_EVENT_FORMAT)
+#undef LOG_EVENT_FORMAT
+};
+
+/**
+ * @brief Writes out every event waiting in a ring.
+ *
+ * Events lost to a full ring since the last drain are reported first, as
+ * one DROPPED event.
+ *
+ * @param ring The ring; only one task may drain it.
+ * @param out Where to write, e.g. Serial.
+ * @param binary true = binary records for host/tools/log_decode, false = text lines.
+ * @param nowMs Timestamp for the DROPPED event.
+ *
+ * @return size_t Number of events written.
+ */
+template <class Out, size_t N>
+size_t log_drain(EventRing<N>& ring, Out& out, bool binary, uint32_t nowMs) {
+  LogEvent ev;
+  size_t count = 0;
+  uint32_t lost = ring.takeDropped();
+  bool have = false;
+  if (lost) {
+    ev.id = LOG_DROPPED;
+    ev.argc = 1;
+    ev.ms = nowMs;
+    ev.args[0] = lost;
+    have = true;
+  }
+  while (have || ring.take(&ev)) {
+    have = false;
+    if (binary) {
+      uint8_t record[LOG_RECORD_MAX];
+      out.write(record, log_encode(ev, record));
+    } else {
+      char line[LOG_LINE_MAX + 1];
+      size_t len = log_format(ev, LOG_FORMATS, LOG_EVENT_COUNT, line);
+      line[len++] = '\n';
+      out.write((const uint8_t*)line, len);
+    }
+    count++;
+  }
+  return count;
+}
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef POSITION_FILTER_H
+#define POSITION_FILTER_H
+
+#include <stdint.h>
+#include <math.h>
+
+#include "Geodesy.h"
+#include "DeadReckoning.h"
+
+/*
+ * Smoothing of the client's own GPS fixes with a constant-velocity Kalman
+ * filter.
+ *
+ * A stationary receiver's fixes wander by several meters, which moves the
+ * distance and bearing to the master as much as the master's own motion
+ * does. The filter keeps position and velocity along north and east, in
+ * meters from an origin near the receiver, as two independent axes with a
+ * 2x2 covariance each. Between fixes the state moves along its velocity
+ * and the covariance grows by a random acceleration of FILTER_ACCEL_MPS2.
+ * A fix's own variance is (FILTER_UERE_M * HDOP)^2, larger still with
+ * fewer than FILTER_GOOD_SATS satellites, so a poor fix moves the estimate
+ * less than a good one. Fixes from fewer than FILTER_MIN_SATS satellites
+ * are ignored.
+ *
+ * A fix whose normalized innovation, over both axes, is above FILTER_GATE
+ * is an outlier and is left out. FILTER_REJECTS_MAX outliers in a row mean
+ * the receiver really is elsewhere, e.g. after a cold start, and the filter
+ * restarts on the fix. So does a gap of FILTER_GAP_MS without fixes.
+ *
+ * MoveGate then passes the estimate on only once it is a set distance from
+ * the last one passed, so standing still costs nothing downstream.
+ *
+ * All float, a few dozen multiplies per fix.
+ */
+
+const float FILTER_UERE_M = 3.0f;        // 1-sigma range error; a fix's error is HDOP times this
+const float FILTER_HDOP_UNKNOWN = 5.0f;  // HDOP assumed when the receiver gives none
+const float FILTER_ACCEL_MPS2 = 0.5f;    // 1-sigma random acceleration; a walker's changes of pace
+const float FILTER_INIT_SPEED_MPS = 2.0f;  // 1-sigma speed before any is measured
+const float FILTER_GATE = 13.8f;         // Chi-squared, 2 degrees of freedom, 99.9%
+const float FILTER_RECENTER_M = 1000.0f; // Distance from the origin at which it is moved
+const uint8_t FILTER_MIN_SATS = 4;       // Fewer satellites and the fix is ignored
+const uint8_t FILTER_GOOD_SATS = 6;      // Fewer satellites and the fix counts for less
+const uint8_t FILTER_REJECTS_MAX = 5;    // Outliers in a row after which the filter restarts
+const uint32_t FILTER_GAP_MS = 10000;    // Time without fixes after which the filter restarts
+
+// What PositionFilter::update() did with a fix
+enum FilterResult {
+  FILTER_STARTED,   // The fix became the new state
+  FILTER_ACCEPTED,  // The fix was blended in
+  FILTER_REJECTED,  // An outlier, left out
+  FILTER_WEAK,      // Too few satellites, left out
+};
+
+/**
+ * @brief Position and velocity along one axis, with their covariance.
+ */
+struct FilterAxis {
+  float x;    // Position, m
+  float v;    // Velocity, m/s
+  float pxx;  // Covariance
+  float pxv;
+  float pvv;
+
+  void start(float z, float r) {
+    x = z;
+    v = 0;
+    pxx = r;
+    pxv = 0;
+    pvv = FILTER_INIT_SPEED_MPS * FILTER_INIT_SPEED_MPS;
+  }
+
+  // Moves the state dt seconds along its velocity, with random acceleration of variance q
+  void predict(float dt, float q) {
+    float dt2 = dt * dt;
+    x += v * dt;
+    pxx += dt * (2.0f * pxv + dt * pvv) + 0.25f * q * dt2 * dt2;
+    pxv += dt * pvv + 0.5f * q * dt2 * dt;
+    pvv += q * dt2;
+  }
+
+  // Variance of a measurement's innovation, for the gate
+  float innovationVariance(float r) const { return pxx + r; }
+
+  // Blends in a position measurement z of variance r
+  void update(float z, float r) {
+    float s = pxx + r;
+    float kx = pxx / s, kv = pxv / s;
+    float y = z - x;
+    x += kx * y;
+    v += kv * y;
+    pvv -= kv * pxv;
+    pxv -= kx * pxv;
+    pxx -= kx * pxx;
+  }
+};
+
+/**
+ * @brief Own-position Kalman filter on micro-degree fixes.
+ */
+struct PositionFilter {
+  int32_t originLat_e6 = 0;  // Where north and east are measured from
+  int32_t originLon_e6 = 0;
+  float eastE6PerM = DR_E6_PER_M;  // Micro-degrees of longitude per meter at the origin
+  FilterAxis north = {};
+  FilterAxis east = {};
+  bool valid = false;
+  uint32_t lastMs = 0;
+  uint8_t rejectRun = 0;     // Outliers in a row
+
+  uint32_t fixes = 0;        // Fixes blended in, restarts included
+  uint32_t rejected = 0;     // Outliers
+  uint32_t weak = 0;         // Too few satellites
+  uint32_t restarts = 0;     // After a gap or a run of outliers; not the first start
+
+  /**
+   * @brief Takes one GPS fix.
+   *
+   * @param lat_e6 Latitude in micro-degrees.
+   * @param lon_e6 Longitude in micro-degrees.
+   * @param hdop Horizontal dilution of precision; 0 if unknown.
+   * @param sats Satellites in use; 0 if unknown, which is taken as enough.
+   * @param nowMs When the fix was taken.
+   *
+   * @return FilterResult What became of the fix.
+   */
+  FilterResult update(int32_t lat_e6, int32_t lon_e6, float hdop, uint8_t sats, uint32_t nowMs) {
+    if (sats && sats < FILTER_MIN_SATS) {
+      weak++;
+      return FILTER_WEAK;
+    }
+    float sigma = FILTER_UERE_M * (hdop > 0 ? hdop : FILTER_HDOP_UNKNOWN);
+    float r = sigma * sigma;
+    if (sats && sats < FILTER_GOOD_SATS) {
+      float k = (float)FILTER_GOOD_SATS / sats;
+      r *= k * k;
+    }
+    bool gap = valid && nowMs - lastMs >= FILTER_GAP_MS;
+    if (!valid || gap || rejectRun >= FILTER_REJECTS_MAX) {
+      restarts += valid;
+      start(lat_e6, lon_e6, r, nowMs);
+      return FILTER_STARTED;
+    }
+    float dt = (nowMs - lastMs) * 0.001f;
+    if (dt > 0) {
+      float q = FILTER_ACCEL_MPS2 * FILTER_ACCEL_MPS2;
+      north.predict(dt, q);
+      east.predict(dt, q);
+    }
+    lastMs = nowMs;
+    float zn, ze;
+    toMeters(lat_e6, lon_e6, &zn, &ze);
+    float yn = zn - north.x, ye = ze - east.x;
+    float d2 = yn * yn / north.innovationVariance(r) + ye * ye / east.innovationVariance(r);
+    if (d2 > FILTER_GATE) {
+      rejected++;
+      rejectRun++;
+      return FILTER_REJECTED;
+    }
+    rejectRun = 0;
+    north.update(zn, r);
+    east.update(ze, r);
+    fixes++;
+    if (fabsf(north.x) > FILTER_RECENTER_M || fabsf(east.x) > FILTER_RECENTER_M) {
+      recenter();
+    }
+    return FILTER_ACCEPTED;
+  }
+
+  // The filtered position in micro-degrees
+  void position(int32_t* lat_e6, int32_t* lon_e6) const {
+    *lat_e6 = originLat_e6 + (int32_t)lroundf(north.x * DR_E6_PER_M);
+    *lon_e6 = wrapLon(originLon_e6 + (int64_t)lroundf(east.x * eastE6PerM));
+  }
+
+  // The filtered speed in m/s
+  float speedMps() const { return sqrtf(north.v * north.v + east.v * east.v); }
+
+ private:
+  static int32_t wrapLon(int64_t lon_e6) {
+    if (lon_e6 > 180000000) {
+      lon_e6 -= 360000000;
+    } else if (lon_e6 < -180000000) {
+      lon_e6 += 360000000;
+    }
+    return (int32_t)lon_e6;
+  }
+
+  void setOrigin(int32_t lat_e6, int32_t lon_e6) {
+    originLat_e6 = lat_e6;
+    originLon_e6 = lon_e6;
+    eastE6PerM = DR_E6_PER_M / cosf(lat_e6 * (GEO_DEG_TO_RAD_F * 1e-6f));
+  }
+
+  void toMeters(int32_t lat_e6, int32_t lon_e6, float* n, float* e) const {
+    *n = (lat_e6 - originLat_e6) / DR_E6_PER_M;
+    *e = wrapLon((int64_t)lon_e6 - originLon_e6) / eastE6PerM;
+  }
+
+  void start(int32_t lat_e6, int32_t lon_e6, float r, uint32_t nowMs) {
+    setOrigin(lat_e6, lon_e6);
+    north.start(0, r);
+    east.start(0, r);
+    valid = true;
+    lastMs = nowMs;
+    rejectRun = 0;
+    fixes++;
+  }
+
+  // Moves the origin to the estimate, so the meters stay small enough for float
+  void recenter() {
+    int32_t lat_e6, lon_e6;
+    position(&lat_e6, &lon_e6);
+    setOrigin(lat_e6, lon_e6);
+    north.x = 0;
+    east.x = 0;
+  }
+};
+
+/**
+ * @brief Passes a position on only once it has moved far enough.
+ */
+struct MoveGate {
+  float thresholdM;
+  int32_t lat_e6 = 0;  // The last position passed
+  int32_t lon_e6 = 0;
+  bool passedAny = false;
+  uint32_t passed = 0;
+  uint32_t held = 0;
+
+  explicit MoveGate(float thresholdM) : thresholdM(thresholdM) {}
+
+  /**
+   * @brief Whether a position is far enough from the last one passed.
+   *
+   * @return true If it is, or nothing was passed yet; it becomes the last one passed.
+   * @return false If it is within the threshold.
+   */
+  bool pass(int32_t lat, int32_t lon) {
+    if (passedAny && geo_distance_e6(lat_e6, lon_e6, lat, lon) < thresholdM) {
+      held++;
+      return false;
+    }
+    lat_e6 = lat;
+    lon_e6 = lon;
+    passedAny = true;
+    passed++;
+    return true;
+  }
+};
+
+#endif
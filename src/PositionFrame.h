@@ -0,0 +1,203 @@
+#ifndef POSITION_FRAME_H
+#define POSITION_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Binary position frame shared by Master_SW.c and Client_SW.c.
+ *
+ * Layout (little-endian, 22 bytes):
+ *   [0]      0xA5 sync
+ *   [1]      0x5A sync
+ *   [2]      frame version
+ *   [3]      sequence number (wraps at 255)
+ *   [4..7]   latitude in micro-degrees (int32)
+ *   [8..11]  longitude in micro-degrees (int32)
+ *   [12..15] GPS time of day of the fix in milliseconds (uint32)
+ *   [16..17] northward velocity in cm/s (int16)
+ *   [18..19] eastward velocity in cm/s (int16)
+ *   [20..21] CRC-16/CCITT-FALSE over bytes [2..19]
+ *
+ * Version 1 frames were the same without the velocity (18 bytes).
+ */
+
+#define FRAME_SYNC0 0xA5
+#define FRAME_SYNC1 0x5A
+#define FRAME_VERSION 2
+#define FRAME_LEN 22
+
+const int32_t FRAME_DEG_SCALE = 1000000;  // Micro-degrees per degree
+
+struct PositionFix {
+  uint8_t seq;      // Sequence number assigned by the master
+  int32_t lat_e6;   // Latitude in micro-degrees
+  int32_t lon_e6;   // Longitude in micro-degrees
+  uint32_t time_ms; // GPS time of day of the fix in milliseconds
+  int16_t vn_cms;   // Northward velocity in cm/s
+  int16_t ve_cms;   // Eastward velocity in cm/s
+};
+
+/**
+ * @brief Computes CRC-16/CCITT-FALSE over a block of bytes.
+ *
+ * Uses a 16-entry nibble table so it stays small in flash and needs no
+ * setup at runtime.
+ *
+ * @param data Bytes to checksum.
+ * @param len Number of bytes.
+ *
+ * @return uint16_t The CRC value.
+ */
+inline uint16_t frame_crc16(const uint8_t* data, size_t len) {
+  static const uint16_t table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+  };
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+    crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)];
+  }
+  return crc;
+}
+
+inline void frame_put32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+inline uint32_t frame_get32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline void frame_put16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+inline uint16_t frame_get16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/**
+ * @brief Converts a coordinate in degrees to rounded micro-degrees.
+ *
+ * @param degrees Latitude or longitude in degrees.
+ *
+ * @return int32_t The coordinate in micro-degrees.
+ */
+inline int32_t frame_to_e6(double degrees) {
+  double scaled = degrees * FRAME_DEG_SCALE;
+  return (int32_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+}
+
+/**
+ * @brief Encodes a position fix into a binary frame.
+ *
+ * @param fix The fix to encode.
+ * @param out Destination buffer, at least FRAME_LEN bytes.
+ *
+ * @return size_t Number of bytes written (always FRAME_LEN).
+ */
+inline size_t frame_encode(const PositionFix& fix, uint8_t* out) {
+  out[0] = FRAME_SYNC0;
+  out[1] = FRAME_SYNC1;
+  out[2] = FRAME_VERSION;
+  out[3] = fix.seq;
+  frame_put32(out + 4, (uint32_t)fix.lat_e6);
+  frame_put32(out + 8, (uint32_t)fix.lon_e6);
+  frame_put32(out + 12, fix.time_ms);
+  frame_put16(out + 16, (uint16_t)fix.vn_cms);
+  frame_put16(out + 18, (uint16_t)fix.ve_cms);
+  uint16_t crc = frame_crc16(out + 2, FRAME_LEN - 4);
+  out[FRAME_LEN - 2] = (uint8_t)crc;
+  out[FRAME_LEN - 1] = (uint8_t)(crc >> 8);
+  return FRAME_LEN;
+}
+
+/**
+ * @brief Incremental frame decoder that resynchronizes after garbage.
+ *
+ * Bytes are pushed one at a time. Anything that is not part of a frame with
+ * valid sync, version and CRC is skipped; after a bad frame the decoder
+ * rescans the bytes it already holds for the next sync pair instead of
+ * throwing them away, so a frame that starts inside a corrupted one is
+ * still found.
+ */
+struct FrameDecoder {
+  uint8_t buf[FRAME_LEN];
+  uint8_t len = 0;
+  uint32_t frames = 0;       // Frames decoded successfully
+  uint32_t crcErrors = 0;    // Frames dropped due to a CRC mismatch
+  uint32_t badVersion = 0;   // Frames dropped due to an unknown version
+  uint32_t skipped = 0;      // Bytes discarded while searching for sync
+
+  /**
+   * @brief Feeds one received byte into the decoder.
+   *
+   * @param b The received byte.
+   * @param out Filled with the decoded fix when a frame completes.
+   *
+   * @return true If a complete, valid frame was decoded.
+   * @return false If more bytes are needed.
+   */
+  bool push(uint8_t b, PositionFix* out) {
+    if (len == 0 && b != FRAME_SYNC0) {
+      skipped++;
+      return false;
+    }
+    if (len == 1 && b != FRAME_SYNC1) {
+      skipped++;
+      len = (b == FRAME_SYNC0) ? 1 : 0;
+      return false;
+    }
+    buf[len++] = b;
+    if (len < FRAME_LEN) {
+      return false;
+    }
+
+    uint16_t crc = (uint16_t)buf[FRAME_LEN - 2] | ((uint16_t)buf[FRAME_LEN - 1] << 8);
+    if (crc != frame_crc16(buf + 2, FRAME_LEN - 4)) {
+      crcErrors++;
+      resync();
+      return false;
+    }
+    if (buf[2] != FRAME_VERSION) {
+      badVersion++;
+      resync();
+      return false;
+    }
+
+    out->seq = buf[3];
+    out->lat_e6 = (int32_t)frame_get32(buf + 4);
+    out->lon_e6 = (int32_t)frame_get32(buf + 8);
+    out->time_ms = frame_get32(buf + 12);
+    out->vn_cms = (int16_t)frame_get16(buf + 16);
+    out->ve_cms = (int16_t)frame_get16(buf + 18);
+    frames++;
+    len = 0;
+    return true;
+  }
+
+  // Discards a partial frame, e.g. after receive bytes were lost
+  void reset() {
+    len = 0;
+  }
+
+  // Drops the current sync pair and restarts from the next candidate sync byte
+  void resync() {
+    uint8_t start = 1;
+    while (start < len && !(buf[start] == FRAME_SYNC0 && (start + 1 == len || buf[start + 1] == FRAME_SYNC1))) {
+      start++;
+    }
+    skipped += start;
+    len -= start;
+    memmove(buf, buf + start, len);
+  }
+};
+
+#endif
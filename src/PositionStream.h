@@ -0,0 +1,516 @@
+#ifndef POSITION_STREAM_H
+#define POSITION_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "PositionFrame.h"
+
+/*
+ * Delta-encoded position stream built on the binary frame in
+ * PositionFrame.h.
+ *
+ * A keyframe is an ordinary position frame. Between keyframes the master
+ * sends delta frames against the previous fix:
+ *   [0]     0xA5 sync
+ *   [1]     0xD1 delta marker, or 0xD2 if the velocity changed
+ *   [2]     sequence number, exactly one more than the previous frame's
+ *   [3..]   zigzag varint latitude delta in micro-degrees
+ *           zigzag varint longitude delta in micro-degrees
+ *           varint time-of-day delta in units of 10 ms
+ *           0xD2 only: zigzag varint north and east velocity deltas in cm/s
+ *   [n-2..] CRC-16/CCITT-FALSE over bytes [2..n-3]
+ * At walking speed every varint fits one byte, so an update is 8 bytes, or
+ * 10 when the velocity is updated too. A velocity change within
+ * STREAM_VELOCITY_BAND is not sent.
+ *
+ * A delta only means something on top of the fix before it. When the
+ * decoder sees a sequence gap or a delta with no base it drops deltas until
+ * the next keyframe and sets needKeyframe, and the client sends a keyframe
+ * request upstream:
+ *   [0] 0xA5 sync  [1] 0x4B request marker  [2] last sequence number applied
+ *   [3..4] CRC-16 over byte [2]
+ *
+ * With StreamEncoder::redundant set, a delta also carries the step before
+ * it, so a decoder that missed one frame rebuilds it from the next one and
+ * keeps its base:
+ *   [0]     0xA5 sync
+ *   [1]     0xD3 redundant delta marker
+ *   [2]     sequence number
+ *   [3]     flags: bit 0 this step carries velocity, bit 1 the previous one does
+ *   [4..]   this step's fields, as in 0xD1 or 0xD2
+ *           the previous step's fields, from the fix before the previous one
+ *   [n-2..] CRC-16 over bytes [2..n-3]
+ * At walking speed that is 11 or 13 bytes. The encoder falls back to a plain
+ * delta when the previous step does not fit one, e.g. after a jump.
+ *
+ * Frames that arrive late, behind one already applied, are dropped as stale
+ * without costing the base: a delta up to STREAM_REORDER_WINDOW sequence
+ * numbers behind, or a keyframe with an older GPS time. Keyframes go by time
+ * rather than sequence number, so a restarted master is not taken for a
+ * late one.
+ */
+
+#define STREAM_DELTA 0xD1
+#define STREAM_DELTA_V 0xD2
+#define STREAM_DELTA_R 0xD3
+#define STREAM_KEY_REQUEST 0x4B
+#define STREAM_REQUEST_LEN 5
+#define STREAM_VARINT_MAX 3           // Longest varint a delta frame may hold
+#define STREAM_FRAME_MAX (4 + 10 * STREAM_VARINT_MAX + 2)  // Longest frame, a redundant delta with two velocities
+#define STREAM_REORDER_WINDOW 8       // Sequence numbers behind the last fix a delta is still taken for stale
+#define STREAM_HALF_DAY_MS 43200000L
+#define STREAM_DELTA_LIMIT (1 << 19)  // Largest coordinate delta (~58 km) before a keyframe is forced
+#define STREAM_VELOCITY_BAND 5        // Velocity change in cm/s per axis that is not worth sending
+#ifndef STREAM_KEYFRAME_MS
+#define STREAM_KEYFRAME_MS 10000      // Longest time between keyframes
+#endif
+
+inline uint32_t stream_zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+inline int32_t stream_unzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Writes an unsigned LEB128 varint and returns its length
+inline size_t stream_put_varint(uint8_t* p, uint32_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    p[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  p[n++] = (uint8_t)v;
+  return n;
+}
+
+// Reads a varint of at most STREAM_VARINT_MAX bytes and returns its length
+inline size_t stream_get_varint(const uint8_t* p, uint32_t* v) {
+  uint32_t value = 0;
+  size_t n = 0;
+  do {
+    value |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+  } while (p[n++] & 0x80);
+  *v = value;
+  return n;
+}
+
+inline void stream_put_crc(uint8_t* frame, size_t len) {
+  uint16_t crc = frame_crc16(frame + 2, len - 4);
+  frame[len - 2] = (uint8_t)crc;
+  frame[len - 1] = (uint8_t)(crc >> 8);
+}
+
+inline bool stream_check_crc(const uint8_t* frame, size_t len) {
+  uint16_t crc = (uint16_t)frame[len - 2] | ((uint16_t)frame[len - 1] << 8);
+  return crc == frame_crc16(frame + 2, len - 4);
+}
+
+/**
+ * @brief Whether the step between two fixes fits a delta frame.
+ *
+ * @param from The fix decoders hold.
+ * @param to The next fix.
+ */
+inline bool stream_fits_delta(const PositionFix& from, const PositionFix& to) {
+  int32_t dLat = to.lat_e6 - from.lat_e6;
+  int32_t dLon = to.lon_e6 - from.lon_e6;
+  uint32_t dTime = to.time_ms - from.time_ms;
+  return (uint8_t)(to.seq - from.seq) == 1 && dLat < STREAM_DELTA_LIMIT && dLat > -STREAM_DELTA_LIMIT &&
+         dLon < STREAM_DELTA_LIMIT && dLon > -STREAM_DELTA_LIMIT && dTime % 10 == 0 &&
+         dTime / 10 < (1UL << (7 * STREAM_VARINT_MAX));
+}
+
+/**
+ * @brief Writes the fields of one step: position, time and optionally velocity.
+ *
+ * @return size_t Number of bytes written.
+ */
+inline size_t stream_put_step(uint8_t* p, const PositionFix& from, const PositionFix& to, bool velocity) {
+  size_t n = stream_put_varint(p, stream_zigzag(to.lat_e6 - from.lat_e6));
+  n += stream_put_varint(p + n, stream_zigzag(to.lon_e6 - from.lon_e6));
+  n += stream_put_varint(p + n, (to.time_ms - from.time_ms) / 10);
+  if (velocity) {
+    n += stream_put_varint(p + n, stream_zigzag(to.vn_cms - from.vn_cms));
+    n += stream_put_varint(p + n, stream_zigzag(to.ve_cms - from.ve_cms));
+  }
+  return n;
+}
+
+/**
+ * @brief Applies the fields of one step to a fix.
+ *
+ * @return size_t Number of bytes read.
+ */
+inline size_t stream_get_step(const uint8_t* p, bool velocity, PositionFix* fix) {
+  uint32_t zLat, zLon, dTime;
+  size_t n = stream_get_varint(p, &zLat);
+  n += stream_get_varint(p + n, &zLon);
+  n += stream_get_varint(p + n, &dTime);
+  fix->lat_e6 += stream_unzigzag(zLat);
+  fix->lon_e6 += stream_unzigzag(zLon);
+  fix->time_ms += dTime * 10;
+  if (velocity) {
+    uint32_t zVn, zVe;
+    n += stream_get_varint(p + n, &zVn);
+    n += stream_get_varint(p + n, &zVe);
+    fix->vn_cms = (int16_t)(fix->vn_cms + stream_unzigzag(zVn));
+    fix->ve_cms = (int16_t)(fix->ve_cms + stream_unzigzag(zVe));
+  }
+  return n;
+}
+
+/**
+ * @brief Encodes a keyframe request.
+ *
+ * @param lastSeq Sequence number of the last frame the client applied.
+ * @param out Destination buffer, at least STREAM_REQUEST_LEN bytes.
+ *
+ * @return size_t Number of bytes written (always STREAM_REQUEST_LEN).
+ */
+inline size_t stream_encode_request(uint8_t lastSeq, uint8_t* out) {
+  out[0] = FRAME_SYNC0;
+  out[1] = STREAM_KEY_REQUEST;
+  out[2] = lastSeq;
+  stream_put_crc(out, STREAM_REQUEST_LEN);
+  return STREAM_REQUEST_LEN;
+}
+
+/**
+ * @brief Looks for a keyframe request in bytes received from a client.
+ *
+ * @return true If `data` holds a valid request.
+ */
+inline bool stream_find_request(const uint8_t* data, size_t len) {
+  for (size_t i = 0; i + STREAM_REQUEST_LEN <= len; i++) {
+    if (data[i] == FRAME_SYNC0 && data[i + 1] == STREAM_KEY_REQUEST && stream_check_crc(data + i, STREAM_REQUEST_LEN)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Turns successive fixes into keyframes and delta frames.
+ *
+ * A keyframe goes out first, every STREAM_KEYFRAME_MS, after
+ * requestKeyframe(), and whenever a change does not fit a delta frame
+ * (a large jump, or the GPS clock going backwards at midnight).
+ */
+struct StreamEncoder {
+  PositionFix base = {};        // The last fix encoded, which the next delta is against
+  bool haveBase = false;
+  PositionFix prev = {};        // The fix before it, as decoders held it
+  bool havePrev = false;
+  bool redundant = false;       // Deltas also carry the step before them (STREAM_DELTA_R)
+  bool keyRequested = false;
+  uint32_t lastKeyMs = 0;
+  uint32_t keyframes = 0;
+  uint32_t deltas = 0;
+  uint32_t bytes = 0;
+
+  void requestKeyframe() { keyRequested = true; }
+
+  /**
+   * @brief Encodes the next fix of the stream.
+   *
+   * @param fix The fix, with its sequence number already assigned.
+   * @param nowMs Current time in milliseconds, for the keyframe interval.
+   * @param out Destination buffer, at least STREAM_FRAME_MAX bytes.
+   *
+   * @return size_t Number of bytes written.
+   */
+  size_t encode(const PositionFix& fix, uint32_t nowMs, uint8_t* out) {
+    int32_t dVn = fix.vn_cms - base.vn_cms;
+    int32_t dVe = fix.ve_cms - base.ve_cms;
+    bool velocity = dVn > STREAM_VELOCITY_BAND || dVn < -STREAM_VELOCITY_BAND || dVe > STREAM_VELOCITY_BAND ||
+                    dVe < -STREAM_VELOCITY_BAND;
+    bool key = !haveBase || keyRequested || nowMs - lastKeyMs >= STREAM_KEYFRAME_MS || !stream_fits_delta(base, fix);
+    // The step before this one, resent so a decoder that missed it can catch up
+    bool again = redundant && !key && havePrev && stream_fits_delta(prev, base);
+    PositionFix from = base;
+    PositionFix before = prev;
+    prev = base;
+    havePrev = haveBase;
+    // The base is what decoders will hold, so an unsent velocity change stays out of it
+    base = fix;
+    if (!key && !velocity) {
+      base.vn_cms = from.vn_cms;
+      base.ve_cms = from.ve_cms;
+    }
+    haveBase = true;
+    size_t len;
+    if (key) {
+      keyRequested = false;
+      lastKeyMs = nowMs;
+      keyframes++;
+      len = frame_encode(fix, out);
+    } else {
+      out[0] = FRAME_SYNC0;
+      out[2] = fix.seq;
+      if (again) {
+        bool velocityBefore = from.vn_cms != before.vn_cms || from.ve_cms != before.ve_cms;
+        out[1] = STREAM_DELTA_R;
+        out[3] = (uint8_t)((velocity ? 1 : 0) | (velocityBefore ? 2 : 0));
+        len = 4;
+        len += stream_put_step(out + len, from, fix, velocity);
+        len += stream_put_step(out + len, before, from, velocityBefore);
+      } else {
+        out[1] = velocity ? STREAM_DELTA_V : STREAM_DELTA;
+        len = 3;
+        len += stream_put_step(out + len, from, fix, velocity);
+      }
+      len += 2;
+      stream_put_crc(out, len);
+      deltas++;
+    }
+    bytes += (uint32_t)len;
+    return len;
+  }
+
+  /**
+   * @brief Encodes the last fix again as a keyframe.
+   *
+   * Gives a client that joins mid-stream a base without waiting for the
+   * next fix. Decoders that already have the fix just apply it again.
+   *
+   * @param nowMs Current time in milliseconds, for the keyframe interval.
+   * @param out Destination buffer, at least FRAME_LEN bytes.
+   *
+   * @return size_t Number of bytes written, or 0 if nothing was encoded yet.
+   */
+  size_t repeatKeyframe(uint32_t nowMs, uint8_t* out) {
+    if (!haveBase) {
+      return 0;
+    }
+    keyRequested = false;
+    lastKeyMs = nowMs;
+    keyframes++;
+    bytes += FRAME_LEN;
+    return frame_encode(base, out);
+  }
+};
+
+/**
+ * @brief Decoder for a stream of keyframes and delta frames.
+ *
+ * Same interface as FrameDecoder, and the same resynchronization after
+ * garbage: after a bad frame it rescans the bytes it already holds for the
+ * next sync pair.
+ */
+struct StreamDecoder {
+  uint8_t buf[STREAM_FRAME_MAX];
+  uint8_t len = 0;
+  PositionFix last = {};        // Last fix applied; the base for the next delta
+  bool haveBase = false;
+  bool started = false;         // A fix was applied, so last.seq means something
+  bool needKeyframe = false;    // Deltas were dropped; a keyframe request is due
+  uint32_t frames = 0;          // Fixes decoded, keyframes plus deltas
+  uint32_t keyframes = 0;
+  uint32_t crcErrors = 0;       // Frames dropped due to a CRC mismatch
+  uint32_t badVersion = 0;      // Keyframes dropped due to an unknown version
+  uint32_t malformed = 0;       // Delta frames with an oversized varint
+  uint32_t gaps = 0;            // Sequence gaps seen
+  uint32_t orphans = 0;         // Deltas dropped for want of a base
+  uint32_t recovered = 0;       // Missed fixes rebuilt from a redundant delta
+  uint32_t stale = 0;           // Frames dropped for arriving behind a newer one
+  uint32_t lost = 0;            // Sequence numbers skipped between fixes applied, modulo 256
+  uint32_t skipped = 0;         // Bytes discarded while searching for sync
+
+  /**
+   * @brief Feeds one received byte into the decoder.
+   *
+   * @param b The received byte.
+   * @param out Filled with the decoded fix when a frame completes.
+   *
+   * @return true If a complete frame produced a new fix.
+   * @return false If more bytes are needed or the frame was dropped.
+   */
+  bool push(uint8_t b, PositionFix* out) {
+    if (len == 0 && b != FRAME_SYNC0) {
+      skipped++;
+      return false;
+    }
+    if (len == 1 && !marker(b)) {
+      skipped++;
+      len = (b == FRAME_SYNC0) ? 1 : 0;
+      return false;
+    }
+    buf[len++] = b;
+    int need = frameLength();
+    if (need < 0) {
+      malformed++;
+      resync();
+      return false;
+    }
+    if (need == 0 || len < need) {
+      return false;
+    }
+
+    if (!stream_check_crc(buf, len)) {
+      crcErrors++;
+      resync();
+      return false;
+    }
+    bool ok = buf[1] == FRAME_SYNC1 ? applyKeyframe() : applyDelta();
+    len = 0;
+    if (ok) {
+      *out = last;
+      frames++;
+    }
+    return ok;
+  }
+
+  // Discards a partial frame, e.g. after receive bytes were lost
+  void reset() {
+    len = 0;
+  }
+
+  static bool marker(uint8_t b) {
+    return b == FRAME_SYNC1 || b == STREAM_DELTA || b == STREAM_DELTA_V || b == STREAM_DELTA_R;
+  }
+
+  /**
+   * @brief Length of the frame being received.
+   *
+   * @return int The total length, 0 while it is not known yet, or -1 if a
+   *         delta varint is longer than STREAM_VARINT_MAX.
+   */
+  int frameLength() const {
+    if (len < 2) {
+      return 0;
+    }
+    if (buf[1] == FRAME_SYNC1) {
+      return FRAME_LEN;
+    }
+    uint8_t want, pos;
+    if (buf[1] == STREAM_DELTA_R) {
+      if (len < 4) {
+        return 0;
+      }
+      want = (uint8_t)(6 + (buf[3] & 1 ? 2 : 0) + (buf[3] & 2 ? 2 : 0));
+      pos = 4;
+    } else {
+      want = buf[1] == STREAM_DELTA_V ? 5 : 3;
+      pos = 3;
+    }
+    uint8_t fields = 0, run = 0;
+    for (; pos < len && fields < want; pos++) {
+      if (buf[pos] & 0x80) {
+        if (++run >= STREAM_VARINT_MAX) {
+          return -1;
+        }
+      } else {
+        fields++;
+        run = 0;
+      }
+    }
+    return fields == want ? pos + 2 : 0;
+  }
+
+  bool applyKeyframe() {
+    if (buf[2] != FRAME_VERSION) {
+      badVersion++;
+      return false;
+    }
+    uint8_t seq = buf[3];
+    uint32_t timeMs = frame_get32(buf + 12);
+    if (started && olderThanLast(timeMs)) {
+      stale++;
+      return false;
+    }
+    if (haveBase && seq != (uint8_t)(last.seq + 1) && seq != last.seq) {
+      gaps++;
+    }
+    count(seq);
+    last.seq = seq;
+    last.lat_e6 = (int32_t)frame_get32(buf + 4);
+    last.lon_e6 = (int32_t)frame_get32(buf + 8);
+    last.time_ms = timeMs;
+    last.vn_cms = (int16_t)frame_get16(buf + 16);
+    last.ve_cms = (int16_t)frame_get16(buf + 18);
+    haveBase = true;
+    needKeyframe = false;
+    keyframes++;
+    return true;
+  }
+
+  bool applyDelta() {
+    uint8_t seq = buf[2];
+    uint8_t ahead = (uint8_t)(seq - last.seq);
+    if (haveBase && (uint8_t)-ahead < STREAM_REORDER_WINDOW) {
+      stale++;  // Includes a repeat of the last frame, ahead == 0
+      return false;
+    }
+    if (!haveBase) {
+      orphans++;
+      needKeyframe = true;
+      return false;
+    }
+    bool redundant = buf[1] == STREAM_DELTA_R;
+    if (ahead != 1 && !(redundant && ahead == 2)) {
+      gaps++;
+      orphans++;
+      haveBase = false;
+      needKeyframe = true;
+      return false;
+    }
+    if (!redundant) {
+      count(seq);
+      last.seq = seq;
+      stream_get_step(buf + 3, buf[1] == STREAM_DELTA_V, &last);
+      return true;
+    }
+    // This step's fields come first; skip them to reach the previous step's
+    PositionFix step = {};
+    size_t pos = 4 + stream_get_step(buf + 4, buf[3] & 1, &step);
+    if (ahead == 2) {
+      gaps++;
+      recovered++;
+      last.seq = (uint8_t)(seq - 1);
+      stream_get_step(buf + pos, buf[3] & 2, &last);
+    }
+    count(seq);
+    last.seq = seq;
+    stream_get_step(buf + 4, buf[3] & 1, &last);
+    return true;
+  }
+
+  // Counts the sequence numbers skipped since the last fix applied
+  void count(uint8_t seq) {
+    uint8_t ahead = (uint8_t)(seq - last.seq);
+    if (started && ahead > 1 && ahead < 128) {
+      lost += ahead - 1u;
+    }
+    started = true;
+  }
+
+  // Whether a GPS time of day is before the last fix's, across midnight too; 0 is no time
+  bool olderThanLast(uint32_t timeMs) const {
+    if (timeMs == 0 || last.time_ms == 0) {
+      return false;
+    }
+    int32_t d = (int32_t)(timeMs - last.time_ms);
+    if (d > STREAM_HALF_DAY_MS) {
+      d -= 2 * STREAM_HALF_DAY_MS;
+    } else if (d < -STREAM_HALF_DAY_MS) {
+      d += 2 * STREAM_HALF_DAY_MS;
+    }
+    return d < 0;
+  }
+
+  // Drops the current sync pair and restarts from the next candidate sync byte
+  void resync() {
+    uint8_t start = 1;
+    while (start < len && !(buf[start] == FRAME_SYNC0 && (start + 1 == len || marker(buf[start + 1])))) {
+      start++;
+    }
+    skipped += start;
+    len -= start;
+    memmove(buf, buf + start, len);
+  }
+};
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+/*
+ * Light-sleep duty cycling between GPS bursts.
+ *
+ * With POWER_SAVE a sketch's tasks block whenever they have nothing to do,
+ * and automatic light sleep is on (esp_pm_configure()). Once every task is
+ * blocked and no timer is due for a few ticks, the idle task stops the CPU
+ * until the next timer or wake-up source. The Bluetooth controller keeps
+ * the SPP link up in modem sleep and wakes the chip for link traffic. The
+ * GPS UART's RX pin is a GPIO wake-up source.
+ *
+ * A UART loses the bytes that arrive while the chip sleeps and wakes up.
+ * Waking on the pin would cost the first sentence of every burst.
+ * GpsBurstClock learns the receiver's burst period from the bytes read.
+ * The task that reads the GPS holds a no-light-sleep lock from
+ * POWER_GUARD_US before each expected burst until the burst is over. The
+ * pin wake-up then only catches bursts that come early or after a gap.
+ * Until the period is known, or once POWER_MISSES_MAX bursts in a row
+ * have not come, the lock is held for POWER_SEARCH_US to find the bursts
+ * again, and every POWER_RESEARCH_US after that while the receiver stays
+ * silent.
+ *
+ * An interval close to a multiple of the period means bursts were missed,
+ * not that the rate changed, so it never becomes the period: otherwise a
+ * few missed bursts could lock the clock onto, say, every fifth one, and
+ * the chip would sleep through the other four. Bursts, or GPS wake-ups
+ * that find their bytes lost, between the expected ones mean the period
+ * is wrong after all; POWER_STRAYS_MAX of them in a row start a new search.
+ *
+ * DutyCycle measures the share of time the chip has to stay awake for the
+ * sketch: while any of its tasks runs or the lock is held.
+ */
+
+#define POWER_BURST_GAP_US 5000  // Silence on the GPS UART that ends a burst
+#define POWER_GUARD_US 3000      // Awake this long before and after an expected burst
+#define POWER_MISSES_MAX 3       // Bursts missed in a row before searching again
+#define POWER_SEARCH_US 1100000  // Awake this long to find the bursts; longer than a 1 Hz period
+#define POWER_RESEARCH_US 10000000  // Search period while the receiver is silent
+#define POWER_STRAYS_MAX 2       // Bursts in a row between the expected ones before searching again
+
+/**
+ * @brief Predicts the GPS receiver's next burst from the bytes read so far.
+ */
+struct GpsBurstClock {
+  uint32_t startUs = 0;    // When the last burst began
+  uint32_t lastUs = 0;     // When bytes were last read
+  uint32_t periodUs = 0;   // Smoothed start-to-start interval; 0 = not learnt yet
+  uint32_t bursts = 0;
+  uint8_t mismatches = 0;  // Intervals in a row that did not fit the period
+  uint8_t strays = 0;      // Bursts in a row that came between the expected ones
+
+  // Starts the first search for the bursts
+  void begin(uint32_t nowUs) {
+    lastUs = nowUs;
+  }
+
+  /**
+   * @brief Notes bytes just read from the GPS UART.
+   *
+   * @param nowUs Current time.
+   * @param count Bytes read; they are taken to have arrived back to back
+   *        up to now.
+   * @param byteUs One character time at the UART's baud rate.
+   * @param gpsWake Whether the reader was woken by the GPS UART.
+   */
+  void read(uint32_t nowUs, uint32_t count, uint32_t byteUs, bool gpsWake) {
+    if (!count) {
+      uint32_t changeUs;
+      if (gpsWake && periodUs && !holdAwake(nowUs, &changeUs)) {
+        stray(nowUs);  // A burst came while the chip slept, between the expected ones
+      }
+      return;
+    }
+    uint32_t began = nowUs - count * byteUs;
+    if (bursts == 0 || (int32_t)(began - lastUs) > POWER_BURST_GAP_US) {
+      if (!bursts || learn(began - startUs, nowUs)) {
+        startUs = began;  // Otherwise the expected bursts keep their phase
+      }
+      bursts++;
+    }
+    lastUs = nowUs;
+  }
+
+  /**
+   * @brief Whether the chip should stay awake for the GPS now.
+   *
+   * @param nowUs Current time.
+   * @param changeUs Set to the time until the answer changes, or
+   *        UINT32_MAX if only a new burst can change it.
+   *
+   * @return true While a burst is expected within POWER_GUARD_US or is
+   *         being received, or while searching for the bursts.
+   */
+  bool holdAwake(uint32_t nowUs, uint32_t* changeUs) const {
+    *changeUs = UINT32_MAX;
+    if (bursts && nowUs - lastUs < POWER_BURST_GAP_US) {
+      *changeUs = lastUs + POWER_BURST_GAP_US - nowUs;
+      return true;
+    }
+    // The first expected burst whose window has not closed yet
+    uint32_t elapsed = nowUs - startUs;
+    uint32_t k = !periodUs ? 0 : elapsed < POWER_GUARD_US ? 1 : (elapsed - POWER_GUARD_US) / periodUs + 1;
+    if (k == 0 || k > POWER_MISSES_MAX) {
+      // Not tracking the bursts: search windows, counted from the last byte
+      uint32_t phase = (nowUs - lastUs) % POWER_RESEARCH_US;
+      if (phase < POWER_SEARCH_US) {
+        *changeUs = POWER_SEARCH_US - phase;
+        return true;
+      }
+      *changeUs = POWER_RESEARCH_US - phase;
+      return false;
+    }
+    uint32_t due = startUs + k * periodUs;
+    if ((int32_t)(due - POWER_GUARD_US - nowUs) > 0) {
+      *changeUs = due - POWER_GUARD_US - nowUs;
+      return false;
+    }
+    *changeUs = due + POWER_GUARD_US - nowUs;
+    return true;
+  }
+
+ private:
+  // Whether a is within tolerance of b
+  static bool near(uint32_t a, uint32_t b, uint32_t tolerance) {
+    return (a > b ? a - b : b - a) < tolerance;
+  }
+
+  // Takes the interval since the last burst; true if the new one sets the phase
+  bool learn(uint32_t intervalUs, uint32_t nowUs) {
+    if (!periodUs) {
+      periodUs = intervalUs;
+      return true;
+    }
+    if (near(intervalUs, periodUs, periodUs / 8)) {
+      periodUs = (uint32_t)((int32_t)periodUs + ((int32_t)intervalUs - (int32_t)periodUs) / 8);
+      mismatches = 0;
+      strays = 0;
+      return true;
+    }
+    uint32_t k = (intervalUs + periodUs / 2) / periodUs;
+    if (k >= 2 && near(intervalUs, k * periodUs, periodUs / 8)) {
+      mismatches = 0;  // Missed bursts, not a new rate
+      return true;
+    }
+    k = (periodUs + intervalUs / 2) / intervalUs;
+    if (k >= 2 && near(k * intervalUs, periodUs, periodUs / 8)) {
+      stray(nowUs);  // The period may be a multiple of the real one
+      return !periodUs;  // Searching again, from this burst
+    }
+    if (++mismatches >= 2) {
+      // A new rate, e.g. after the receiver was configured; a single long
+      // interval is more likely a missed burst
+      periodUs = intervalUs;
+      mismatches = 0;
+      strays = 0;
+      return true;
+    }
+    return false;  // Most likely the tail of a burst read late
+  }
+
+  // Counts a burst between the expected ones and searches again after POWER_STRAYS_MAX
+  void stray(uint32_t nowUs) {
+    if (++strays < POWER_STRAYS_MAX) {
+      return;
+    }
+    periodUs = 0;
+    mismatches = 0;
+    strays = 0;
+    bursts = 0;  // The next burst starts the count afresh
+    lastUs = nowUs;
+  }
+};
+
+enum PowerWake {
+  POWER_WAKE_TIMER,  // A task's own timeout, including the wake-up before a GPS burst
+  POWER_WAKE_GPS,    // The GPS UART
+  POWER_WAKE_BT,     // Link data or events
+  POWER_WAKE_USB,    // The serial monitor
+  POWER_WAKE_CAUSES
+};
+
+/**
+ * @brief Share of time the sketch keeps the chip awake, and why it woke.
+ *
+ * Tasks call wake() when they unblock and sleep() before they block again,
+ * and a held no-light-sleep lock counts as one more awake task. The chip
+ * can sleep while the count is zero. Safe to call from any task.
+ */
+struct DutyCycle {
+  std::atomic<int32_t> awake{0};
+  std::atomic<uint32_t> awakeSum{0};  // Ends minus starts of awake intervals, in us, modulo 2^32
+  std::atomic<uint32_t> wakes[POWER_WAKE_CAUSES] = {};
+  uint32_t sampleUs = 0;              // Used by the reporting task only
+  uint32_t sampleAwake = 0;
+  uint32_t sampleWakes[POWER_WAKE_CAUSES] = {};
+
+  void wake(uint32_t nowUs, PowerWake cause) {
+    if (awake.fetch_add(1) == 0) {
+      awakeSum.fetch_sub(nowUs);
+      wakes[cause].fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void sleep(uint32_t nowUs) {
+    if (awake.fetch_sub(1) == 1) {
+      awakeSum.fetch_add(nowUs);
+    }
+  }
+
+  /**
+   * @brief Awake share and wake-ups since the last call; call while awake.
+   *
+   * @param nowUs Current time.
+   * @param wakesPerSec Set to the wake-ups per second by cause.
+   *
+   * @return float Percentage of the time the chip had to stay awake.
+   */
+  float sample(uint32_t nowUs, float wakesPerSec[POWER_WAKE_CAUSES]) {
+    uint32_t total = awakeSum.load() + nowUs;  // The caller is awake, so the count is not zero
+    uint32_t spanUs = nowUs - sampleUs;
+    uint32_t awakeUs = total - sampleAwake;
+    sampleUs = nowUs;
+    sampleAwake = total;
+    for (uint8_t i = 0; i < POWER_WAKE_CAUSES; i++) {
+      uint32_t n = wakes[i].load(std::memory_order_relaxed);
+      wakesPerSec[i] = spanUs ? (n - sampleWakes[i]) * 1e6f / spanUs : 0.0f;
+      sampleWakes[i] = n;
+    }
+    return spanUs ? 100.0f * awakeUs / spanUs : 100.0f;
+  }
+};
+
+#endif
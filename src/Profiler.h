@@ -0,0 +1,295 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#include "PositionStream.h"
+
+/*
+ * Hot-path profiler: per-stage cycle histograms, loop-period jitter and
+ * stall detection in fixed memory.
+ *
+ * A sketch numbers its stages, gives them names with begin(), and wraps
+ * each one in PROF_SCOPE(profiler, stage). Every scope reads the CPU cycle counter
+ * twice and adds one sample to a log2 histogram: bucket 0 holds anything
+ * under 128 cycles, bucket k cycles in [2^(k+6), 2^(k+7)), and the last
+ * bucket everything from 2^25 cycles (140 ms at 240 MHz) up. loopMark() at
+ * the top of loop() samples the loop period the same way. A period longer
+ * than PROF_STALL_US is a stall; the longest one is kept together with the
+ * slowest stage that ran during it. A loop() that blocks on purpose calls
+ * loopIdle() first, so the time it sleeps is not counted as a stall.
+ *
+ * Scopes nest, so a stage's time includes the stages it calls. The cycle
+ * counter is per core: a scope must start and end on the same core, which
+ * holds for the master's pinned tasks.
+ *
+ * The stats travel in a binary dump, sent in reply to a request:
+ *   [0] 0xA5 sync  [1] 0x50 profile marker  [2] flags, bit 0 = reset after
+ *   the dump  [3..4] CRC-16 over byte [2]
+ * The dump (little-endian, varints as in PositionStream.h, up to 64 bits):
+ *   [0] 0xA5 sync  [1] 0x50 profile marker  [2..3] body length
+ *   body:
+ *     version, device address (6 bytes), CPU MHz (uint16), uptime ms (uint32),
+ *     stage count, bucket count
+ *     loop period histogram, sum of squared periods in us (varint),
+ *     stalls, longest stall in us, when it ended in ms, its stage (0xFF if none)
+ *     per stage: NUL-terminated name, histogram
+ *   [n-2..] CRC-16/CCITT-FALSE over bytes [2..n-3]
+ * A histogram is count, max cycles, total cycles, then one count per bucket,
+ * all varints.
+ */
+
+// 1 = PROF_SCOPE() and PROF_LOOP() record, 0 = they compile to nothing
+#ifndef PROFILER
+#define PROFILER 1
+#endif
+
+#define PROF_MARKER 0x50
+#define PROF_REQUEST_LEN 5
+#define PROF_REQUEST_RESET 0x01
+#define PROF_VERSION 1
+#define PROF_BUCKETS 20
+#define PROF_MIN_SHIFT 7        // Bucket 0 ends at 2^7 cycles
+#define PROF_MAX_STAGES 10
+#define PROF_NAME_MAX 15
+#define PROF_NO_STAGE 0xFF
+#ifndef PROF_STALL_US
+#define PROF_STALL_US 20000     // Loop period counted as a stall
+#endif
+// Largest dump: header, loop record and every stage with maximal varints
+#define PROF_HIST_MAX (5 + 5 + 10 + PROF_BUCKETS * 5)
+#define PROF_DUMP_MAX (4 + 16 + PROF_HIST_MAX + 10 + 5 + 5 + 5 + 1 + PROF_MAX_STAGES * (PROF_NAME_MAX + 1 + PROF_HIST_MAX) + 2)
+
+// Cycle counter read by the scopes; the host build supplies the same call
+#ifndef PROF_CYCLES
+#define PROF_CYCLES() ESP.getCycleCount()
+#endif
+
+inline size_t prof_put_varint(uint8_t* p, uint64_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    p[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  p[n++] = (uint8_t)v;
+  return n;
+}
+
+inline uint8_t prof_bucket(uint32_t cycles) {
+  if (cycles < (1u << PROF_MIN_SHIFT)) {
+    return 0;
+  }
+  uint32_t b = 32 - __builtin_clz(cycles) - PROF_MIN_SHIFT;  // Bit length minus the shift
+  return b < PROF_BUCKETS ? (uint8_t)b : PROF_BUCKETS - 1;
+}
+
+struct ProfHistogram {
+  uint32_t count = 0;
+  uint32_t maxCycles = 0;
+  uint64_t totalCycles = 0;
+  uint32_t buckets[PROF_BUCKETS] = {};
+
+  void add(uint32_t cycles) {
+    count++;
+    totalCycles += cycles;
+    if (cycles > maxCycles) {
+      maxCycles = cycles;
+    }
+    buckets[prof_bucket(cycles)]++;
+  }
+
+  size_t put(uint8_t* p) const {
+    size_t n = prof_put_varint(p, count);
+    n += prof_put_varint(p + n, maxCycles);
+    n += prof_put_varint(p + n, totalCycles);
+    for (uint8_t i = 0; i < PROF_BUCKETS; i++) {
+      n += prof_put_varint(p + n, buckets[i]);
+    }
+    return n;
+  }
+};
+
+struct Profiler {
+  const char* const* names = nullptr;
+  uint8_t stages = 0;
+  uint16_t cpuMhz = 240;
+  ProfHistogram stage[PROF_MAX_STAGES];
+  ProfHistogram period;         // Loop period in cycles
+  uint64_t periodSqUs = 0;      // Sum of squared periods in us, for the jitter
+  uint32_t lastLoopCycles = 0;
+  bool looping = false;
+  uint32_t stalls = 0;
+  uint32_t worstStallUs = 0;
+  uint32_t worstStallAtMs = 0;
+  uint8_t worstStallStage = PROF_NO_STAGE;
+  uint8_t passStage = PROF_NO_STAGE;  // Slowest stage since the last loopMark()
+  uint32_t passCycles = 0;
+
+  void begin(const char* const* stageNames, uint8_t count, uint16_t mhz) {
+    names = stageNames;
+    stages = count < PROF_MAX_STAGES ? count : PROF_MAX_STAGES;
+    cpuMhz = mhz;
+  }
+
+  void reset() {
+    for (uint8_t i = 0; i < PROF_MAX_STAGES; i++) {
+      stage[i] = ProfHistogram();
+    }
+    period = ProfHistogram();
+    periodSqUs = 0;
+    looping = false;
+    stalls = 0;
+    worstStallUs = 0;
+    worstStallAtMs = 0;
+    worstStallStage = PROF_NO_STAGE;
+    passStage = PROF_NO_STAGE;
+    passCycles = 0;
+  }
+
+  void record(uint8_t s, uint32_t cycles) {
+    if (s >= stages) {
+      return;
+    }
+    stage[s].add(cycles);
+    if (cycles > passCycles) {
+      passCycles = cycles;
+      passStage = s;
+    }
+  }
+
+  // Called at the top of every loop() pass
+  void loopMark(uint32_t nowCycles, uint32_t nowMs) {
+    loopIdle(nowCycles, nowMs);
+    looping = true;
+    lastLoopCycles = nowCycles;
+  }
+
+  // Ends the current period before loop() blocks; the next loopMark() starts a new one
+  void loopIdle(uint32_t nowCycles, uint32_t nowMs) {
+    if (looping) {
+      uint32_t cycles = nowCycles - lastLoopCycles;
+      uint32_t us = cycles / cpuMhz;
+      period.add(cycles);
+      periodSqUs += (uint64_t)us * us;
+      if (us >= PROF_STALL_US) {
+        stalls++;
+        if (us > worstStallUs) {
+          worstStallUs = us;
+          worstStallAtMs = nowMs;
+          worstStallStage = passStage;
+        }
+      }
+    }
+    looping = false;
+    passStage = PROF_NO_STAGE;
+    passCycles = 0;
+  }
+
+  uint32_t meanPeriodUs() const {
+    return period.count ? (uint32_t)(period.totalCycles / cpuMhz / period.count) : 0;
+  }
+
+  // Standard deviation of the loop period
+  uint32_t jitterUs() const {
+    if (!period.count) {
+      return 0;
+    }
+    double mean = (double)period.totalCycles / cpuMhz / period.count;
+    double var = (double)periodSqUs / period.count - mean * mean;
+    return var > 0 ? (uint32_t)sqrt(var) : 0;
+  }
+
+  /**
+   * @brief Writes the binary stats dump.
+   *
+   * @param address Bluetooth address of this device, to tell dumps apart.
+   * @param nowMs Uptime in milliseconds.
+   * @param out Destination buffer, at least PROF_DUMP_MAX bytes.
+   *
+   * @return size_t Number of bytes written.
+   */
+  size_t dump(const uint8_t address[6], uint32_t nowMs, uint8_t* out) const {
+    uint8_t* p = out + 4;
+    *p++ = PROF_VERSION;
+    memcpy(p, address, 6);
+    p += 6;
+    frame_put16(p, cpuMhz);
+    frame_put32(p + 2, nowMs);
+    p += 6;
+    *p++ = stages;
+    *p++ = PROF_BUCKETS;
+    p += period.put(p);
+    p += prof_put_varint(p, periodSqUs);
+    p += prof_put_varint(p, stalls);
+    p += prof_put_varint(p, worstStallUs);
+    p += prof_put_varint(p, worstStallAtMs);
+    *p++ = worstStallStage;
+    for (uint8_t i = 0; i < stages; i++) {
+      size_t len = strnlen(names[i], PROF_NAME_MAX);
+      memcpy(p, names[i], len);
+      p[len] = '\0';
+      p += len + 1;
+      p += stage[i].put(p);
+    }
+    size_t len = (size_t)(p - out) + 2;
+    out[0] = FRAME_SYNC0;
+    out[1] = PROF_MARKER;
+    frame_put16(out + 2, (uint16_t)(len - 6));
+    stream_put_crc(out, len);
+    return len;
+  }
+};
+
+// Times the enclosing block as one sample of a stage
+struct ProfScope {
+  Profiler& prof;
+  uint8_t stage;
+  uint32_t start;
+
+  ProfScope(Profiler& p, uint8_t s) : prof(p), stage(s), start(PROF_CYCLES()) {}
+  ~ProfScope() { prof.record(stage, PROF_CYCLES() - start); }
+};
+
+/**
+ * @brief Recognises a stats request in a byte stream, one byte at a time.
+ */
+struct ProfRequestMatcher {
+  uint8_t window[PROF_REQUEST_LEN] = {};
+  uint8_t flags = 0;  // Flags of the last request matched
+
+  bool push(uint8_t b) {
+    memmove(window, window + 1, PROF_REQUEST_LEN - 1);
+    window[PROF_REQUEST_LEN - 1] = b;
+    if (window[0] != FRAME_SYNC0 || window[1] != PROF_MARKER || !stream_check_crc(window, PROF_REQUEST_LEN)) {
+      return false;
+    }
+    flags = window[2];
+    memset(window, 0, sizeof(window));
+    return true;
+  }
+};
+
+inline size_t prof_encode_request(uint8_t flags, uint8_t* out) {
+  out[0] = FRAME_SYNC0;
+  out[1] = PROF_MARKER;
+  out[2] = flags;
+  stream_put_crc(out, PROF_REQUEST_LEN);
+  return PROF_REQUEST_LEN;
+}
+
+#define PROF_CONCAT2(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT2(a, b)
+#if PROFILER
+#define PROF_SCOPE(prof, s) ProfScope PROF_CONCAT(profScope, __LINE__)(prof, s)
+#define PROF_LOOP(prof) (prof).loopMark(PROF_CYCLES(), millis())
+#define PROF_IDLE(prof) (prof).loopIdle(PROF_CYCLES(), millis())
+#else
+#define PROF_SCOPE(prof, s)
+#define PROF_LOOP(prof)
+#define PROF_IDLE(prof)
+#endif
+
+#endif
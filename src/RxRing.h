@@ -0,0 +1,145 @@
+#ifndef RX_RING_H
+#define RX_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Receive-side helpers for the Client's Bluetooth link.
+ *
+ * RxRing is a fixed byte ring that the sketch fills from the stream every
+ * loop() and drains into a frame decoder or LineAssembler. When a burst
+ * overruns it, the oldest bytes are overwritten so the newest position is
+ * always the one that survives.
+ */
+
+/**
+ * @brief Fixed-size byte ring that overwrites its oldest bytes when full.
+ *
+ * @tparam N Capacity in bytes; must be a power of two.
+ */
+template <size_t N>
+struct RxRing {
+  static_assert((N & (N - 1)) == 0, "RxRing size must be a power of two");
+
+  uint8_t buf[N];
+  size_t head = 0;        // Total bytes written
+  size_t tail = 0;        // Total bytes read
+  uint32_t overruns = 0;  // Bytes overwritten before they were read
+
+  size_t available() const { return head - tail; }
+  size_t capacity() const { return N; }
+
+  /**
+   * @brief Returns the contiguous free span at the write position.
+   *
+   * The span can be filled directly (for example by Stream::readBytes())
+   * and then published with commit(). When the ring is full the span
+   * covers the oldest bytes, which commit() then drops.
+   *
+   * @param len Set to the span length, never zero.
+   *
+   * @return uint8_t* Start of the span.
+   */
+  uint8_t* writeSpan(size_t* len) {
+    size_t pos = head & (N - 1);
+    *len = N - pos;
+    return buf + pos;
+  }
+
+  /**
+   * @brief Publishes bytes written into the span from writeSpan().
+   *
+   * @param n Number of bytes written.
+   *
+   * @return true If older unread bytes were overwritten.
+   * @return false If everything fitted.
+   */
+  bool commit(size_t n) {
+    head += n;
+    if (head - tail > N) {
+      overruns += (uint32_t)(head - tail - N);
+      tail = head - N;
+      return true;
+    }
+    return false;
+  }
+
+  int read() {
+    if (head == tail) {
+      return -1;
+    }
+    return buf[tail++ & (N - 1)];
+  }
+
+  void clear() { tail = head; }
+};
+
+/**
+ * @brief Assembles newline-terminated text lines in a fixed buffer.
+ *
+ * Lines are NUL-terminated in place with the trailing CR/LF removed, so
+ * they can be parsed without copying; the line stays valid until the next
+ * push(). A line longer than the buffer is discarded up to the next
+ * newline rather than truncated.
+ *
+ * @tparam N Buffer size including the terminating NUL.
+ */
+template <size_t N>
+struct LineAssembler {
+  char line[N];
+  size_t len = 0;
+  bool overflow = false;   // Skipping to the next newline
+  bool ready = false;      // `line` holds a complete line from the last push()
+  uint32_t lines = 0;      // Complete lines emitted
+  uint32_t discarded = 0;  // Lines dropped for being too long or cut short
+
+  /**
+   * @brief Feeds one received character.
+   *
+   * @param c The received character.
+   *
+   * @return true If a complete line is now in `line` (length `len`).
+   * @return false If more characters are needed.
+   */
+  bool push(char c) {
+    if (ready) {
+      ready = false;
+      len = 0;
+    }
+    if (c == '\n') {
+      bool ok = !overflow;
+      overflow = false;
+      if (!ok) {
+        discarded++;
+        len = 0;
+        return false;
+      }
+      while (len > 0 && line[len - 1] == '\r') {
+        len--;
+      }
+      line[len] = '\0';
+      lines++;
+      ready = true;
+      return true;
+    }
+    if (overflow) {
+      return false;
+    }
+    if (len >= N - 1) {
+      overflow = true;
+      return false;
+    }
+    line[len++] = c;
+    return false;
+  }
+
+  // Drops the partial line after bytes were lost and skips to the next newline
+  void resync() {
+    ready = false;
+    len = 0;
+    overflow = true;
+  }
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <atomic>
+#include <type_traits>
+
+/*
+ * Single-writer sequence lock, for handing a small struct such as a
+ * position from a task on one core to a task on the other without a mutex.
+ *
+ * The writer makes the sequence number odd, stores the value and makes it
+ * even again. A reader copies the value between two loads of the sequence
+ * number. If they differ, or the first one is odd, a write overlapped the
+ * copy and the reader tries again. A reader thus always gets one whole
+ * value, never half of an old one and half of a new one. It never blocks
+ * the writer, and the writer never waits for it.
+ *
+ * The value is kept as 32-bit atomic words, so the copy is not a data race
+ * in the C++ memory model. On the ESP32 those are plain loads and stores,
+ * with a memory barrier on each side.
+ *
+ * A reader spins for as long as a write is in progress. The writer must
+ * not be preempted by a reader on its own core halfway through a write,
+ * which holds when they are pinned to different cores.
+ */
+
+/**
+ * @brief A value shared by one writer and any number of readers.
+ *
+ * @tparam T A trivially copyable type.
+ */
+template <class T>
+struct Seqlock {
+  static_assert(std::is_trivially_copyable<T>::value, "Seqlock copies its value word by word");
+  static const size_t WORDS = (sizeof(T) + 3) / 4;
+
+  std::atomic<uint32_t> seq{0};          // Odd while a write is in progress
+  std::atomic<uint32_t> words[WORDS] = {};
+  std::atomic<uint32_t> retries{0};      // Reads that overlapped a write and went again
+
+  /**
+   * @brief Publishes a new value; only ever called from one task.
+   *
+   * @param value The value.
+   */
+  void write(const T& value) {
+    uint32_t buf[WORDS] = {};
+    memcpy(buf, &value, sizeof(T));
+    uint32_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);  // Odd before any word changes
+    for (size_t i = 0; i < WORDS; i++) {
+      words[i].store(buf[i], std::memory_order_relaxed);
+    }
+    seq.store(s + 2, std::memory_order_release);
+  }
+
+  /**
+   * @brief Copies out the newest whole value.
+   *
+   * @param out Receives the value.
+   *
+   * @return uint32_t How many values have been written; 0 if none yet, and
+   *         `out` then holds zeroes.
+   */
+  uint32_t read(T* out) {
+    uint32_t buf[WORDS];
+    uint32_t before, after;
+    for (;;) {
+      before = seq.load(std::memory_order_acquire);
+      for (size_t i = 0; i < WORDS; i++) {
+        buf[i] = words[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);  // Words before the second look
+      after = seq.load(std::memory_order_relaxed);
+      if (before == after && !(before & 1)) {
+        break;
+      }
+      retries.fetch_add(1, std::memory_order_relaxed);
+    }
+    memcpy(out, buf, sizeof(T));
+    return before / 2;
+  }
+
+  // Values written so far, to tell whether there is a new one without copying it
+  uint32_t version() const { return seq.load(std::memory_order_acquire) / 2; }
+};
+
+#endif
@@ -0,0 +1,297 @@
+#ifndef SESSION_MANAGER_H
+#define SESSION_MANAGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "LinkState.h"
+
+/*
+ * Session table that lets one Master serve a group of Clients.
+ *
+ * Each client has its own connection state machine (LinkState.h) and send
+ * queue.
+ * A frame is encoded once into a shared ring of SESSION_POOL_LEN frames;
+ * a client's send queue is just its cursor into that ring, so publishing
+ * costs the same for one client as for sixteen and nothing is re-formatted
+ * per client. A client that falls more than the ring behind skips to the
+ * oldest frame still held, which drops stale fixes rather than delaying
+ * new ones.
+ *
+ * The table does no I/O itself. connect and send go through a transport
+ * passed to maintain() and service(), which provides
+ *   bool connect(uint8_t slot, const uint8_t address[6]);
+ *   bool send(uint8_t slot, const uint8_t* data, size_t len);
+ * connect() starts a connection whose result is reported back with
+ * opened() or closed(); send() takes a whole frame or nothing.
+ *
+ * Not thread-safe: callers serialize access, including between
+ * nextFrame() and publish().
+ */
+
+#ifndef SESSION_MAX_CLIENTS
+#define SESSION_MAX_CLIENTS 16
+#endif
+#define SESSION_POOL_LEN 8        // Frames held for clients that are behind; power of two
+#define SESSION_FRAME_MAX 64      // Largest frame, including a legacy text line
+#define SESSION_CONNECT_TIMEOUT_MS 15000  // A connect the stack never answers counts as failed
+
+static_assert((SESSION_POOL_LEN & (SESSION_POOL_LEN - 1)) == 0, "SESSION_POOL_LEN must be a power of two");
+
+struct SessionStats {
+  uint32_t frames = 0;       // Frames handed to the transport
+  uint32_t bytes = 0;
+  uint32_t dropped = 0;      // Frames skipped because the client fell behind the ring
+  uint32_t refused = 0;      // send() calls the transport turned down, retried later
+  uint32_t lastUs = 0;       // Publish-to-send latency
+  uint32_t maxUs = 0;
+  uint64_t totalUs = 0;
+};
+
+struct ClientSession {
+  uint8_t address[6];
+  LinkStateMachine link;      // Connect state, backoff and reconnect statistics
+  uint32_t handle = 0;        // Transport's connection handle
+  uint32_t cursor = 0;        // Next frame to send; the queue is [cursor, published)
+  SessionStats stats;
+};
+
+struct SessionFrame {
+  uint8_t data[SESSION_FRAME_MAX];
+  uint8_t len = 0;
+  uint32_t publishedUs = 0;  // Timestamp latency is measured from
+};
+
+struct SessionManager {
+  ClientSession clients[SESSION_MAX_CLIENTS];
+  uint8_t count = 0;
+  int8_t connecting = -1;      // Slot with a connect in progress; one page at a time
+  SessionFrame pool[SESSION_POOL_LEN];
+  uint32_t published = 0;      // Frames published so far
+
+  /**
+   * @brief Adds a client to the table.
+   *
+   * @param address Bluetooth device address of the client.
+   *
+   * @return int The client's slot, or -1 if the table is full.
+   */
+  int add(const uint8_t address[6]) {
+    if (count >= SESSION_MAX_CLIENTS) {
+      return -1;
+    }
+    ClientSession& c = clients[count];
+    memcpy(c.address, address, 6);
+    c.link = LinkStateMachine();
+    c.link.seed(address, 6);
+    return count++;
+  }
+
+  int find(const uint8_t address[6]) const {
+    for (uint8_t i = 0; i < count; i++) {
+      if (memcmp(clients[i].address, address, 6) == 0) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  int findHandle(uint32_t handle) const {
+    for (uint8_t i = 0; i < count; i++) {
+      LinkState state = clients[i].link.state;
+      if (clients[i].handle == handle && (state == LINK_CONNECTING || state == LINK_CONNECTED)) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  uint8_t connectedCount() const {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < count; i++) {
+      n += clients[i].link.state == LINK_CONNECTED;
+    }
+    return n;
+  }
+
+  // True while a connected client has frames service() has not sent yet
+  bool backlog() const {
+    for (uint8_t i = 0; i < count; i++) {
+      if (clients[i].link.state == LINK_CONNECTED && clients[i].cursor != published) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Starts a connect to the client that has been due longest.
+   *
+   * Does nothing while another connect is in progress, unless that one has
+   * gone SESSION_CONNECT_TIMEOUT_MS without an answer, in which case it
+   * fails first.
+   *
+   * @param transport Transport whose connect() starts the attempt.
+   * @param nowMs Current time in milliseconds.
+   *
+   * @return int The slot a connect was started for, or -1.
+   */
+  template <class Transport>
+  int maintain(Transport& transport, uint32_t nowMs) {
+    if (connecting >= 0 && clients[connecting].link.timedOut(nowMs, SESSION_CONNECT_TIMEOUT_MS)) {
+      failed((uint8_t)connecting, nowMs);
+    }
+    if (connecting >= 0) {
+      return -1;
+    }
+    int due = -1;
+    for (uint8_t i = 0; i < count; i++) {
+      const LinkStateMachine& l = clients[i].link;
+      if (l.due(nowMs) && (due < 0 || (int32_t)(l.retryAtMs - clients[due].link.retryAtMs) < 0)) {
+        due = i;
+      }
+    }
+    if (due < 0) {
+      return -1;
+    }
+    clients[due].link.connecting(nowMs);
+    connecting = (int8_t)due;
+    if (!transport.connect((uint8_t)due, clients[due].address)) {
+      failed((uint8_t)due, nowMs);
+    }
+    return due;
+  }
+
+  /**
+   * @brief Time until maintain() has something to do.
+   *
+   * @return uint32_t Milliseconds until the next client is due or the
+   *         pending connect times out, or UINT32_MAX if neither.
+   */
+  uint32_t nextDueMs(uint32_t nowMs) const {
+    if (connecting >= 0) {
+      uint32_t pending = nowMs - clients[connecting].link.sinceMs;
+      return pending < SESSION_CONNECT_TIMEOUT_MS ? SESSION_CONNECT_TIMEOUT_MS - pending : 0;
+    }
+    uint32_t wait = UINT32_MAX;
+    for (uint8_t i = 0; i < count; i++) {
+      uint32_t w = clients[i].link.waitMs(nowMs);
+      wait = w < wait ? w : wait;
+    }
+    return wait;
+  }
+
+  /**
+   * @brief Records a connection that opened.
+   *
+   * The client starts with the newest frame already published, so it gets
+   * the current position without waiting for the next fix.
+   */
+  void opened(uint8_t slot, uint32_t handle, uint32_t nowMs) {
+    ClientSession& c = clients[slot];
+    if (connecting == slot) {
+      connecting = -1;
+    }
+    c.link.opened(nowMs);
+    c.handle = handle;
+    c.cursor = published ? published - 1 : 0;
+  }
+
+  // Records a failed connect; the client backs off before the next attempt
+  void failed(uint8_t slot, uint32_t nowMs) {
+    ClientSession& c = clients[slot];
+    if (connecting == slot) {
+      connecting = -1;
+    }
+    c.handle = 0;
+    c.link.failed(nowMs);
+  }
+
+  // Records a closed connection; a pending connect that closes has failed
+  void closed(uint8_t slot, uint32_t nowMs) {
+    ClientSession& c = clients[slot];
+    if (c.link.state == LINK_CONNECTING) {
+      failed(slot, nowMs);
+      return;
+    }
+    if (c.link.state != LINK_CONNECTED) {
+      return;
+    }
+    c.handle = 0;
+    c.link.closed(nowMs);
+  }
+
+  /**
+   * @brief Buffer for the next frame, to encode into in place.
+   *
+   * @return uint8_t* SESSION_FRAME_MAX bytes, valid until publish().
+   */
+  uint8_t* nextFrame() { return pool[published & (SESSION_POOL_LEN - 1)].data; }
+
+  /**
+   * @brief Publishes the frame encoded into nextFrame() to every client.
+   *
+   * @param len Length of the encoded frame.
+   * @param timeUs Timestamp to measure send latency from, e.g. when the
+   *        data the frame carries was received.
+   */
+  void publish(uint8_t len, uint32_t timeUs) {
+    SessionFrame& f = pool[published & (SESSION_POOL_LEN - 1)];
+    f.len = len;
+    f.publishedUs = timeUs;
+    published++;
+  }
+
+  // Copies a frame into the ring and publishes it
+  void publish(const uint8_t* data, uint8_t len, uint32_t timeUs) {
+    memcpy(nextFrame(), data, len);
+    publish(len, timeUs);
+  }
+
+  /**
+   * @brief Sends queued frames to every connected client.
+   *
+   * A client whose transport refuses a frame keeps it at the head of its
+   * queue for the next call; the others carry on.
+   *
+   * @param transport Transport whose send() carries the frames.
+   * @param nowUs Current time in microseconds, for latency.
+   *
+   * @return uint32_t Frames sent in this call.
+   */
+  template <class Transport>
+  uint32_t service(Transport& transport, uint32_t nowUs) {
+    uint32_t sent = 0;
+    for (uint8_t i = 0; i < count; i++) {
+      ClientSession& c = clients[i];
+      if (c.link.state != LINK_CONNECTED) {
+        continue;
+      }
+      if (published - c.cursor > SESSION_POOL_LEN) {
+        c.stats.dropped += published - c.cursor - SESSION_POOL_LEN;
+        c.cursor = published - SESSION_POOL_LEN;
+      }
+      while (c.cursor != published) {
+        const SessionFrame& f = pool[c.cursor & (SESSION_POOL_LEN - 1)];
+        if (!transport.send(i, f.data, f.len)) {
+          c.stats.refused++;
+          break;
+        }
+        uint32_t latency = nowUs - f.publishedUs;
+        c.stats.frames++;
+        c.stats.bytes += f.len;
+        c.stats.lastUs = latency;
+        c.stats.totalUs += latency;
+        if (latency > c.stats.maxUs) {
+          c.stats.maxUs = latency;
+        }
+        c.cursor++;
+        sent++;
+      }
+    }
+    return sent;
+  }
+};
+
+#endif
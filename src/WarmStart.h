@@ -0,0 +1,310 @@
+#ifndef WARM_START_H
+#define WARM_START_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "GpsConfig.h"
+#include "Geodesy.h"
+#include "PositionFrame.h"
+
+/*
+ * Warm start: what the client knew when it was switched off, kept in NVS
+ * so the next boot can use it before the GPS and the link are back.
+ *
+ * The state is the client's last fix and the master's last position, each
+ * with the UTC time it was taken, the master's Bluetooth address and the
+ * round trip last measured to it. It is stored as one versioned blob with
+ * a CRC, so a blob from another firmware or a torn write reads as nothing:
+ *   [0]      'W'
+ *   [1]      WARM_VERSION
+ *   [2]      flags (WARM_OWN, WARM_MASTER, WARM_PEER)
+ *   [3..4]   boots that have saved a state (uint16)
+ *   [5..12]  own latitude, longitude in micro-degrees (int32)
+ *   [13..16] own fix time, seconds since 2000-01-01 UTC, 0 = unknown
+ *   [17..24] master latitude, longitude in micro-degrees (int32)
+ *   [25..28] master fix time, as for the own fix
+ *   [29..34] master's Bluetooth address
+ *   [35..38] shortest round trip to the master in us (int32)
+ *   [39..40] CRC-16/CCITT-FALSE over bytes [0..38]
+ *
+ * At boot the stored positions go on the LCD at once, and the client's
+ * last fix is handed to the GPS receiver as aiding, so it searches the
+ * right part of the sky instead of all of it:
+ *   UBX   MGA-INI-POS_LLH, position only; it keeps time itself
+ *   PMTK  PMTK741, position and UTC time; the time comes from the
+ *         master's GPS over the link, as the ESP32 has no clock that runs
+ *         while it is switched off
+ *
+ * WarmSaver limits flash wear: a blob is written once the first fix of a
+ * boot arrives, then at most every WARM_SAVE_MIN_MS, and only when a
+ * position has moved WARM_MOVE_M or the master has changed. One 41-byte
+ * blob a minute is about 2000 NVS entries a day, spread over the NVS
+ * partition's pages, which leaves each page far below its erase limit.
+ */
+
+#define WARM_MAGIC 'W'
+#define WARM_VERSION 1
+#define WARM_BLOB_LEN 41
+#define WARM_SAVE_MIN_MS 60000UL    // Shortest time between saves after the first
+#define WARM_MOVE_M 20.0f           // Movement of either position that is worth a save
+#define WARM_AID_ACCURACY_M 5000    // Accuracy claimed for the aiding position; the client may have been carried
+#define WARM_DAY_S 86400UL
+
+#define WARM_OWN 0x01     // Own fix held
+#define WARM_MASTER 0x02  // Master position held
+#define WARM_PEER 0x04    // Master address held
+
+struct WarmState {
+  uint8_t flags;
+  uint16_t boots;
+  int32_t ownLat_e6;
+  int32_t ownLon_e6;
+  uint32_t ownUtc;
+  int32_t masterLat_e6;
+  int32_t masterLon_e6;
+  uint32_t masterUtc;
+  uint8_t peer[6];
+  int32_t rttUs;
+};
+
+/**
+ * @brief Days since 2000-01-01 of a civil date.
+ *
+ * @param y Year, 2000 or later.
+ * @param m Month, 1-12.
+ * @param d Day, 1-31.
+ */
+inline uint32_t warm_days(uint16_t y, uint8_t m, uint8_t d) {
+  // Days from civil, with the year starting in March so the leap day comes last
+  uint32_t yy = (uint32_t)y - (m <= 2);
+  uint32_t era = yy / 400;
+  uint32_t yoe = yy - era * 400;
+  uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 730425;  // 730425 = days from 0000-03-01 to 2000-01-01
+}
+
+// Civil date of a day since 2000-01-01; the inverse of warm_days()
+inline void warm_civil(uint32_t days, uint16_t* y, uint8_t* m, uint8_t* d) {
+  uint32_t z = days + 730425;
+  uint32_t era = z / 146097;
+  uint32_t doe = z - era * 146097;
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  *d = (uint8_t)(doy - (153 * mp + 2) / 5 + 1);
+  *m = (uint8_t)(mp < 10 ? mp + 3 : mp - 9);
+  *y = (uint16_t)(yoe + era * 400 + (*m <= 2));
+}
+
+/**
+ * @brief The UTC time closest to `nearUtc` with a given time of day.
+ *
+ * Dates a time of day, such as a GPS time in a position frame, by a nearby
+ * full time, across midnight if need be.
+ *
+ * @param nearUtc Seconds since 2000-01-01, at least a day in.
+ * @param dayMs Time of day in milliseconds.
+ */
+inline uint32_t warm_utc_near(uint32_t nearUtc, uint32_t dayMs) {
+  uint32_t utc = nearUtc - nearUtc % WARM_DAY_S + dayMs / 1000;
+  if (utc > nearUtc + WARM_DAY_S / 2) {
+    utc -= WARM_DAY_S;
+  } else if (utc + WARM_DAY_S / 2 < nearUtc) {
+    utc += WARM_DAY_S;
+  }
+  return utc;
+}
+
+/**
+ * @brief Encodes the state for NVS.
+ *
+ * @param s The state.
+ * @param out Destination buffer, at least WARM_BLOB_LEN bytes.
+ *
+ * @return size_t Number of bytes written (always WARM_BLOB_LEN).
+ */
+inline size_t warm_encode(const WarmState& s, uint8_t* out) {
+  out[0] = WARM_MAGIC;
+  out[1] = WARM_VERSION;
+  out[2] = s.flags;
+  out[3] = (uint8_t)s.boots;
+  out[4] = (uint8_t)(s.boots >> 8);
+  frame_put32(out + 5, (uint32_t)s.ownLat_e6);
+  frame_put32(out + 9, (uint32_t)s.ownLon_e6);
+  frame_put32(out + 13, s.ownUtc);
+  frame_put32(out + 17, (uint32_t)s.masterLat_e6);
+  frame_put32(out + 21, (uint32_t)s.masterLon_e6);
+  frame_put32(out + 25, s.masterUtc);
+  memcpy(out + 29, s.peer, 6);
+  frame_put32(out + 35, (uint32_t)s.rttUs);
+  uint16_t crc = frame_crc16(out, WARM_BLOB_LEN - 2);
+  out[WARM_BLOB_LEN - 2] = (uint8_t)crc;
+  out[WARM_BLOB_LEN - 1] = (uint8_t)(crc >> 8);
+  return WARM_BLOB_LEN;
+}
+
+/**
+ * @brief Decodes a blob read from NVS.
+ *
+ * @return true If it is a whole blob of this version; otherwise `s` is
+ *         left empty.
+ */
+inline bool warm_decode(const uint8_t* p, size_t len, WarmState* s) {
+  *s = WarmState();
+  if (len != WARM_BLOB_LEN || p[0] != WARM_MAGIC || p[1] != WARM_VERSION ||
+      frame_crc16(p, WARM_BLOB_LEN - 2) != (uint16_t)(p[WARM_BLOB_LEN - 2] | p[WARM_BLOB_LEN - 1] << 8)) {
+    return false;
+  }
+  s->flags = p[2];
+  s->boots = (uint16_t)(p[3] | p[4] << 8);
+  s->ownLat_e6 = (int32_t)frame_get32(p + 5);
+  s->ownLon_e6 = (int32_t)frame_get32(p + 9);
+  s->ownUtc = frame_get32(p + 13);
+  s->masterLat_e6 = (int32_t)frame_get32(p + 17);
+  s->masterLon_e6 = (int32_t)frame_get32(p + 21);
+  s->masterUtc = frame_get32(p + 25);
+  memcpy(s->peer, p + 29, 6);
+  s->rttUs = (int32_t)frame_get32(p + 35);
+  return true;
+}
+
+/**
+ * @brief Builds the UBX MGA-INI-POS_LLH aiding message for a position.
+ *
+ * @param out Destination buffer, at least 28 bytes.
+ *
+ * @return size_t Length of the message.
+ */
+inline size_t warm_ubx_aid(int32_t lat_e6, int32_t lon_e6, uint8_t* out) {
+  uint8_t payload[20] = { 0x01 };  // Type 1: position as latitude, longitude and height
+  gps_put32(payload + 4, (uint32_t)(lat_e6 * 10));  // 1e-7 degrees
+  gps_put32(payload + 8, (uint32_t)(lon_e6 * 10));
+  gps_put32(payload + 12, 0);                       // Height unknown; the accuracy covers it
+  gps_put32(payload + 16, WARM_AID_ACCURACY_M * 100UL);
+  return gps_ubx(out, GPS_UBX_CLASS_MGA, GPS_UBX_MGA_INI, payload, sizeof(payload));
+}
+
+/**
+ * @brief Builds the PMTK741 time and position aiding sentence.
+ *
+ * @param utc The current time, seconds since 2000-01-01.
+ * @param out Destination buffer, at least 80 bytes.
+ *
+ * @return size_t Length of the sentence including CR LF.
+ */
+inline size_t warm_pmtk_aid(int32_t lat_e6, int32_t lon_e6, uint32_t utc, char* out) {
+  uint16_t y;
+  uint8_t mo, d;
+  warm_civil(utc / WARM_DAY_S, &y, &mo, &d);
+  uint32_t s = utc % WARM_DAY_S;
+  char body[72];
+  snprintf(body, sizeof(body), "PMTK741,%s%ld.%06ld,%s%ld.%06ld,0,%u,%02u,%02u,%02lu,%02lu,%02lu",
+           lat_e6 < 0 ? "-" : "", (long)(lat_e6 < 0 ? -lat_e6 : lat_e6) / 1000000,
+           (long)(lat_e6 < 0 ? -lat_e6 : lat_e6) % 1000000, lon_e6 < 0 ? "-" : "",
+           (long)(lon_e6 < 0 ? -lon_e6 : lon_e6) / 1000000, (long)(lon_e6 < 0 ? -lon_e6 : lon_e6) % 1000000,
+           y, mo, d, (unsigned long)(s / 3600), (unsigned long)(s / 60 % 60), (unsigned long)(s % 60));
+  return gps_pmtk(out, body);
+}
+
+/**
+ * @brief Decides when the state is worth writing to flash.
+ */
+struct WarmSaver {
+  bool saved = false;      // Written this boot
+  uint32_t lastMs = 0;     // When
+  WarmState last = {};     // What
+  uint32_t saves = 0;
+
+  bool due(const WarmState& s, uint32_t nowMs) const {
+    if (!(s.flags & WARM_OWN)) {
+      return false;  // Nothing from this boot yet
+    }
+    if (!saved) {
+      return true;
+    }
+    if (nowMs - lastMs < WARM_SAVE_MIN_MS) {
+      return false;
+    }
+    if (s.flags != last.flags || memcmp(s.peer, last.peer, 6) != 0) {
+      return true;
+    }
+    return geo_distance_e6(s.ownLat_e6, s.ownLon_e6, last.ownLat_e6, last.ownLon_e6) >= WARM_MOVE_M ||
+           geo_distance_e6(s.masterLat_e6, s.masterLon_e6, last.masterLat_e6, last.masterLon_e6) >= WARM_MOVE_M;
+  }
+
+  void done(const WarmState& s, uint32_t nowMs) {
+    saved = true;
+    lastMs = nowMs;
+    last = s;
+    saves++;
+  }
+};
+
+// Milestones of a boot, in the order they are printed
+enum BootStage {
+  BOOT_LCD,          // Stored state, or the placeholder, on the LCD
+  BOOT_GPS_SETUP,    // Receiver configured
+  BOOT_AIDED,        // Aiding sent to the receiver
+  BOOT_CONNECTED,    // Master connected
+  BOOT_MASTER,       // First position from the master
+  BOOT_FIX,          // First own fix
+  BOOT_LIVE,         // LCD from a live fix and a live master position
+  BOOT_STAGES
+};
+
+const char* const BOOT_STAGE_NAMES[BOOT_STAGES] = {
+  "lcd", "gps setup", "aided", "master connected", "master position", "own fix", "live"
+};
+
+#define BOOT_PENDING 0xFFFFFFFFUL
+
+/**
+ * @brief Time from power-up to each BootStage, marked from any task.
+ */
+struct BootTimeline {
+  std::atomic<uint32_t> at[BOOT_STAGES];
+
+  BootTimeline() {
+    for (int i = 0; i < BOOT_STAGES; i++) {
+      at[i].store(BOOT_PENDING, std::memory_order_relaxed);
+    }
+  }
+
+  // Records the first time a stage is reached; later calls are ignored
+  void mark(BootStage stage, uint32_t ms) {
+    uint32_t pending = BOOT_PENDING;
+    at[stage].compare_exchange_strong(pending, ms, std::memory_order_relaxed);
+  }
+
+  bool reached(BootStage stage) const { return at[stage].load(std::memory_order_relaxed) != BOOT_PENDING; }
+
+  /**
+   * @brief Formats the stages reached, e.g. "lcd 3 ms, own fix 4210 ms".
+   *
+   * @return size_t Length written, without the NUL.
+   */
+  size_t format(char* out, size_t size) const {
+    size_t len = 0;
+    out[0] = '\0';
+    for (int i = 0; i < BOOT_STAGES && len < size; i++) {
+      uint32_t ms = at[i].load(std::memory_order_relaxed);
+      if (ms == BOOT_PENDING) {
+        continue;
+      }
+      int n = snprintf(out + len, size - len, "%s%s %lu ms", len ? ", " : "", BOOT_STAGE_NAMES[i], (unsigned long)ms);
+      if (n < 0) {
+        break;
+      }
+      len += (size_t)n;
+    }
+    return len < size ? len : size - 1;
+  }
+};
+
+#endif